@@ -1,31 +1,108 @@
-#include "LightCB.hlsli"
-
-float3 CalculateColor(in float3 objColor, in float3 objNormal, in float3 pos, in float shine, in bool trans)
-{
-    float3 finalColor = float3(0, 0, 0);
-
-    for (int i = 0; i < lightCount.x; i++)
-    {
-        float3 norm = objNormal;
-
-        float3 lightDir = lightPos[i].xyz - pos;
-        float lightDist = length(lightDir);
-        lightDir /= lightDist;
-
-        float atten = clamp(1.0 / (lightDist * lightDist), 0, 1);
-
-        if (trans && dot(lightDir, objNormal) < 0.0)
-        {
-            norm = -norm;
-        }
-        finalColor += objColor * max(dot(lightDir, norm), 0) * atten * lightColor[i].xyz;
-
-        float3 viewDir = normalize(cameraPos.xyz - pos);
-        float3 reflectDir = reflect(-lightDir, norm);
-        float spec = shine > 0 ? pow(max(dot(viewDir, reflectDir), 0.0), shine) : 0.0;
-
-        finalColor += objColor * 0.5 * spec * lightColor[i].xyz;
-    }
-
-    return finalColor;
-}
+#include "SceneCB.hlsli"
+
+// ClusterLight from structures.h, w of the position is the influence radius
+struct ClusterLight
+{
+    float4 positionRange;
+    float4 color;
+};
+
+// Written by Light::assignClusters every frame
+StructuredBuffer<ClusterLight> clusterLights : register(t8);
+StructuredBuffer<uint2> clusterRanges : register(t9); // offset, count in clusterIndices
+StructuredBuffer<uint> clusterIndices : register(t10);
+
+// The skybox prefiltered by Skybox, mip m holds the GGX lobe of roughness m / environmentParams.x
+TextureCube environmentMap : register(t11);
+
+uint GetCluster(in float4 screenPos)
+{
+    uint2 tile = min(uint2(screenPos.xy * clusterScale.xy), uint2(clusterGrid.xy - 1));
+    // w of SV_Position is the view depth
+    int slice = clamp(int(floor(log(screenPos.w) * clusterScale.z + clusterScale.w)), 0, clusterGrid.z - 1);
+    return (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x;
+}
+
+float3 ShadeLight(in ClusterLight light, in float3 objColor, in float3 objNormal, in float3 pos, in float shine, in bool trans)
+{
+    float3 norm = objNormal;
+
+    float3 lightDir = light.positionRange.xyz - pos;
+    float lightDist = length(lightDir);
+    lightDir /= lightDist;
+
+    // fades to zero at the influence radius, so the light can stop at its clusters
+    float falloff = lightDist / light.positionRange.w;
+    float window = saturate(1.0 - falloff * falloff * falloff * falloff);
+    window *= window;
+    float atten = clamp(1.0 / (lightDist * lightDist), 0, 1) * window;
+
+    if (trans && dot(lightDir, objNormal) < 0.0)
+    {
+        norm = -norm;
+    }
+    float3 color = objColor * max(dot(lightDir, norm), 0) * atten * light.color.xyz;
+
+    float3 viewDir = normalize(cameraPos.xyz - pos);
+    float3 reflectDir = reflect(-lightDir, norm);
+    float spec = shine > 0 ? pow(max(dot(viewDir, reflectDir), 0.0), shine) : 0.0;
+
+    return color + objColor * 0.5 * spec * window * light.color.xyz;
+}
+
+float3 CalculateColor(in float4 screenPos, in float3 objColor, in float3 objNormal, in float3 pos, in float shine, in bool trans)
+{
+    float3 finalColor = float3(0, 0, 0);
+
+    uint2 range = clusterRanges[GetCluster(screenPos)];
+    for (uint k = 0; k < range.y; k++)
+    {
+        finalColor += ShadeLight(clusterLights[clusterIndices[range.x + k]], objColor, objNormal, pos, shine, trans);
+    }
+
+    return finalColor;
+}
+
+// Diffuse sky light over pi from the SH9 irradiance of the skybox, albedo times it is the color
+float3 EvaluateIrradiance(in float3 n)
+{
+    float4 n1 = float4(n, 1.0);
+    float4 n2 = n.xyzz * n.yzzx;
+    float3 color;
+    color.r = dot(irradianceSH[0], n1) + dot(irradianceSH[3], n2);
+    color.g = dot(irradianceSH[1], n1) + dot(irradianceSH[4], n2);
+    color.b = dot(irradianceSH[2], n1) + dot(irradianceSH[5], n2);
+    color += irradianceSH[6].rgb * (n.x * n.x - n.y * n.y);
+    return max(color, 0.0);
+}
+
+// Image-based ambient light: the irradiance for the diffuse part and one fetch of the
+// prefiltered sky for the specular part, the Phong exponent taken to a GGX roughness
+float3 CalculateAmbient(in SamplerState smplr, in float3 objColor, in float3 objNormal, in float3 pos, in float shine)
+{
+    float3 color = objColor * EvaluateIrradiance(objNormal);
+    if (shine > 0)
+    {
+        float3 viewDir = normalize(cameraPos.xyz - pos);
+        float3 reflectDir = reflect(-viewDir, objNormal);
+        float roughness = sqrt(sqrt(2.0 / (shine + 2.0)));
+        color += objColor * 0.5 * environmentMap.SampleLevel(smplr, reflectDir, roughness * environmentParams.x).rgb;
+    }
+    return color * environmentParams.y;
+}
+
+// Same lighting from a fixed list of INSTANCE_LIGHTS 16-bit light indices, 0xFFFF ends the list
+float3 CalculateInstanceColor(in uint2 lights, in float3 objColor, in float3 objNormal, in float3 pos, in float shine, in bool trans)
+{
+    float3 finalColor = float3(0, 0, 0);
+
+    for (uint k = 0; k < INSTANCE_LIGHTS; k++)
+    {
+        uint index = ((k < 2 ? lights.x : lights.y) >> ((k & 1) * 16)) & 0xFFFF;
+        if (index == 0xFFFF)
+            break;
+        finalColor += ShadeLight(clusterLights[index], objColor, objNormal, pos, shine, trans);
+    }
+
+    return finalColor;
+}
@@ -1,4 +1,18 @@
-#define MAX_LIGHTS 8
-#define MAX_CUBES 6
-#define SCENE_SIZE 8
-#define MAX_QUERY 10
\ No newline at end of file
+#define MAX_LIGHTS 8
+#define MAX_LIGHT_LODS 4
+#define CUBES_COUNT 6
+#define SCENE_SIZE 8
+#define MAX_QUERY 10
+#define CULL_GROUP_SIZE 64
+#define MAX_DISPATCH_GROUPS 65535
+#define MAX_OCCLUDERS 512
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+#define MAX_CLUSTER_LIGHTS 4096
+#define MAX_CLUSTER_INDICES 65536
+#define INSTANCE_LIGHTS 4
+#define LIGHTING_CLUSTERED 0
+#define LIGHTING_INSTANCE 1
+#define STATIC_CUBES_COUNT 16
+#define BAKED_NONE 0xFFFFFFFF
\ No newline at end of file
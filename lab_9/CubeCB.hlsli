@@ -1,24 +1,50 @@
-#include "Consts.h"
-
-struct CubeGeomBuffer
-{
-    float4x4 worldMatrix;
-    float4x4 norm;
-    float4 cubeParams;
-};
-
-cbuffer CubeGeomBuffers : register(b0)
-{
-    CubeGeomBuffer geomBuffers[MAX_CUBES];
-};
-
-cbuffer SceneCB : register(b1)
-{
-    float4x4 viewProjectionMatrix;
-    float4 planes[6];
-};
-
-cbuffer IndexBuffer : register(b2)
-{
-    uint4 objectID[MAX_CUBES];
-}
\ No newline at end of file
+#include "Consts.h"
+
+// PackedInstance from instancePacking.h
+struct CubeGeomBuffer
+{
+    float3 position;
+    float scale;
+    uint2 rotation;
+    uint2 params;
+};
+
+StructuredBuffer<CubeGeomBuffer> geomBuffers : register(t2);
+
+// INSTANCE_LIGHTS 16-bit light indices per slot, brightest first, 0xFFFF - none (Cube::selectLights)
+StructuredBuffer<uint2> instanceLights : register(t4);
+
+// First baked vertex of every slot, BAKED_NONE for the moving cubes (Cube::bakeStaticLighting)
+StructuredBuffer<uint> bakedOffsets : register(t5);
+// Four halves per vertex: light of the baked lights for a white surface, sky visibility
+StructuredBuffer<uint2> bakedVertices : register(t6);
+
+// Four snorm16, x and z in the low halves
+float4 DecodeRotation(uint2 rotation)
+{
+    int2 low = int2(rotation << 16) >> 16;
+    int2 high = int2(rotation) >> 16;
+    float4 q = float4(low.x, high.x, low.y, high.y) / 32767.0f;
+    return normalize(q);
+}
+
+float3 RotateVector(float4 q, float3 v)
+{
+    return v + 2.0f * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+float4 DecodeParams(uint2 params)
+{
+    return float4(f16tof32(params.x), f16tof32(params.x >> 16), f16tof32(params.y), f16tof32(params.y >> 16));
+}
+
+// R16G16_SNORM octahedral direction to a unit vector
+float3 OctDecode(float2 e)
+{
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+StructuredBuffer<uint> objectID : register(t3);
\ No newline at end of file
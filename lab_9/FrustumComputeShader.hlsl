@@ -1,46 +1,48 @@
-#include "CubeCB.hlsli"
-
-cbuffer CullingParams : register(b0)
-{
-    uint4 numShapes;
-    float4 bbMin[MAX_CUBES];
-    float4 bbMax[MAX_CUBES];
-}
-
-RWStructuredBuffer<uint> indirectArgs : register(u0);
-RWStructuredBuffer<uint4> objectsIds : register(u1);
-
-bool IsInFrustum(in float4 planes[6], in float3 bbMin, in float3 bbMax)
-{
-    for (int i = 0; i < 6; i++)
-    {
-        if ((planes[i].x * bbMin.x) + (planes[i].y * bbMin.y) + (planes[i].z * bbMin.z) + (planes[i].w * 1.0f) >= 0.0f ||
-        (planes[i].x * bbMax.x) + (planes[i].y * bbMin.y) + (planes[i].z * bbMin.z) + (planes[i].w * 1.0f) >= 0.0f ||
-        (planes[i].x * bbMin.x) + (planes[i].y * bbMin.y) + (planes[i].z * bbMin.z) + (planes[i].w * 1.0f) >= 0.0f ||
-        (planes[i].x * bbMax.x) + (planes[i].y * bbMax.y) + (planes[i].z * bbMin.z) + (planes[i].w * 1.0f) >= 0.0f ||
-        (planes[i].x * bbMin.x) + (planes[i].y * bbMin.y) + (planes[i].z * bbMax.z) + (planes[i].w * 1.0f) >= 0.0f ||
-        (planes[i].x * bbMax.x) + (planes[i].y * bbMin.y) + (planes[i].z * bbMax.z) + (planes[i].w * 1.0f) >= 0.0f ||
-        (planes[i].x * bbMin.x) + (planes[i].y * bbMax.y) + (planes[i].z * bbMax.z) + (planes[i].w * 1.0f) >= 0.0f ||
-        (planes[i].x * bbMax.x) + (planes[i].y * bbMax.y) + (planes[i].z * bbMax.z) + (planes[i].w * 1.0f) >= 0.0f)
-            continue;
-        else
-            return false;
-    }
-
-    return true;
-}
-
-[numthreads(64, 1, 1)]
-void main(uint3 globalThreadId : SV_DispatchThreadID)
-{
-    if (globalThreadId.x >= numShapes.x)
-    {
-        return;
-    }
-    if (IsInFrustum(planes, bbMin[globalThreadId.x].xyz, bbMax[globalThreadId.x].xyz))
-    {
-        uint id = 0;
-        InterlockedAdd(indirectArgs[1], 1, id);
-        objectsIds[id] = uint4(globalThreadId.x, 0, 0, 0);
-    }
+#include "CubeCB.hlsli"
+
+cbuffer CullingParams : register(b0)
+{
+    uint4 numShapes;
+    float4 planes[6];
+}
+
+struct CullingBounds
+{
+    float4 bbMin; // w < 0 - free slot
+    float4 bbMax;
+};
+
+StructuredBuffer<CullingBounds> bounds : register(t0);
+
+RWStructuredBuffer<uint> indirectArgs : register(u0);
+RWStructuredBuffer<uint> objectsIds : register(u1);
+
+bool IsInFrustum(in float4 planes[6], in float3 bbMin, in float3 bbMax)
+{
+    float3 center = (bbMin + bbMax) * 0.5f;
+    float3 extent = abs(bbMax - bbMin) * 0.5f;
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (dot(planes[i].xyz, center) + planes[i].w + dot(abs(planes[i].xyz), extent) < 0.0f)
+            return false;
+    }
+
+    return true;
+}
+
+[numthreads(CULL_GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    uint index = (groupId.y * MAX_DISPATCH_GROUPS + groupId.x) * CULL_GROUP_SIZE + groupIndex;
+    if (index >= numShapes.x || bounds[index].bbMin.w < 0.0f)
+    {
+        return;
+    }
+    if (IsInFrustum(planes, bounds[index].bbMin.xyz, bounds[index].bbMax.xyz))
+    {
+        uint id = 0;
+        InterlockedAdd(indirectArgs[1], 1, id);
+        objectsIds[id] = index;
+    }
 }
\ No newline at end of file
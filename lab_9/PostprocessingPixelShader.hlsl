@@ -1,53 +1,63 @@
-Texture2D sourceTexture : register(t0);
-SamplerState Sampler : register(s0);
-
-cbuffer PostEffectConstantBuffer : register(b0)
-{
-    int4 params; // x - use posteffect, y - screen width, z - screen height
-};
-
-struct PS_INPUT
-{
-    float4 pos : SV_POSITION;
-    float2 tex : TEXCOORD;
-};
-
-float4 main(PS_INPUT input) : SV_TARGET
-{
-    float3 x_color = float3(0.0, 0.0, 0.0);
-    float3 y_color = float3(0.0, 0.0, 0.0);
-    float3 color = float3(0.0, 0.0, 0.0);
-    
-    if (params.x > 0) {
-        float x_kernel[3][3] =
-        {
-            { -1.0, 0.0, 1.0 },
-            { -2.0, 0.0, 2.0 },
-            { -1.0, 0.0, 1.0 }
-        };
-        
-        float y_kernel[3][3] =
-        {
-            { 1.0, 2.0, 1.0 },
-            { 0.0, 0.0, 0.0 },
-            { -1.0, -2.0, -1.0 }
-        };
-        
-        for (int i = -1; i <= 1; i++)
-        {
-            for (int j = -1; j <= 1; j++)
-            {
-                float2 texOffset = normalize(float2(i, j));
-                x_color += sourceTexture.Sample(Sampler, input.tex + float2(i, j) / float2(params.y, params.z)).xyz * x_kernel[i + 1][j + 1];
-                y_color += sourceTexture.Sample(Sampler, input.tex + float2(i, j) / float2(params.y, params.z)).xyz * y_kernel[i + 1][j + 1];
-            }
-        }
-        color = sqrt(x_color * x_color + y_color * y_color);
-    }
-    else
-    {
-        color = sourceTexture.Sample(Sampler, input.tex).xyz;
-    }
-    
-    return float4(color, 1.0f);
+Texture2D sourceTexture : register(t0);
+SamplerState Sampler : register(s0);
+
+cbuffer PostEffectConstantBuffer : register(b0)
+{
+    int4 params;     // x - pass (PostPass), y - screen width, z - screen height, w - blur direction (0 - x, 1 - y)
+    float4 settings; // x - exposure
+};
+
+// Gaussian of sigma ~2 over 9 texels, the weights of offsets 0 to 4
+static const float blurWeights[5] = { 0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216 };
+
+struct PS_INPUT
+{
+    float4 pos : SV_POSITION;
+    float2 tex : TEXCOORD;
+};
+
+float4 main(PS_INPUT input) : SV_TARGET
+{
+    float3 color = float3(0.0, 0.0, 0.0);
+    float2 texelSize = 1.0 / float2(params.y, params.z);
+
+    if (params.x == 1) {
+        // Every neighbour is fetched once, s[i + 1][j + 1] is the texel at offset (i, j). Both
+        // kernels are separable: x_color is the [1 2 1] sum of the row below minus the row
+        // above and y_color that of the left minus the right column, the same as weighting the
+        // neighbourhood with { -1, 0, 1 }, { -2, 0, 2 }, { -1, 0, 1 } and { 1, 2, 1 }, { 0, 0, 0 }, { -1, -2, -1 }.
+        float3 s[3][3];
+        for (int i = -1; i <= 1; i++)
+        {
+            for (int j = -1; j <= 1; j++)
+            {
+                s[i + 1][j + 1] = sourceTexture.Sample(Sampler, input.tex + float2(i, j) * texelSize).xyz;
+            }
+        }
+        float3 x_color = (s[0][2] + 2.0 * s[1][2] + s[2][2]) - (s[0][0] + 2.0 * s[1][0] + s[2][0]);
+        float3 y_color = (s[0][0] + 2.0 * s[0][1] + s[0][2]) - (s[2][0] + 2.0 * s[2][1] + s[2][2]);
+        color = sqrt(x_color * x_color + y_color * y_color);
+    }
+    else if (params.x == 2)
+    {
+        // One direction of the separable blur, the other one is the next pass
+        float2 step = params.w == 0 ? float2(texelSize.x, 0.0) : float2(0.0, texelSize.y);
+        color = sourceTexture.Sample(Sampler, input.tex).xyz * blurWeights[0];
+        for (int i = 1; i < 5; i++)
+        {
+            color += (sourceTexture.Sample(Sampler, input.tex + step * i).xyz +
+                sourceTexture.Sample(Sampler, input.tex - step * i).xyz) * blurWeights[i];
+        }
+    }
+    else if (params.x == 3)
+    {
+        color = sourceTexture.Sample(Sampler, input.tex).xyz * settings.x;
+        color = color / (1.0 + color);
+    }
+    else
+    {
+        color = sourceTexture.Sample(Sampler, input.tex).xyz;
+    }
+    
+    return float4(color, 1.0f);
 }
\ No newline at end of file
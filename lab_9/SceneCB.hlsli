@@ -1,9 +1,13 @@
-cbuffer SceneMatrixBuffer : register(b1)
-{
-    float4x4 viewProjectionMatrix;
-    float4 cameraPos;
-    int4 lightCount;
-    float4 lightPos[10];
-    float4 lightColor[10];
-    float4 ambientColor;
+#include "Consts.h"
+
+// SceneCB from structures.h, shared by all the passes of a frame
+cbuffer SceneCB : register(b1)
+{
+    float4x4 viewProjectionMatrix;
+    float4 cameraPos;
+    int4 clusterGrid;
+    float4 clusterScale;
+    float4 ambientColor;
+    float4 irradianceSH[7];
+    float4 environmentParams;
 };
\ No newline at end of file
@@ -1,36 +1,57 @@
-#include "CubeCB.hlsli"
-
-struct VS_INPUT
-{
-    float3 position : POSITION;
-    float2 uv : TEXCOORD;
-    float3 normal : NORMAL;
-    float3 tangent : TANGENT;
-    uint instanceId : SV_InstanceID;
-};
-
-struct PS_INPUT
-{
-    float4 position : SV_POSITION;
-    float4 worldPos : POSITION;
-    float2 uv : TEXCOORD;
-    float3 normal : NORMAL;
-    float3 tangent : TANGENT;
-    float3 binormal : BINORMAL;
-    nointerpolation uint instanceId : INST_ID;
-};
-
-PS_INPUT main(VS_INPUT input)
-{
-    PS_INPUT output;
-
-    unsigned int idx = objectID[input.instanceId].x;
-    output.worldPos = mul(geomBuffers[idx].worldMatrix, float4(input.position, 1.0f));
-    output.position = mul(viewProjectionMatrix, output.worldPos);
-    output.normal = mul(geomBuffers[idx].norm, float4(input.normal, 0.0f)).xyz;
-    output.tangent = mul(geomBuffers[idx].norm, float4(input.tangent, 0.0f)).xyz;
-    output.binormal = normalize(cross(output.normal, output.tangent));
-    output.uv = input.uv;
-    output.instanceId = idx;
-    return output;
-}
+#include "CubeCB.hlsli"
+#include "SceneCB.hlsli"
+
+// VertexQuantization from vertexPacking.h
+cbuffer MeshCB : register(b0)
+{
+    float4 positionScale;
+    float4 positionOffset;
+};
+
+struct VS_INPUT
+{
+    float4 position : POSITION; // unorm in the mesh bounds, w is the tangent handedness
+    float2 uv : TEXCOORD;
+    float2 normal : NORMAL;
+    float2 tangent : TANGENT;
+    uint vertexId : SV_VertexID;
+    uint instanceId : SV_InstanceID;
+};
+
+struct PS_INPUT
+{
+    float4 position : SV_POSITION;
+    float4 worldPos : POSITION;
+    float2 uv : TEXCOORD;
+    float3 normal : NORMAL;
+    float3 tangent : TANGENT;
+    float3 binormal : BINORMAL;
+    float4 baked : BAKED; // a < 0 for the cubes that are not baked
+    nointerpolation uint instanceId : INST_ID;
+};
+
+PS_INPUT main(VS_INPUT input)
+{
+    PS_INPUT output;
+
+    unsigned int idx = objectID[input.instanceId];
+    CubeGeomBuffer geom = geomBuffers[idx];
+    float4 rotation = DecodeRotation(geom.rotation);
+    float3 position = input.position.xyz * positionScale.xyz + positionOffset.xyz;
+    float handedness = input.position.w * 2.0f - 1.0f;
+    output.worldPos = float4(RotateVector(rotation, position * geom.scale) + geom.position, 1.0f);
+    output.position = mul(viewProjectionMatrix, output.worldPos);
+    output.normal = RotateVector(rotation, OctDecode(input.normal));
+    output.tangent = RotateVector(rotation, OctDecode(input.tangent));
+    output.binormal = handedness * normalize(cross(output.normal, output.tangent));
+    output.uv = input.uv;
+    output.baked = float4(0.0f, 0.0f, 0.0f, -1.0f);
+    uint bakedOffset = bakedOffsets[idx];
+    if (bakedOffset != BAKED_NONE)
+    {
+        uint2 baked = bakedVertices[bakedOffset + input.vertexId];
+        output.baked = float4(f16tof32(baked.x), f16tof32(baked.x >> 16), f16tof32(baked.y), f16tof32(baked.y >> 16));
+    }
+    output.instanceId = idx;
+    return output;
+}
@@ -1,27 +1,27 @@
-#pragma once
-
-#include <d3d11.h>
-#include <DirectXMath.h>
-
-using namespace DirectX;
-
-constexpr float movement_downshifting = 300.f;
-
-class Camera {
-public:
-	HRESULT init();
-	void realize() {};
-	void frame();
-	void getViewMatrix(XMMATRIX& viewMatrix);
-	XMFLOAT3 getPos();
-	void move(float dx, float dy);
-	void updateDistance(float wheel);
-
-private:
-	XMMATRIX viewMatrix;
-	XMFLOAT3 pointOfInterest;
-
-	float distanceToPoint;
-	float phi;
-	float theta;
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+
+using namespace DirectX;
+
+constexpr float movement_downshifting = 300.f;
+
+class Camera {
+public:
+	HRESULT init();
+	void realize() {};
+	void frame();
+	void getViewMatrix(XMMATRIX& viewMatrix);
+	XMFLOAT3 getPos();
+	void move(float dx, float dy);
+	void updateDistance(float wheel);
+
+private:
+	XMMATRIX viewMatrix;
+	XMFLOAT3 pointOfInterest;
+
+	float distanceToPoint;
+	float phi;
+	float theta;
 };
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include <atomic>
+#include <cstring>
+
+#include "commandList.h"
+#include "jobSystem.h"
+
+// Uploaded structures hold 16-byte aligned matrices.
+static const uint32_t PAYLOAD_ALIGNMENT = 16;
+
+Command& CommandList::push(CommandType type, GpuHandle object, ShaderStage stage, uint32_t slot) {
+    Command command = {};
+    command.type = type;
+    command.stage = stage;
+    command.slot = uint16_t(slot);
+    command.object = object;
+    commands.push_back(command);
+    return commands.back();
+}
+
+uint32_t CommandList::pushPayload(const void* data, uint32_t size) {
+    uint32_t offset = uint32_t((payload.size() + PAYLOAD_ALIGNMENT - 1) & ~size_t(PAYLOAD_ALIGNMENT - 1));
+    payload.resize(offset + size);
+    if (data != nullptr && size > 0)
+        memcpy(payload.data() + offset, data, size);
+    return offset;
+}
+
+void CommandList::setConstantBlocks(ShaderStage stage, uint32_t slot, uint32_t count, const uint32_t* blocks) {
+    uint32_t first = pushPayload(blocks, count * sizeof(uint32_t));
+    Command& command = push(COMMAND_SET_CONSTANT_BLOCKS, nullptr, stage, slot);
+    command.first = first;
+    command.count = count;
+}
+
+void CommandList::setIndexBuffer(GpuHandle buffer, uint32_t format, uint32_t offset) {
+    Command& command = push(COMMAND_SET_INDEX_BUFFER, buffer);
+    command.args[0] = format;
+    command.args[1] = offset;
+}
+
+void CommandList::setViewport(float x, float y, float width, float height, float minDepth, float maxDepth) {
+    const float viewport[6] = { x, y, width, height, minDepth, maxDepth };
+    uint32_t first = pushPayload(viewport, sizeof(viewport));
+    Command& command = push(COMMAND_SET_VIEWPORT, nullptr, SHADER_STAGE_PIXEL);
+    command.first = first;
+    command.count = sizeof(viewport);
+}
+
+void CommandList::clearRenderTarget(GpuHandle view, const float color[4]) {
+    uint32_t first = pushPayload(color, 4 * sizeof(float));
+    Command& command = push(COMMAND_CLEAR_RENDER_TARGET, view, SHADER_STAGE_PIXEL);
+    command.first = first;
+    command.count = 4 * sizeof(float);
+}
+
+void CommandList::clearDepth(GpuHandle view, float depth) {
+    Command& command = push(COMMAND_CLEAR_DEPTH, view, SHADER_STAGE_PIXEL);
+    memcpy(&command.args[0], &depth, sizeof(depth));
+}
+
+void CommandList::pushUpdate(GpuHandle buffer, const void* data, uint32_t offset, uint32_t size, bool range) {
+    uint32_t first = pushPayload(data, size);
+    Command& command = push(COMMAND_UPDATE_BUFFER, buffer);
+    command.first = first;
+    command.count = size;
+    command.args[0] = offset;
+    command.args[1] = range ? 1 : 0;
+}
+
+void* CommandList::writeBuffer(GpuHandle buffer, uint32_t size) {
+    uint32_t first = pushPayload(nullptr, size);
+    Command& command = push(COMMAND_WRITE_BUFFER, buffer);
+    command.first = first;
+    command.count = size;
+    return payload.data() + first;
+}
+
+void* CommandList::writeConstants(uint32_t block, uint32_t size) {
+    uint32_t first = pushPayload(nullptr, size);
+    Command& command = push(COMMAND_WRITE_CONSTANTS, nullptr);
+    command.first = first;
+    command.count = size;
+    command.args[0] = block;
+    return payload.data() + first;
+}
+
+void CommandList::copyResource(GpuHandle destination, GpuHandle source) {
+    pushBind(COMMAND_COPY_RESOURCE, SHADER_STAGE_COMPUTE, 0, 1, &source);
+    commands.back().object = destination;
+}
+
+void CommandList::draw(uint32_t vertexCount, uint32_t startVertex) {
+    Command& command = push(COMMAND_DRAW, nullptr, SHADER_STAGE_PIXEL);
+    command.args[0] = vertexCount;
+    command.args[1] = startVertex;
+}
+
+void CommandList::drawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) {
+    Command& command = push(COMMAND_DRAW_INDEXED, nullptr, SHADER_STAGE_PIXEL);
+    command.args[0] = indexCount;
+    command.args[1] = startIndex;
+    command.args[2] = uint32_t(baseVertex);
+}
+
+void CommandList::drawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) {
+    Command& command = push(COMMAND_DRAW_INDEXED_INSTANCED, nullptr, SHADER_STAGE_PIXEL);
+    command.args[0] = indexCount;
+    command.args[1] = instanceCount;
+    command.args[2] = startIndex;
+    command.args[3] = uint32_t(baseVertex);
+    command.args[4] = startInstance;
+}
+
+void CommandList::dispatch(uint32_t x, uint32_t y, uint32_t z) {
+    Command& command = push(COMMAND_DISPATCH, nullptr, SHADER_STAGE_COMPUTE);
+    command.args[0] = x;
+    command.args[1] = y;
+    command.args[2] = z;
+}
+
+void CommandList::replay(CommandBackend& backend) const {
+    for (const Command& command : commands) {
+        if (command.type == COMMAND_EXECUTE_LIST)
+            static_cast<const CommandList*>(command.object)->replay(backend);
+        else
+            backend.execute(*this, command);
+    }
+}
+
+void recordParallel(CommandList& commands, std::vector<CommandList>& parts, size_t count,
+        const std::function<void(size_t part, CommandList& list)>& record) {
+    if (parts.size() < count)
+        parts.resize(count);
+
+    JobSystem::GetInstance().parallelFor(count, 1, [&](size_t begin, size_t end) {
+        for (size_t part = begin; part < end; part++) {
+            parts[part].clear();
+            record(part, parts[part]);
+        }
+    });
+
+    for (size_t part = 0; part < count; part++)
+        commands.executeList(parts[part]);
+}
+
+uint32_t newConstantBlock() {
+    static std::atomic<uint32_t> blocks(0);
+    return blocks++;
+}
+
+size_t CommandStats::getTotal() const {
+    size_t total = 0;
+    for (size_t count : commands)
+        total += count;
+    return total;
+}
+
+size_t CommandStats::getDraws() const {
+    return commands[COMMAND_DRAW] + commands[COMMAND_DRAW_INDEXED] + commands[COMMAND_DRAW_INDEXED_INSTANCED] +
+        commands[COMMAND_DRAW_INDEXED_INSTANCED_INDIRECT] + commands[COMMAND_DISPATCH];
+}
+
+size_t CommandStats::getBinds() const {
+    size_t binds = 0;
+    for (int type = COMMAND_SET_SHADER; type <= COMMAND_SET_VIEWPORT; type++)
+        binds += commands[type];
+    return binds;
+}
+
+void CountingBackend::execute(const CommandList&, const Command& command) {
+    stats.commands[command.type]++;
+    if (command.type == COMMAND_UPDATE_BUFFER || command.type == COMMAND_WRITE_BUFFER ||
+        command.type == COMMAND_WRITE_CONSTANTS)
+        stats.uploadBytes += command.count;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class CommandBackend;
+
+// Shaders, buffers, views and states are opaque to the list; only the backend knows their type.
+typedef void* GpuHandle;
+
+enum ShaderStage : uint8_t {
+	SHADER_STAGE_VERTEX = 0,
+	SHADER_STAGE_PIXEL = 1,
+	SHADER_STAGE_COMPUTE = 2,
+	SHADER_STAGE_COUNT
+};
+
+enum CommandType : uint8_t {
+	COMMAND_SET_SHADER = 0,
+	COMMAND_SET_CONSTANT_BUFFERS,
+	COMMAND_SET_CONSTANT_BLOCKS,
+	COMMAND_SET_SHADER_RESOURCES,
+	COMMAND_SET_SAMPLERS,
+	COMMAND_SET_UNORDERED_ACCESS_VIEWS,
+	COMMAND_SET_INPUT_LAYOUT,
+	COMMAND_SET_PRIMITIVE_TOPOLOGY,
+	COMMAND_SET_VERTEX_BUFFERS,
+	COMMAND_SET_INDEX_BUFFER,
+	COMMAND_SET_RASTERIZER_STATE,
+	COMMAND_SET_DEPTH_STENCIL_STATE,
+	COMMAND_SET_BLEND_STATE,
+	COMMAND_SET_RENDER_TARGETS,
+	COMMAND_SET_VIEWPORT,
+	COMMAND_CLEAR_RENDER_TARGET,
+	COMMAND_CLEAR_DEPTH,
+	COMMAND_UPDATE_BUFFER,
+	COMMAND_WRITE_BUFFER,
+	COMMAND_WRITE_CONSTANTS,
+	COMMAND_COPY_RESOURCE,
+	COMMAND_BEGIN_QUERY,
+	COMMAND_END_QUERY,
+	COMMAND_DRAW,
+	COMMAND_DRAW_INDEXED,
+	COMMAND_DRAW_INDEXED_INSTANCED,
+	COMMAND_DRAW_INDEXED_INSTANCED_INDIRECT,
+	COMMAND_DISPATCH,
+	COMMAND_EXECUTE_LIST,
+	COMMAND_TYPE_COUNT
+};
+
+// One recorded call. Arrays (bound handles, strides, uploaded bytes, clear colors) live in the
+// list: `first` and `count` address its handles for binds and copies, its payload otherwise.
+struct Command {
+	CommandType type;
+	ShaderStage stage;
+	uint16_t slot;
+	uint32_t first;
+	uint32_t count;
+	GpuHandle object;
+	uint32_t args[5];
+};
+
+// Calls recorded for one frame. Enum arguments (topology, index format) are kept as the
+// backend values. Nothing is issued until the list is replayed into a backend.
+class CommandList {
+public:
+	void clear() { commands.clear(); handles.clear(); payload.clear(); };
+
+	void setShader(ShaderStage stage, GpuHandle shader) { push(COMMAND_SET_SHADER, shader, stage); };
+	template <typename T>
+	void setConstantBuffers(ShaderStage stage, uint32_t slot, uint32_t count, T* const* buffers) { pushBind(COMMAND_SET_CONSTANT_BUFFERS, stage, slot, count, buffers); };
+	// Binds the last copies written for `blocks` (see writeConstants).
+	void setConstantBlocks(ShaderStage stage, uint32_t slot, uint32_t count, const uint32_t* blocks);
+	template <typename T>
+	void setShaderResources(ShaderStage stage, uint32_t slot, uint32_t count, T* const* views) { pushBind(COMMAND_SET_SHADER_RESOURCES, stage, slot, count, views); };
+	template <typename T>
+	void setSamplers(ShaderStage stage, uint32_t slot, uint32_t count, T* const* samplers) { pushBind(COMMAND_SET_SAMPLERS, stage, slot, count, samplers); };
+	template <typename T>
+	void setUnorderedAccessViews(uint32_t slot, uint32_t count, T* const* views) { pushBind(COMMAND_SET_UNORDERED_ACCESS_VIEWS, SHADER_STAGE_COMPUTE, slot, count, views); };
+
+	void setInputLayout(GpuHandle layout) { push(COMMAND_SET_INPUT_LAYOUT, layout); };
+	void setPrimitiveTopology(uint32_t topology) { push(COMMAND_SET_PRIMITIVE_TOPOLOGY, nullptr).args[0] = topology; };
+	template <typename T>
+	void setVertexBuffers(uint32_t slot, uint32_t count, T* const* buffers, const uint32_t* strides, const uint32_t* offsets);
+	void setIndexBuffer(GpuHandle buffer, uint32_t format, uint32_t offset);
+
+	void setRasterizerState(GpuHandle state) { push(COMMAND_SET_RASTERIZER_STATE, state); };
+	void setDepthStencilState(GpuHandle state, uint32_t stencilRef) { push(COMMAND_SET_DEPTH_STENCIL_STATE, state).args[0] = stencilRef; };
+	void setBlendState(GpuHandle state, uint32_t sampleMask) { push(COMMAND_SET_BLEND_STATE, state).args[0] = sampleMask; };
+	template <typename T>
+	void setRenderTargets(uint32_t count, T* const* views, GpuHandle depthView);
+	void setViewport(float x, float y, float width, float height, float minDepth, float maxDepth);
+	void clearRenderTarget(GpuHandle view, const float color[4]);
+	void clearDepth(GpuHandle view, float depth);
+
+	// Copies into a default-usage buffer: all of it, or `size` bytes at `offset` (not for
+	// constant buffers).
+	void updateBuffer(GpuHandle buffer, const void* data, uint32_t size) { pushUpdate(buffer, data, 0, size, false); };
+	void updateBufferRange(GpuHandle buffer, const void* data, uint32_t offset, uint32_t size) { pushUpdate(buffer, data, offset, size, true); };
+	// Replaces the contents of a dynamic buffer. The returned memory is filled by the caller
+	// and stays valid until the next call that records into the list.
+	void* writeBuffer(GpuHandle buffer, uint32_t size);
+	// Writes the constants of `block` for this frame. The backend places them in its upload
+	// ring and the block's binds recorded after this one read them. Like writeBuffer, the
+	// caller fills the returned memory.
+	void* writeConstants(uint32_t block, uint32_t size);
+	void copyResource(GpuHandle destination, GpuHandle source);
+
+	void beginQuery(GpuHandle query) { push(COMMAND_BEGIN_QUERY, query); };
+	void endQuery(GpuHandle query) { push(COMMAND_END_QUERY, query); };
+
+	void draw(uint32_t vertexCount, uint32_t startVertex);
+	void drawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+	void drawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+	void drawIndexedInstancedIndirect(GpuHandle arguments, uint32_t offset) { push(COMMAND_DRAW_INDEXED_INSTANCED_INDIRECT, arguments).args[0] = offset; };
+	void dispatch(uint32_t x, uint32_t y, uint32_t z);
+
+	// Replays `list` at this point. It is not copied, so it must stay unchanged until this
+	// list has been replayed.
+	void executeList(const CommandList& list) { push(COMMAND_EXECUTE_LIST, const_cast<CommandList*>(&list)); };
+
+	const std::vector<Command>& getCommands() const { return commands; };
+	const GpuHandle* getHandles(const Command& command) const { return handles.data() + command.first; };
+	const void* getPayload(uint32_t offset) const { return payload.data() + offset; };
+	size_t getPayloadSize() const { return payload.size(); };
+
+	// Hands every command to the backend in recording order, nested lists inline.
+	void replay(CommandBackend& backend) const;
+
+private:
+	Command& push(CommandType type, GpuHandle object, ShaderStage stage = SHADER_STAGE_VERTEX, uint32_t slot = 0);
+	uint32_t pushPayload(const void* data, uint32_t size);
+	void pushUpdate(GpuHandle buffer, const void* data, uint32_t offset, uint32_t size, bool range);
+	template <typename T>
+	void pushBind(CommandType type, ShaderStage stage, uint32_t slot, uint32_t count, T* const* objects);
+
+	std::vector<Command> commands;
+	std::vector<GpuHandle> handles;
+	std::vector<uint8_t> payload;
+};
+
+// Records parts [0, count) on the job system, part i into parts[i], then executes them from
+// `commands` in index order: the replayed stream is the same as if the parts had been recorded
+// one after another, whichever thread finished first. `parts` only grows.
+void recordParallel(CommandList& commands, std::vector<CommandList>& parts, size_t count,
+	const std::function<void(size_t part, CommandList& list)>& record);
+
+// Constant blocks have no buffer of their own: an object takes an id once and writes the
+// block every frame it is used. Ids are small and dense, so backends can index by them.
+uint32_t newConstantBlock();
+
+class CommandBackend {
+public:
+	virtual ~CommandBackend() {};
+	virtual void execute(const CommandList& list, const Command& command) = 0;
+};
+
+struct CommandStats {
+	size_t commands[COMMAND_TYPE_COUNT] = {};
+	size_t uploadBytes = 0;
+
+	size_t getTotal() const;
+	size_t getDraws() const;
+	size_t getBinds() const;
+};
+
+// Issues nothing, only counts; lets the frame run without a device.
+class CountingBackend : public CommandBackend {
+public:
+	void execute(const CommandList& list, const Command& command) override;
+	void reset() { stats = CommandStats(); };
+	const CommandStats& getStats() const { return stats; };
+
+private:
+	CommandStats stats;
+};
+
+template <typename T>
+void CommandList::pushBind(CommandType type, ShaderStage stage, uint32_t slot, uint32_t count, T* const* objects) {
+	Command& command = push(type, nullptr, stage, slot);
+	command.first = uint32_t(handles.size());
+	command.count = count;
+	for (uint32_t i = 0; i < count; i++)
+		handles.push_back(objects[i]);
+}
+
+// Strides and offsets go to the payload, `args` keeps where.
+template <typename T>
+void CommandList::setVertexBuffers(uint32_t slot, uint32_t count, T* const* buffers, const uint32_t* strides, const uint32_t* offsets) {
+	uint32_t stridesAt = pushPayload(strides, count * sizeof(uint32_t));
+	uint32_t offsetsAt = pushPayload(offsets, count * sizeof(uint32_t));
+	pushBind(COMMAND_SET_VERTEX_BUFFERS, SHADER_STAGE_VERTEX, slot, count, buffers);
+	commands.back().args[0] = stridesAt;
+	commands.back().args[1] = offsetsAt;
+}
+
+template <typename T>
+void CommandList::setRenderTargets(uint32_t count, T* const* views, GpuHandle depthView) {
+	pushBind(COMMAND_SET_RENDER_TARGETS, SHADER_STAGE_PIXEL, 0, count, views);
+	commands.back().object = depthView;
+}
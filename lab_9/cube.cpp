@@ -1,606 +1,627 @@
-#include "cube.h"
-#include "timer.h"
-
-void Cube::readQueries(ID3D11DeviceContext* context) {
-    D3D11_QUERY_DATA_PIPELINE_STATISTICS stats;
-
-    while (lastCompletedFrame < curFrame) {
-        HRESULT hr = context->GetData(queries[lastCompletedFrame % MAX_QUERY], &stats, sizeof(D3D11_QUERY_DATA_PIPELINE_STATISTICS), 0);
-        if (hr == S_OK) {
-            countOfRenderedCubes = int(stats.IAPrimitives / 12);
-            lastCompletedFrame++;
-        }
-        else {
-            break;
-        }
-    }
-}
-
-HRESULT Cube::initQuery(ID3D11Device* device) {
-    HRESULT hr = S_OK;
-    D3D11_QUERY_DESC desc;
-
-    desc.Query = D3D11_QUERY_PIPELINE_STATISTICS;
-    desc.MiscFlags = 0;
-    for (int i = 0; i < MAX_QUERY && SUCCEEDED(hr); i++)
-        hr = device->CreateQuery(&desc, &queries[i]);
-
-    return hr;
-}
-
-HRESULT Cube::init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight,
-    std::vector<const wchar_t*> diffPaths, const wchar_t* normalPath, float shines, const std::vector<XMFLOAT4>& positions) {
-    assert(positions.size() == MAX_CUBES);
-    initQuery(device);
-
-    frustum.screenDepth = 0.1f;
-
-    cubesModelVector = std::vector<CubeModel>(MAX_CUBES);
-    for (int i = 0; i < MAX_CUBES; i++) {
-        CubeModel tmp;
-        float textureIndex = (float)(rand() % diffPaths.size());
-        tmp.pos = positions[i];
-        tmp.params = XMFLOAT4(shines, (float)(rand() % 10 - 5), textureIndex, textureIndex > 0.0f ? 0.0f : 1.0f);
-        cubesModelVector[i] = tmp;
-    }
-
-    ID3DBlob* pVSBlob = nullptr;
-    HRESULT hr = D3DReadFileToBlob(L"VertexShader.cso", &pVSBlob);
-    if (FAILED(hr)) {
-        MessageBox(nullptr, L"VertexShader.cso not found.", L"Error", MB_OK);
-        return hr;
-    }
-
-    hr = device->CreateVertexShader(pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize(), nullptr, &g_pVertexShader);
-    if (FAILED(hr)) {
-        pVSBlob->Release();
-        return hr;
-    }
-
-    D3D11_INPUT_ELEMENT_DESC layout[] = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 20, D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0},
-    };
-    UINT numElements = ARRAYSIZE(layout);
-
-    hr = device->CreateInputLayout(layout, numElements, pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize(), &g_pVertexLayout);
-    pVSBlob->Release();
-    if (FAILED(hr))
-        return hr;
-
-    context->IASetInputLayout(g_pVertexLayout);
-
-    ID3DBlob* pPSBlob = nullptr;
-    hr = D3DReadFileToBlob(L"PixelShader.cso", &pPSBlob);
-    if (FAILED(hr)) {
-        MessageBox(nullptr, L"PixelShader.cso not found.", L"Error", MB_OK);
-        return hr;
-    }
-
-    hr = device->CreatePixelShader(pPSBlob->GetBufferPointer(), pPSBlob->GetBufferSize(), nullptr, &g_pPixelShader);
-    pPSBlob->Release();
-    if (FAILED(hr))
-        return hr;
-
-    ID3DBlob* pCSBlob = nullptr;
-    hr = D3DReadFileToBlob(L"FrustumComputeShader.cso", &pCSBlob);
-    if (FAILED(hr))
-    {
-        MessageBox(nullptr, L"FrustumComputeShader.cso not found.", L"Error", MB_OK);
-        return hr;
-    }
-
-    hr = device->CreateComputeShader(pCSBlob->GetBufferPointer(), pCSBlob->GetBufferSize(), nullptr, &g_pCullShader);
-    pCSBlob->Release();
-    if (FAILED(hr))
-        return hr;
-
-    cubesTextures = std::vector<Texture>(2);
-    hr = cubesTextures[0].initArray(device, context, diffPaths);
-    hr = cubesTextures[1].init(device, context, normalPath);
-    if (FAILED(hr))
-        return hr;
-
-    TexVertex vertices[] = {
-        {{-0.5, -0.5,  0.5}, {0, 1}, {0, -1, 0}, {1, 0, 0}},
-        {{ 0.5, -0.5,  0.5}, {1, 1}, {0, -1, 0}, {1, 0, 0}},
-        {{ 0.5, -0.5, -0.5}, {1, 0}, {0, -1, 0}, {1, 0, 0}},
-        {{-0.5, -0.5, -0.5}, {0, 0}, {0, -1, 0}, {1, 0, 0}},
-
-        {{-0.5,  0.5, -0.5}, {1, 1}, {0, 1, 0}, {1, 0, 0}},
-        {{ 0.5,  0.5, -0.5}, {0, 1}, {0, 1, 0}, {1, 0, 0}},
-        {{ 0.5,  0.5,  0.5}, {0, 0}, {0, 1, 0}, {1, 0, 0}},
-        {{-0.5,  0.5,  0.5}, {1, 0}, {0, 1, 0}, {1, 0, 0}},
-
-        {{ 0.5, -0.5, -0.5}, {0, 1}, {1, 0, 0}, {0, 0, 1}},
-        {{ 0.5, -0.5,  0.5}, {1, 1}, {1, 0, 0}, {0, 0, 1}},
-        {{ 0.5,  0.5,  0.5}, {1, 0}, {1, 0, 0}, {0, 0, 1}},
-        {{ 0.5,  0.5, -0.5}, {0, 0}, {1, 0, 0}, {0, 0, 1}},
-
-        {{-0.5, -0.5,  0.5}, {0, 1}, {-1, 0, 0}, {0, 0, -1}},
-        {{-0.5, -0.5, -0.5}, {1, 1}, {-1, 0, 0}, {0, 0, -1}},
-        {{-0.5,  0.5, -0.5}, {1, 0}, {-1, 0, 0}, {0, 0, -1}},
-        {{-0.5,  0.5,  0.5}, {0, 0}, {-1, 0, 0}, {0, 0, -1}},
-
-        {{ 0.5, -0.5,  0.5}, {1, 1}, {0, 0, 1}, {-1, 0, 0}},
-        {{-0.5, -0.5,  0.5}, {0, 1}, {0, 0, 1}, {-1, 0, 0}},
-        {{-0.5,  0.5,  0.5}, {0, 0}, {0, 0, 1}, {-1, 0, 0}},
-        {{ 0.5,  0.5,  0.5}, {1, 0}, {0, 0, 1}, {-1, 0, 0}},
-
-        {{-0.5, -0.5, -0.5}, {1, 1}, {0, 0, -1}, {1, 0, 0}},
-        {{ 0.5, -0.5, -0.5}, {0, 1}, {0, 0, -1}, {1, 0, 0}},
-        {{ 0.5,  0.5, -0.5}, {0, 0}, {0, 0, -1}, {1, 0, 0}},
-        {{-0.5,  0.5, -0.5}, {1, 0}, {0, 0, -1}, {1, 0, 0}}
-    };
-
-    USHORT indices[] = {
-          0, 2, 1, 0, 3, 2,
-          4, 6, 5, 4, 7, 6,
-          8, 10, 9, 8, 11, 10,
-          12, 14, 13, 12, 15, 14,
-          16, 18, 17, 16, 19, 18,
-          20, 22, 21, 20, 23, 22
-    };
-
-    D3D11_BUFFER_DESC bd;
-    ZeroMemory(&bd, sizeof(bd));
-    bd.Usage = D3D11_USAGE_IMMUTABLE;
-    bd.ByteWidth = sizeof(vertices);
-    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bd.CPUAccessFlags = 0;
-    bd.MiscFlags = 0;
-    bd.StructureByteStride = 0;
-
-    D3D11_SUBRESOURCE_DATA InitData;
-    ZeroMemory(&InitData, sizeof(InitData));
-    InitData.pSysMem = &vertices;
-    InitData.SysMemPitch = sizeof(vertices);
-    InitData.SysMemSlicePitch = 0;
-
-    hr = device->CreateBuffer(&bd, &InitData, &g_pVertexBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC bd1;
-    ZeroMemory(&bd1, sizeof(bd1));
-    bd1.Usage = D3D11_USAGE_IMMUTABLE;
-    bd1.ByteWidth = sizeof(indices);
-    bd1.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    bd1.CPUAccessFlags = 0;
-    bd1.MiscFlags = 0;
-    bd1.StructureByteStride = 0;
-
-    D3D11_SUBRESOURCE_DATA InitData1;
-    ZeroMemory(&InitData1, sizeof(InitData1));
-    InitData1.pSysMem = &indices;
-    InitData1.SysMemPitch = sizeof(indices);
-    InitData1.SysMemSlicePitch = 0;
-
-    hr = device->CreateBuffer(&bd1, &InitData1, &g_pIndexBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC descWMB = {};
-    descWMB.ByteWidth = sizeof(GeomBuffer) * MAX_CUBES;
-    descWMB.Usage = D3D11_USAGE_DEFAULT;
-    descWMB.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    descWMB.CPUAccessFlags = 0;
-    descWMB.MiscFlags = 0;
-    descWMB.StructureByteStride = 0;
-
-    static const XMFLOAT4 AABB[] = {
-        {-0.5, -0.5, -0.5, 1.0},
-        {0.5,  0.5, 0.5, 1.0}
-    };
-    GeomBuffer geomBufferInst[MAX_CUBES];
-    CullingParams cullingParams;
-    for (int i = 0; i < MAX_CUBES; i++) {
-        geomBufferInst[i].worldMatrix = XMMatrixTranslation(cubesModelVector[i].pos.x, cubesModelVector[i].pos.y, cubesModelVector[i].pos.z);
-        geomBufferInst[i].norm = geomBufferInst[i].worldMatrix;
-        geomBufferInst[i].params = cubesModelVector[i].params;
-
-        XMFLOAT4 min, max;
-        XMStoreFloat4(&min, XMVector4Transform(XMLoadFloat4(&AABB[0]), geomBufferInst[i].worldMatrix));
-        XMStoreFloat4(&max, XMVector4Transform(XMLoadFloat4(&AABB[1]), geomBufferInst[i].worldMatrix));
-        cullingParams.bbMin[i] = min;
-        cullingParams.bbMax[i] = max;
-    }
-
-    cullingParams.numShapes = XMINT4(int(cubesModelVector.size()), 0, 0, 0);
-
-    D3D11_SUBRESOURCE_DATA cullData;
-    cullData.pSysMem = &cullingParams;
-    cullData.SysMemPitch = sizeof(cullingParams);
-    cullData.SysMemSlicePitch = 0;
-    hr = device->CreateBuffer(&descWMB, &cullData, &g_pCullingParams);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC argSrcDesc = {};
-    argSrcDesc.ByteWidth = sizeof(D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS);
-    argSrcDesc.Usage = D3D11_USAGE_DEFAULT;
-    argSrcDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-    argSrcDesc.CPUAccessFlags = 0;
-    argSrcDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-    argSrcDesc.StructureByteStride = sizeof(UINT);
-
-    hr = device->CreateBuffer(&argSrcDesc, nullptr, &g_pInderectArgsSrc);
-    if (FAILED(hr))
-        return hr;
-    hr = device->CreateUnorderedAccessView(g_pInderectArgsSrc, nullptr, &g_pInderectArgsUAV);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC argDesc = {};
-    argDesc.ByteWidth = sizeof(D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS);
-    argDesc.Usage = D3D11_USAGE_DEFAULT;
-    argDesc.BindFlags = 0;
-    argDesc.CPUAccessFlags = 0;
-    argDesc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
-    argDesc.StructureByteStride = 0;
-
-    hr = device->CreateBuffer(&argDesc, nullptr, &g_pInderectArgs);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC gbDesc = {};
-    gbDesc.ByteWidth = sizeof(XMINT4) * MAX_CUBES;
-    gbDesc.Usage = D3D11_USAGE_DEFAULT;
-    gbDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-    gbDesc.CPUAccessFlags = 0;
-    gbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
-    gbDesc.StructureByteStride = sizeof(XMINT4);
-
-    hr = device->CreateBuffer(&gbDesc, nullptr, &g_pGeomBufferInstVisGpu);
-    if (FAILED(hr))
-        return hr;
-    hr = device->CreateUnorderedAccessView(g_pGeomBufferInstVisGpu, nullptr, &g_pGeomBufferInstVisGpu_UAV);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC gbDescGPU = {};
-    gbDescGPU.ByteWidth = sizeof(XMINT4) * MAX_CUBES;
-    gbDescGPU.Usage = D3D11_USAGE_DEFAULT;
-    gbDescGPU.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    gbDescGPU.CPUAccessFlags = 0;
-    gbDescGPU.MiscFlags = 0;
-    gbDescGPU.StructureByteStride = 0;
-
-    hr = device->CreateBuffer(&gbDescGPU, nullptr, &g_pGeomBufferInstVis);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_SUBRESOURCE_DATA data;
-    data.pSysMem = &geomBufferInst;
-    data.SysMemPitch = sizeof(geomBufferInst);
-    data.SysMemSlicePitch = 0;
-
-    hr = device->CreateBuffer(&descWMB, &data, &g_pGeomBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC descSMB = {};
-    descSMB.ByteWidth = sizeof(CubeSceneMatrixBuffer);
-    descSMB.Usage = D3D11_USAGE_DYNAMIC;
-    descSMB.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    descSMB.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    descSMB.MiscFlags = 0;
-    descSMB.StructureByteStride = 0;
-
-    hr = device->CreateBuffer(&descSMB, nullptr, &g_pSceneMatrixBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC descLCB = {};
-    descLCB.ByteWidth = sizeof(LightableCB);
-    descLCB.Usage = D3D11_USAGE_DYNAMIC;
-    descLCB.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    descLCB.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    descLCB.MiscFlags = 0;
-    descLCB.StructureByteStride = 0;
-
-    hr = device->CreateBuffer(&descLCB, nullptr, &g_LightConstantBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_RASTERIZER_DESC descRastr = {};
-    descRastr.FillMode = D3D11_FILL_SOLID;
-    descRastr.CullMode = D3D11_CULL_BACK;
-    descRastr.FrontCounterClockwise = false;
-    descRastr.DepthBias = 0;
-    descRastr.SlopeScaledDepthBias = 0.0f;
-    descRastr.DepthBiasClamp = 0.0f;
-    descRastr.DepthClipEnable = true;
-    descRastr.ScissorEnable = false;
-    descRastr.MultisampleEnable = false;
-    descRastr.AntialiasedLineEnable = false;
-
-    hr = device->CreateRasterizerState(&descRastr, &g_pRasterizerState);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_SAMPLER_DESC descSmplr = {};
-    descSmplr.Filter = D3D11_FILTER_ANISOTROPIC;
-    descSmplr.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-    descSmplr.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-    descSmplr.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-    descSmplr.MinLOD = -D3D11_FLOAT32_MAX;
-    descSmplr.MaxLOD = D3D11_FLOAT32_MAX;
-    descSmplr.MipLODBias = 0.0f;
-    descSmplr.MaxAnisotropy = 16;
-    descSmplr.ComparisonFunc = D3D11_COMPARISON_NEVER;
-    descSmplr.BorderColor[0] =
-        descSmplr.BorderColor[1] =
-        descSmplr.BorderColor[2] =
-        descSmplr.BorderColor[3] = 1.0f;
-
-    hr = device->CreateSamplerState(&descSmplr, &g_pSamplerState);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_DEPTH_STENCIL_DESC dsDesc = { 0 };
-    ZeroMemory(&dsDesc, sizeof(dsDesc));
-    dsDesc.DepthEnable = TRUE;
-    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-    dsDesc.DepthFunc = D3D11_COMPARISON_GREATER_EQUAL;
-    dsDesc.StencilEnable = FALSE;
-
-    hr = device->CreateDepthStencilState(&dsDesc, &g_pDepthState);
-    if (FAILED(hr))
-        return hr;
-
-    return S_OK;
-}
-
-
-void Cube::realize() {
-    for (auto& tex : cubesTextures)
-        tex.realize();
-
-    if (g_pSamplerState) g_pSamplerState->Release();
-    if (g_pRasterizerState) g_pRasterizerState->Release();
-
-    if (g_pGeomBuffer) g_pGeomBuffer->Release();
-    if (g_LightConstantBuffer) g_LightConstantBuffer->Release();
-
-    if (g_pDepthState) g_pDepthState->Release();
-    if (g_pSceneMatrixBuffer) g_pSceneMatrixBuffer->Release();
-    if (g_pIndexBuffer) g_pIndexBuffer->Release();
-    if (g_pVertexBuffer) g_pVertexBuffer->Release();
-    if (g_pVertexLayout) g_pVertexLayout->Release();
-    if (g_pVertexShader) g_pVertexShader->Release();
-    if (g_pPixelShader) g_pPixelShader->Release();
-
-    if (g_pInderectArgsSrc) g_pInderectArgsSrc->Release();
-    if (g_pInderectArgs) g_pInderectArgs->Release();
-    if (g_pGeomBufferInstVisGpu) g_pGeomBufferInstVisGpu->Release();
-    if (g_pGeomBufferInstVisGpu_UAV) g_pGeomBufferInstVisGpu_UAV->Release();
-    if (g_pGeomBufferInstVis) g_pGeomBufferInstVis->Release();
-    if (g_pInderectArgsUAV) g_pInderectArgsUAV->Release();
-    if (g_pCullShader) g_pCullShader->Release();
-    if (g_pCullingParams) g_pCullingParams->Release();
-
-    for (auto& q : queries) {
-        q->Release();
-    }
-}
-
-void Cube::render(ID3D11DeviceContext* context) {
-    context->OMSetDepthStencilState(g_pDepthState, 0);
-    context->RSSetState(g_pRasterizerState);
-
-    context->IASetIndexBuffer(g_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-    ID3D11SamplerState* samplers[] = { g_pSamplerState };
-    context->PSSetSamplers(0, 1, samplers);
-
-    ID3D11ShaderResourceView* resources[] = {
-        cubesTextures[0].getTexture(),
-        cubesTextures[1].getTexture()
-    };
-    context->PSSetShaderResources(0, 2, resources);
-
-    ID3D11Buffer* vertexBuffers[] = { g_pVertexBuffer };
-    UINT strides[] = { sizeof(TexVertex) };
-    UINT offsets[] = { 0 };
-    context->IASetVertexBuffers(0, 1, vertexBuffers, strides, offsets);
-    context->IASetInputLayout(g_pVertexLayout);
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-    context->VSSetShader(g_pVertexShader, nullptr, 0);
-    context->VSSetConstantBuffers(0, 1, &g_pGeomBuffer);
-    context->VSSetConstantBuffers(1, 1, &g_pSceneMatrixBuffer);
-    context->VSSetConstantBuffers(2, 1, &g_pGeomBufferInstVis);
-
-    context->PSSetShader(g_pPixelShader, nullptr, 0);
-    context->PSSetConstantBuffers(0, 1, &g_pGeomBuffer);
-    context->PSSetConstantBuffers(1, 1, &g_pSceneMatrixBuffer);
-    context->PSSetConstantBuffers(2, 1, &g_LightConstantBuffer);
-
-    context->Begin(queries[curFrame % MAX_QUERY]);
-    context->DrawIndexedInstancedIndirect(g_pInderectArgs, 0);
-    context->End(queries[curFrame % MAX_QUERY]);
-    curFrame++;
-
-    readQueries(context);
-}
-
-void Cube::getFrustum(XMMATRIX viewMatrix, XMMATRIX projectionMatrix) {
-    XMFLOAT4X4 pMatrix;
-    XMStoreFloat4x4(&pMatrix, projectionMatrix);
-
-    float zMinimum = -pMatrix._43 / pMatrix._33;
-    float r = frustum.screenDepth / (frustum.screenDepth - zMinimum);
-
-    pMatrix._33 = r;
-    pMatrix._43 = -r * zMinimum;
-    projectionMatrix = XMLoadFloat4x4(&pMatrix);
-
-    XMMATRIX finalMatrix = XMMatrixMultiply(viewMatrix, projectionMatrix);
-
-    XMFLOAT4X4 matrix;
-    XMStoreFloat4x4(&matrix, finalMatrix);
-
-    frustum.planes[0].x = matrix._14 + matrix._13;
-    frustum.planes[0].y = matrix._24 + matrix._23;
-    frustum.planes[0].z = matrix._34 + matrix._33;
-    frustum.planes[0].w = matrix._44 + matrix._43;
-
-    float length = sqrtf((frustum.planes[0].x * frustum.planes[0].x) + (frustum.planes[0].y * frustum.planes[0].y) + (frustum.planes[0].z * frustum.planes[0].z));
-    frustum.planes[0].x /= length;
-    frustum.planes[0].y /= length;
-    frustum.planes[0].z /= length;
-    frustum.planes[0].w /= length;
-
-    frustum.planes[1].x = matrix._14 - matrix._13;
-    frustum.planes[1].y = matrix._24 - matrix._23;
-    frustum.planes[1].z = matrix._34 - matrix._33;
-    frustum.planes[1].w = matrix._44 - matrix._43;
-
-    length = sqrtf((frustum.planes[1].x * frustum.planes[1].x) + (frustum.planes[1].y * frustum.planes[1].y) + (frustum.planes[1].z * frustum.planes[1].z));
-    frustum.planes[1].x /= length;
-    frustum.planes[1].y /= length;
-    frustum.planes[1].z /= length;
-    frustum.planes[1].w /= length;
-
-    frustum.planes[2].x = matrix._14 + matrix._11;
-    frustum.planes[2].y = matrix._24 + matrix._21;
-    frustum.planes[2].z = matrix._34 + matrix._31;
-    frustum.planes[2].w = matrix._44 + matrix._41;
-
-    length = sqrtf((frustum.planes[2].x * frustum.planes[2].x) + (frustum.planes[2].y * frustum.planes[2].y) + (frustum.planes[2].z * frustum.planes[2].z));
-    frustum.planes[2].x /= length;
-    frustum.planes[2].y /= length;
-    frustum.planes[2].z /= length;
-    frustum.planes[2].w /= length;
-
-    frustum.planes[3].x = matrix._14 - matrix._11;
-    frustum.planes[3].y = matrix._24 - matrix._21;
-    frustum.planes[3].z = matrix._34 - matrix._31;
-    frustum.planes[3].w = matrix._44 - matrix._41;
-
-    length = sqrtf((frustum.planes[3].x * frustum.planes[3].x) + (frustum.planes[3].y * frustum.planes[3].y) + (frustum.planes[3].z * frustum.planes[3].z));
-    frustum.planes[3].x /= length;
-    frustum.planes[3].y /= length;
-    frustum.planes[3].z /= length;
-    frustum.planes[3].w /= length;
-
-    frustum.planes[4].x = matrix._14 - matrix._12;
-    frustum.planes[4].y = matrix._24 - matrix._22;
-    frustum.planes[4].z = matrix._34 - matrix._32;
-    frustum.planes[4].w = matrix._44 - matrix._42;
-
-    length = sqrtf((frustum.planes[4].x * frustum.planes[4].x) + (frustum.planes[4].y * frustum.planes[4].y) + (frustum.planes[4].z * frustum.planes[4].z));
-    frustum.planes[4].x /= length;
-    frustum.planes[4].y /= length;
-    frustum.planes[4].z /= length;
-    frustum.planes[4].w /= length;
-
-    frustum.planes[5].x = matrix._14 + matrix._12;
-    frustum.planes[5].y = matrix._24 + matrix._22;
-    frustum.planes[5].z = matrix._34 + matrix._32;
-    frustum.planes[5].w = matrix._44 + matrix._42;
-
-    length = sqrtf((frustum.planes[5].x * frustum.planes[5].x) + (frustum.planes[5].y * frustum.planes[5].y) + (frustum.planes[5].z * frustum.planes[5].z));
-    frustum.planes[5].x /= length;
-    frustum.planes[5].y /= length;
-    frustum.planes[5].z /= length;
-    frustum.planes[5].w /= length;
-}
-
-bool Cube::frame(ID3D11DeviceContext* context, XMMATRIX& viewMatrix, XMMATRIX& projectionMatrix,
-        XMFLOAT3& cameraPos, const Light& lights, bool fixFrustumCulling) {
-    CullingParams cullingParams;
-    auto duration = Timer::GetInstance().Clock();
-    GeomBuffer geomBufferInst[MAX_CUBES];
-    for (int i = 0; i < MAX_CUBES; i++) {
-        geomBufferInst[i].worldMatrix = 
-            XMMatrixRotationX((float)duration * cubesModelVector[i].params.x * 0.01f) * 
-            XMMatrixTranslation((float)sin(duration) * 0.5f, (float)cos(duration) * 0.5f, (float)sin(duration) * 0.5f) *
-            XMMatrixRotationY((float)duration * cubesModelVector[i].params.y * 1.5f) *
-            XMMatrixRotationZ((float)(sin(duration * cubesModelVector[i].params.y * 0.30f) * 0.25f)) *
-            XMMatrixTranslation((float)sin(duration * angle_velocity * cubesModelVector[i].params.y * 1.0), (float)(sin(duration * cubesModelVector[i].params.y * 0.30) * 0.25f), (float)cos(duration) * 3.0f) *
-            XMMatrixTranslation(cubesModelVector[i].pos.x, cubesModelVector[i].pos.y, cubesModelVector[i].pos.z);
-        geomBufferInst[i].norm = geomBufferInst[i].worldMatrix;
-        geomBufferInst[i].params = cubesModelVector[i].params;
-    }
-
-    context->UpdateSubresource(g_pGeomBuffer, 0, nullptr, &geomBufferInst, 0, 0);
-
-    if (!fixFrustumCulling) {
-        getFrustum(viewMatrix, projectionMatrix);
-    }
-
-    static const XMFLOAT4 AABB[] = {
-        {-0.5, -0.5, -0.5, 1.0},
-        {0.5,  0.5, 0.5, 1.0}
-    };
-
-    cubesIndexies.clear();
-    for (int i = 0; i < MAX_CUBES; i++) {
-        XMFLOAT4 min, max;
-
-        XMStoreFloat4(&min, XMVector4Transform(XMLoadFloat4(&AABB[0]), geomBufferInst[i].worldMatrix));
-        XMStoreFloat4(&max, XMVector4Transform(XMLoadFloat4(&AABB[1]), geomBufferInst[i].worldMatrix));
-
-        cubesIndexies.push_back(i);
-
-        cullingParams.bbMin[i] = min;
-        cullingParams.bbMax[i] = max;
-    }
-
-    cullingParams.numShapes = XMINT4(MAX_CUBES, 0, 0, 0);
-    context->UpdateSubresource(g_pCullingParams, 0, nullptr, &cullingParams, 0, 0);
-
-    D3D11_MAPPED_SUBRESOURCE subresource;
-    HRESULT hr = context->Map(g_pSceneMatrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-    if (FAILED(hr))
-        return FAILED(hr);
-
-    CubeSceneMatrixBuffer& sceneBuffer = *reinterpret_cast<CubeSceneMatrixBuffer*>(subresource.pData);
-    sceneBuffer.viewProjectionMatrix = XMMatrixMultiply(viewMatrix, projectionMatrix);
-
-    for (int i = 0; i < 6; i++) {
-        sceneBuffer.planes[i] = frustum.planes[i];
-    }
-
-    context->Unmap(g_pSceneMatrixBuffer, 0);
-
-    hr = context->Map(g_LightConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-    if (FAILED(hr))
-        return FAILED(hr);
-
-    LightableCB& lightBuffer = *reinterpret_cast<LightableCB*>(subresource.pData);
-    lightBuffer.cameraPos = XMFLOAT4(cameraPos.x, cameraPos.y, cameraPos.z, 1.0f);
-    lightBuffer.ambientColor = XMFLOAT4(0.9f, 0.9f, 0.4f, 1.0f);
-    auto& lightColors = lights.getColors();
-    auto& lightPos = lights.getPositions();
-    lightBuffer.lightCount = XMINT4(int(lightColors.size()), 1, 0, 0);
-
-    for (int i = 0; i < lightColors.size(); i++) {
-        lightBuffer.lightPos[i] = XMFLOAT4(lightPos[i].x, lightPos[i].y, lightPos[i].z, 1.0f);
-        lightBuffer.lightColor[i] = XMFLOAT4(lightColors[i].x, lightColors[i].y, lightColors[i].z, 1.0f);
-    }
-    context->Unmap(g_LightConstantBuffer, 0);
-
-    D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS args;
-    args.IndexCountPerInstance = 36;
-    args.InstanceCount = 0;
-    args.StartInstanceLocation = 0;
-    args.BaseVertexLocation = 0;
-    args.StartIndexLocation = 0;
-    context->UpdateSubresource(g_pInderectArgsSrc, 0, nullptr, &args, 0, 0);
-    UINT groupNumber = MAX_CUBES / 64u + !!(MAX_CUBES % 64u);
-    context->CSSetConstantBuffers(0, 1, &g_pCullingParams);
-    context->CSSetConstantBuffers(1, 1, &g_pSceneMatrixBuffer);
-    context->CSSetUnorderedAccessViews(0, 1, &g_pInderectArgsUAV, nullptr);
-    context->CSSetUnorderedAccessViews(1, 1, &g_pGeomBufferInstVisGpu_UAV, nullptr);
-    context->CSSetShader(g_pCullShader, nullptr, 0);
-    context->Dispatch(groupNumber, 1, 1);
-
-    context->CopyResource(g_pGeomBufferInstVis, g_pGeomBufferInstVisGpu);
-    context->CopyResource(g_pInderectArgs, g_pInderectArgsSrc);
-
-    return S_OK;
-}
+#include <algorithm>
+#include <cassert>
+
+#include "cube.h"
+#include "timer.h"
+
+static_assert(sizeof(IndexedIndirectArgs) == sizeof(D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS), "CubeFrame records the indirect arguments");
+
+void Cube::readQueries(ID3D11DeviceContext* context) {
+    D3D11_QUERY_DATA_PIPELINE_STATISTICS stats;
+
+    while (lastCompletedFrame < curFrame) {
+        HRESULT hr = context->GetData(queries[lastCompletedFrame % MAX_QUERY], &stats, sizeof(D3D11_QUERY_DATA_PIPELINE_STATISTICS), 0);
+        if (hr == S_OK) {
+            countOfRenderedCubes = int(stats.IAPrimitives / 12);
+            lastCompletedFrame++;
+        }
+        else {
+            break;
+        }
+    }
+}
+
+HRESULT Cube::initQuery(ID3D11Device* device) {
+    HRESULT hr = S_OK;
+    D3D11_QUERY_DESC desc;
+
+    desc.Query = D3D11_QUERY_PIPELINE_STATISTICS;
+    desc.MiscFlags = 0;
+    for (int i = 0; i < MAX_QUERY && SUCCEEDED(hr); i++)
+        hr = device->CreateQuery(&desc, &queries[i]);
+
+    return hr;
+}
+
+HRESULT Cube::init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight,
+    std::vector<const wchar_t*> diffPaths, const wchar_t* normalPath, float shines, const std::vector<XMFLOAT4>& positions) {
+    initQuery(device);
+
+    frustum.screenDepth = 0.1f;
+
+    cubesShines = shines;
+    texturesCount = diffPaths.size();
+    cubesFrame.reserve(positions.size());
+    for (auto& pos : positions)
+        addCube(pos);
+
+    ID3DBlob* pVSBlob = nullptr;
+    HRESULT hr = D3DReadFileToBlob(L"VertexShader.cso", &pVSBlob);
+    if (FAILED(hr)) {
+        MessageBox(nullptr, L"VertexShader.cso not found.", L"Error", MB_OK);
+        return hr;
+    }
+
+    hr = device->CreateVertexShader(pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize(), nullptr, &g_pVertexShader);
+    if (FAILED(hr)) {
+        pVSBlob->Release();
+        return hr;
+    }
+
+    D3D11_INPUT_ELEMENT_DESC layout[] = {
+        {"POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    };
+    UINT numElements = ARRAYSIZE(layout);
+
+    hr = device->CreateInputLayout(layout, numElements, pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize(), &g_pVertexLayout);
+    pVSBlob->Release();
+    if (FAILED(hr))
+        return hr;
+
+    ID3DBlob* pPSBlob = nullptr;
+    hr = D3DReadFileToBlob(L"PixelShader.cso", &pPSBlob);
+    if (FAILED(hr)) {
+        MessageBox(nullptr, L"PixelShader.cso not found.", L"Error", MB_OK);
+        return hr;
+    }
+
+    hr = device->CreatePixelShader(pPSBlob->GetBufferPointer(), pPSBlob->GetBufferSize(), nullptr, &g_pPixelShader);
+    pPSBlob->Release();
+    if (FAILED(hr))
+        return hr;
+
+    ID3DBlob* pCSBlob = nullptr;
+    hr = D3DReadFileToBlob(L"FrustumComputeShader.cso", &pCSBlob);
+    if (FAILED(hr))
+    {
+        MessageBox(nullptr, L"FrustumComputeShader.cso not found.", L"Error", MB_OK);
+        return hr;
+    }
+
+    hr = device->CreateComputeShader(pCSBlob->GetBufferPointer(), pCSBlob->GetBufferSize(), nullptr, &g_pCullShader);
+    pCSBlob->Release();
+    if (FAILED(hr))
+        return hr;
+
+    cubesTextures = std::vector<Texture>(2);
+    hr = cubesTextures[0].initArray(device, context, diffPaths);
+    hr = cubesTextures[1].init(device, context, normalPath);
+    if (FAILED(hr))
+        return hr;
+
+    const Mesh& cubeMesh = MeshLibrary::GetInstance().getCube();
+    indexCount = (UINT)cubeMesh.getIndexCount();
+    indexFormat = cubeMesh.hasShortIndices() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+    VertexQuantization quantization = computeQuantization(cubeMesh.vertices[0].position, sizeof(MeshVertex), cubeMesh.vertices.size());
+    std::vector<PackedVertex> packedVertices(cubeMesh.vertices.size());
+    packVertices(cubeMesh.vertices[0].position, sizeof(MeshVertex), cubeMesh.vertices.size(), nullptr, quantization, packedVertices.data());
+
+    D3D11_BUFFER_DESC bd;
+    ZeroMemory(&bd, sizeof(bd));
+    bd.Usage = D3D11_USAGE_IMMUTABLE;
+    bd.ByteWidth = (UINT)(sizeof(PackedVertex) * packedVertices.size());
+    bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bd.CPUAccessFlags = 0;
+    bd.MiscFlags = 0;
+    bd.StructureByteStride = 0;
+
+    D3D11_SUBRESOURCE_DATA InitData;
+    ZeroMemory(&InitData, sizeof(InitData));
+    InitData.pSysMem = packedVertices.data();
+    InitData.SysMemPitch = bd.ByteWidth;
+    InitData.SysMemSlicePitch = 0;
+
+    hr = device->CreateBuffer(&bd, &InitData, &g_pVertexBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    MeshQuantizationCB meshQuantization = {
+        XMFLOAT4(quantization.scale[0], quantization.scale[1], quantization.scale[2], 0.0f),
+        XMFLOAT4(quantization.offset[0], quantization.offset[1], quantization.offset[2], 0.0f)
+    };
+
+    D3D11_BUFFER_DESC quantizationDesc = {};
+    quantizationDesc.ByteWidth = sizeof(MeshQuantizationCB);
+    quantizationDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    quantizationDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA quantizationData = {};
+    quantizationData.pSysMem = &meshQuantization;
+
+    hr = device->CreateBuffer(&quantizationDesc, &quantizationData, &g_pMeshQuantizationBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_BUFFER_DESC bd1;
+    ZeroMemory(&bd1, sizeof(bd1));
+    bd1.Usage = D3D11_USAGE_IMMUTABLE;
+    bd1.ByteWidth = (UINT)(cubeMesh.getIndexSize() * indexCount);
+    bd1.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    bd1.CPUAccessFlags = 0;
+    bd1.MiscFlags = 0;
+    bd1.StructureByteStride = 0;
+
+    D3D11_SUBRESOURCE_DATA InitData1;
+    ZeroMemory(&InitData1, sizeof(InitData1));
+    InitData1.pSysMem = cubeMesh.getIndexData();
+    InitData1.SysMemPitch = bd1.ByteWidth;
+    InitData1.SysMemSlicePitch = 0;
+
+    hr = device->CreateBuffer(&bd1, &InitData1, &g_pIndexBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_BUFFER_DESC argSrcDesc = {};
+    argSrcDesc.ByteWidth = sizeof(D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS);
+    argSrcDesc.Usage = D3D11_USAGE_DEFAULT;
+    argSrcDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    argSrcDesc.CPUAccessFlags = 0;
+    argSrcDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    argSrcDesc.StructureByteStride = sizeof(UINT);
+
+    hr = device->CreateBuffer(&argSrcDesc, nullptr, &g_pInderectArgsSrc);
+    if (FAILED(hr))
+        return hr;
+    hr = device->CreateUnorderedAccessView(g_pInderectArgsSrc, nullptr, &g_pInderectArgsUAV);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_BUFFER_DESC argDesc = {};
+    argDesc.ByteWidth = sizeof(D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS);
+    argDesc.Usage = D3D11_USAGE_DEFAULT;
+    argDesc.BindFlags = 0;
+    argDesc.CPUAccessFlags = 0;
+    argDesc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+    argDesc.StructureByteStride = 0;
+
+    hr = device->CreateBuffer(&argDesc, nullptr, &g_pInderectArgs);
+    if (FAILED(hr))
+        return hr;
+
+    hr = initInstanceBuffers(device);
+    if (FAILED(hr))
+        return hr;
+    cubesFrame.consumeGrowth();
+
+    D3D11_RASTERIZER_DESC descRastr = {};
+    descRastr.FillMode = D3D11_FILL_SOLID;
+    descRastr.CullMode = D3D11_CULL_BACK;
+    descRastr.FrontCounterClockwise = false;
+    descRastr.DepthBias = 0;
+    descRastr.SlopeScaledDepthBias = 0.0f;
+    descRastr.DepthBiasClamp = 0.0f;
+    descRastr.DepthClipEnable = true;
+    descRastr.ScissorEnable = false;
+    descRastr.MultisampleEnable = false;
+    descRastr.AntialiasedLineEnable = false;
+
+    hr = device->CreateRasterizerState(&descRastr, &g_pRasterizerState);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_SAMPLER_DESC descSmplr = {};
+    descSmplr.Filter = D3D11_FILTER_ANISOTROPIC;
+    descSmplr.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+    descSmplr.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+    descSmplr.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    descSmplr.MinLOD = -D3D11_FLOAT32_MAX;
+    descSmplr.MaxLOD = D3D11_FLOAT32_MAX;
+    descSmplr.MipLODBias = 0.0f;
+    descSmplr.MaxAnisotropy = 16;
+    descSmplr.ComparisonFunc = D3D11_COMPARISON_NEVER;
+    descSmplr.BorderColor[0] =
+        descSmplr.BorderColor[1] =
+        descSmplr.BorderColor[2] =
+        descSmplr.BorderColor[3] = 1.0f;
+
+    hr = device->CreateSamplerState(&descSmplr, &g_pSamplerState);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_DEPTH_STENCIL_DESC dsDesc = { 0 };
+    ZeroMemory(&dsDesc, sizeof(dsDesc));
+    dsDesc.DepthEnable = TRUE;
+    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    dsDesc.DepthFunc = D3D11_COMPARISON_GREATER_EQUAL;
+    dsDesc.StencilEnable = FALSE;
+
+    hr = device->CreateDepthStencilState(&dsDesc, &g_pDepthState);
+    if (FAILED(hr))
+        return hr;
+
+    return S_OK;
+}
+
+int Cube::addCube(const XMFLOAT4& pos, bool isStatic) {
+    float textureIndex = (float)(rand() % texturesCount);
+    XMFLOAT4 params = XMFLOAT4(cubesShines, (float)(rand() % 10 - 5), textureIndex, textureIndex > 0.0f ? 0.0f : 1.0f);
+    return int(cubesFrame.add(&pos.x, &params.x, isStatic));
+}
+
+// A removed static cube keeps shadowing the bake of the others until the next bake.
+void Cube::removeCube(int id) {
+    if (id < 0)
+        return;
+    cubesFrame.remove(uint32_t(id));
+    if (size_t(id) < cubesBakedOffsets.size() && cubesBakedOffsets[id] != BAKED_NONE) {
+        cubesBakedOffsets[id] = BAKED_NONE;
+        bakedOffsetsDirty = true;
+    }
+}
+
+// One BakedVertex per vertex of the cube mesh per static cube, in the order of the static slots,
+// uploaded as four halves (light rgb, sky visibility) the vertex shader picks by SV_VertexID.
+HRESULT Cube::bakeStaticLighting(ID3D11Device* device, const std::vector<XMFLOAT4>& lightSpheres, const std::vector<XMFLOAT4>& lightColors, float lightSize) {
+    if (g_pBakedVerticesSRV) g_pBakedVerticesSRV->Release();
+    if (g_pBakedVertices) g_pBakedVertices->Release();
+    g_pBakedVerticesSRV = nullptr;
+    g_pBakedVertices = nullptr;
+
+    const std::vector<uint32_t>& staticSlots = cubesFrame.getStaticSlots();
+    std::vector<XMFLOAT4X4> matrices(staticSlots.size());
+    for (size_t i = 0; i < staticSlots.size(); i++)
+        memcpy(&matrices[i], cubesFrame.getInstance(staticSlots[i]).worldMatrix, sizeof(XMFLOAT4X4));
+    cubesBaker.setInstances(reinterpret_cast<const float*>(matrices.data()), sizeof(XMFLOAT4X4), matrices.size(), CubeFrame::localMin, CubeFrame::localMax);
+    assert(lightSpheres.size() == lightColors.size());
+    cubesBaker.setLights(reinterpret_cast<const float*>(lightSpheres.data()), sizeof(XMFLOAT4),
+        reinterpret_cast<const float*>(lightColors.data()), sizeof(XMFLOAT4), lightSpheres.size());
+
+    const Mesh& cubeMesh = MeshLibrary::GetInstance().getCube();
+    size_t vertexCount = cubeMesh.vertices.size();
+    BakeSettings settings;
+    settings.lightSize = lightSize;
+    std::vector<BakedVertex> baked;
+    cubesBaker.bakeCached("./staticCubes.bake", cubeMesh.vertices[0].position, cubeMesh.vertices[0].normal, sizeof(MeshVertex), vertexCount,
+        settings, baked);
+
+    cubesBakedOffsets.assign(cubesFrame.size(), BAKED_NONE);
+    for (size_t i = 0; i < staticSlots.size(); i++)
+        cubesBakedOffsets[staticSlots[i]] = UINT(i * vertexCount);
+    bakedOffsetsDirty = true;
+    if (baked.empty())
+        return S_OK;
+
+    std::vector<uint32_t> packed(baked.size() * 2);
+    for (size_t i = 0; i < baked.size(); i++) {
+        packed[i * 2] = floatToHalf(baked[i].light[0]) | (uint32_t(floatToHalf(baked[i].light[1])) << 16);
+        packed[i * 2 + 1] = floatToHalf(baked[i].light[2]) | (uint32_t(floatToHalf(baked[i].skyVisibility)) << 16);
+    }
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = UINT(sizeof(uint32_t) * packed.size());
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    desc.StructureByteStride = sizeof(uint32_t) * 2;
+
+    D3D11_SUBRESOURCE_DATA data = {};
+    data.pSysMem = packed.data();
+
+    HRESULT hr = device->CreateBuffer(&desc, &data, &g_pBakedVertices);
+    if (FAILED(hr))
+        return hr;
+    return device->CreateShaderResourceView(g_pBakedVertices, nullptr, &g_pBakedVerticesSRV);
+}
+
+// Instance buffers are sized by the store capacity and indexed by slot, so they are only
+// recreated when the store grows. Views are created with null descriptions (whole buffer).
+HRESULT Cube::initInstanceBuffers(ID3D11Device* device) {
+    releaseInstanceBuffers();
+
+    UINT capacity = UINT((std::max)(cubesFrame.capacity(), cubesFrame.getChunkSize()));
+
+    D3D11_BUFFER_DESC geomDesc = {};
+    geomDesc.ByteWidth = sizeof(PackedInstance) * capacity;
+    geomDesc.Usage = D3D11_USAGE_DEFAULT;
+    geomDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    geomDesc.CPUAccessFlags = 0;
+    geomDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    geomDesc.StructureByteStride = sizeof(PackedInstance);
+
+    HRESULT hr = device->CreateBuffer(&geomDesc, nullptr, &g_pGeomBuffer);
+    if (FAILED(hr))
+        return hr;
+    hr = device->CreateShaderResourceView(g_pGeomBuffer, nullptr, &g_pGeomBufferSRV);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_BUFFER_DESC boundsDesc = {};
+    boundsDesc.ByteWidth = sizeof(CullingBounds) * capacity;
+    boundsDesc.Usage = D3D11_USAGE_DEFAULT;
+    boundsDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    boundsDesc.CPUAccessFlags = 0;
+    boundsDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    boundsDesc.StructureByteStride = sizeof(CullingBounds);
+
+    hr = device->CreateBuffer(&boundsDesc, nullptr, &g_pCullingBounds);
+    if (FAILED(hr))
+        return hr;
+    hr = device->CreateShaderResourceView(g_pCullingBounds, nullptr, &g_pCullingBoundsSRV);
+    if (FAILED(hr))
+        return hr;
+
+    // INSTANCE_LIGHTS 16-bit light indices per slot, read as uint2 by the pixel shader.
+    D3D11_BUFFER_DESC lightsDesc = {};
+    lightsDesc.ByteWidth = sizeof(uint16_t) * INSTANCE_LIGHTS * capacity;
+    lightsDesc.Usage = D3D11_USAGE_DEFAULT;
+    lightsDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    lightsDesc.CPUAccessFlags = 0;
+    lightsDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    lightsDesc.StructureByteStride = sizeof(uint16_t) * INSTANCE_LIGHTS;
+
+    hr = device->CreateBuffer(&lightsDesc, nullptr, &g_pInstanceLights);
+    if (FAILED(hr))
+        return hr;
+    hr = device->CreateShaderResourceView(g_pInstanceLights, nullptr, &g_pInstanceLightsSRV);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_BUFFER_DESC bakedDesc = {};
+    bakedDesc.ByteWidth = sizeof(UINT) * capacity;
+    bakedDesc.Usage = D3D11_USAGE_DEFAULT;
+    bakedDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bakedDesc.CPUAccessFlags = 0;
+    bakedDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bakedDesc.StructureByteStride = sizeof(UINT);
+
+    hr = device->CreateBuffer(&bakedDesc, nullptr, &g_pBakedOffsets);
+    if (FAILED(hr))
+        return hr;
+    hr = device->CreateShaderResourceView(g_pBakedOffsets, nullptr, &g_pBakedOffsetsSRV);
+    if (FAILED(hr))
+        return hr;
+    bakedOffsetsDirty = true;
+
+    D3D11_BUFFER_DESC visDesc = {};
+    visDesc.ByteWidth = sizeof(UINT) * capacity;
+    visDesc.Usage = D3D11_USAGE_DEFAULT;
+    visDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+    visDesc.CPUAccessFlags = 0;
+    visDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    visDesc.StructureByteStride = sizeof(UINT);
+
+    hr = device->CreateBuffer(&visDesc, nullptr, &g_pGeomBufferInstVisGpu);
+    if (FAILED(hr))
+        return hr;
+    hr = device->CreateUnorderedAccessView(g_pGeomBufferInstVisGpu, nullptr, &g_pGeomBufferInstVisGpu_UAV);
+    if (FAILED(hr))
+        return hr;
+    hr = device->CreateShaderResourceView(g_pGeomBufferInstVisGpu, nullptr, &g_pGeomBufferInstVisGpu_SRV);
+    if (FAILED(hr))
+        return hr;
+
+    cubesFrame.markAllDirty();
+
+    return S_OK;
+}
+
+void Cube::releaseInstanceBuffers() {
+    if (g_pGeomBufferSRV) g_pGeomBufferSRV->Release();
+    if (g_pGeomBuffer) g_pGeomBuffer->Release();
+    if (g_pCullingBoundsSRV) g_pCullingBoundsSRV->Release();
+    if (g_pCullingBounds) g_pCullingBounds->Release();
+    if (g_pInstanceLightsSRV) g_pInstanceLightsSRV->Release();
+    if (g_pInstanceLights) g_pInstanceLights->Release();
+    if (g_pBakedOffsetsSRV) g_pBakedOffsetsSRV->Release();
+    if (g_pBakedOffsets) g_pBakedOffsets->Release();
+    if (g_pGeomBufferInstVisGpu_SRV) g_pGeomBufferInstVisGpu_SRV->Release();
+    if (g_pGeomBufferInstVisGpu_UAV) g_pGeomBufferInstVisGpu_UAV->Release();
+    if (g_pGeomBufferInstVisGpu) g_pGeomBufferInstVisGpu->Release();
+
+    g_pGeomBufferSRV = nullptr;
+    g_pGeomBuffer = nullptr;
+    g_pCullingBoundsSRV = nullptr;
+    g_pCullingBounds = nullptr;
+    g_pInstanceLightsSRV = nullptr;
+    g_pInstanceLights = nullptr;
+    g_pBakedOffsetsSRV = nullptr;
+    g_pBakedOffsets = nullptr;
+    g_pGeomBufferInstVisGpu_SRV = nullptr;
+    g_pGeomBufferInstVisGpu_UAV = nullptr;
+    g_pGeomBufferInstVisGpu = nullptr;
+}
+
+// Slots added since the last upload are moving cubes until the next bake.
+void Cube::uploadBakedOffsets(CommandList& commands) {
+    if (!bakedOffsetsDirty && cubesBakedOffsets.size() == cubesFrame.size())
+        return;
+
+    cubesBakedOffsets.resize(cubesFrame.size(), BAKED_NONE);
+    if (!cubesBakedOffsets.empty())
+        commands.updateBufferRange(g_pBakedOffsets, cubesBakedOffsets.data(), 0, UINT(sizeof(UINT) * cubesBakedOffsets.size()));
+    bakedOffsetsDirty = false;
+}
+
+void Cube::realize() {
+    for (auto& tex : cubesTextures)
+        tex.realize();
+
+    if (g_pSamplerState) g_pSamplerState->Release();
+    if (g_pRasterizerState) g_pRasterizerState->Release();
+
+    releaseInstanceBuffers();
+
+    if (g_pBakedVerticesSRV) g_pBakedVerticesSRV->Release();
+    if (g_pBakedVertices) g_pBakedVertices->Release();
+    if (g_pDepthState) g_pDepthState->Release();
+    if (g_pIndexBuffer) g_pIndexBuffer->Release();
+    if (g_pMeshQuantizationBuffer) g_pMeshQuantizationBuffer->Release();
+    if (g_pVertexBuffer) g_pVertexBuffer->Release();
+    if (g_pVertexLayout) g_pVertexLayout->Release();
+    if (g_pVertexShader) g_pVertexShader->Release();
+    if (g_pPixelShader) g_pPixelShader->Release();
+
+    if (g_pInderectArgsSrc) g_pInderectArgsSrc->Release();
+    if (g_pInderectArgs) g_pInderectArgs->Release();
+    if (g_pInderectArgsUAV) g_pInderectArgsUAV->Release();
+    if (g_pCullShader) g_pCullShader->Release();
+
+    for (auto& q : queries) {
+        q->Release();
+    }
+}
+
+// All the cubes are one indirect draw.
+void Cube::submit(RenderQueue& queue, uint32_t object) const {
+    queue.submit(makeOpaqueKey(RENDER_PASS_OPAQUE, object, 0, 0.0f), object, 0);
+}
+
+void Cube::bind(CommandList& commands) {
+    commands.setDepthStencilState(g_pDepthState, 0);
+    commands.setRasterizerState(g_pRasterizerState);
+
+    commands.setIndexBuffer(g_pIndexBuffer, indexFormat, 0);
+    ID3D11SamplerState* samplers[] = { g_pSamplerState };
+    commands.setSamplers(SHADER_STAGE_PIXEL, 0, 1, samplers);
+
+    ID3D11ShaderResourceView* resources[] = {
+        cubesTextures[0].getTexture(),
+        cubesTextures[1].getTexture()
+    };
+    commands.setShaderResources(SHADER_STAGE_PIXEL, 0, 2, resources);
+
+    ID3D11Buffer* vertexBuffers[] = { g_pVertexBuffer };
+    UINT strides[] = { sizeof(PackedVertex) };
+    UINT offsets[] = { 0 };
+    commands.setVertexBuffers(0, 1, vertexBuffers, strides, offsets);
+    commands.setInputLayout(g_pVertexLayout);
+    commands.setPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    ID3D11ShaderResourceView* instanceResources[] = { g_pGeomBufferSRV, g_pGeomBufferInstVisGpu_SRV };
+
+    commands.setShader(SHADER_STAGE_VERTEX, g_pVertexShader);
+    commands.setConstantBuffers(SHADER_STAGE_VERTEX, 0, 1, &g_pMeshQuantizationBuffer);
+    commands.setShaderResources(SHADER_STAGE_VERTEX, 2, 2, instanceResources);
+    ID3D11ShaderResourceView* bakedResources[] = { g_pBakedOffsetsSRV, g_pBakedVerticesSRV };
+    commands.setShaderResources(SHADER_STAGE_VERTEX, 5, 2, bakedResources);
+
+    commands.setShader(SHADER_STAGE_PIXEL, g_pPixelShader);
+    commands.setShaderResources(SHADER_STAGE_PIXEL, 2, 1, &g_pGeomBufferSRV);
+    commands.setShaderResources(SHADER_STAGE_PIXEL, 4, 1, &g_pInstanceLightsSRV);
+}
+
+void Cube::draw(CommandList& commands, uint32_t item) {
+    commands.beginQuery(queries[curFrame % MAX_QUERY]);
+    commands.drawIndexedInstancedIndirect(g_pInderectArgs, 0);
+    commands.endQuery(queries[curFrame % MAX_QUERY]);
+    curFrame++;
+}
+
+// The cubes move every frame, so every slot is scored again and the whole list is sent. Free
+// slots have a negative radius and get no lights, and so does every slot when there are none.
+void Cube::selectLights(CommandList& commands, const std::vector<XMFLOAT4>& lightSpheres, const std::vector<XMFLOAT4>& lightColors) {
+    if (lightSpheres.empty()) {
+        cubesLightIndices.assign(cubesFrame.size() * INSTANCE_LIGHTS, LightSelector::NO_LIGHT);
+    }
+    else {
+        cubesLights.setLights(reinterpret_cast<const float*>(lightSpheres.data()), sizeof(XMFLOAT4),
+            reinterpret_cast<const float*>(lightColors.data()), sizeof(XMFLOAT4), lightSpheres.size());
+        cubesLights.select(cubesFrame.getBounds(), INSTANCE_LIGHTS, cubesLightIndices);
+    }
+    if (!cubesLightIndices.empty())
+        commands.updateBufferRange(g_pInstanceLights, cubesLightIndices.data(), 0, UINT(sizeof(uint16_t) * cubesLightIndices.size()));
+}
+
+void Cube::cullShadowCasters(const std::vector<XMFLOAT4>& lightSpheres) {
+    cubesShadowCasters.cull(cubesFrame.getBounds(), reinterpret_cast<const float*>(lightSpheres.data()), sizeof(XMFLOAT4), lightSpheres.size(),
+        reinterpret_cast<const float(*)[4]>(frustum.planes));
+}
+
+void Cube::getFrustum(XMMATRIX viewMatrix, XMMATRIX projectionMatrix) {
+    XMFLOAT4X4 pMatrix;
+    XMStoreFloat4x4(&pMatrix, projectionMatrix);
+
+    float zMinimum = -pMatrix._43 / pMatrix._33;
+    float r = frustum.screenDepth / (frustum.screenDepth - zMinimum);
+
+    pMatrix._33 = r;
+    pMatrix._43 = -r * zMinimum;
+    projectionMatrix = XMLoadFloat4x4(&pMatrix);
+
+    XMMATRIX finalMatrix = XMMatrixMultiply(viewMatrix, projectionMatrix);
+
+    XMFLOAT4X4 matrix;
+    XMStoreFloat4x4(&matrix, finalMatrix);
+
+    extractFrustumPlanes(&matrix._11, reinterpret_cast<float(*)[4]>(frustum.planes));
+}
+
+// The context only creates buffers and reads the queries back; everything else is recorded.
+// The CPU side of the frame is CubeFrame's, this only adds the buffers and the GPU culling.
+bool Cube::frame(ID3D11DeviceContext* context, CommandList& commands, XMMATRIX& viewMatrix, XMMATRIX& projectionMatrix,
+        XMFLOAT3& cameraPos, bool fixFrustumCulling, bool gpuCulling, bool occlusionCulling) {
+    readQueries(context);
+
+    cubesFrame.update(Timer::GetInstance().Clock(), angle_velocity);
+
+    if (!fixFrustumCulling) {
+        getFrustum(viewMatrix, projectionMatrix);
+    }
+
+    if (cubesFrame.consumeGrowth()) {
+        ID3D11Device* device = nullptr;
+        context->GetDevice(&device);
+        HRESULT hr = initInstanceBuffers(device);
+        device->Release();
+        if (FAILED(hr))
+            return FAILED(hr);
+    }
+    cubesFrame.recordUploads(commands, g_pGeomBuffer, g_pCullingBounds);
+    uploadBakedOffsets(commands);
+
+    if (!gpuCulling) {
+        const float(*planes)[4] = reinterpret_cast<const float(*)[4]>(frustum.planes);
+        XMFLOAT4X4 viewProjection;
+        XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(viewMatrix, projectionMatrix));
+        cubesFrame.cull(planes, occlusionCulling ? &viewProjection._11 : nullptr, &cameraPos.x);
+        cubesFrame.recordVisible(commands, g_pGeomBufferInstVisGpu, g_pInderectArgsSrc, g_pInderectArgs, indexCount);
+
+        return S_OK;
+    }
+
+    IndexedIndirectArgs args = { indexCount, 0, 0, 0, 0 };
+    commands.updateBuffer(g_pInderectArgsSrc, &args, sizeof(args));
+
+    size_t slots = cubesFrame.size();
+    CullingParams& cullingParams = *reinterpret_cast<CullingParams*>(commands.writeConstants(cullingParamsBlock, sizeof(CullingParams)));
+    cullingParams.numShapes = XMINT4(int(slots), 0, 0, 0);
+    for (int i = 0; i < 6; i++)
+        cullingParams.planes[i] = frustum.planes[i];
+
+    UINT groupNumber = UINT((slots + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE);
+    if (groupNumber > 0) {
+        // The visible ids are still bound to the vertex shader from the previous frame.
+        ID3D11ShaderResourceView* nullSRV = nullptr;
+        commands.setShaderResources(SHADER_STAGE_VERTEX, 3, 1, &nullSRV);
+
+        ID3D11UnorderedAccessView* uavs[] = { g_pInderectArgsUAV, g_pGeomBufferInstVisGpu_UAV };
+        commands.setConstantBlocks(SHADER_STAGE_COMPUTE, 0, 1, &cullingParamsBlock);
+        commands.setShaderResources(SHADER_STAGE_COMPUTE, 0, 1, &g_pCullingBoundsSRV);
+        commands.setUnorderedAccessViews(0, 2, uavs);
+        commands.setShader(SHADER_STAGE_COMPUTE, g_pCullShader);
+        commands.dispatch((std::min)(groupNumber, UINT(MAX_DISPATCH_GROUPS)), (groupNumber + MAX_DISPATCH_GROUPS - 1) / MAX_DISPATCH_GROUPS, 1);
+
+        ID3D11UnorderedAccessView* nullUAVs[] = { nullptr, nullptr };
+        commands.setUnorderedAccessViews(0, 2, nullUAVs);
+        commands.setShaderResources(SHADER_STAGE_COMPUTE, 0, 1, &nullSRV);
+    }
+
+    commands.copyResource(g_pInderectArgs, g_pInderectArgsSrc);
+
+    return S_OK;
+}
@@ -1,72 +1,128 @@
-#pragma once
-
-#include <d3dcompiler.h>
-#include <dxgi.h>
-#include <d3d11.h>
-#include <directxmath.h>
-#include <string>
-#include <vector>
-
-#include "texture.h"
-#include "structures.h"
-#include "light.h"
-
-using namespace DirectX;
-
-struct Frustum
-{
-	float screenDepth;
-	XMFLOAT4 planes[6];
-};
-
-class Cube {
-public:
-	HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight,
-		std::vector<const wchar_t*> diffPaths, const wchar_t* normalPath, float shines, const std::vector<XMFLOAT4>& positions);
-	void realize();
-	void resize(int screenWidth, int screenHeight) {};
-	void render(ID3D11DeviceContext* context);
-	bool frame(ID3D11DeviceContext* context, XMMATRIX& viewMatrix, XMMATRIX& projectionMatrix,
-		XMFLOAT3& cameraPos, const Light& lights, bool fixFrustumCulling);
-	int getRenderedCubesCount() { return countOfRenderedCubes; };
-
-private:
-	HRESULT initQuery(ID3D11Device* device);
-	void readQueries(ID3D11DeviceContext* context);
-	void getFrustum(XMMATRIX viewMatrix, XMMATRIX projectionMatrix);
-
-	ID3D11VertexShader* g_pVertexShader = nullptr;
-	ID3D11PixelShader* g_pPixelShader = nullptr;
-	ID3D11InputLayout* g_pVertexLayout = nullptr;
-	ID3D11ComputeShader* g_pCullShader = nullptr;
-
-	ID3D11Buffer* g_pVertexBuffer = nullptr;
-	ID3D11Buffer* g_pIndexBuffer = nullptr;
-	ID3D11Buffer* g_pGeomBuffer = nullptr;
-	ID3D11Buffer* g_pCullingParams = nullptr;
-	ID3D11Buffer* g_LightConstantBuffer = nullptr;
-	ID3D11Buffer* g_pSceneMatrixBuffer = nullptr;
-	ID3D11RasterizerState* g_pRasterizerState = nullptr;
-	ID3D11SamplerState* g_pSamplerState = nullptr;
-	ID3D11DepthStencilState* g_pDepthState = nullptr;
-
-	ID3D11Buffer* g_pInderectArgsSrc = nullptr;
-	ID3D11Buffer* g_pInderectArgs = nullptr;
-	ID3D11UnorderedAccessView* g_pInderectArgsUAV = nullptr;
-	ID3D11Buffer* g_pGeomBufferInstVis = nullptr;
-	ID3D11Buffer* g_pGeomBufferInstVisGpu = nullptr;
-	ID3D11UnorderedAccessView* g_pGeomBufferInstVisGpu_UAV = nullptr;
-
-	std::vector<Texture> cubesTextures;
-	std::vector<CubeModel> cubesModelVector;
-	std::vector<int> cubesIndexies;
-
-	Frustum frustum;
-	float angle_velocity = XM_PIDIV2;
-
-	int countOfRenderedCubes = MAX_CUBES;
-
-	UINT curFrame = 0;
-	UINT lastCompletedFrame = 0;
-	ID3D11Query* queries[MAX_QUERY];
-};
+#pragma once
+
+#include <d3dcompiler.h>
+#include <dxgi.h>
+#include <d3d11.h>
+#include <directxmath.h>
+#include <string>
+#include <vector>
+
+#include "texture.h"
+#include "structures.h"
+#include "light.h"
+#include "cubeFrame.h"
+#include "lightSelection.h"
+#include "lightBaker.h"
+#include "shadowCasterCuller.h"
+#include "vertexPacking.h"
+#include "meshLibrary.h"
+#include "renderQueue.h"
+#include "commandList.h"
+
+using namespace DirectX;
+
+struct Frustum
+{
+	float screenDepth;
+	XMFLOAT4 planes[6];
+};
+
+class Cube {
+public:
+	HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight,
+		std::vector<const wchar_t*> diffPaths, const wchar_t* normalPath, float shines, const std::vector<XMFLOAT4>& positions);
+	void realize();
+	void resize(int screenWidth, int screenHeight) {};
+	void submit(RenderQueue& queue, uint32_t object) const;
+	void bind(CommandList& commands);
+	void draw(CommandList& commands, uint32_t item);
+	bool frame(ID3D11DeviceContext* context, CommandList& commands, XMMATRIX& viewMatrix, XMMATRIX& projectionMatrix,
+		XMFLOAT3& cameraPos, bool fixFrustumCulling, bool gpuCulling, bool occlusionCulling);
+	int getRenderedCubesCount() { return countOfRenderedCubes; };
+	int getCubesCount() { return (int)cubesFrame.count(); };
+	// World bounds by slot from the last frame; free slots have a negative radius.
+	const InstanceBounds& getBounds() const { return cubesFrame.getBounds(); };
+	// Plane cache counters of the last cull of the static cubes' BVH.
+	const CullingStats& getCullingStats() const { return cubesFrame.getCullingStats(); };
+	const OcclusionStats& getOcclusionStats() const { return cubesFrame.getOcclusionStats(); };
+	// Picks the INSTANCE_LIGHTS brightest lights of every cube for the LIGHTING_INSTANCE mode.
+	void selectLights(CommandList& commands, const std::vector<XMFLOAT4>& lightSpheres, const std::vector<XMFLOAT4>& lightColors);
+	const LightSelectionStats& getLightSelectionStats() const { return cubesLights.getStats(); };
+	// Finds the cubes seen by each cube face of the lights that reach the view frustum, the
+	// draw lists of point-light shadows.
+	void cullShadowCasters(const std::vector<XMFLOAT4>& lightSpheres);
+	const ShadowCasterCuller& getShadowCasters() const { return cubesShadowCasters; };
+	// The grid the cubes keep their bounding spheres in, by slot id; set before init.
+	void setSpatialGrid(SpatialGrid* grid) { cubesFrame.setSpatialGrid(grid); };
+	// Static cubes stay where they were added and take their light from the bake.
+	int addCube(const XMFLOAT4& pos, bool isStatic = false);
+	void removeCube(int id);
+	// Bakes the lights and the sky occlusion of the static cubes into their vertices, or reads
+	// the bake back from the asset when nothing it depends on has changed. Every light passed
+	// is baked as static: the static cubes get no other light, so none of these may move or
+	// change color afterwards (Scene's lights are placed once, in init).
+	HRESULT bakeStaticLighting(ID3D11Device* device, const std::vector<XMFLOAT4>& lightSpheres, const std::vector<XMFLOAT4>& lightColors, float lightSize);
+	const BakeStats& getBakeStats() const { return cubesBaker.getStats(); };
+
+private:
+	HRESULT initInstanceBuffers(ID3D11Device* device);
+	void releaseInstanceBuffers();
+	void uploadBakedOffsets(CommandList& commands);
+	HRESULT initQuery(ID3D11Device* device);
+	void readQueries(ID3D11DeviceContext* context);
+	void getFrustum(XMMATRIX viewMatrix, XMMATRIX projectionMatrix);
+
+	ID3D11VertexShader* g_pVertexShader = nullptr;
+	ID3D11PixelShader* g_pPixelShader = nullptr;
+	ID3D11InputLayout* g_pVertexLayout = nullptr;
+	ID3D11ComputeShader* g_pCullShader = nullptr;
+
+	ID3D11Buffer* g_pVertexBuffer = nullptr;
+	ID3D11Buffer* g_pIndexBuffer = nullptr;
+	ID3D11Buffer* g_pMeshQuantizationBuffer = nullptr;
+	ID3D11Buffer* g_pGeomBuffer = nullptr;
+	ID3D11ShaderResourceView* g_pGeomBufferSRV = nullptr;
+	ID3D11Buffer* g_pCullingBounds = nullptr;
+	ID3D11ShaderResourceView* g_pCullingBoundsSRV = nullptr;
+	ID3D11Buffer* g_pInstanceLights = nullptr;
+	ID3D11ShaderResourceView* g_pInstanceLightsSRV = nullptr;
+	ID3D11Buffer* g_pBakedOffsets = nullptr;
+	ID3D11ShaderResourceView* g_pBakedOffsetsSRV = nullptr;
+	ID3D11Buffer* g_pBakedVertices = nullptr;
+	ID3D11ShaderResourceView* g_pBakedVerticesSRV = nullptr;
+	ID3D11RasterizerState* g_pRasterizerState = nullptr;
+	ID3D11SamplerState* g_pSamplerState = nullptr;
+	ID3D11DepthStencilState* g_pDepthState = nullptr;
+
+	ID3D11Buffer* g_pInderectArgsSrc = nullptr;
+	ID3D11Buffer* g_pInderectArgs = nullptr;
+	ID3D11UnorderedAccessView* g_pInderectArgsUAV = nullptr;
+	ID3D11Buffer* g_pGeomBufferInstVisGpu = nullptr;
+	ID3D11UnorderedAccessView* g_pGeomBufferInstVisGpu_UAV = nullptr;
+	ID3D11ShaderResourceView* g_pGeomBufferInstVisGpu_SRV = nullptr;
+
+	uint32_t cullingParamsBlock = newConstantBlock();
+
+	std::vector<Texture> cubesTextures;
+	CubeFrame cubesFrame;
+	LightSelector cubesLights;
+	ShadowCasterCuller cubesShadowCasters;
+	std::vector<uint16_t> cubesLightIndices; // INSTANCE_LIGHTS per slot
+	std::vector<UINT> cubesBakedOffsets; // first baked vertex per slot, BAKED_NONE for moving cubes
+	bool bakedOffsetsDirty = false;
+	LightBaker cubesBaker;
+
+	UINT indexCount = 0;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT;
+
+	Frustum frustum;
+	float angle_velocity = XM_PIDIV2;
+	float cubesShines = 0.0f;
+	size_t texturesCount = 1;
+
+	int countOfRenderedCubes = 0;
+
+	UINT curFrame = 0;
+	UINT lastCompletedFrame = 0;
+	ID3D11Query* queries[MAX_QUERY];
+};
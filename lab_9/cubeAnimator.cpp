@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cmath>
+
+#include "cubeAnimator.h"
+#include "simd.h"
+
+// With the row-vector convention the rotation part of the chain is Rx * Ry * Rz and the
+// translations only add up in the last row: (T1 * Ry * Rz) + T2 + pos. Writing the products
+// out leaves five sines/cosines per instance instead of six 4x4 matrix multiplications.
+void CubeAnimator::setTime(double duration, float angleVelocity) {
+    time = (float)duration;
+    this->angleVelocity = angleVelocity;
+    halfSinTime = (float)sin(duration) * 0.5f;
+    halfCosTime = (float)cos(duration) * 0.5f;
+    cosTime3 = (float)cos(duration) * 3.0f;
+}
+
+void CubeAnimator::animateOne(const float pos[3], float spin, float speed, float matrix[16]) const {
+    float a = time * spin * 0.01f;
+    float b = time * speed * 1.5f;
+    float c = sinf(time * speed * 0.3f) * 0.25f;
+    float d = sinf(time * angleVelocity * speed);
+    float sa = sinf(a), ca = cosf(a);
+    float sb = sinf(b), cb = cosf(b);
+    float sc = sinf(c), cc = cosf(c);
+
+    matrix[0] = cb * cc;
+    matrix[1] = cb * sc;
+    matrix[2] = -sb;
+    matrix[3] = 0.0f;
+
+    matrix[4] = sa * sb * cc - ca * sc;
+    matrix[5] = sa * sb * sc + ca * cc;
+    matrix[6] = sa * cb;
+    matrix[7] = 0.0f;
+
+    matrix[8] = ca * sb * cc + sa * sc;
+    matrix[9] = ca * sb * sc - sa * cc;
+    matrix[10] = ca * cb;
+    matrix[11] = 0.0f;
+
+    matrix[12] = halfSinTime * (cb + sb) * cc - halfCosTime * sc + d + pos[0];
+    matrix[13] = halfSinTime * (cb + sb) * sc + halfCosTime * cc + c + pos[1];
+    matrix[14] = halfSinTime * (cb - sb) + cosTime3 + pos[2];
+    matrix[15] = 1.0f;
+}
+
+#if defined(SIMD_SSE)
+// Cephes sinf/cosf for four lanes: reduce by multiples of pi/4 in three parts, evaluate
+// both minimax polynomials and pick/sign them by the octant. Max error is about 1 ulp for
+// |x| < 8192, in line with the float XMScalarSinCos used by XMMatrixRotation*.
+static inline void sinCos4(__m128 x, __m128& s, __m128& c) {
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(int(0x80000000)));
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128i four = _mm_set1_epi32(4);
+
+    __m128 signSin = _mm_and_ps(x, signMask);
+    x = _mm_andnot_ps(signMask, x);
+
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+    j = _mm_andnot_si128(one, _mm_add_epi32(j, one));
+    __m128 y = _mm_cvtepi32_ps(j);
+
+    __m128 swapSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, four), 29));
+    __m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, two), _mm_setzero_si128()));
+    __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, two), four), 29));
+    signSin = _mm_xor_ps(signSin, swapSin);
+
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 cosPoly = _mm_set1_ps(2.443315711809948e-5f);
+    cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(-1.388731625493765e-3f));
+    cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(4.166664568298827e-2f));
+    cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+    cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+    __m128 sinPoly = _mm_set1_ps(-1.9515295891e-4f);
+    sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(8.3321608736e-3f));
+    sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(-1.6666654611e-1f));
+    sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+    s = _mm_or_ps(_mm_and_ps(polyMask, sinPoly), _mm_andnot_ps(polyMask, cosPoly));
+    c = _mm_or_ps(_mm_and_ps(polyMask, cosPoly), _mm_andnot_ps(polyMask, sinPoly));
+    s = _mm_xor_ps(s, signSin);
+    c = _mm_xor_ps(c, signCos);
+}
+
+// Turns one matrix row held as four lane-vectors (x, y, z, w of instances 0..3) into
+// four rows and stores them `stride` bytes apart.
+static inline void storeRows(__m128 x, __m128 y, __m128 z, __m128 w, char* dst, size_t stride, size_t count) {
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    const __m128 rows[4] = { x, y, z, w };
+    for (size_t k = 0; k < count; k++)
+        _mm_storeu_ps(reinterpret_cast<float*>(dst + k * stride), rows[k]);
+}
+#endif
+
+void CubeAnimator::animate(const float* models, size_t modelStride, size_t count, float* world, size_t matrixStride) const {
+    const char* src = reinterpret_cast<const char*>(models);
+    char* dst = reinterpret_cast<char*>(world);
+
+#if defined(SIMD_SSE)
+    const __m128 time4 = _mm_set1_ps(time);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 halfSin = _mm_set1_ps(halfSinTime);
+    const __m128 halfCos = _mm_set1_ps(halfCosTime);
+    const __m128 cos3 = _mm_set1_ps(cosTime3);
+
+    for (size_t i = 0; i < count; i += 4) {
+        size_t lanes = (std::min)(count - i, size_t(4));
+
+        // CubeModel is AoS; the tail block repeats the last instance in the unused lanes.
+        alignas(16) float px[4], py[4], pz[4], spin[4], speed[4];
+        for (size_t k = 0; k < 4; k++) {
+            const float* model = reinterpret_cast<const float*>(src + (i + (std::min)(k, lanes - 1)) * modelStride);
+            px[k] = model[0];
+            py[k] = model[1];
+            pz[k] = model[2];
+            spin[k] = model[4];
+            speed[k] = model[5];
+        }
+
+        __m128 speed4 = _mm_load_ps(speed);
+        __m128 timeSpeed = _mm_mul_ps(time4, speed4);
+
+        __m128 sa, ca, sb, cb, sw, cw, sc, cc, sd, cd;
+        sinCos4(_mm_mul_ps(_mm_mul_ps(time4, _mm_load_ps(spin)), _mm_set1_ps(0.01f)), sa, ca);
+        sinCos4(_mm_mul_ps(timeSpeed, _mm_set1_ps(1.5f)), sb, cb);
+        sinCos4(_mm_mul_ps(timeSpeed, _mm_set1_ps(0.3f)), sw, cw);
+        __m128 c = _mm_mul_ps(sw, _mm_set1_ps(0.25f));
+        sinCos4(c, sc, cc);
+        sinCos4(_mm_mul_ps(timeSpeed, _mm_set1_ps(angleVelocity)), sd, cd);
+
+        __m128 sasb = _mm_mul_ps(sa, sb);
+        __m128 casb = _mm_mul_ps(ca, sb);
+        __m128 cbsb = _mm_add_ps(cb, sb);
+
+        char* block = dst + i * matrixStride;
+        storeRows(_mm_mul_ps(cb, cc), _mm_mul_ps(cb, sc), _mm_sub_ps(zero, sb), zero,
+            block, matrixStride, lanes);
+        storeRows(_mm_sub_ps(_mm_mul_ps(sasb, cc), _mm_mul_ps(ca, sc)), _mm_add_ps(_mm_mul_ps(sasb, sc), _mm_mul_ps(ca, cc)), _mm_mul_ps(sa, cb), zero,
+            block + 16, matrixStride, lanes);
+        storeRows(_mm_add_ps(_mm_mul_ps(casb, cc), _mm_mul_ps(sa, sc)), _mm_sub_ps(_mm_mul_ps(casb, sc), _mm_mul_ps(sa, cc)), _mm_mul_ps(ca, cb), zero,
+            block + 32, matrixStride, lanes);
+
+        __m128 tx = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(halfSin, cbsb), cc), _mm_mul_ps(halfCos, sc)), _mm_add_ps(sd, _mm_load_ps(px)));
+        __m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(halfSin, cbsb), sc), _mm_mul_ps(halfCos, cc)), _mm_add_ps(c, _mm_load_ps(py)));
+        __m128 tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(halfSin, _mm_sub_ps(cb, sb)), cos3), _mm_load_ps(pz));
+        storeRows(tx, ty, tz, one, block + 48, matrixStride, lanes);
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        const float* model = reinterpret_cast<const float*>(src + i * modelStride);
+        animateOne(model, model[4], model[5], reinterpret_cast<float*>(dst + i * matrixStride));
+    }
+#endif
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+// Evaluates the cube animation chain
+//   RotationX(t * spin * 0.01) * Translation(0.5 sin t, 0.5 cos t, 0.5 sin t) * RotationY(t * speed * 1.5) *
+//   RotationZ(0.25 sin(0.3 t * speed)) * Translation(sin(t * angleVelocity * speed), 0.25 sin(0.3 t * speed), 3 cos t) *
+//   Translation(pos)
+// in closed form, several instances at a time. spin and speed are CubeModel::params.x and .y.
+// Matrices are row-major with the row-vector convention, as XMMATRIX.
+class CubeAnimator {
+public:
+	// Per-frame terms shared by every instance.
+	void setTime(double duration, float angleVelocity);
+
+	// `models` points at the first CubeModel (pos.xyz, then params.xy at +16 bytes), read
+	// `modelStride` bytes apart. World matrices are written `matrixStride` bytes apart to `world`.
+	void animate(const float* models, size_t modelStride, size_t count, float* world, size_t matrixStride) const;
+
+	// Scalar reference of the same chain for a single instance.
+	void animateOne(const float pos[3], float spin, float speed, float matrix[16]) const;
+
+private:
+	float time = 0.0f;
+	float angleVelocity = 0.0f;
+	float halfSinTime = 0.0f;
+	float halfCosTime = 0.0f;
+	float cosTime3 = 0.0f;
+};
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cmath>
+
+#include "cubeFrame.h"
+#include "Consts.h"
+
+const float CubeFrame::localMin[3] = { -0.5f, -0.5f, -0.5f };
+const float CubeFrame::localMax[3] = { 0.5f, 0.5f, 0.5f };
+static const float DEPTH_SORT_RANGE = 100.0f; // the far plane of the camera projection
+
+static void updateBufferRange(CommandList& commands, GpuHandle buffer, const void* data, size_t stride, size_t first, size_t count) {
+    if (count == 0)
+        return;
+
+    commands.updateBufferRange(buffer, reinterpret_cast<const char*>(data) + first * stride, uint32_t(first * stride), uint32_t(count * stride));
+}
+
+uint32_t CubeFrame::add(const float pos[3], const float params[4], bool isStatic) {
+    CubeModel model = {};
+    GeomBuffer instance = {};
+    for (int i = 0; i < 3; i++)
+        model.pos[i] = pos[i];
+    model.pos[3] = 1.0f;
+    for (int i = 0; i < 4; i++) {
+        model.params[i] = params[i];
+        instance.params[i] = params[i];
+        instance.worldMatrix[i * 5] = 1.0f;
+    }
+    for (int i = 0; i < 3; i++)
+        instance.worldMatrix[12 + i] = pos[i];
+
+    uint32_t slot = store.add(instance);
+    if (slot >= models.size()) {
+        models.resize(slot + 1);
+        isStaticSlot.resize(slot + 1);
+    }
+    models[slot] = model;
+    isStaticSlot[slot] = isStatic ? 1 : 0;
+    if (isStatic) {
+        staticSlots.push_back(slot);
+        staticBvhDirty = true;
+        if (packed.size() < store.size())
+            packed.resize(store.size());
+        packInstances(store[slot].worldMatrix, sizeof(GeomBuffer), store[slot].params, sizeof(GeomBuffer), 1, &packed[slot]);
+    }
+
+    return slot;
+}
+
+void CubeFrame::remove(uint32_t slot) {
+    store.remove(slot);
+    if (spatialGrid && slot < gridHandles.size()) {
+        spatialGrid->remove(gridHandles[slot]);
+        gridHandles[slot] = -1;
+    }
+    auto it = std::find(staticSlots.begin(), staticSlots.end(), slot);
+    if (it != staticSlots.end()) {
+        staticSlots.erase(it);
+        staticBvhDirty = true;
+    }
+}
+
+// Only the runs of moving slots are animated, packed and marked for upload. Free slots are
+// animated as well: they keep their last model and are culled by their bounds.
+void CubeFrame::update(double time, float angleVelocity) {
+    size_t slots = store.size();
+    animator.setTime(time, angleVelocity);
+    packed.resize(slots);
+    movingRuns.clear();
+    size_t begin = 0;
+    while (begin < slots) {
+        if (isStaticSlot[begin]) {
+            begin++;
+            continue;
+        }
+        size_t end = begin + 1;
+        while (end < slots && !isStaticSlot[end])
+            end++;
+        animator.animate(models[begin].pos, sizeof(CubeModel), end - begin, store[begin].worldMatrix, sizeof(GeomBuffer));
+        packInstances(store[begin].worldMatrix, sizeof(GeomBuffer), store[begin].params, sizeof(GeomBuffer),
+            end - begin, &packed[begin]);
+        store.markDirty(begin, end - begin);
+        movingRuns.push_back({ begin, end - begin });
+        begin = end;
+    }
+
+    bounds.resize(slots);
+    cullingBounds.resize(slots);
+    if (slots > 0)
+        bounds.transform(store[0].worldMatrix, sizeof(GeomBuffer), slots, localMin, localMax);
+    for (size_t i = 0; i < slots; i++) {
+        if (!store.isAlive(i)) {
+            bounds.hide(i);
+            cullingBounds[i].bbMin[3] = -1.0f;
+            continue;
+        }
+        bounds.getBox(i, cullingBounds[i].bbMin, cullingBounds[i].bbMax);
+        cullingBounds[i].bbMin[3] = 1.0f;
+        cullingBounds[i].bbMax[3] = 1.0f;
+    }
+    updateSpatialGrid();
+}
+
+// A static cube enters the grid once; the moving ones are moved every frame, which only
+// relinks the cubes whose center crosses into another cell.
+void CubeFrame::updateSpatialGrid() {
+    if (!spatialGrid)
+        return;
+
+    float center[3];
+    gridHandles.resize(store.size(), -1);
+    for (uint32_t slot : staticSlots) {
+        if (gridHandles[slot] >= 0)
+            continue;
+        bounds.getCenter(slot, center);
+        gridHandles[slot] = spatialGrid->insert(int(slot), center, bounds.radius[slot]);
+    }
+
+    for (const std::pair<size_t, size_t>& run : movingRuns) {
+        for (size_t i = run.first; i < run.first + run.second; i++) {
+            if (!store.isAlive(i)) {
+                spatialGrid->remove(gridHandles[i]);
+                gridHandles[i] = -1;
+                continue;
+            }
+            bounds.getCenter(i, center);
+            if (gridHandles[i] < 0)
+                gridHandles[i] = spatialGrid->insert(int(i), center, bounds.radius[i]);
+            else
+                spatialGrid->move(gridHandles[i], center, bounds.radius[i]);
+        }
+    }
+}
+
+// The moving cubes are culled flat: refitting a tree over them every frame costs more than the
+// SIMD pass it would save. The tree of the static cubes never needs a refit.
+void CubeFrame::cull(const float planes[6][4], const float* viewProjection, const float cameraPos[3]) {
+    if (staticBvhDirty) {
+        staticBvh.build(bounds, staticSlots);
+        staticBvhDirty = false;
+    }
+    culler.cull(bounds, planes, movingRuns, visible);
+    staticBvh.cull(bounds, planes, staticVisible);
+    visible.insert(visible.end(), staticVisible.begin(), staticVisible.end());
+
+    // The largest visible cubes are the occluders of the rest.
+    if (viewProjection && !visible.empty()) {
+        occlusion.beginFrame(viewProjection);
+        occlusion.selectOccluders(bounds, visible, MAX_OCCLUDERS, occluders);
+        occlusion.renderOccluders(store[0].worldMatrix, sizeof(GeomBuffer), occluders, localMin, localMax);
+        occlusion.cull(bounds, visible);
+    }
+    sortFrontToBack(cameraPos);
+}
+
+// Visible cubes go front to back so the reversed-depth test rejects the hidden fragments of
+// the later instances early. 16 bits of distance are enough for that and take two sort passes.
+void CubeFrame::sortFrontToBack(const float cameraPos[3]) {
+    const float depthScale = 65535.0f / DEPTH_SORT_RANGE;
+    size_t count = visible.size();
+    depthOrder.resize(count);
+    depthScratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        int id = visible[i];
+        float dx = bounds.centerX[id] - cameraPos[0];
+        float dy = bounds.centerY[id] - cameraPos[1];
+        float dz = bounds.centerZ[id] - cameraPos[2];
+        float depth = (std::min)(sqrtf(dx * dx + dy * dy + dz * dz) * depthScale, 65535.0f);
+        depthOrder[i] = { uint64_t(depth), 0, uint32_t(id) };
+    }
+    radixSort(depthOrder.data(), depthScratch.data(), count);
+    for (size_t i = 0; i < count; i++)
+        visible[i] = int(depthOrder[i].item);
+}
+
+// Only the chunks touched since the last upload are sent; a removed cube stays in its slot
+// with a negative bbMin.w so the culling shader skips it. Every chunk is recorded as its own
+// part, in parallel.
+void CubeFrame::recordUploads(CommandList& commands, GpuHandle instances, GpuHandle boundsBuffer) {
+    const size_t chunkSize = store.getChunkSize();
+    uploadRanges.clear();
+    store.flushDirty([&](size_t first, size_t count) {
+        for (size_t begin = first; begin < first + count; begin += chunkSize)
+            uploadRanges.push_back({ begin, (std::min)(chunkSize, first + count - begin) });
+    });
+    recordParallel(commands, uploadCommands, uploadRanges.size(), [&](size_t part, CommandList& list) {
+        size_t first = uploadRanges[part].first;
+        size_t count = uploadRanges[part].second;
+        updateBufferRange(list, instances, packed.data(), sizeof(PackedInstance), first, count);
+        updateBufferRange(list, boundsBuffer, cullingBounds.data(), sizeof(CullingBounds), first, count);
+    });
+}
+
+void CubeFrame::recordVisible(CommandList& commands, GpuHandle visibleIds, GpuHandle argsSource, GpuHandle args, uint32_t indexCount) const {
+    IndexedIndirectArgs drawArgs = { indexCount, uint32_t(visible.size()), 0, 0, 0 };
+    updateBufferRange(commands, visibleIds, visible.data(), sizeof(uint32_t), 0, visible.size());
+    commands.updateBuffer(argsSource, &drawArgs, sizeof(drawArgs));
+    commands.copyResource(args, argsSource);
+}
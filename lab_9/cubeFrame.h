@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "commandList.h"
+#include "cubeAnimator.h"
+#include "frustumCuller.h"
+#include "instanceBounds.h"
+#include "instanceBvh.h"
+#include "instancePacking.h"
+#include "instanceStore.h"
+#include "occlusionCuller.h"
+#include "renderQueue.h"
+#include "spatialGrid.h"
+
+// CPU copy of a cube instance, the GPU gets it as PackedInstance (instancePacking.h).
+// Matrices are row-major with the row-vector convention, as XMFLOAT4X4.
+struct GeomBuffer {
+	float worldMatrix[16];
+	float params[4];
+};
+
+struct CubeModel {
+	float pos[4];
+	float params[4];
+};
+
+// Read by FrustumComputeShader.hlsl.
+struct CullingBounds {
+	float bbMin[4]; // w < 0 - free slot
+	float bbMax[4];
+};
+
+// Same layout as D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS.
+struct IndexedIndirectArgs {
+	uint32_t indexCountPerInstance;
+	uint32_t instanceCount;
+	uint32_t startIndexLocation;
+	int32_t baseVertexLocation;
+	uint32_t startInstanceLocation;
+};
+
+// The per-frame CPU work of the cubes: animation, bounds, the spatial grid, CPU culling, draw
+// order and the recording of the uploads. GPU buffers are only handles here, so the frame can
+// be recorded into a CountingBackend without a device; Cube owns the buffers and the shaders.
+class CubeFrame {
+public:
+	static const float localMin[3];
+	static const float localMax[3];
+
+	// Static cubes stay where they were added; they are packed here once and frame never
+	// touches them again.
+	uint32_t add(const float pos[3], const float params[4], bool isStatic);
+	void remove(uint32_t slot);
+	void reserve(size_t count) { store.reserve(count); };
+	// The grid the cubes keep their bounding spheres in, by slot id.
+	void setSpatialGrid(SpatialGrid* grid) { spatialGrid = grid; };
+
+	// Animates and packs the moving cubes, then refreshes the bounds of every slot and the grid.
+	void update(double time, float angleVelocity);
+	// Culls the moving cubes flat and the static ones by their BVH, then removes the occluded
+	// ones when `viewProjection` is given and sorts the rest front to back.
+	void cull(const float planes[6][4], const float* viewProjection, const float cameraPos[3]);
+	// Records the instance and bounds chunks touched since the last upload, one part per chunk.
+	void recordUploads(CommandList& commands, GpuHandle instances, GpuHandle boundsBuffer);
+	// Records the visible ids and the indirect arguments of the draw that reads them.
+	void recordVisible(CommandList& commands, GpuHandle visibleIds, GpuHandle argsSource, GpuHandle args, uint32_t indexCount) const;
+
+	// True once after the slots outgrew the GPU buffers; recreated buffers need markAllDirty.
+	bool consumeGrowth() { return store.consumeGrowth(); };
+	void markAllDirty() { store.markAllDirty(); };
+
+	// Slots in use including the free ones.
+	size_t size() const { return store.size(); };
+	size_t count() const { return store.count(); };
+	size_t capacity() const { return store.capacity(); };
+	size_t getChunkSize() const { return store.getChunkSize(); };
+	const GeomBuffer& getInstance(size_t slot) const { return store[slot]; };
+	// World bounds by slot from the last update; free slots have a negative radius.
+	const InstanceBounds& getBounds() const { return bounds; };
+	const std::vector<uint32_t>& getStaticSlots() const { return staticSlots; };
+	// Slot ids of the last cull, front to back.
+	const std::vector<int>& getVisible() const { return visible; };
+	// Plane cache counters of the last cull of the static cubes' BVH.
+	const CullingStats& getCullingStats() const { return staticBvh.getStats(); };
+	const OcclusionStats& getOcclusionStats() const { return occlusion.getStats(); };
+
+private:
+	void updateSpatialGrid();
+	void sortFrontToBack(const float cameraPos[3]);
+
+	InstanceStore<GeomBuffer> store = InstanceStore<GeomBuffer>(1024);
+	std::vector<PackedInstance> packed; // uploaded form of store, same slots
+	std::vector<CubeModel> models; // by slot
+	std::vector<uint8_t> isStaticSlot; // by slot, 1 for the cubes that keep their placement
+	std::vector<uint32_t> staticSlots;
+	std::vector<std::pair<size_t, size_t>> movingRuns; // first slot, slot count
+	InstanceBounds bounds;
+	std::vector<CullingBounds> cullingBounds;
+	CubeAnimator animator;
+	SpatialGrid* spatialGrid = nullptr;
+	std::vector<int> gridHandles; // by slot, -1 for the slots outside the grid
+
+	FrustumCuller culler; // the moving cubes
+	InstanceBVH staticBvh; // the static cubes, rebuilt when one is added or removed
+	bool staticBvhDirty = true;
+	std::vector<int> staticVisible;
+	OcclusionCuller occlusion;
+	std::vector<int> occluders;
+	std::vector<int> visible;
+	std::vector<DrawPacket> depthOrder;
+	std::vector<DrawPacket> depthScratch;
+
+	std::vector<std::pair<size_t, size_t>> uploadRanges; // first slot, slot count
+	std::vector<CommandList> uploadCommands;
+};
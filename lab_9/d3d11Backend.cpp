@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cstring>
+
+#include "d3d11Backend.h"
+
+// Offsets and sizes of bound constant ranges go in steps of 16 constants.
+static const UINT CONSTANT_BLOCK_ALIGNMENT = 16 * 16;
+
+template <typename T>
+static T* const* as(const GpuHandle* handles) {
+    return reinterpret_cast<T* const*>(handles);
+}
+
+template <typename T>
+static T* as(GpuHandle handle) {
+    return static_cast<T*>(handle);
+}
+
+static void setConstantBuffers(ID3D11DeviceContext* context, const CommandList& list, const Command& command) {
+    ID3D11Buffer* const* buffers = as<ID3D11Buffer>(list.getHandles(command));
+    switch (command.stage) {
+    case SHADER_STAGE_VERTEX: context->VSSetConstantBuffers(command.slot, command.count, buffers); break;
+    case SHADER_STAGE_PIXEL: context->PSSetConstantBuffers(command.slot, command.count, buffers); break;
+    case SHADER_STAGE_COMPUTE: context->CSSetConstantBuffers(command.slot, command.count, buffers); break;
+    }
+}
+
+static void setShaderResources(ID3D11DeviceContext* context, const CommandList& list, const Command& command) {
+    ID3D11ShaderResourceView* const* views = as<ID3D11ShaderResourceView>(list.getHandles(command));
+    switch (command.stage) {
+    case SHADER_STAGE_VERTEX: context->VSSetShaderResources(command.slot, command.count, views); break;
+    case SHADER_STAGE_PIXEL: context->PSSetShaderResources(command.slot, command.count, views); break;
+    case SHADER_STAGE_COMPUTE: context->CSSetShaderResources(command.slot, command.count, views); break;
+    }
+}
+
+static void setSamplers(ID3D11DeviceContext* context, const CommandList& list, const Command& command) {
+    ID3D11SamplerState* const* samplers = as<ID3D11SamplerState>(list.getHandles(command));
+    switch (command.stage) {
+    case SHADER_STAGE_VERTEX: context->VSSetSamplers(command.slot, command.count, samplers); break;
+    case SHADER_STAGE_PIXEL: context->PSSetSamplers(command.slot, command.count, samplers); break;
+    case SHADER_STAGE_COMPUTE: context->CSSetSamplers(command.slot, command.count, samplers); break;
+    }
+}
+
+static void setShader(ID3D11DeviceContext* context, const Command& command) {
+    switch (command.stage) {
+    case SHADER_STAGE_VERTEX: context->VSSetShader(as<ID3D11VertexShader>(command.object), nullptr, 0); break;
+    case SHADER_STAGE_PIXEL: context->PSSetShader(as<ID3D11PixelShader>(command.object), nullptr, 0); break;
+    case SHADER_STAGE_COMPUTE: context->CSSetShader(as<ID3D11ComputeShader>(command.object), nullptr, 0); break;
+    }
+}
+
+HRESULT D3D11Backend::init(ID3D11Device* device, ID3D11DeviceContext* context) {
+    this->context = context;
+    HRESULT hr = context->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&context1));
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    hr = device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+    if (FAILED(hr))
+        return hr;
+    if (!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+        return E_NOTIMPL;
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = UPLOAD_RING_SIZE;
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    hr = device->CreateBuffer(&desc, nullptr, &g_pUploadBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_QUERY_DESC queryDesc = {};
+    queryDesc.Query = D3D11_QUERY_EVENT;
+    for (ID3D11Query*& fence : g_pFrameFences) {
+        hr = device->CreateQuery(&queryDesc, &fence);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    ring.reset(UPLOAD_RING_SIZE, CONSTANT_BLOCK_ALIGNMENT);
+    frame = 0;
+    return S_OK;
+}
+
+void D3D11Backend::realize() {
+    for (ID3D11Query*& fence : g_pFrameFences) {
+        if (fence) fence->Release();
+        fence = nullptr;
+    }
+    if (g_pUploadBuffer) g_pUploadBuffer->Release();
+    if (context1) context1->Release();
+    g_pUploadBuffer = nullptr;
+    context1 = nullptr;
+}
+
+// True once the GPU is past `frame`. A failing query (device removed) counts as done so the
+// ring never waits forever.
+bool D3D11Backend::pollFence(UINT64 frame, bool wait) {
+    ID3D11Query* fence = g_pFrameFences[frame % UPLOAD_RING_FRAMES];
+    if (!wait)
+        return context->GetData(fence, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_FALSE;
+
+    HRESULT hr;
+    do {
+        hr = context->GetData(fence, nullptr, 0, 0);
+    } while (hr == S_FALSE);
+    return true;
+}
+
+// Frees the ring space of the frames the GPU has finished. The fence of the coming frame
+// replaces the one of the frame UPLOAD_RING_FRAMES back, which has to be waited for if it
+// still holds ring space.
+void D3D11Backend::beginFrame() {
+    while (ring.hasPendingFrames()) {
+        UINT64 oldest = ring.getOldestPendingFrame();
+        if (!pollFence(oldest, frame + 1 - oldest >= UPLOAD_RING_FRAMES))
+            break;
+        ring.completeFrame(oldest);
+    }
+
+    frame++;
+    ring.beginFrame(frame);
+}
+
+void D3D11Backend::endFrame() {
+    uploadBytes = ring.getFrameBytes();
+    ring.endFrame();
+    context->End(g_pFrameFences[frame % UPLOAD_RING_FRAMES]);
+}
+
+// Waits for older frames when the ring is full. A block that cannot fit at all is left
+// unbound rather than pointing at bytes of another one.
+void D3D11Backend::writeConstants(const CommandList& list, const Command& command) {
+    uint32_t block = command.args[0];
+    if (block >= blocks.size())
+        blocks.resize(block + 1, { 0, 0 });
+    blocks[block] = { 0, 0 };
+
+    uint32_t offset;
+    while (!ring.allocate(command.count, offset)) {
+        if (!ring.hasPendingFrames())
+            return;
+        UINT64 oldest = ring.getOldestPendingFrame();
+        pollFence(oldest, true);
+        ring.completeFrame(oldest);
+    }
+
+    D3D11_MAPPED_SUBRESOURCE subresource;
+    if (FAILED(context->Map(g_pUploadBuffer, 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &subresource)))
+        return;
+    memcpy(static_cast<uint8_t*>(subresource.pData) + offset, list.getPayload(command.first), command.count);
+    context->Unmap(g_pUploadBuffer, 0);
+
+    UINT size = (command.count + CONSTANT_BLOCK_ALIGNMENT - 1) & ~(CONSTANT_BLOCK_ALIGNMENT - 1);
+    blocks[block] = { offset / 16, size / 16 };
+}
+
+void D3D11Backend::setConstantBlocks(const CommandList& list, const Command& command) {
+    ID3D11Buffer* buffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+    UINT firstConstants[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+    UINT constantsCounts[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+    const uint32_t* ids = static_cast<const uint32_t*>(list.getPayload(command.first));
+    UINT count = (std::min)(command.count, UINT(D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT));
+    for (UINT i = 0; i < count; i++) {
+        BlockPlace place = ids[i] < blocks.size() ? blocks[ids[i]] : BlockPlace{ 0, 0 };
+        buffers[i] = place.constantsCount ? g_pUploadBuffer : nullptr;
+        firstConstants[i] = place.firstConstant;
+        constantsCounts[i] = place.constantsCount;
+    }
+
+    switch (command.stage) {
+    case SHADER_STAGE_VERTEX: context1->VSSetConstantBuffers1(command.slot, count, buffers, firstConstants, constantsCounts); break;
+    case SHADER_STAGE_PIXEL: context1->PSSetConstantBuffers1(command.slot, count, buffers, firstConstants, constantsCounts); break;
+    case SHADER_STAGE_COMPUTE: context1->CSSetConstantBuffers1(command.slot, count, buffers, firstConstants, constantsCounts); break;
+    }
+}
+
+void D3D11Backend::execute(const CommandList& list, const Command& command) {
+    switch (command.type) {
+    case COMMAND_SET_SHADER:
+        setShader(context, command);
+        break;
+    case COMMAND_SET_CONSTANT_BUFFERS:
+        setConstantBuffers(context, list, command);
+        break;
+    case COMMAND_SET_CONSTANT_BLOCKS:
+        setConstantBlocks(list, command);
+        break;
+    case COMMAND_SET_SHADER_RESOURCES:
+        setShaderResources(context, list, command);
+        break;
+    case COMMAND_SET_SAMPLERS:
+        setSamplers(context, list, command);
+        break;
+    case COMMAND_SET_UNORDERED_ACCESS_VIEWS:
+        context->CSSetUnorderedAccessViews(command.slot, command.count, as<ID3D11UnorderedAccessView>(list.getHandles(command)), nullptr);
+        break;
+    case COMMAND_SET_INPUT_LAYOUT:
+        context->IASetInputLayout(as<ID3D11InputLayout>(command.object));
+        break;
+    case COMMAND_SET_PRIMITIVE_TOPOLOGY:
+        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY(command.args[0]));
+        break;
+    case COMMAND_SET_VERTEX_BUFFERS: {
+        const UINT* strides = static_cast<const UINT*>(list.getPayload(command.args[0]));
+        const UINT* offsets = static_cast<const UINT*>(list.getPayload(command.args[1]));
+        context->IASetVertexBuffers(command.slot, command.count, as<ID3D11Buffer>(list.getHandles(command)), strides, offsets);
+        break;
+    }
+    case COMMAND_SET_INDEX_BUFFER:
+        context->IASetIndexBuffer(as<ID3D11Buffer>(command.object), DXGI_FORMAT(command.args[0]), command.args[1]);
+        break;
+    case COMMAND_SET_RASTERIZER_STATE:
+        context->RSSetState(as<ID3D11RasterizerState>(command.object));
+        break;
+    case COMMAND_SET_DEPTH_STENCIL_STATE:
+        context->OMSetDepthStencilState(as<ID3D11DepthStencilState>(command.object), command.args[0]);
+        break;
+    case COMMAND_SET_BLEND_STATE:
+        context->OMSetBlendState(as<ID3D11BlendState>(command.object), nullptr, command.args[0]);
+        break;
+    case COMMAND_SET_RENDER_TARGETS:
+        context->OMSetRenderTargets(command.count, as<ID3D11RenderTargetView>(list.getHandles(command)), as<ID3D11DepthStencilView>(command.object));
+        break;
+    case COMMAND_SET_VIEWPORT: {
+        const float* values = static_cast<const float*>(list.getPayload(command.first));
+        D3D11_VIEWPORT viewport = { values[0], values[1], values[2], values[3], values[4], values[5] };
+        context->RSSetViewports(1, &viewport);
+        break;
+    }
+    case COMMAND_CLEAR_RENDER_TARGET:
+        context->ClearRenderTargetView(as<ID3D11RenderTargetView>(command.object), static_cast<const float*>(list.getPayload(command.first)));
+        break;
+    case COMMAND_CLEAR_DEPTH: {
+        float depth;
+        memcpy(&depth, &command.args[0], sizeof(depth));
+        context->ClearDepthStencilView(as<ID3D11DepthStencilView>(command.object), D3D11_CLEAR_DEPTH, depth, 0);
+        break;
+    }
+    case COMMAND_UPDATE_BUFFER: {
+        const void* data = list.getPayload(command.first);
+        D3D11_BOX box = { command.args[0], 0, 0, command.args[0] + command.count, 1, 1 };
+        context->UpdateSubresource(as<ID3D11Buffer>(command.object), 0, command.args[1] ? &box : nullptr, data, 0, 0);
+        break;
+    }
+    case COMMAND_WRITE_BUFFER: {
+        D3D11_MAPPED_SUBRESOURCE subresource;
+        if (SUCCEEDED(context->Map(as<ID3D11Buffer>(command.object), 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource))) {
+            memcpy(subresource.pData, list.getPayload(command.first), command.count);
+            context->Unmap(as<ID3D11Buffer>(command.object), 0);
+        }
+        break;
+    }
+    case COMMAND_WRITE_CONSTANTS:
+        writeConstants(list, command);
+        break;
+    case COMMAND_COPY_RESOURCE:
+        context->CopyResource(as<ID3D11Resource>(command.object), as<ID3D11Resource>(list.getHandles(command)[0]));
+        break;
+    case COMMAND_BEGIN_QUERY:
+        context->Begin(as<ID3D11Query>(command.object));
+        break;
+    case COMMAND_END_QUERY:
+        context->End(as<ID3D11Query>(command.object));
+        break;
+    case COMMAND_DRAW:
+        context->Draw(command.args[0], command.args[1]);
+        break;
+    case COMMAND_DRAW_INDEXED:
+        context->DrawIndexed(command.args[0], command.args[1], INT(command.args[2]));
+        break;
+    case COMMAND_DRAW_INDEXED_INSTANCED:
+        context->DrawIndexedInstanced(command.args[0], command.args[1], command.args[2], INT(command.args[3]), command.args[4]);
+        break;
+    case COMMAND_DRAW_INDEXED_INSTANCED_INDIRECT:
+        context->DrawIndexedInstancedIndirect(as<ID3D11Buffer>(command.object), command.args[0]);
+        break;
+    case COMMAND_DISPATCH:
+        context->Dispatch(command.args[0], command.args[1], command.args[2]);
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <vector>
+
+#include "commandList.h"
+#include "uploadRing.h"
+
+// Bytes shared by the constant blocks of the frames in flight.
+static const UINT UPLOAD_RING_SIZE = 1 << 20;
+// Frames the ring can be fenced for; beginFrame() waits when they are all in flight.
+static const UINT UPLOAD_RING_FRAMES = 4;
+
+// Replays a command list on a device context.
+// Constant blocks are copied into one dynamic constant buffer with WRITE_NO_OVERWRITE and bound
+// by offset (D3D11.1 constant buffer offsetting). Every replayed frame ends with an event query;
+// the ring reuses a frame's bytes only once its query has signaled.
+class D3D11Backend : public CommandBackend {
+public:
+	HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context);
+	void realize();
+	void beginFrame();
+	void endFrame();
+	void execute(const CommandList& list, const Command& command) override;
+
+	// Bytes taken from the upload ring by the last replayed frame.
+	uint64_t getUploadBytes() const { return uploadBytes; };
+
+private:
+	// Where the last copy of a constant block is.
+	struct BlockPlace {
+		UINT firstConstant;
+		UINT constantsCount;
+	};
+
+	void writeConstants(const CommandList& list, const Command& command);
+	void setConstantBlocks(const CommandList& list, const Command& command);
+	bool pollFence(UINT64 frame, bool wait);
+
+	ID3D11DeviceContext* context = nullptr;
+	ID3D11DeviceContext1* context1 = nullptr;
+	ID3D11Buffer* g_pUploadBuffer = nullptr;
+	ID3D11Query* g_pFrameFences[UPLOAD_RING_FRAMES] = {};
+
+	UploadRing ring;
+	UINT64 frame = 0;
+	uint64_t uploadBytes = 0;
+	std::vector<BlockPlace> blocks;
+};
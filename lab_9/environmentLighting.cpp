@@ -0,0 +1,622 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "environmentLighting.h"
+#include "jobSystem.h"
+#include "instancePacking.h"
+
+static const float PI = 3.14159265358979f;
+
+static const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+static const uint32_t DDS_HEADER_SIZE = 124;
+static const uint32_t DDS_DX10_HEADER_SIZE = 20;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDPF_RGB = 0x40;
+static const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xFE00;
+static const uint32_t DDS_MISC_TEXTURECUBE = 0x4;
+
+// Bumped whenever the computation or the file layout changes, so old caches miss.
+static const uint32_t CACHE_MAGIC = 0x314C4249; // "IBL1"
+static const uint32_t CACHE_VERSION = 1;
+
+enum DdsFormat {
+    DDS_UNKNOWN,
+    DDS_RGBA8,
+    DDS_BGRA8,
+    DDS_RGBA16F,
+    DDS_RGBA32F,
+    DDS_BC1,
+    DDS_BC2,
+    DDS_BC3,
+};
+
+static uint32_t makeFourCC(char a, char b, char c, char d) {
+    return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+static uint32_t readU32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static DdsFormat getDxgiFormat(uint32_t format, bool& srgb) {
+    srgb = format == 29 || format == 91 || format == 72 || format == 75 || format == 78;
+    switch (format) {
+    case 28: case 29: return DDS_RGBA8;   // DXGI_FORMAT_R8G8B8A8_UNORM(_SRGB)
+    case 87: case 91: return DDS_BGRA8;   // DXGI_FORMAT_B8G8R8A8_UNORM(_SRGB)
+    case 10: return DDS_RGBA16F;          // DXGI_FORMAT_R16G16B16A16_FLOAT
+    case 2: return DDS_RGBA32F;           // DXGI_FORMAT_R32G32B32A32_FLOAT
+    case 71: case 72: return DDS_BC1;
+    case 74: case 75: return DDS_BC2;
+    case 77: case 78: return DDS_BC3;
+    default: return DDS_UNKNOWN;
+    }
+}
+
+static DdsFormat getLegacyFormat(const uint8_t* pixelFormat) {
+    uint32_t flags = readU32(pixelFormat + 4);
+    uint32_t fourCC = readU32(pixelFormat + 8);
+    if (flags & DDPF_FOURCC) {
+        if (fourCC == 113) return DDS_RGBA16F; // D3DFMT_A16B16G16R16F
+        if (fourCC == 116) return DDS_RGBA32F; // D3DFMT_A32B32G32R32F
+        if (fourCC == makeFourCC('D', 'X', 'T', '1')) return DDS_BC1;
+        if (fourCC == makeFourCC('D', 'X', 'T', '2') || fourCC == makeFourCC('D', 'X', 'T', '3')) return DDS_BC2;
+        if (fourCC == makeFourCC('D', 'X', 'T', '4') || fourCC == makeFourCC('D', 'X', 'T', '5')) return DDS_BC3;
+        return DDS_UNKNOWN;
+    }
+    if ((flags & DDPF_RGB) && readU32(pixelFormat + 12) == 32) {
+        uint32_t redMask = readU32(pixelFormat + 16);
+        if (redMask == 0x000000FF) return DDS_RGBA8;
+        if (redMask == 0x00FF0000) return DDS_BGRA8;
+    }
+    return DDS_UNKNOWN;
+}
+
+static size_t getLevelBytes(DdsFormat format, uint32_t size) {
+    size_t blocks = size_t((size + 3) / 4) * ((size + 3) / 4);
+    switch (format) {
+    case DDS_RGBA8: case DDS_BGRA8: return size_t(size) * size * 4;
+    case DDS_RGBA16F: return size_t(size) * size * 8;
+    case DDS_RGBA32F: return size_t(size) * size * 16;
+    case DDS_BC1: return blocks * 8;
+    case DDS_BC2: case DDS_BC3: return blocks * 16;
+    default: return 0;
+    }
+}
+
+static void decodeColor565(uint16_t color, float rgb[3]) {
+    uint32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = float((r << 3) | (r >> 2)) / 255.0f;
+    rgb[1] = float((g << 2) | (g >> 4)) / 255.0f;
+    rgb[2] = float((b << 3) | (b >> 2)) / 255.0f;
+}
+
+// The color half of a BC1-BC3 block; only BC1 has the three color mode.
+static void decodeColorBlock(const uint8_t* block, bool bc1, float* face, uint32_t size, uint32_t bx, uint32_t by) {
+    uint16_t c0 = uint16_t(block[0] | (block[1] << 8));
+    uint16_t c1 = uint16_t(block[2] | (block[3] << 8));
+    float palette[4][3];
+    decodeColor565(c0, palette[0]);
+    decodeColor565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        if (!bc1 || c0 > c1) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) * 0.5f;
+            palette[3][c] = 0.0f;
+        }
+    }
+    uint32_t indices = readU32(block + 4);
+    for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t px = bx * 4 + x, py = by * 4 + y;
+            if (px >= size || py >= size)
+                continue;
+            const float* color = palette[(indices >> (2 * (y * 4 + x))) & 3];
+            float* texel = face + (size_t(py) * size + px) * 4;
+            texel[0] = color[0];
+            texel[1] = color[1];
+            texel[2] = color[2];
+            texel[3] = 1.0f;
+        }
+    }
+}
+
+static void decodeFace(const uint8_t* data, DdsFormat format, bool srgb, uint32_t size, float* face) {
+    size_t texels = size_t(size) * size;
+    switch (format) {
+    case DDS_RGBA8:
+    case DDS_BGRA8:
+        for (size_t i = 0; i < texels; i++) {
+            for (int c = 0; c < 4; c++)
+                face[i * 4 + c] = float(data[i * 4 + c]) / 255.0f;
+            if (format == DDS_BGRA8)
+                std::swap(face[i * 4], face[i * 4 + 2]);
+        }
+        break;
+    case DDS_RGBA16F:
+        for (size_t i = 0; i < texels * 4; i++)
+            face[i] = halfToFloat(uint16_t(data[i * 2] | (data[i * 2 + 1] << 8)));
+        break;
+    case DDS_RGBA32F:
+        memcpy(face, data, texels * 16);
+        break;
+    default: {
+        size_t blockBytes = format == DDS_BC1 ? 8 : 16;
+        size_t colorOffset = format == DDS_BC1 ? 0 : 8; // the alpha half comes first
+        uint32_t blocks = (size + 3) / 4;
+        for (uint32_t by = 0; by < blocks; by++)
+            for (uint32_t bx = 0; bx < blocks; bx++)
+                decodeColorBlock(data + (size_t(by) * blocks + bx) * blockBytes + colorOffset, format == DDS_BC1, face, size, bx, by);
+        break;
+    }
+    }
+    if (srgb) {
+        for (size_t i = 0; i < texels; i++)
+            for (int c = 0; c < 3; c++)
+                face[i * 4 + c] = srgbToLinear(face[i * 4 + c]);
+    }
+}
+
+bool decodeCubeDds(const uint8_t* data, size_t size, CubeImage& image) {
+    if (size < 4 + DDS_HEADER_SIZE || readU32(data) != DDS_MAGIC || readU32(data + 4) != DDS_HEADER_SIZE)
+        return false;
+    const uint8_t* header = data + 4;
+    uint32_t height = readU32(header + 8);
+    uint32_t width = readU32(header + 12);
+    uint32_t mipCount = (std::max)(readU32(header + 24), 1u);
+    const uint8_t* pixelFormat = header + 72;
+    uint32_t caps2 = readU32(header + 108);
+
+    size_t offset = 4 + DDS_HEADER_SIZE;
+    DdsFormat format;
+    bool srgb = false;
+    if ((readU32(pixelFormat + 4) & DDPF_FOURCC) && readU32(pixelFormat + 8) == makeFourCC('D', 'X', '1', '0')) {
+        if (size < offset + DDS_DX10_HEADER_SIZE)
+            return false;
+        const uint8_t* dx10 = data + offset;
+        if (!(readU32(dx10 + 8) & DDS_MISC_TEXTURECUBE) || readU32(dx10 + 12) != 1)
+            return false;
+        format = getDxgiFormat(readU32(dx10), srgb);
+        offset += DDS_DX10_HEADER_SIZE;
+    } else {
+        if ((caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+            return false;
+        format = getLegacyFormat(pixelFormat);
+    }
+    if (format == DDS_UNKNOWN || width == 0 || width != height)
+        return false;
+
+    size_t faceBytes = 0;
+    for (uint32_t level = 0; level < mipCount; level++)
+        faceBytes += getLevelBytes(format, (std::max)(width >> level, 1u));
+    if (size < offset + faceBytes * 6)
+        return false;
+
+    image.size = width;
+    image.texels.assign(size_t(width) * width * 4 * 6, 0.0f);
+    for (uint32_t face = 0; face < 6; face++)
+        decodeFace(data + offset + face * faceBytes, format, srgb, width, image.getFace(face));
+    return true;
+}
+
+uint64_t hashContent(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Direction through (s, t) in [-1, 1] of a face, t growing down the face.
+static void getFaceDirection(uint32_t face, float s, float t, float dir[3]) {
+    switch (face) {
+    case 0: dir[0] = 1.0f; dir[1] = -t; dir[2] = -s; break;
+    case 1: dir[0] = -1.0f; dir[1] = -t; dir[2] = s; break;
+    case 2: dir[0] = s; dir[1] = 1.0f; dir[2] = t; break;
+    case 3: dir[0] = s; dir[1] = -1.0f; dir[2] = -t; break;
+    case 4: dir[0] = s; dir[1] = -t; dir[2] = 1.0f; break;
+    default: dir[0] = -s; dir[1] = -t; dir[2] = -1.0f; break;
+    }
+}
+
+static uint32_t getDirectionFace(const float dir[3], float& s, float& t) {
+    float ax = fabsf(dir[0]), ay = fabsf(dir[1]), az = fabsf(dir[2]);
+    if (ax >= ay && ax >= az) {
+        s = (dir[0] > 0.0f ? -dir[2] : dir[2]) / ax;
+        t = -dir[1] / ax;
+        return dir[0] > 0.0f ? 0 : 1;
+    }
+    if (ay >= az) {
+        s = dir[0] / ay;
+        t = (dir[1] > 0.0f ? dir[2] : -dir[2]) / ay;
+        return dir[1] > 0.0f ? 2 : 3;
+    }
+    s = (dir[2] > 0.0f ? dir[0] : -dir[0]) / az;
+    t = -dir[1] / az;
+    return dir[2] > 0.0f ? 4 : 5;
+}
+
+// Integral of the solid angle over the face from its center to (x, y).
+static double getAreaElement(double x, double y) {
+    return atan2(x * y, sqrt(x * x + y * y + 1.0));
+}
+
+static void getShBasis(const float dir[3], float basis[9]) {
+    float x = dir[0], y = dir[1], z = dir[2];
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * y;
+    basis[2] = 0.488603f * z;
+    basis[3] = 0.488603f * x;
+    basis[4] = 1.092548f * x * y;
+    basis[5] = 1.092548f * y * z;
+    basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+    basis[7] = 1.092548f * x * z;
+    basis[8] = 0.546274f * (x * x - y * y);
+}
+
+// Convolution with the clamped cosine over pi (1, 2/3, 1/4 per band), laid out as the
+// polynomial in n the shaders evaluate.
+static void getIrradianceConstants(const float coefficients[27], float irradiance[28]) {
+    const float k0 = 1.0f, k1 = 2.0f / 3.0f, k2 = 0.25f;
+    for (int c = 0; c < 3; c++) {
+        const float* L[9];
+        for (int i = 0; i < 9; i++)
+            L[i] = &coefficients[i * 3 + c];
+        float* a = &irradiance[c * 4];
+        a[0] = k1 * 0.488603f * *L[3];
+        a[1] = k1 * 0.488603f * *L[1];
+        a[2] = k1 * 0.488603f * *L[2];
+        a[3] = k0 * 0.282095f * *L[0] - k2 * 0.315392f * *L[6];
+        float* b = &irradiance[(3 + c) * 4];
+        b[0] = k2 * 1.092548f * *L[4];
+        b[1] = k2 * 1.092548f * *L[5];
+        b[2] = k2 * 0.315392f * 3.0f * *L[6];
+        b[3] = k2 * 1.092548f * *L[7];
+        irradiance[6 * 4 + c] = k2 * 0.546274f * *L[8];
+    }
+    irradiance[6 * 4 + 3] = 0.0f;
+}
+
+// Every texel weighted by its exact solid angle. Rows go out in fixed chunks and the partial
+// sums are added up in chunk order, so the result does not depend on the threads.
+void EnvironmentLighting::projectIrradiance(const CubeImage& image) {
+    const size_t GRAIN = 8;
+    uint32_t size = image.size;
+    size_t rows = size_t(size) * 6;
+    size_t chunks = (rows + GRAIN - 1) / GRAIN;
+    std::vector<double> partial(chunks * 28, 0.0);
+
+    // The same for every face.
+    std::vector<float> texelAngles(size_t(size) * size);
+    for (uint32_t y = 0; y < size; y++) {
+        double y0 = 2.0 * y / size - 1.0, y1 = 2.0 * (y + 1) / size - 1.0;
+        for (uint32_t x = 0; x < size; x++) {
+            double x0 = 2.0 * x / size - 1.0, x1 = 2.0 * (x + 1) / size - 1.0;
+            texelAngles[size_t(y) * size + x] = float(getAreaElement(x0, y0) - getAreaElement(x0, y1) - getAreaElement(x1, y0) + getAreaElement(x1, y1));
+        }
+    }
+
+    JobSystem::GetInstance().parallelFor(rows, GRAIN, [&](size_t begin, size_t end) {
+        double* sums = &partial[begin / GRAIN * 28];
+        float invSize = 1.0f / size;
+        for (size_t row = begin; row < end; row++) {
+            uint32_t face = uint32_t(row / size), y = uint32_t(row % size);
+            const float* texels = image.getFace(face) + size_t(y) * size * 4;
+            for (uint32_t x = 0; x < size; x++) {
+                float weight = texelAngles[size_t(y) * size + x];
+                float dir[3];
+                getFaceDirection(face, (2.0f * x + 1.0f) * invSize - 1.0f, (2.0f * y + 1.0f) * invSize - 1.0f, dir);
+                float invLength = 1.0f / sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+                for (int c = 0; c < 3; c++)
+                    dir[c] *= invLength;
+                float basis[9];
+                getShBasis(dir, basis);
+                const float* texel = texels + size_t(x) * 4;
+                for (int i = 0; i < 9; i++)
+                    for (int c = 0; c < 3; c++)
+                        sums[i * 3 + c] += double(basis[i] * weight * texel[c]);
+                sums[27] += weight;
+            }
+        }
+    });
+
+    double total[28] = {};
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+        for (int i = 0; i < 28; i++)
+            total[i] += partial[chunk * 28 + i];
+    // The texel solid angles add up to 4 pi up to rounding.
+    double normalize = 4.0 * PI / total[27];
+    for (int i = 0; i < 27; i++)
+        coefficients[i] = float(total[i] * normalize);
+    getIrradianceConstants(coefficients, irradiance);
+}
+
+static void downsample(const CubeImage& source, CubeImage& target) {
+    uint32_t size = (std::max)(source.size / 2, 1u);
+    target.size = size;
+    target.texels.assign(size_t(size) * size * 4 * 6, 0.0f);
+    uint32_t last = source.size - 1;
+    JobSystem::GetInstance().parallelFor(size_t(size) * 6, 16, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+            uint32_t face = uint32_t(row / size), y = uint32_t(row % size);
+            const float* from = source.getFace(face);
+            float* to = target.getFace(face) + size_t(y) * size * 4;
+            uint32_t sy0 = (std::min)(y * 2, last), sy1 = (std::min)(y * 2 + 1, last);
+            for (uint32_t x = 0; x < size; x++) {
+                uint32_t sx0 = (std::min)(x * 2, last), sx1 = (std::min)(x * 2 + 1, last);
+                for (int c = 0; c < 4; c++)
+                    to[x * 4 + c] = 0.25f * (from[(size_t(sy0) * source.size + sx0) * 4 + c] + from[(size_t(sy0) * source.size + sx1) * 4 + c] +
+                        from[(size_t(sy1) * source.size + sx0) * 4 + c] + from[(size_t(sy1) * source.size + sx1) * 4 + c]);
+            }
+        }
+    });
+}
+
+// Bilinear inside the face, clamped at its edges.
+static void sampleFace(const CubeImage& image, uint32_t face, float s, float t, float weight, float color[3]) {
+    uint32_t size = image.size;
+    float fx = (std::min)((std::max)((s * 0.5f + 0.5f) * size - 0.5f, 0.0f), float(size - 1));
+    float fy = (std::min)((std::max)((t * 0.5f + 0.5f) * size - 0.5f, 0.0f), float(size - 1));
+    uint32_t x0 = uint32_t(fx), y0 = uint32_t(fy);
+    uint32_t x1 = (std::min)(x0 + 1, size - 1), y1 = (std::min)(y0 + 1, size - 1);
+    float wx = fx - x0, wy = fy - y0;
+    const float* texels = image.getFace(face);
+    const float* t00 = texels + (size_t(y0) * size + x0) * 4;
+    const float* t01 = texels + (size_t(y0) * size + x1) * 4;
+    const float* t10 = texels + (size_t(y1) * size + x0) * 4;
+    const float* t11 = texels + (size_t(y1) * size + x1) * 4;
+    for (int c = 0; c < 3; c++) {
+        float top = t00[c] + (t01[c] - t00[c]) * wx;
+        float bottom = t10[c] + (t11[c] - t10[c]) * wx;
+        color[c] += weight * (top + (bottom - top) * wy);
+    }
+}
+
+// A GGX sample around n = (0, 0, 1): the reflected direction, its cosine weight and the mip
+// of the source whose texels cover about the solid angle the sample stands for.
+struct PrefilterSample {
+    float x, y, z;
+    float weight;
+    float lod;
+};
+
+static float getRadicalInverse(uint32_t bits) {
+    bits = (bits << 16) | (bits >> 16);
+    bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+    bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+    bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+    bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+    return float(bits) * 2.3283064365386963e-10f;
+}
+
+static void buildSamples(float roughness, uint32_t samples, uint32_t sourceSize, uint32_t sourceLevels, std::vector<PrefilterSample>& table) {
+    float alpha = roughness * roughness;
+    float alpha2 = alpha * alpha;
+    float texelAngle = 4.0f * PI / (6.0f * sourceSize * sourceSize);
+    table.clear();
+    for (uint32_t i = 0; i < samples; i++) {
+        float u = (i + 0.5f) / samples, v = getRadicalInverse(i);
+        float cosTheta = sqrtf((1.0f - u) / (1.0f + (alpha2 - 1.0f) * u));
+        float sinTheta = sqrtf((std::max)(1.0f - cosTheta * cosTheta, 0.0f));
+        float phi = 2.0f * PI * v;
+        float hx = sinTheta * cosf(phi), hy = sinTheta * sinf(phi), hz = cosTheta;
+        // l = 2 (v . h) h - v with v = n
+        PrefilterSample sample;
+        sample.x = 2.0f * hz * hx;
+        sample.y = 2.0f * hz * hy;
+        sample.z = 2.0f * hz * hz - 1.0f;
+        if (sample.z <= 0.0f)
+            continue;
+        float d = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+        float pdf = alpha2 / (PI * d * d) * 0.25f;
+        float sampleAngle = 1.0f / (samples * pdf);
+        sample.weight = sample.z;
+        sample.lod = (std::min)((std::max)(0.5f * log2f(sampleAngle / texelAngle) + 1.0f, 0.0f), float(sourceLevels - 1));
+        table.push_back(sample);
+    }
+}
+
+// Mip 0 is the source mip of that size as it is; every rougher mip integrates the GGX lobe
+// with the same table of samples turned around each texel direction, blending two source
+// mips by the sample's footprint so few samples do not alias.
+void EnvironmentLighting::prefilter(const std::vector<CubeImage>& chain, uint32_t samples) {
+    uint32_t base = 0;
+    while (base + 1 < chain.size() && chain[base].size > specularSize)
+        base++;
+    specularSize = chain[base].size;
+    uint32_t maxLevels = 1;
+    while ((specularSize >> maxLevels) > 0)
+        maxLevels++;
+    specularLevels = (std::max)((std::min)(specularLevels, maxLevels), 1u);
+    buildLevelOffsets();
+
+    for (uint32_t face = 0; face < 6; face++)
+        memcpy(&specular[levelOffsets[face * specularLevels]], chain[base].getFace(face), sizeof(float) * 4 * specularSize * specularSize);
+
+    std::vector<PrefilterSample> table;
+    for (uint32_t level = 1; level < specularLevels; level++) {
+        buildSamples(float(level) / (specularLevels - 1), samples, chain[0].size, uint32_t(chain.size()), table);
+        uint32_t size = specularSize >> level;
+        float invSize = 1.0f / size;
+        JobSystem::GetInstance().parallelFor(size_t(size) * 6, 4, [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; row++) {
+                uint32_t face = uint32_t(row / size), y = uint32_t(row % size);
+                float* out = &specular[levelOffsets[face * specularLevels + level] + size_t(y) * size * 4];
+                for (uint32_t x = 0; x < size; x++) {
+                    float n[3];
+                    getFaceDirection(face, (2.0f * x + 1.0f) * invSize - 1.0f, (2.0f * y + 1.0f) * invSize - 1.0f, n);
+                    float invLength = 1.0f / sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    for (int c = 0; c < 3; c++)
+                        n[c] *= invLength;
+                    float up[3] = { 0.0f, 0.0f, 1.0f };
+                    if (fabsf(n[2]) > 0.999f) {
+                        up[0] = 1.0f;
+                        up[2] = 0.0f;
+                    }
+                    // tangent = normalize(up x n), bitangent = n x tangent
+                    float tx = up[1] * n[2] - up[2] * n[1], ty = up[2] * n[0] - up[0] * n[2], tz = up[0] * n[1] - up[1] * n[0];
+                    float invTangent = 1.0f / sqrtf(tx * tx + ty * ty + tz * tz);
+                    tx *= invTangent;
+                    ty *= invTangent;
+                    tz *= invTangent;
+                    float bx = n[1] * tz - n[2] * ty, by = n[2] * tx - n[0] * tz, bz = n[0] * ty - n[1] * tx;
+
+                    float color[3] = {};
+                    float total = 0.0f;
+                    for (const PrefilterSample& sample : table) {
+                        float l[3] = {
+                            tx * sample.x + bx * sample.y + n[0] * sample.z,
+                            ty * sample.x + by * sample.y + n[1] * sample.z,
+                            tz * sample.x + bz * sample.y + n[2] * sample.z,
+                        };
+                        float s, t;
+                        uint32_t sampleFaceIndex = getDirectionFace(l, s, t);
+                        uint32_t lod = uint32_t(sample.lod);
+                        float blend = sample.lod - lod;
+                        sampleFace(chain[lod], sampleFaceIndex, s, t, sample.weight * (1.0f - blend), color);
+                        if (blend > 0.0f)
+                            sampleFace(chain[lod + 1], sampleFaceIndex, s, t, sample.weight * blend, color);
+                        total += sample.weight;
+                    }
+                    float invTotal = total > 0.0f ? 1.0f / total : 0.0f;
+                    out[x * 4 + 0] = color[0] * invTotal;
+                    out[x * 4 + 1] = color[1] * invTotal;
+                    out[x * 4 + 2] = color[2] * invTotal;
+                    out[x * 4 + 3] = 1.0f;
+                }
+            }
+        });
+    }
+}
+
+void EnvironmentLighting::buildLevelOffsets() {
+    levelOffsets.resize(size_t(6) * specularLevels);
+    size_t offset = 0;
+    for (uint32_t face = 0; face < 6; face++) {
+        for (uint32_t level = 0; level < specularLevels; level++) {
+            uint32_t size = (std::max)(specularSize >> level, 1u);
+            levelOffsets[face * specularLevels + level] = offset;
+            offset += size_t(size) * size * 4;
+        }
+    }
+    specular.assign(offset, 0.0f);
+}
+
+void EnvironmentLighting::compute(const CubeImage& image, const EnvironmentSettings& settings) {
+    projectIrradiance(image);
+
+    std::vector<CubeImage> chain(1, image);
+    while (chain.back().size > 1) {
+        chain.push_back(CubeImage());
+        downsample(chain[chain.size() - 2], chain.back());
+    }
+    specularSize = settings.specularSize;
+    specularLevels = settings.specularLevels;
+    prefilter(chain, (std::max)(settings.samples, 1u));
+}
+
+void EnvironmentLighting::setConstant(const float color[3]) {
+    for (int i = 0; i < 27; i++)
+        coefficients[i] = 0.0f;
+    for (int c = 0; c < 3; c++)
+        coefficients[c] = color[c] / 0.282095f;
+    getIrradianceConstants(coefficients, irradiance);
+
+    specularSize = 1;
+    specularLevels = 1;
+    buildLevelOffsets();
+    for (uint32_t face = 0; face < 6; face++) {
+        float* texel = &specular[levelOffsets[face]];
+        texel[0] = color[0];
+        texel[1] = color[1];
+        texel[2] = color[2];
+        texel[3] = 1.0f;
+    }
+    stats = EnvironmentStats();
+}
+
+void EnvironmentLighting::getAverage(float color[3]) const {
+    for (int c = 0; c < 3; c++)
+        color[c] = coefficients[c] * 0.282095f;
+}
+
+const float* EnvironmentLighting::getSpecular(uint32_t face, uint32_t level) const {
+    return &specular[levelOffsets[face * specularLevels + level]];
+}
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint32_t specularSize;
+    uint32_t specularLevels;
+};
+
+bool EnvironmentLighting::readCache(const std::string& path, uint64_t hash) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.hash != hash ||
+        header.specularSize == 0 || header.specularLevels == 0 || header.specularLevels > 32)
+        return false;
+
+    specularSize = header.specularSize;
+    specularLevels = header.specularLevels;
+    buildLevelOffsets();
+    return file.read(reinterpret_cast<char*>(irradiance), sizeof(irradiance)) &&
+        file.read(reinterpret_cast<char*>(coefficients), sizeof(coefficients)) &&
+        file.read(reinterpret_cast<char*>(specular.data()), std::streamsize(specular.size() * sizeof(float)));
+}
+
+void EnvironmentLighting::writeCache(const std::string& path, uint64_t hash) const {
+    CacheHeader header = { CACHE_MAGIC, CACHE_VERSION, hash, specularSize, specularLevels };
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(irradiance), sizeof(irradiance));
+    file.write(reinterpret_cast<const char*>(coefficients), sizeof(coefficients));
+    file.write(reinterpret_cast<const char*>(specular.data()), std::streamsize(specular.size() * sizeof(float)));
+}
+
+bool EnvironmentLighting::load(const std::string& path, const EnvironmentSettings& settings) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    uint64_t hash = hashContent(data.data(), data.size());
+    uint32_t key[4] = { CACHE_VERSION, settings.specularSize, settings.specularLevels, settings.samples };
+    hash = hashContent(key, sizeof(key), hash);
+
+    std::string cachePath = path + ".ibl";
+    bool cached = readCache(cachePath, hash);
+    if (!cached) {
+        CubeImage image;
+        if (!decodeCubeDds(data.data(), data.size(), image))
+            return false;
+        compute(image, settings);
+        writeCache(cachePath, hash);
+    }
+
+    stats.hash = hash;
+    stats.cached = cached;
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A cubemap as linear RGBA floats, the faces in the D3D order +X, -X, +Y, -Y, +Z, -Z and
+// every face `size` x `size` texels, top row first.
+struct CubeImage {
+	uint32_t size = 0;
+	std::vector<float> texels;
+
+	float* getFace(uint32_t face) { return &texels[size_t(face) * size * size * 4]; };
+	const float* getFace(uint32_t face) const { return &texels[size_t(face) * size * size * 4]; };
+};
+
+// Reads the top mip of the six faces of a DDS cubemap. RGBA8 / BGRA8 (the _SRGB ones are
+// linearized, the others taken as the GPU samples them), RGBA16F, RGBA32F and BC1-BC3 are
+// understood; false for anything else.
+bool decodeCubeDds(const uint8_t* data, size_t size, CubeImage& image);
+
+// 64-bit FNV-1a of `size` bytes, continued from `seed`.
+uint64_t hashContent(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+struct EnvironmentSettings {
+	uint32_t specularSize = 128;  // of the sharpest prefiltered mip, at most the source size
+	uint32_t specularLevels = 6;  // roughness 0 to 1 in equal steps, at most the full chain
+	uint32_t samples = 256;       // GGX samples per texel of every rough mip
+};
+
+struct EnvironmentStats {
+	uint64_t hash = 0;       // of the source file and the settings, the key of the cache
+	bool cached = false;     // read back from the cache instead of computed
+	double milliseconds = 0.0;
+};
+
+// Image-based ambient light from a sky cubemap, precomputed on the job system:
+// - SH9 irradiance, already convolved with the cosine lobe and divided by pi, so albedo times
+//   the result is the diffuse light. getIrradiance() holds it as seven float4 for the
+//   shaders: dot(c[0..2], float4(n, 1)) + dot(c[3..5], n.xyzz * n.yzzx) per channel, plus
+//   c[6].rgb * (n.x * n.x - n.y * n.y);
+// - a GGX-prefiltered mip chain, mip m holding the lobe of roughness m / (levels - 1) under
+//   the usual n = v assumption, mip 0 the sky itself.
+// load() keeps the result next to the source as "<path>.ibl", keyed by the content hash, and
+// only computes it again when the file or the settings change.
+class EnvironmentLighting {
+public:
+	bool load(const std::string& path, const EnvironmentSettings& settings);
+	void compute(const CubeImage& image, const EnvironmentSettings& settings);
+	// A sky of one color, for when there is no usable cubemap.
+	void setConstant(const float color[3]);
+
+	const float* getIrradiance() const { return irradiance; };
+	const float* getCoefficients() const { return coefficients; }; // radiance SH9, rgb each
+	// Average radiance of the sky, from the DC term of the SH9; the color given to setConstant().
+	void getAverage(float color[3]) const;
+	uint32_t getSpecularSize() const { return specularSize; };
+	uint32_t getSpecularLevels() const { return specularLevels; };
+	// RGBA floats of mip `level` of `face`, (specularSize >> level)^2 texels.
+	const float* getSpecular(uint32_t face, uint32_t level) const;
+	const EnvironmentStats& getStats() const { return stats; };
+
+private:
+	void projectIrradiance(const CubeImage& image);
+	void prefilter(const std::vector<CubeImage>& chain, uint32_t samples);
+	void buildLevelOffsets();
+	bool readCache(const std::string& path, uint64_t hash);
+	void writeCache(const std::string& path, uint64_t hash) const;
+
+	float irradiance[7 * 4] = {};
+	float coefficients[9 * 3] = {};
+	uint32_t specularSize = 0;
+	uint32_t specularLevels = 0;
+	std::vector<float> specular;     // per face, every mip, like the subresources of a cube
+	std::vector<size_t> levelOffsets; // in floats, per face * levels + level
+	EnvironmentStats stats;
+};
@@ -0,0 +1,163 @@
+#include <cmath>
+
+#include "frustumCuller.h"
+#include "simd.h"
+
+const uint8_t FrustumCuller::NO_PLANE;
+
+// Every plane is the last column of the matrix plus or minus one of the others.
+void extractFrustumPlanes(const float viewProjection[16], float planes[6][4]) {
+    static const int columns[6] = { 2, 2, 0, 0, 1, 1 };
+    static const float signs[6] = { 1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f };
+    for (int p = 0; p < 6; p++) {
+        for (int r = 0; r < 4; r++)
+            planes[p][r] = viewProjection[r * 4 + 3] + signs[p] * viewProjection[r * 4 + columns[p]];
+
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        for (int r = 0; r < 4; r++)
+            planes[p][r] /= length;
+    }
+}
+
+// The box is outside of a plane when its corner farthest along the plane normal is behind it:
+// dot(n, center) + d + dot(|n|, extent) < 0. This is the same answer the 8-corner test gives.
+bool FrustumCuller::isBoxVisible(const float planes[6][4], float cx, float cy, float cz, float ex, float ey, float ez) {
+    for (int i = 0; i < 6; i++) {
+        float dist = planes[i][0] * cx + planes[i][1] * cy + planes[i][2] * cz + planes[i][3] +
+            fabsf(planes[i][0]) * ex + fabsf(planes[i][1]) * ey + fabsf(planes[i][2]) * ez;
+        if (dist < 0.0f)
+            return false;
+    }
+
+    return true;
+}
+
+bool FrustumCuller::isVisible(const InstanceBounds& bounds, const float planes[6][4], size_t i) {
+    bool inside = true;
+    for (int p = 0; p < 6; p++) {
+        float dist = planes[p][0] * bounds.centerX[i] + planes[p][1] * bounds.centerY[i] + planes[p][2] * bounds.centerZ[i] + planes[p][3];
+        if (dist < -bounds.radius[i])
+            return false;
+        inside = inside && dist >= bounds.radius[i];
+    }
+
+    return inside || isBoxVisible(planes, bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i],
+        bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+}
+
+// Both loops first classify the bounding spheres: a sphere behind any plane rejects the box,
+// a sphere in front of all planes accepts it. Only undecided lanes pay for the box test.
+size_t FrustumCuller::cullRange(const InstanceBounds& bounds, const float planes[6][4], size_t begin, size_t end, int* out) const {
+    size_t count = 0;
+    size_t i = begin;
+
+#if defined(SIMD_AVX)
+    for (; i + 8 <= end; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+        __m256 r = _mm256_loadu_ps(&bounds.radius[i]);
+        __m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), r);
+
+        __m256 dist[6];
+        int outside = 0;
+        int inside = 0xFF;
+        for (int p = 0; p < 6; p++) {
+            dist[p] = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p][0]), cx), _mm256_mul_ps(_mm256_set1_ps(planes[p][1]), cy)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p][2]), cz), _mm256_set1_ps(planes[p][3])));
+            outside |= _mm256_movemask_ps(_mm256_cmp_ps(dist[p], negR, _CMP_LT_OQ));
+            inside &= _mm256_movemask_ps(_mm256_cmp_ps(dist[p], r, _CMP_GE_OQ));
+        }
+
+        if (((outside | inside) & 0xFF) != 0xFF) {
+            __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+            __m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+            __m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+            for (int p = 0; p < 6 && (outside | inside) != 0xFF; p++) {
+                __m256 radius = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(fabsf(planes[p][0])), ex), _mm256_mul_ps(_mm256_set1_ps(fabsf(planes[p][1])), ey)),
+                    _mm256_mul_ps(_mm256_set1_ps(fabsf(planes[p][2])), ez));
+                outside |= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(dist[p], radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+            }
+        }
+
+        int visible = ~outside;
+        for (int k = 0; k < 8; k++) {
+            out[count] = int(i + k);
+            count += (visible >> k) & 1;
+        }
+    }
+#endif
+
+#if defined(SIMD_SSE)
+    for (; i + 4 <= end; i += 4) {
+        __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 r = _mm_loadu_ps(&bounds.radius[i]);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        __m128 dist[6];
+        int outside = 0;
+        int inside = 0xF;
+        for (int p = 0; p < 6; p++) {
+            dist[p] = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][0]), cx), _mm_mul_ps(_mm_set1_ps(planes[p][1]), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][2]), cz), _mm_set1_ps(planes[p][3])));
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(dist[p], negR));
+            inside &= _mm_movemask_ps(_mm_cmpge_ps(dist[p], r));
+        }
+
+        if (((outside | inside) & 0xF) != 0xF) {
+            __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+            __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+            __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+            for (int p = 0; p < 6 && (outside | inside) != 0xF; p++) {
+                __m128 radius = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(fabsf(planes[p][0])), ex), _mm_mul_ps(_mm_set1_ps(fabsf(planes[p][1])), ey)),
+                    _mm_mul_ps(_mm_set1_ps(fabsf(planes[p][2])), ez));
+                outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist[p], radius), _mm_setzero_ps()));
+            }
+        }
+
+        int visible = ~outside;
+        for (int k = 0; k < 4; k++) {
+            out[count] = int(i + k);
+            count += (visible >> k) & 1;
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        out[count] = int(i);
+        count += isVisible(bounds, planes, i);
+    }
+
+    return count;
+}
+
+size_t FrustumCuller::cull(const InstanceBounds& bounds, const float planes[6][4], std::vector<int>& visible) const {
+    // Compaction writes every candidate and only advances past the visible ones,
+    // so the output needs room for one extra SIMD batch.
+    visible.resize(bounds.size() + 8);
+    size_t count = cullRange(bounds, planes, 0, bounds.size(), visible.data());
+    visible.resize(count);
+
+    return count;
+}
+
+size_t FrustumCuller::cull(const InstanceBounds& bounds, const float planes[6][4], const std::vector<std::pair<size_t, size_t>>& runs,
+        std::vector<int>& visible) const {
+    size_t tested = 0;
+    for (const auto& run : runs)
+        tested += run.second;
+
+    visible.resize(tested + 8);
+    size_t count = 0;
+    for (const auto& run : runs)
+        count += cullRange(bounds, planes, run.first, run.first + run.second, visible.data() + count);
+    visible.resize(count);
+
+    return count;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "instanceBounds.h"
+
+// Counters of the plane cache of InstanceBVH: `cached` nodes were first tested against the
+// plane that rejected them last frame, `hits` of them were rejected by it again.
+struct CullingStats {
+	size_t tested = 0;
+	size_t cached = 0;
+	size_t hits = 0;
+
+	float getHitRate() const { return cached ? float(hits) / float(cached) : 0.0f; };
+};
+
+// The six unit-length planes (near, far, left, right, top, bottom) bounding the clip volume of
+// `viewProjection`, the row-major matrix applied to row vectors (an XMFLOAT4X4).
+void extractFrustumPlanes(const float viewProjection[16], float planes[6][4]);
+
+// Frustum culling of instance AABBs against the six planes built by Cube::getFrustum.
+// A point is inside a plane (a, b, c, d) when a*x + b*y + c*z + d >= 0; the plane normals
+// must be unit length for the bounding-sphere test.
+//
+// The flat cull keeps no plane cache: testing every instance against its own cached plane
+// costs about as much as the SIMD sphere pass it would skip, and a batch is only skipped
+// when all of its lanes hit. InstanceBVH caches per node, where a hit skips a subtree.
+class FrustumCuller {
+public:
+	// Writes the indices of the visible boxes to the front of `visible` and returns their count.
+	size_t cull(const InstanceBounds& bounds, const float planes[6][4], std::vector<int>& visible) const;
+	// Same for the instances of the runs only, (first, count) pairs in ascending order.
+	size_t cull(const InstanceBounds& bounds, const float planes[6][4], const std::vector<std::pair<size_t, size_t>>& runs,
+		std::vector<int>& visible) const;
+	static bool isVisible(const InstanceBounds& bounds, const float planes[6][4], size_t i);
+	static bool isBoxVisible(const float planes[6][4], float cx, float cy, float cz, float ex, float ey, float ez);
+
+	// A cached plane index that names no plane.
+	static const uint8_t NO_PLANE = 0xFF;
+
+private:
+	size_t cullRange(const InstanceBounds& bounds, const float planes[6][4], size_t begin, size_t end, int* out) const;
+};
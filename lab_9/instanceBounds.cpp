@@ -0,0 +1,78 @@
+#include <algorithm>
+
+#include "instanceBounds.h"
+#include "simd.h"
+
+// Arvo's method: the world box center is the transformed local center and every world
+// extent is the sum of the local extents weighted by the absolute matrix entries.
+// Unlike transforming the two extreme corners this stays correct under rotation.
+void InstanceBounds::transform(const float* matrices, size_t stride, size_t count, const float localMin[3], const float localMax[3]) {
+    resize(count);
+
+    const float c[3] = {
+        (localMin[0] + localMax[0]) * 0.5f,
+        (localMin[1] + localMax[1]) * 0.5f,
+        (localMin[2] + localMax[2]) * 0.5f
+    };
+    const float e[3] = {
+        fabsf(localMax[0] - localMin[0]) * 0.5f,
+        fabsf(localMax[1] - localMin[1]) * 0.5f,
+        fabsf(localMax[2] - localMin[2]) * 0.5f
+    };
+    const float localRadius = sqrtf(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+    const char* base = reinterpret_cast<const char*>(matrices);
+
+#if defined(SIMD_SSE)
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 cx = _mm_set1_ps(c[0]), cy = _mm_set1_ps(c[1]), cz = _mm_set1_ps(c[2]);
+    const __m128 ex = _mm_set1_ps(e[0]), ey = _mm_set1_ps(e[1]), ez = _mm_set1_ps(e[2]);
+
+    for (size_t i = 0; i < count; i++) {
+        const float* m = reinterpret_cast<const float*>(base + i * stride);
+        __m128 r0 = _mm_loadu_ps(m);
+        __m128 r1 = _mm_loadu_ps(m + 4);
+        __m128 r2 = _mm_loadu_ps(m + 8);
+        __m128 r3 = _mm_loadu_ps(m + 12);
+
+        __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, r0), _mm_mul_ps(cy, r1)), _mm_add_ps(_mm_mul_ps(cz, r2), r3));
+        __m128 extent = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(ex, _mm_and_ps(r0, absMask)),
+            _mm_mul_ps(ey, _mm_and_ps(r1, absMask))),
+            _mm_mul_ps(ez, _mm_and_ps(r2, absMask)));
+
+        // The sphere radius scales with the longest basis vector.
+        __m128 len0 = _mm_mul_ps(r0, r0), len1 = _mm_mul_ps(r1, r1), len2 = _mm_mul_ps(r2, r2);
+        _MM_TRANSPOSE4_PS(len0, len1, len2, r3);
+        __m128 sq = _mm_add_ps(_mm_add_ps(len0, len1), len2);
+        sq = _mm_max_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 1)));
+        sq = _mm_max_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)));
+
+        float cf[4], ef[4];
+        _mm_storeu_ps(cf, center);
+        _mm_storeu_ps(ef, extent);
+        centerX[i] = cf[0];
+        centerY[i] = cf[1];
+        centerZ[i] = cf[2];
+        extentX[i] = ef[0];
+        extentY[i] = ef[1];
+        extentZ[i] = ef[2];
+        radius[i] = sqrtf(_mm_cvtss_f32(sq)) * localRadius;
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        const float* m = reinterpret_cast<const float*>(base + i * stride);
+        centerX[i] = c[0] * m[0] + c[1] * m[4] + c[2] * m[8] + m[12];
+        centerY[i] = c[0] * m[1] + c[1] * m[5] + c[2] * m[9] + m[13];
+        centerZ[i] = c[0] * m[2] + c[1] * m[6] + c[2] * m[10] + m[14];
+        extentX[i] = e[0] * fabsf(m[0]) + e[1] * fabsf(m[4]) + e[2] * fabsf(m[8]);
+        extentY[i] = e[0] * fabsf(m[1]) + e[1] * fabsf(m[5]) + e[2] * fabsf(m[9]);
+        extentZ[i] = e[0] * fabsf(m[2]) + e[1] * fabsf(m[6]) + e[2] * fabsf(m[10]);
+
+        float scale = (std::max)((std::max)(
+            m[0] * m[0] + m[1] * m[1] + m[2] * m[2],
+            m[4] * m[4] + m[5] * m[5] + m[6] * m[6]),
+            m[8] * m[8] + m[9] * m[9] + m[10] * m[10]);
+        radius[i] = sqrtf(scale) * localRadius;
+    }
+#endif
+}
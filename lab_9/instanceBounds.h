@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// World-space bounds of the instances in structure-of-arrays form:
+// one array per component so the culling kernels can load 4/8 boxes at once.
+// Every box also carries the radius of its bounding sphere (centered at the box center).
+struct InstanceBounds {
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+
+	size_t size() const { return centerX.size(); };
+
+	void resize(size_t count) {
+		centerX.resize(count);
+		centerY.resize(count);
+		centerZ.resize(count);
+		extentX.resize(count);
+		extentY.resize(count);
+		extentZ.resize(count);
+		radius.resize(count);
+	};
+
+	// Corners may come in any order, the box spans both of them.
+	void setBox(size_t i, const float cornerA[3], const float cornerB[3]) {
+		centerX[i] = (cornerA[0] + cornerB[0]) * 0.5f;
+		centerY[i] = (cornerA[1] + cornerB[1]) * 0.5f;
+		centerZ[i] = (cornerA[2] + cornerB[2]) * 0.5f;
+		extentX[i] = fabsf(cornerB[0] - cornerA[0]) * 0.5f;
+		extentY[i] = fabsf(cornerB[1] - cornerA[1]) * 0.5f;
+		extentZ[i] = fabsf(cornerB[2] - cornerA[2]) * 0.5f;
+		radius[i] = sqrtf(extentX[i] * extentX[i] + extentY[i] * extentY[i] + extentZ[i] * extentZ[i]);
+	};
+
+	// Free slots keep their place in the arrays; a negative radius makes every test reject them.
+	void hide(size_t i) {
+		radius[i] = -FLT_MAX;
+	};
+
+	void getBox(size_t i, float bbMin[3], float bbMax[3]) const {
+		bbMin[0] = centerX[i] - extentX[i];
+		bbMin[1] = centerY[i] - extentY[i];
+		bbMin[2] = centerZ[i] - extentZ[i];
+		bbMax[0] = centerX[i] + extentX[i];
+		bbMax[1] = centerY[i] + extentY[i];
+		bbMax[2] = centerZ[i] + extentZ[i];
+	};
+
+	void getCenter(size_t i, float center[3]) const {
+		center[0] = centerX[i];
+		center[1] = centerY[i];
+		center[2] = centerZ[i];
+	};
+
+	// Builds the bounds of `count` copies of the local box [localMin, localMax] placed by
+	// row-major 4x4 world matrices (row-vector convention, as XMMATRIX). Matrices are read
+	// `stride` bytes apart so they can be taken straight from the GeomBuffer array.
+	void transform(const float* matrices, size_t stride, size_t count, const float localMin[3], const float localMax[3]);
+};
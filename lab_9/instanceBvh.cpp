@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "instanceBvh.h"
+
+static const int BVH_LEAF_SIZE = 4;
+static const int BVH_MAX_LEAF_SIZE = 16;
+static const int BVH_BINS = 12;
+
+static void resetBox(float bbMin[3], float bbMax[3]) {
+    for (int a = 0; a < 3; a++) {
+        bbMin[a] = FLT_MAX;
+        bbMax[a] = -FLT_MAX;
+    }
+}
+
+static void growBox(float bbMin[3], float bbMax[3], const float otherMin[3], const float otherMax[3]) {
+    for (int a = 0; a < 3; a++) {
+        bbMin[a] = (std::min)(bbMin[a], otherMin[a]);
+        bbMax[a] = (std::max)(bbMax[a], otherMax[a]);
+    }
+}
+
+float InstanceBVH::area(const float bbMin[3], const float bbMax[3]) {
+    if (bbMin[0] > bbMax[0])
+        return 0.0f;
+
+    float dx = bbMax[0] - bbMin[0];
+    float dy = bbMax[1] - bbMin[1];
+    float dz = bbMax[2] - bbMin[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+void InstanceBVH::fitLeaf(Node& node, const InstanceBounds& bounds) const {
+    resetBox(node.bbMin, node.bbMax);
+    for (int k = node.first; k < node.first + node.count; k++) {
+        int i = indices[k];
+        if (bounds.radius[i] < 0.0f)
+            continue;
+
+        float bbMin[3], bbMax[3];
+        bounds.getBox(i, bbMin, bbMax);
+        growBox(node.bbMin, node.bbMax, bbMin, bbMax);
+    }
+}
+
+void InstanceBVH::build(const InstanceBounds& bounds) {
+    indices.resize(bounds.size());
+    for (size_t i = 0; i < indices.size(); i++)
+        indices[i] = int(i);
+    buildTree(bounds);
+}
+
+void InstanceBVH::build(const InstanceBounds& bounds, const std::vector<uint32_t>& instances) {
+    indices.assign(instances.begin(), instances.end());
+    buildTree(bounds);
+}
+
+void InstanceBVH::buildTree(const InstanceBounds& bounds) {
+    int count = int(indices.size());
+    nodes.clear();
+    builtArea = 0.0f;
+    depth = 0;
+    leafOf.assign(bounds.size(), -1);
+    if (count == 0)
+        return;
+
+    nodes.reserve(2 * (count / BVH_LEAF_SIZE) + 1);
+    nodes.push_back(Node());
+    buildNode(bounds, 0, 0, count, 0);
+    builtArea = area(nodes[0].bbMin, nodes[0].bbMax);
+
+    rejectPlanes.assign(nodes.size(), FrustumCuller::NO_PLANE);
+    for (size_t n = 0; n < nodes.size(); n++) {
+        if (nodes[n].left >= 0)
+            continue;
+        for (int k = nodes[n].first; k < nodes[n].first + nodes[n].count; k++)
+            leafOf[indices[k]] = int(n);
+    }
+}
+
+// Children are always allocated after their parent, which lets refit walk the array backwards.
+void InstanceBVH::buildNode(const InstanceBounds& bounds, int nodeIndex, int first, int count, int level) {
+    depth = (std::max)(depth, level);
+    {
+        Node& node = nodes[nodeIndex];
+        node.left = -1;
+        node.first = first;
+        node.count = count;
+        fitLeaf(node, bounds);
+    }
+
+    if (count <= BVH_LEAF_SIZE)
+        return;
+
+    const float* centers[3] = { bounds.centerX.data(), bounds.centerY.data(), bounds.centerZ.data() };
+    float centerMin[3], centerMax[3];
+    resetBox(centerMin, centerMax);
+    for (int k = first; k < first + count; k++) {
+        float c[3] = { centers[0][indices[k]], centers[1][indices[k]], centers[2][indices[k]] };
+        growBox(centerMin, centerMax, c, c);
+    }
+
+    // Binned SAH over all three axes.
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centerMax[axis] - centerMin[axis];
+        if (extent <= 1e-6f)
+            continue;
+
+        int binCount[BVH_BINS] = {};
+        float binMin[BVH_BINS][3], binMax[BVH_BINS][3];
+        for (int b = 0; b < BVH_BINS; b++)
+            resetBox(binMin[b], binMax[b]);
+
+        float scale = BVH_BINS / extent;
+        for (int k = first; k < first + count; k++) {
+            int i = indices[k];
+            int b = (std::min)(int((centers[axis][i] - centerMin[axis]) * scale), BVH_BINS - 1);
+            binCount[b]++;
+            if (bounds.radius[i] < 0.0f)
+                continue;
+
+            float bbMin[3], bbMax[3];
+            bounds.getBox(i, bbMin, bbMax);
+            growBox(binMin[b], binMax[b], bbMin, bbMax);
+        }
+
+        float leftArea[BVH_BINS - 1];
+        int leftCount[BVH_BINS - 1];
+        float boxMin[3], boxMax[3];
+        resetBox(boxMin, boxMax);
+        int sum = 0;
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            growBox(boxMin, boxMax, binMin[b], binMax[b]);
+            sum += binCount[b];
+            leftArea[b] = area(boxMin, boxMax);
+            leftCount[b] = sum;
+        }
+
+        resetBox(boxMin, boxMax);
+        sum = 0;
+        for (int b = BVH_BINS - 1; b > 0; b--) {
+            growBox(boxMin, boxMax, binMin[b], binMax[b]);
+            sum += binCount[b];
+            float cost = leftArea[b - 1] * leftCount[b - 1] + area(boxMin, boxMax) * sum;
+            if (leftCount[b - 1] > 0 && sum > 0 && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    float leafCost = area(nodes[nodeIndex].bbMin, nodes[nodeIndex].bbMax) * count;
+    if (bestAxis >= 0 && bestCost >= leafCost && count <= BVH_MAX_LEAF_SIZE)
+        return;
+
+    int middle;
+    if (bestAxis >= 0) {
+        const float* c = centers[bestAxis];
+        float axisMin = centerMin[bestAxis];
+        float scale = BVH_BINS / (centerMax[bestAxis] - centerMin[bestAxis]);
+        int* split = std::partition(indices.data() + first, indices.data() + first + count, [&](int i) {
+            return (std::min)(int((c[i] - axisMin) * scale), BVH_BINS - 1) < bestSplit;
+        });
+        middle = int(split - indices.data());
+    }
+    else {
+        // Every center is the same point, any split is as good as another.
+        middle = first + count / 2;
+    }
+
+    if (middle == first || middle == first + count)
+        middle = first + count / 2;
+
+    int left = int(nodes.size());
+    nodes[nodeIndex].left = left;
+    nodes.resize(left + 2);
+    buildNode(bounds, left, first, middle - first, level + 1);
+    buildNode(bounds, left + 1, middle, first + count - middle, level + 1);
+}
+
+// The instances are read in slot order and scattered to their leaves: gathering them leaf by
+// leaf touches every bounds array at random and is several times slower on large scenes.
+void InstanceBVH::refit(const InstanceBounds& bounds) {
+    for (auto& node : nodes) {
+        if (node.left < 0)
+            resetBox(node.bbMin, node.bbMax);
+    }
+
+    for (size_t i = 0; i < leafOf.size(); i++) {
+        if (leafOf[i] < 0 || bounds.radius[i] < 0.0f)
+            continue;
+
+        float bbMin[3], bbMax[3];
+        bounds.getBox(i, bbMin, bbMax);
+        Node& leaf = nodes[leafOf[i]];
+        growBox(leaf.bbMin, leaf.bbMax, bbMin, bbMax);
+    }
+
+    for (size_t n = nodes.size(); n-- > 0;) {
+        Node& node = nodes[n];
+        if (node.left < 0)
+            continue;
+
+        const Node& left = nodes[node.left];
+        const Node& right = nodes[node.left + 1];
+        for (int a = 0; a < 3; a++) {
+            node.bbMin[a] = (std::min)(left.bbMin[a], right.bbMin[a]);
+            node.bbMax[a] = (std::max)(left.bbMax[a], right.bbMax[a]);
+        }
+    }
+}
+
+bool InstanceBVH::needsRebuild() const {
+    return !nodes.empty() && area(nodes[0].bbMin, nodes[0].bbMax) > 2.0f * builtArea;
+}
+
+// Every node carries the set of planes it still straddles: once a box is completely in front
+// of a plane its whole subtree is, so the children skip that plane. A node in front of all
+// planes emits its instance range without further tests.
+size_t InstanceBVH::cull(const InstanceBounds& bounds, const float planes[6][4], std::vector<int>& visible) {
+    visible.resize(bounds.size());
+    size_t count = 0;
+    stats = CullingStats();
+
+    struct Entry {
+        int node;
+        int mask;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    if (!nodes.empty())
+        stack.push_back({ 0, 0x3F });
+
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[entry.node];
+        int mask = entry.mask;
+        if (node.bbMin[0] > node.bbMax[0])
+            continue;
+
+        float cx = (node.bbMin[0] + node.bbMax[0]) * 0.5f;
+        float cy = (node.bbMin[1] + node.bbMax[1]) * 0.5f;
+        float cz = (node.bbMin[2] + node.bbMax[2]) * 0.5f;
+        float ex = (node.bbMax[0] - node.bbMin[0]) * 0.5f;
+        float ey = (node.bbMax[1] - node.bbMin[1]) * 0.5f;
+        float ez = (node.bbMax[2] - node.bbMin[2]) * 0.5f;
+
+        stats.tested++;
+        uint8_t& rejectPlane = rejectPlanes[entry.node];
+        if (rejectPlane != FrustumCuller::NO_PLANE) {
+            const float* plane = planes[rejectPlane];
+            stats.cached++;
+            if (plane[0] * cx + plane[1] * cy + plane[2] * cz + plane[3] + fabsf(plane[0]) * ex + fabsf(plane[1]) * ey + fabsf(plane[2]) * ez < 0.0f) {
+                stats.hits++;
+                continue;
+            }
+        }
+
+        bool outside = false;
+        rejectPlane = FrustumCuller::NO_PLANE;
+        for (int p = 0; p < 6 && !outside; p++) {
+            if (!(mask & (1 << p)))
+                continue;
+
+            float dist = planes[p][0] * cx + planes[p][1] * cy + planes[p][2] * cz + planes[p][3];
+            float radius = fabsf(planes[p][0]) * ex + fabsf(planes[p][1]) * ey + fabsf(planes[p][2]) * ez;
+            outside = dist + radius < 0.0f;
+            if (outside)
+                rejectPlane = uint8_t(p);
+            if (dist - radius >= 0.0f)
+                mask &= ~(1 << p);
+        }
+
+        if (outside)
+            continue;
+
+        if (mask == 0) {
+            for (int k = node.first; k < node.first + node.count; k++) {
+                int i = indices[k];
+                visible[count] = i;
+                count += bounds.radius[i] >= 0.0f;
+            }
+        }
+        else if (node.left < 0) {
+            for (int k = node.first; k < node.first + node.count; k++) {
+                int i = indices[k];
+                visible[count] = i;
+                count += FrustumCuller::isVisible(bounds, planes, i);
+            }
+        }
+        else {
+            stack.push_back({ node.left, mask });
+            stack.push_back({ node.left + 1, mask });
+        }
+    }
+
+    visible.resize(count);
+    return count;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "frustumCuller.h"
+
+// Bounding volume hierarchy over instance boxes, built with the binned surface area
+// heuristic. refit() moves the boxes bottom-up without changing the topology, and
+// needsRebuild() tells when they have grown too loose. Cube only builds it over the static
+// cubes and never refits it: the moving cubes are culled flat by FrustumCuller, which costs
+// less than a refit. Free slots (negative sphere radius, see InstanceBounds::hide) stay in
+// the tree but never enlarge a node and are never reported as visible.
+class InstanceBVH {
+public:
+	void build(const InstanceBounds& bounds);
+	// Builds over the listed instances only, the others are never reported.
+	void build(const InstanceBounds& bounds, const std::vector<uint32_t>& instances);
+	void refit(const InstanceBounds& bounds);
+	// True when the root surface area has doubled since the last build.
+	bool needsRebuild() const;
+
+	// Same contract as FrustumCuller::cull, the indices are not sorted. Every node remembers
+	// the plane that rejected it and tests that plane first on the next call.
+	size_t cull(const InstanceBounds& bounds, const float planes[6][4], std::vector<int>& visible);
+	const CullingStats& getStats() const { return stats; };
+
+	// Calls hit(instance) for the instances in the leaves whose box the segment
+	// origin + t * dir, 0 <= t <= tMax, crosses, until one call returns true, and tells whether
+	// one did. Children are not visited nearest first: this answers "is anything in the way"
+	// for shadow and occlusion rays, and `hit` does the exact test of the instance.
+	template <typename F>
+	bool intersectSegment(const float origin[3], const float dir[3], float tMax, F hit) const;
+
+	size_t size() const { return indices.size(); };
+	size_t getNodesCount() const { return nodes.size(); };
+	int getDepth() const { return depth; };
+
+private:
+	struct Node {
+		float bbMin[3];
+		int left;  // first child, the second one is left + 1; -1 for leaves
+		float bbMax[3];
+		int count; // instances in the subtree, they are indices[first, first + count)
+		int first;
+	};
+
+	void buildTree(const InstanceBounds& bounds);
+	void buildNode(const InstanceBounds& bounds, int nodeIndex, int first, int count, int level);
+	void fitLeaf(Node& node, const InstanceBounds& bounds) const;
+	static float area(const float bbMin[3], const float bbMax[3]);
+
+	std::vector<Node> nodes;
+	std::vector<int> indices;
+	std::vector<int> leafOf; // leaf node of every instance, -1 for those left out of the tree
+	std::vector<uint8_t> rejectPlanes; // per node, FrustumCuller::NO_PLANE when it was visited
+	CullingStats stats;
+	float builtArea = 0.0f;
+	int depth = 0; // levels below the root
+};
+
+template <typename F>
+bool InstanceBVH::intersectSegment(const float origin[3], const float dir[3], float tMax, F hit) const {
+	if (nodes.empty())
+		return false;
+
+	float invDir[3];
+	for (int a = 0; a < 3; a++)
+		invDir[a] = 1.0f / dir[a];
+
+	// Every level leaves at most one sibling on the stack. Binned SAH trees stay far below
+	// the local array; a degenerate one takes the heap instead of losing children.
+	int local[64];
+	std::vector<int> heap;
+	int* stack = local;
+	int capacity = 64;
+	if (depth + 1 > capacity) {
+		heap.resize(depth + 1);
+		stack = heap.data();
+		capacity = int(heap.size());
+	}
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		if (node.bbMin[0] > node.bbMax[0])
+			continue;
+
+		float tNear = 0.0f, tFar = tMax;
+		for (int a = 0; a < 3; a++) {
+			float t0 = (node.bbMin[a] - origin[a]) * invDir[a];
+			float t1 = (node.bbMax[a] - origin[a]) * invDir[a];
+			// max/min with the running interval first, so a NaN of a zero direction drops out
+			tNear = (std::max)(tNear, (std::min)(t0, t1));
+			tFar = (std::min)(tFar, (std::max)(t0, t1));
+		}
+		if (tNear > tFar)
+			continue;
+
+		if (node.left < 0) {
+			for (int k = node.first; k < node.first + node.count; k++) {
+				if (hit(indices[k]))
+					return true;
+			}
+		}
+		else {
+			assert(top + 2 <= capacity);
+			stack[top++] = node.left;
+			stack[top++] = node.left + 1;
+		}
+	}
+	return false;
+}
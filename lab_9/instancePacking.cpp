@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "instancePacking.h"
+#include "simd.h"
+
+// Round to nearest even; overflow goes to infinity, NaN stays a (quiet) NaN.
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint32_t half;
+    if (bits >= (127u + 16u) << 23) {
+        half = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+    }
+    else if (bits < 113u << 23) {
+        // Adding the magic number lets the FPU round the subnormal mantissa.
+        const uint32_t magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+        float magic, sum;
+        memcpy(&magic, &magicBits, sizeof(magic));
+        memcpy(&sum, &bits, sizeof(sum));
+        sum += magic;
+        memcpy(&half, &sum, sizeof(half));
+        half -= magicBits;
+    }
+    else {
+        uint32_t mantissaOdd = (bits >> 13) & 1u;
+        bits += ((15u - 127u) << 23) + 0xFFFu + mantissaOdd;
+        half = bits >> 13;
+    }
+
+    return uint16_t(half | (sign >> 16));
+}
+
+float halfToFloat(uint16_t value) {
+    uint32_t sign = uint32_t(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+
+    float result;
+    if (exponent == 0) {
+        result = ldexpf(float(mantissa), -24);
+        uint32_t bits;
+        memcpy(&bits, &result, sizeof(bits));
+        bits |= sign;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    uint32_t bits = sign | (exponent == 31 ? 0x7F800000u | (mantissa << 13) : ((exponent + 112u) << 23) | (mantissa << 13));
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+static inline uint32_t packSnorm16(float low, float high) {
+    int lowBits = int(lrintf(low * 32767.0f));
+    int highBits = int(lrintf(high * 32767.0f));
+    return (uint32_t(lowBits) & 0xFFFFu) | (uint32_t(highBits) << 16);
+}
+
+static inline float unpackSnorm16(uint32_t bits) {
+    return (std::max)(float(int16_t(uint16_t(bits))) / 32767.0f, -1.0f);
+}
+
+// The quaternion component with the largest magnitude is taken from the diagonal and the
+// others from the off-diagonal sums and differences. Every candidate is the quaternion
+// scaled by 4 times that component, so normalizing replaces the division.
+static void packOne(const float* m, const float* params, PackedInstance& packed) {
+    float scale = (sqrtf(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]) + sqrtf(m[4] * m[4] + m[5] * m[5] + m[6] * m[6]) +
+        sqrtf(m[8] * m[8] + m[9] * m[9] + m[10] * m[10])) * (1.0f / 3.0f);
+    float inv = scale > 0.0f ? 1.0f / scale : 0.0f;
+    float a00 = m[0] * inv, a01 = m[1] * inv, a02 = m[2] * inv;
+    float a10 = m[4] * inv, a11 = m[5] * inv, a12 = m[6] * inv;
+    float a20 = m[8] * inv, a21 = m[9] * inv, a22 = m[10] * inv;
+
+    float w2 = 1.0f + a00 + a11 + a22;
+    float x2 = 1.0f + a00 - a11 - a22;
+    float y2 = 1.0f - a00 + a11 - a22;
+    float z2 = 1.0f - a00 - a11 + a22;
+
+    float q[4];
+    if (w2 >= (std::max)((std::max)(x2, y2), z2)) {
+        q[0] = a12 - a21; q[1] = a20 - a02; q[2] = a01 - a10; q[3] = w2;
+    }
+    else if (x2 >= (std::max)(y2, z2)) {
+        q[0] = x2; q[1] = a01 + a10; q[2] = a02 + a20; q[3] = a12 - a21;
+    }
+    else if (y2 >= z2) {
+        q[0] = a01 + a10; q[1] = y2; q[2] = a12 + a21; q[3] = a20 - a02;
+    }
+    else {
+        q[0] = a02 + a20; q[1] = a12 + a21; q[2] = z2; q[3] = a01 - a10;
+    }
+    float invLength = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+    packed.position[0] = m[12];
+    packed.position[1] = m[13];
+    packed.position[2] = m[14];
+    packed.scale = scale;
+    packed.rotation[0] = packSnorm16(q[0] * invLength, q[1] * invLength);
+    packed.rotation[1] = packSnorm16(q[2] * invLength, q[3] * invLength);
+    packed.params[0] = uint32_t(floatToHalf(params[0])) | (uint32_t(floatToHalf(params[1])) << 16);
+    packed.params[1] = uint32_t(floatToHalf(params[2])) | (uint32_t(floatToHalf(params[3])) << 16);
+}
+
+#if defined(SIMD_SSE)
+static inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Four lanes of floatToHalf, the result is in the low 16 bits of every lane.
+static inline __m128i floatToHalf4(__m128 value) {
+    __m128i bits = _mm_castps_si128(value);
+    __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(int(0x80000000u)));
+    bits = _mm_xor_si128(bits, sign);
+
+    __m128i infNan = select(_mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7F800000)), _mm_set1_epi32(0x7E00), _mm_set1_epi32(0x7C00));
+
+    const __m128i magicBits = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(magicBits))), magicBits);
+
+    __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(int((15u - 127u) << 23) + 0xFFF)), mantissaOdd), 13);
+
+    __m128i result = select(_mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23)), subnormal, normal);
+    result = select(_mm_cmpgt_epi32(bits, _mm_set1_epi32(((127 + 16) << 23) - 1)), infNan, result);
+    return _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+}
+
+static inline __m128i packSnorm16x4(__m128 low, __m128 high) {
+    const __m128 range = _mm_set1_ps(32767.0f);
+    __m128i lowBits = _mm_cvtps_epi32(_mm_mul_ps(low, range));
+    __m128i highBits = _mm_cvtps_epi32(_mm_mul_ps(high, range));
+    return _mm_or_si128(_mm_and_si128(lowBits, _mm_set1_epi32(0xFFFF)), _mm_slli_epi32(highBits, 16));
+}
+
+static inline __m128 loadRow(const char* base, size_t stride, size_t k, int offset) {
+    return _mm_loadu_ps(reinterpret_cast<const float*>(base + k * stride) + offset);
+}
+
+// Four instances at a time: the matrix rows are transposed so every lane is an instance.
+// The operations match packOne one to one, so both paths produce the same bits.
+static void packFour(const char* matrices, size_t matrixStride, const char* params, size_t paramsStride, PackedInstance* packed) {
+    __m128 r0[4], r1[4], r2[4], t[4], p[4];
+    for (int k = 0; k < 4; k++) {
+        r0[k] = loadRow(matrices, matrixStride, k, 0);
+        r1[k] = loadRow(matrices, matrixStride, k, 4);
+        r2[k] = loadRow(matrices, matrixStride, k, 8);
+        t[k] = loadRow(matrices, matrixStride, k, 12);
+        p[k] = loadRow(params, paramsStride, k, 0);
+    }
+    _MM_TRANSPOSE4_PS(r0[0], r0[1], r0[2], r0[3]);
+    _MM_TRANSPOSE4_PS(r1[0], r1[1], r1[2], r1[3]);
+    _MM_TRANSPOSE4_PS(r2[0], r2[1], r2[2], r2[3]);
+    _MM_TRANSPOSE4_PS(t[0], t[1], t[2], t[3]);
+    _MM_TRANSPOSE4_PS(p[0], p[1], p[2], p[3]);
+
+    auto length = [](__m128 x, __m128 y, __m128 z) {
+        return _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    };
+    __m128 scale = _mm_mul_ps(_mm_add_ps(_mm_add_ps(length(r0[0], r0[1], r0[2]), length(r1[0], r1[1], r1[2])), length(r2[0], r2[1], r2[2])),
+        _mm_set1_ps(1.0f / 3.0f));
+    __m128 positive = _mm_cmpgt_ps(scale, _mm_setzero_ps());
+    __m128 inv = _mm_and_ps(positive, _mm_div_ps(_mm_set1_ps(1.0f), select(positive, scale, _mm_set1_ps(1.0f))));
+
+    __m128 a00 = _mm_mul_ps(r0[0], inv), a01 = _mm_mul_ps(r0[1], inv), a02 = _mm_mul_ps(r0[2], inv);
+    __m128 a10 = _mm_mul_ps(r1[0], inv), a11 = _mm_mul_ps(r1[1], inv), a12 = _mm_mul_ps(r1[2], inv);
+    __m128 a20 = _mm_mul_ps(r2[0], inv), a21 = _mm_mul_ps(r2[1], inv), a22 = _mm_mul_ps(r2[2], inv);
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 w2 = _mm_add_ps(_mm_add_ps(_mm_add_ps(one, a00), a11), a22);
+    __m128 x2 = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(one, a00), a11), a22);
+    __m128 y2 = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(one, a00), a11), a22);
+    __m128 z2 = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(one, a00), a11), a22);
+
+    __m128 dx = _mm_sub_ps(a12, a21), dy = _mm_sub_ps(a20, a02), dz = _mm_sub_ps(a01, a10);
+    __m128 sxy = _mm_add_ps(a01, a10), sxz = _mm_add_ps(a02, a20), syz = _mm_add_ps(a12, a21);
+
+    __m128 bigW = _mm_cmpge_ps(w2, _mm_max_ps(_mm_max_ps(x2, y2), z2));
+    __m128 bigX = _mm_cmpge_ps(x2, _mm_max_ps(y2, z2));
+    __m128 bigY = _mm_cmpge_ps(y2, z2);
+    __m128 qx = select(bigW, dx, select(bigX, x2, select(bigY, sxy, sxz)));
+    __m128 qy = select(bigW, dy, select(bigX, sxy, select(bigY, y2, syz)));
+    __m128 qz = select(bigW, dz, select(bigX, sxz, select(bigY, syz, z2)));
+    __m128 qw = select(bigW, w2, select(bigX, dx, select(bigY, dy, dz)));
+
+    __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+        _mm_mul_ps(qz, qz)), _mm_mul_ps(qw, qw))));
+
+    __m128 words[4] = {
+        _mm_castsi128_ps(packSnorm16x4(_mm_mul_ps(qx, invLength), _mm_mul_ps(qy, invLength))),
+        _mm_castsi128_ps(packSnorm16x4(_mm_mul_ps(qz, invLength), _mm_mul_ps(qw, invLength))),
+        _mm_castsi128_ps(_mm_or_si128(floatToHalf4(p[0]), _mm_slli_epi32(floatToHalf4(p[1]), 16))),
+        _mm_castsi128_ps(_mm_or_si128(floatToHalf4(p[2]), _mm_slli_epi32(floatToHalf4(p[3]), 16))),
+    };
+    _MM_TRANSPOSE4_PS(words[0], words[1], words[2], words[3]);
+
+    __m128 head[4] = { t[0], t[1], t[2], scale };
+    _MM_TRANSPOSE4_PS(head[0], head[1], head[2], head[3]);
+
+    for (int k = 0; k < 4; k++) {
+        float* dst = reinterpret_cast<float*>(packed + k);
+        _mm_storeu_ps(dst, head[k]);
+        _mm_storeu_ps(dst + 4, words[k]);
+    }
+}
+#endif
+
+void packInstances(const float* matrices, size_t matrixStride, const float* params, size_t paramsStride,
+        size_t count, PackedInstance* packed) {
+    const char* matrixBytes = reinterpret_cast<const char*>(matrices);
+    const char* paramsBytes = reinterpret_cast<const char*>(params);
+    size_t i = 0;
+
+#if defined(SIMD_SSE)
+    for (; i + 4 <= count; i += 4)
+        packFour(matrixBytes + i * matrixStride, matrixStride, paramsBytes + i * paramsStride, paramsStride, packed + i);
+#endif
+
+    for (; i < count; i++) {
+        packOne(reinterpret_cast<const float*>(matrixBytes + i * matrixStride),
+            reinterpret_cast<const float*>(paramsBytes + i * paramsStride), packed[i]);
+    }
+}
+
+void decodeInstance(const PackedInstance& packed, float matrix[16], float params[4]) {
+    float x = unpackSnorm16(packed.rotation[0]);
+    float y = unpackSnorm16(packed.rotation[0] >> 16);
+    float z = unpackSnorm16(packed.rotation[1]);
+    float w = unpackSnorm16(packed.rotation[1] >> 16);
+    float invLength = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+    x *= invLength;
+    y *= invLength;
+    z *= invLength;
+    w *= invLength;
+
+    // Rows are the rotated basis vectors, as RotateVector in CubeCB.hlsli produces them.
+    float s = packed.scale;
+    float rows[3][3] = {
+        { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w) },
+        { 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w) },
+        { 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y) },
+    };
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++)
+            matrix[r * 4 + c] = rows[r][c] * s;
+        matrix[r * 4 + 3] = 0.0f;
+    }
+    matrix[12] = packed.position[0];
+    matrix[13] = packed.position[1];
+    matrix[14] = packed.position[2];
+    matrix[15] = 1.0f;
+
+    params[0] = halfToFloat(uint16_t(packed.params[0]));
+    params[1] = halfToFloat(uint16_t(packed.params[0] >> 16));
+    params[2] = halfToFloat(uint16_t(packed.params[1]));
+    params[3] = halfToFloat(uint16_t(packed.params[1] >> 16));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// GPU form of a cube instance, 32 bytes instead of the 144 of a world matrix, its normal
+// matrix copy and float params. The world matrix must be a rotation with a uniform scale
+// followed by a translation, which is all the cube animation produces.
+//   rotation - unit quaternion (x, y, z, w) as four snorm16, x and z in the low halves
+//   params   - CubeModel::params as four halves, same order
+// Decoded by CubeCB.hlsli; decodeInstance below is the same code on the CPU.
+struct PackedInstance {
+	float position[3];
+	float scale;
+	uint32_t rotation[2];
+	uint32_t params[2];
+};
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+// Matrices are row-major with the row-vector convention (as XMMATRIX) and are read
+// `matrixStride` bytes apart, params `paramsStride` bytes apart, so both can be taken
+// straight from the GeomBuffer array.
+void packInstances(const float* matrices, size_t matrixStride, const float* params, size_t paramsStride,
+	size_t count, PackedInstance* packed);
+
+void decodeInstance(const PackedInstance& packed, float matrix[16], float params[4]);
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Growable per-instance storage with stable slot indices.
+// Removed slots go to a free list and are reused by the next add, so the indices already
+// written into GPU buffers stay valid. Capacity grows geometrically; the owner checks
+// consumeGrowth() to know when its GPU buffers have to be recreated. Changes are tracked
+// per chunk of `chunkSize` slots so only the touched ranges need to be uploaded.
+template <typename T>
+class InstanceStore {
+public:
+	explicit InstanceStore(size_t chunkSize = 4096) : chunkSize(chunkSize) {};
+
+	uint32_t add(const T& value) {
+		uint32_t slot;
+		if (!freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+			items[slot] = value;
+			alive[slot] = 1;
+		}
+		else {
+			slot = (uint32_t)items.size();
+			if (items.size() == gpuCapacity) {
+				gpuCapacity = gpuCapacity ? gpuCapacity * 2 : chunkSize;
+				items.reserve(gpuCapacity);
+				alive.reserve(gpuCapacity);
+				grown = true;
+			}
+			items.push_back(value);
+			alive.push_back(1);
+			dirtyChunks.resize((items.size() + chunkSize - 1) / chunkSize, 1);
+		}
+		aliveCount++;
+		markDirty(slot);
+		return slot;
+	};
+
+	void remove(uint32_t slot) {
+		if (slot >= items.size() || !alive[slot])
+			return;
+		alive[slot] = 0;
+		freeSlots.push_back(slot);
+		aliveCount--;
+		markDirty(slot);
+	};
+
+	void reserve(size_t count) {
+		if (count <= gpuCapacity)
+			return;
+		while (gpuCapacity < count)
+			gpuCapacity = gpuCapacity ? gpuCapacity * 2 : chunkSize;
+		items.reserve(gpuCapacity);
+		alive.reserve(gpuCapacity);
+		grown = true;
+	};
+
+	T& operator[](size_t slot) { return items[slot]; };
+	const T& operator[](size_t slot) const { return items[slot]; };
+	T* data() { return items.data(); };
+	const T* data() const { return items.data(); };
+	bool isAlive(size_t slot) const { return alive[slot] != 0; };
+
+	// Slots in use including the free ones; GPU buffers are indexed by slot.
+	size_t size() const { return items.size(); };
+	size_t count() const { return aliveCount; };
+	size_t capacity() const { return gpuCapacity; };
+	size_t getChunkSize() const { return chunkSize; };
+
+	bool consumeGrowth() {
+		bool result = grown;
+		grown = false;
+		return result;
+	};
+
+	void markDirty(size_t slot) { dirtyChunks[slot / chunkSize] = 1; };
+	void markDirty(size_t first, size_t count) {
+		if (count == 0)
+			return;
+		for (size_t chunk = first / chunkSize; chunk <= (first + count - 1) / chunkSize; chunk++)
+			dirtyChunks[chunk] = 1;
+	};
+	void markAllDirty() { dirtyChunks.assign(dirtyChunks.size(), 1); };
+
+	// Calls upload(firstSlot, slotCount) for every run of adjacent dirty chunks and clears them.
+	// Returns the number of upload calls.
+	template <typename F>
+	size_t flushDirty(F upload) {
+		size_t calls = 0;
+		size_t chunk = 0;
+		while (chunk < dirtyChunks.size()) {
+			if (!dirtyChunks[chunk]) {
+				chunk++;
+				continue;
+			}
+			size_t first = chunk;
+			while (chunk < dirtyChunks.size() && dirtyChunks[chunk])
+				dirtyChunks[chunk++] = 0;
+
+			size_t begin = first * chunkSize;
+			size_t end = chunk * chunkSize < items.size() ? chunk * chunkSize : items.size();
+			upload(begin, end - begin);
+			calls++;
+		}
+		return calls;
+	};
+
+private:
+	size_t chunkSize;
+	size_t gpuCapacity = 0;
+	size_t aliveCount = 0;
+	bool grown = false;
+
+	std::vector<T> items;
+	std::vector<uint8_t> alive;
+	std::vector<uint32_t> freeSlots;
+	std::vector<uint8_t> dirtyChunks;
+};
@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include "jobSystem.h"
+
+static thread_local bool insideJob = false;
+
+JobSystem::JobSystem() : nextChunk(0), finishedChunks(0) {
+    startWorkers(std::thread::hardware_concurrency());
+}
+
+JobSystem::~JobSystem() {
+    stopWorkers();
+}
+
+void JobSystem::setThreadsCount(size_t count) {
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    stopWorkers();
+    startWorkers(count ? count : std::thread::hardware_concurrency());
+}
+
+void JobSystem::startWorkers(size_t count) {
+    for (size_t i = 1; i < count; i++)
+        workers.emplace_back(&JobSystem::workerLoop, this);
+}
+
+void JobSystem::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+    stopping = false;
+}
+
+void JobSystem::runChunks() {
+    insideJob = true;
+    for (;;) {
+        size_t chunk = nextChunk++;
+        if (chunk >= chunksCount)
+            break;
+
+        size_t begin = chunk * jobGrain;
+        (*job)(begin, (std::min)(begin + jobGrain, jobCount));
+        if (++finishedChunks == chunksCount) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+    }
+    insideJob = false;
+}
+
+// A worker that joins a job is counted until it leaves, so the next job cannot start while
+// it may still pick up a chunk of the previous one.
+void JobSystem::workerLoop() {
+    uint64_t seen;
+    {
+        // A worker started by setThreadsCount must not take the last job for a new one.
+        std::lock_guard<std::mutex> lock(mutex);
+        seen = generation;
+    }
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            activeWorkers++;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--activeWorkers == 0)
+                done.notify_all();
+        }
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const RangeFunction& function) {
+    if (count == 0)
+        return;
+
+    grain = (std::max)(grain, size_t(1));
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || workers.empty() || insideJob) {
+        for (size_t begin = 0; begin < count; begin += grain)
+            function(begin, (std::min)(begin + grain, count));
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    {
+        // A worker that woke up late for the previous job may still be looking at it.
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return activeWorkers == 0; });
+        job = &function;
+        jobCount = count;
+        jobGrain = grain;
+        chunksCount = chunks;
+        nextChunk = 0;
+        finishedChunks = 0;
+        generation++;
+    }
+    wake.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return finishedChunks == chunksCount && activeWorkers == 0; });
+    job = nullptr;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads for the data-parallel CPU kernels. parallelFor splits
+// [0, count) into chunks of `grain` items, the workers and the calling thread take them in
+// turn and the call returns when all of them are done. Chunk k is always [k * grain,
+// min((k + 1) * grain, count)), so per-chunk outputs merge in the same order on every run.
+// A parallelFor issued from inside a chunk runs inline on the calling thread.
+class JobSystem {
+public:
+	typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+	static JobSystem& GetInstance() {
+		static JobSystem jobSystemInstance;
+		return jobSystemInstance;
+	};
+
+	void parallelFor(size_t count, size_t grain, const RangeFunction& function);
+	size_t getThreadsCount() const { return workers.size() + 1; };
+	// Restarts the pool so that `count` threads, the caller included, take the chunks; 0 is
+	// one per hardware thread, as at startup. Waits for the running parallelFor, if any, and
+	// must not be called from inside a chunk.
+	void setThreadsCount(size_t count);
+
+	~JobSystem();
+
+private:
+	JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void startWorkers(size_t count);
+	void stopWorkers();
+	void workerLoop();
+	void runChunks();
+
+	std::vector<std::thread> workers;
+	std::mutex submitMutex; // one parallelFor at a time
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const RangeFunction* job = nullptr;
+	size_t jobCount = 0;
+	size_t jobGrain = 1;
+	size_t chunksCount = 0;
+	std::atomic<size_t> nextChunk;
+	std::atomic<size_t> finishedChunks;
+	int activeWorkers = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+};
@@ -1,282 +1,315 @@
-#include "light.h"
-
-void Light::generateSphere(UINT LatLines, UINT LongLines, std::vector<SimpleVertex>& vertices, std::vector<UINT>& indices) {
-    numSphereVertices = ((LatLines - 2) * LongLines) + 2;
-    numSphereFaces = ((LatLines - 3) * (LongLines) * 2) + (LongLines * 2);
-
-    float sphereYaw = 0.0f;
-    float spherePitch = 0.0f;
-
-    vertices.resize(numSphereVertices);
-
-    XMVECTOR currVertPos = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-
-    vertices[0].x = 0.0f;
-    vertices[0].y = 0.0f;
-    vertices[0].z = 1.0f;
-
-    for (UINT i = 0; i < LatLines - 2; i++) {
-        spherePitch = (i + 1) * (XM_PI / (LatLines - 1));
-        XMMATRIX Rotationx = XMMatrixRotationX(spherePitch);
-        for (UINT j = 0; j < LongLines; j++) {
-            sphereYaw = j * (XM_2PI / (LongLines));
-            XMMATRIX Rotationy = XMMatrixRotationZ(sphereYaw);
-            currVertPos = XMVector3TransformNormal(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), (Rotationx * Rotationy));
-            currVertPos = XMVector3Normalize(currVertPos);
-            vertices[i * LongLines + j + 1].x = XMVectorGetX(currVertPos);
-            vertices[i * LongLines + j + 1].y = XMVectorGetY(currVertPos);
-            vertices[i * LongLines + j + 1].z = XMVectorGetZ(currVertPos);
-        }
-    }
-
-    vertices[numSphereVertices - 1].x = 0.0f;
-    vertices[numSphereVertices - 1].y = 0.0f;
-    vertices[numSphereVertices - 1].z = -1.0f;
-
-    indices.resize(numSphereFaces * 3);
-
-    UINT k = 0;
-    for (UINT i = 0; i < LongLines - 1; i++) {
-        indices[k] = 0;
-        indices[k + 1] = i + 1;
-        indices[k + 2] = i + 2;
-        k += 3;
-    }
-
-    indices[k] = 0;
-    indices[k + 1] = LongLines;
-    indices[k + 2] = 1;
-    k += 3;
-
-    for (UINT i = 0; i < LatLines - 3; i++) {
-        for (UINT j = 0; j < LongLines - 1; j++) {
-            indices[k] = i * LongLines + j + 1;
-            indices[k + 1] = i * LongLines + j + 2;
-            indices[k + 2] = (i + 1) * LongLines + j + 1;
-
-            indices[k + 3] = (i + 1) * LongLines + j + 1;
-            indices[k + 4] = i * LongLines + j + 2;
-            indices[k + 5] = (i + 1) * LongLines + j + 2;
-
-            k += 6;
-        }
-
-        indices[k] = (i * LongLines) + LongLines;
-        indices[k + 1] = (i * LongLines) + 1;
-        indices[k + 2] = ((i + 1) * LongLines) + LongLines;
-
-        indices[k + 3] = ((i + 1) * LongLines) + LongLines;
-        indices[k + 4] = (i * LongLines) + 1;
-        indices[k + 5] = ((i + 1) * LongLines) + 1;
-
-        k += 6;
-    }
-
-    for (UINT i = 0; i < LongLines - 1; i++) {
-        indices[k] = numSphereVertices - 1;
-        indices[k + 1] = (numSphereVertices - 1) - (i + 1);
-        indices[k + 2] = (numSphereVertices - 1) - (i + 2);
-        k += 3;
-    }
-
-    indices[k] = numSphereVertices - 1;
-    indices[k + 1] = (numSphereVertices - 1) - LongLines;
-    indices[k + 2] = numSphereVertices - 2;
-
-    return;
-}
-
-HRESULT Light::init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight,
-        const std::vector<XMFLOAT4>& colors, const std::vector<XMFLOAT4>& positions) {
-
-    std::vector<SimpleVertex> vertices;
-    std::vector<UINT> indices;
-    generateSphere(10, 10, vertices, indices);
-
-    this->colors = colors;
-    this->positions = positions;
-    assert(this->colors.size() == MAX_LIGHTS);
-    assert(this->positions.size() == MAX_LIGHTS);
-
-    static const D3D11_INPUT_ELEMENT_DESC InputDesc[] = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-    };
-
-    D3D11_BUFFER_DESC descVert = {};
-    descVert.ByteWidth = sizeof(SimpleVertex) * numSphereVertices;
-    descVert.Usage = D3D11_USAGE_IMMUTABLE;
-    descVert.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    descVert.CPUAccessFlags = 0;
-    descVert.MiscFlags = 0;
-    descVert.StructureByteStride = 0;
-
-    D3D11_SUBRESOURCE_DATA dataVert;
-    ZeroMemory(&dataVert, sizeof(dataVert));
-    dataVert.pSysMem = &vertices[0];
-    HRESULT hr = device->CreateBuffer(&descVert, &dataVert, &g_pVertexBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC descInd = {};
-    ZeroMemory(&descInd, sizeof(descInd));
-
-    descInd.ByteWidth = sizeof(UINT) * numSphereFaces * 3;
-    descInd.Usage = D3D11_USAGE_IMMUTABLE;
-    descInd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    descInd.CPUAccessFlags = 0;
-    descInd.MiscFlags = 0;
-    descInd.StructureByteStride = 0;
-
-    D3D11_SUBRESOURCE_DATA dataInd;
-    dataInd.pSysMem = &indices[0];
-
-    hr = device->CreateBuffer(&descInd, &dataInd, &g_pIndexBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    ID3D10Blob* vertexShaderBuffer = nullptr;
-    ID3D10Blob* pixelShaderBuffer = nullptr;
-    int flags = 0;
-#ifdef _DEBUG
-    flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-
-    hr = D3DReadFileToBlob(L"LightVertexShader.cso", &vertexShaderBuffer);
-    if (FAILED(hr)) {
-        MessageBox(nullptr, L"LightVertexShader.cso not found.", L"Error", MB_OK);
-        return hr;
-    }
-
-    hr = device->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &g_pVertexShader);
-    if (FAILED(hr))
-        return hr;
-
-    hr = D3DReadFileToBlob(L"LightPixelShader.cso", &pixelShaderBuffer);
-    if (FAILED(hr)) {
-        MessageBox(nullptr, L"LightPixelShader.cso not found.", L"Error", MB_OK);
-        return hr;
-    }
-
-    hr = device->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize(), NULL, &g_pPixelShader);
-    if (FAILED(hr))
-        return hr;
-
-    int numElements = sizeof(InputDesc) / sizeof(InputDesc[0]);
-    hr = device->CreateInputLayout(InputDesc, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &g_pVertexLayout);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC descWM = {};
-    descWM.ByteWidth = (UINT)(sizeof(WorldMatrixBuffer) * colors.size());
-    descWM.Usage = D3D11_USAGE_DEFAULT;
-    descWM.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    descWM.CPUAccessFlags = 0;
-    descWM.MiscFlags = 0;
-    descWM.StructureByteStride = 0;
-
-    WorldMatrixBuffer lightGeomBuffer[MAX_LIGHTS];
-    for (UINT i = 0; i < MAX_LIGHTS; i++) {
-        lightGeomBuffer[i].worldMatrix =
-            DirectX::XMMatrixScaling(0.1f, 0.1f, 0.1f) *
-            XMMatrixTranslation(
-                this->positions[i].x,
-                this->positions[i].y,
-                this->positions[i].z);
-        lightGeomBuffer[i].color = this->colors[i];
-    }
-
-    D3D11_SUBRESOURCE_DATA data;
-    data.pSysMem = &lightGeomBuffer;
-    data.SysMemPitch = sizeof(lightGeomBuffer);
-    data.SysMemSlicePitch = 0;
-
-    hr = device->CreateBuffer(&descWM, &data, &g_pWorldMatrixBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_BUFFER_DESC descSM = {};
-    descSM.ByteWidth = sizeof(SceneMatrixBuffer);
-    descSM.Usage = D3D11_USAGE_DYNAMIC;
-    descSM.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    descSM.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    descSM.MiscFlags = 0;
-    descSM.StructureByteStride = 0;
-
-    hr = device->CreateBuffer(&descSM, nullptr, &g_pSceneMatrixBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_RASTERIZER_DESC descRast = {};
-    descRast.AntialiasedLineEnable = false;
-    descRast.FillMode = D3D11_FILL_SOLID;
-    descRast.CullMode = D3D11_CULL_NONE;
-    descRast.DepthBias = 0;
-    descRast.DepthBiasClamp = 0.0f;
-    descRast.FrontCounterClockwise = false;
-    descRast.DepthClipEnable = true;
-    descRast.ScissorEnable = false;
-    descRast.MultisampleEnable = false;
-    descRast.SlopeScaledDepthBias = 0.0f;
-
-    hr = device->CreateRasterizerState(&descRast, &g_pRasterizerState);
-    if (FAILED(hr))
-        return hr;
-
-    resize(screenWidth, screenHeight);
-
-    return hr;
-}
-
-void Light::realize() {
-    if (g_pRasterizerState) g_pRasterizerState->Release();
-    if (g_pGeomBuffer) g_pGeomBuffer->Release();
-    if (g_pWorldMatrixBuffer) g_pWorldMatrixBuffer->Release();
-    if (g_pSceneMatrixBuffer) g_pSceneMatrixBuffer->Release();
-    if (g_pIndexBuffer) g_pIndexBuffer->Release();
-    if (g_pVertexBuffer) g_pVertexBuffer->Release();
-    if (g_pVertexLayout) g_pVertexLayout->Release();
-    if (g_pVertexShader) g_pVertexShader->Release();
-    if (g_pPixelShader) g_pPixelShader->Release();
-}
-
-void Light::render(ID3D11DeviceContext* context) {
-    context->RSSetState(g_pRasterizerState);
-
-    context->IASetIndexBuffer(g_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
-
-    ID3D11Buffer* vertexBuffers[] = { g_pVertexBuffer };
-    UINT strides[] = { 12 };
-    UINT offsets[] = { 0 };
-
-    context->IASetVertexBuffers(0, 1, vertexBuffers, strides, offsets);
-    context->IASetInputLayout(g_pVertexLayout);
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    context->VSSetShader(g_pVertexShader, nullptr, 0);
-    context->VSSetConstantBuffers(0, 1, &g_pWorldMatrixBuffer);
-    context->VSSetConstantBuffers(1, 1, &g_pSceneMatrixBuffer);
-    context->PSSetShader(g_pPixelShader, nullptr, 0);
-    context->PSSetConstantBuffers(0, 1, &g_pWorldMatrixBuffer);
-
-    context->DrawIndexedInstanced(numSphereFaces * 3, (UINT)colors.size(), 0, 0, 0);
-}
-
-bool Light::frame(ID3D11DeviceContext* context, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos) {
-    WorldMatrixBuffer lightGeomBuffer[MAX_LIGHTS];
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        lightGeomBuffer[i].worldMatrix = DirectX::XMMatrixScaling(0.1f, 0.1f, 0.1f)
-            * XMMatrixTranslation(positions[i].x, positions[i].y, positions[i].z);
-        lightGeomBuffer[i].color = colors[i];
-    }
-    context->UpdateSubresource(g_pWorldMatrixBuffer, 0, nullptr, &lightGeomBuffer, 0, 0);
-
-    D3D11_MAPPED_SUBRESOURCE subresource;
-    HRESULT hr = context->Map(g_pSceneMatrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-    if (FAILED(hr))
-        return FAILED(hr);
-
-    SceneMatrixBuffer& sceneBuffer = *reinterpret_cast<SceneMatrixBuffer*>(subresource.pData);
-    sceneBuffer.viewProjectionMatrix = XMMatrixMultiply(viewMatrix, projectionMatrix);
-    context->Unmap(g_pSceneMatrixBuffer, 0);
-
-    return S_OK;
-}
+#include <algorithm>
+#include <cstring>
+
+#include "light.h"
+
+// Lights stop where 1/d^2 falls under this, a step the 8-bit target would not show.
+static const float LIGHT_CUTOFF = 1.0f / 256.0f;
+// Depth slices are spaced exponentially from here to the far plane, closer goes to slice 0.
+static const float CLUSTER_NEAR = 0.1f;
+
+HRESULT Light::init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight,
+        const std::vector<XMFLOAT4>& colors, const std::vector<XMFLOAT4>& positions) {
+
+    // All the levels share one vertex and one index buffer, every draw picks its range.
+    std::vector<MeshLod> lods;
+    buildUVSphereLods(24, 24, MAX_LIGHT_LODS, lods);
+    lodSelector.setChain(lods);
+    lodSelector.setPixelError(1.0f, 0.25f);
+
+    std::vector<SimpleVertex> vertices;
+    std::vector<UINT> indices;
+    bool shortIndices = true;
+    lodRanges.resize(lods.size());
+    for (size_t level = 0; level < lods.size(); level++) {
+        const Mesh& sphere = *lods[level].mesh;
+        lodRanges[level].firstIndex = (UINT)indices.size();
+        lodRanges[level].indexCount = (UINT)sphere.getIndexCount();
+        lodRanges[level].baseVertex = (INT)vertices.size();
+        lodRanges[level].firstInstance = 0;
+        lodRanges[level].instanceCount = level == 0 ? MAX_LIGHTS : 0;
+        for (auto& vertex : sphere.vertices)
+            vertices.push_back({ vertex.position[0], vertex.position[1], vertex.position[2] });
+        indices.insert(indices.end(), sphere.indices.begin(), sphere.indices.end());
+        shortIndices = shortIndices && sphere.hasShortIndices();
+    }
+    std::vector<USHORT> indices16(shortIndices ? indices.size() : 0);
+    for (size_t i = 0; i < indices16.size(); i++)
+        indices16[i] = (USHORT)indices[i];
+    indexFormat = shortIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+    this->colors = colors;
+    this->positions = positions;
+    assert(this->colors.size() == MAX_LIGHTS);
+    assert(this->positions.size() == MAX_LIGHTS);
+    spheres.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        float intensity = (std::max)((std::max)(colors[i].x, colors[i].y), colors[i].z);
+        spheres[i] = XMFLOAT4(positions[i].x, positions[i].y, positions[i].z, getInfluenceRadius(intensity, LIGHT_CUTOFF));
+    }
+    assert(spheres.size() <= MAX_CLUSTER_LIGHTS);
+
+    static const D3D11_INPUT_ELEMENT_DESC InputDesc[] = {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+        {"INSTANCE", 0, DXGI_FORMAT_R32_UINT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    };
+
+    D3D11_BUFFER_DESC descVert = {};
+    descVert.ByteWidth = (UINT)(sizeof(SimpleVertex) * vertices.size());
+    descVert.Usage = D3D11_USAGE_IMMUTABLE;
+    descVert.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    descVert.CPUAccessFlags = 0;
+    descVert.MiscFlags = 0;
+    descVert.StructureByteStride = 0;
+
+    D3D11_SUBRESOURCE_DATA dataVert;
+    ZeroMemory(&dataVert, sizeof(dataVert));
+    dataVert.pSysMem = &vertices[0];
+    HRESULT hr = device->CreateBuffer(&descVert, &dataVert, &g_pVertexBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_BUFFER_DESC descInd = {};
+    ZeroMemory(&descInd, sizeof(descInd));
+
+    descInd.ByteWidth = (UINT)((shortIndices ? sizeof(USHORT) : sizeof(UINT)) * indices.size());
+    descInd.Usage = D3D11_USAGE_IMMUTABLE;
+    descInd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    descInd.CPUAccessFlags = 0;
+    descInd.MiscFlags = 0;
+    descInd.StructureByteStride = 0;
+
+    D3D11_SUBRESOURCE_DATA dataInd;
+    dataInd.pSysMem = shortIndices ? (const void*)indices16.data() : (const void*)indices.data();
+
+    hr = device->CreateBuffer(&descInd, &dataInd, &g_pIndexBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    // Slot of every drawn instance in the world matrix buffer, so instances of one draw can
+    // start anywhere in it (SV_InstanceID ignores StartInstanceLocation).
+    UINT instanceIndices[MAX_LIGHTS];
+    for (UINT i = 0; i < MAX_LIGHTS; i++)
+        instanceIndices[i] = i;
+
+    D3D11_BUFFER_DESC descInst = {};
+    descInst.ByteWidth = sizeof(instanceIndices);
+    descInst.Usage = D3D11_USAGE_IMMUTABLE;
+    descInst.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA dataInst = {};
+    dataInst.pSysMem = instanceIndices;
+
+    hr = device->CreateBuffer(&descInst, &dataInst, &g_pInstanceBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    ID3D10Blob* vertexShaderBuffer = nullptr;
+    ID3D10Blob* pixelShaderBuffer = nullptr;
+    int flags = 0;
+#ifdef _DEBUG
+    flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+
+    hr = D3DReadFileToBlob(L"LightVertexShader.cso", &vertexShaderBuffer);
+    if (FAILED(hr)) {
+        MessageBox(nullptr, L"LightVertexShader.cso not found.", L"Error", MB_OK);
+        return hr;
+    }
+
+    hr = device->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), NULL, &g_pVertexShader);
+    if (FAILED(hr))
+        return hr;
+
+    hr = D3DReadFileToBlob(L"LightPixelShader.cso", &pixelShaderBuffer);
+    if (FAILED(hr)) {
+        MessageBox(nullptr, L"LightPixelShader.cso not found.", L"Error", MB_OK);
+        return hr;
+    }
+
+    hr = device->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize(), NULL, &g_pPixelShader);
+    if (FAILED(hr))
+        return hr;
+
+    int numElements = sizeof(InputDesc) / sizeof(InputDesc[0]);
+    hr = device->CreateInputLayout(InputDesc, numElements, vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(), &g_pVertexLayout);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_RASTERIZER_DESC descRast = {};
+    descRast.AntialiasedLineEnable = false;
+    descRast.FillMode = D3D11_FILL_SOLID;
+    descRast.CullMode = D3D11_CULL_NONE;
+    descRast.DepthBias = 0;
+    descRast.DepthBiasClamp = 0.0f;
+    descRast.FrontCounterClockwise = false;
+    descRast.DepthClipEnable = true;
+    descRast.ScissorEnable = false;
+    descRast.MultisampleEnable = false;
+    descRast.SlopeScaledDepthBias = 0.0f;
+
+    hr = device->CreateRasterizerState(&descRast, &g_pRasterizerState);
+    if (FAILED(hr))
+        return hr;
+
+    hr = initClusterBuffers(device);
+    if (FAILED(hr))
+        return hr;
+
+    resize(screenWidth, screenHeight);
+
+    return hr;
+}
+
+// The lights, the cluster ranges and the index list are rewritten every frame, each at its
+// largest size; a frame only uploads the part it uses.
+HRESULT Light::initClusterBuffers(ID3D11Device* device) {
+    ID3D11Buffer** buffers[] = { &g_pClusterLights, &g_pClusterRanges, &g_pClusterIndices };
+    ID3D11ShaderResourceView** views[] = { &g_pClusterLightsSRV, &g_pClusterRangesSRV, &g_pClusterIndicesSRV };
+    UINT strides[] = { sizeof(ClusterLight), sizeof(ClusterRange), sizeof(UINT) };
+    UINT counts[] = { MAX_CLUSTER_LIGHTS, CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES, MAX_CLUSTER_INDICES };
+
+    for (int i = 0; i < 3; i++) {
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = strides[i] * counts[i];
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        desc.StructureByteStride = strides[i];
+
+        HRESULT hr = device->CreateBuffer(&desc, nullptr, buffers[i]);
+        if (FAILED(hr))
+            return hr;
+        hr = device->CreateShaderResourceView(*buffers[i], nullptr, views[i]);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    return S_OK;
+}
+
+void Light::realize() {
+    if (g_pRasterizerState) g_pRasterizerState->Release();
+    if (g_pGeomBuffer) g_pGeomBuffer->Release();
+    if (g_pClusterLightsSRV) g_pClusterLightsSRV->Release();
+    if (g_pClusterRangesSRV) g_pClusterRangesSRV->Release();
+    if (g_pClusterIndicesSRV) g_pClusterIndicesSRV->Release();
+    if (g_pClusterLights) g_pClusterLights->Release();
+    if (g_pClusterRanges) g_pClusterRanges->Release();
+    if (g_pClusterIndices) g_pClusterIndices->Release();
+    if (g_pIndexBuffer) g_pIndexBuffer->Release();
+    if (g_pVertexBuffer) g_pVertexBuffer->Release();
+    if (g_pInstanceBuffer) g_pInstanceBuffer->Release();
+    if (g_pVertexLayout) g_pVertexLayout->Release();
+    if (g_pVertexShader) g_pVertexShader->Release();
+    if (g_pPixelShader) g_pPixelShader->Release();
+}
+
+// One packet per used LOD level, the level is the material.
+void Light::submit(RenderQueue& queue, uint32_t object) const {
+    for (size_t level = 0; level < lodRanges.size(); level++) {
+        if (lodRanges[level].instanceCount > 0)
+            queue.submit(makeOpaqueKey(RENDER_PASS_OPAQUE, object, (uint32_t)level, 0.0f), object, (uint32_t)level);
+    }
+}
+
+void Light::bind(CommandList& commands) {
+    commands.setRasterizerState(g_pRasterizerState);
+
+    commands.setIndexBuffer(g_pIndexBuffer, indexFormat, 0);
+
+    ID3D11Buffer* vertexBuffers[] = { g_pVertexBuffer, g_pInstanceBuffer };
+    UINT strides[] = { 12, sizeof(UINT) };
+    UINT offsets[] = { 0, 0 };
+
+    commands.setVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+    commands.setInputLayout(g_pVertexLayout);
+    commands.setPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    commands.setShader(SHADER_STAGE_VERTEX, g_pVertexShader);
+    commands.setConstantBlocks(SHADER_STAGE_VERTEX, 0, 1, &worldBlock);
+    commands.setShader(SHADER_STAGE_PIXEL, g_pPixelShader);
+    commands.setConstantBlocks(SHADER_STAGE_PIXEL, 0, 1, &worldBlock);
+}
+
+void Light::draw(CommandList& commands, uint32_t item) {
+    const LodRange& range = lodRanges[item];
+    commands.drawIndexedInstanced(range.indexCount, range.instanceCount, range.firstIndex, range.baseVertex, range.firstInstance);
+}
+
+// The world matrices are grouped by LOD level, finest first, one draw per level.
+bool Light::frame(CommandList& commands, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos) {
+    XMFLOAT4X4 projection;
+    XMStoreFloat4x4(&projection, projectionMatrix);
+    float pixelsPerUnit = 0.5f * screenHeight * projection._22;
+    lodSelector.select(reinterpret_cast<const float*>(positions.data()), sizeof(XMFLOAT4), positions.size(), 1.0f, radius, &cameraPos.x, pixelsPerUnit, lodLevels);
+
+    UINT slot[MAX_LIGHT_LODS + 1] = {};
+    for (auto& range : lodRanges)
+        range.instanceCount = 0;
+    for (uint8_t level : lodLevels)
+        lodRanges[level].instanceCount++;
+    for (size_t level = 0; level < lodRanges.size(); level++) {
+        lodRanges[level].firstInstance = slot[level];
+        slot[level + 1] = slot[level] + lodRanges[level].instanceCount;
+    }
+
+    WorldMatrixBuffer* lightGeomBuffer = reinterpret_cast<WorldMatrixBuffer*>(commands.writeConstants(worldBlock, sizeof(WorldMatrixBuffer) * MAX_LIGHTS));
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        WorldMatrixBuffer& lightGeom = lightGeomBuffer[slot[lodLevels[i]]++];
+        lightGeom.worldMatrix = DirectX::XMMatrixScaling(radius, radius, radius)
+            * XMMatrixTranslation(positions[i].x, positions[i].y, positions[i].z);
+        lightGeom.color = colors[i];
+    }
+
+    return S_OK;
+}
+
+// The light spheres are binned into the view clusters once per frame, before anything is drawn;
+// the pixel shaders find the lights of their cluster in t8-t10 (CalculateColor.hlsli).
+void Light::assignClusters(CommandList& commands, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, const std::vector<int>& visibleLights) {
+    XMFLOAT4X4 view, projection;
+    XMStoreFloat4x4(&view, viewMatrix);
+    XMStoreFloat4x4(&projection, projectionMatrix);
+
+    // Depth is 0 at one clip plane and 1 at the other, whichever way round the projection is.
+    float depth0 = -projection._43 / projection._33;
+    float depth1 = projection._43 / (1.0f - projection._33);
+    clusters.setGrid(CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES, 1.0f / projection._11, 1.0f / projection._22,
+        CLUSTER_NEAR, (std::max)(depth0, depth1));
+    clusterSpheres.clear();
+    clusterLightIds.clear();
+    for (int light : visibleLights) {
+        clusterSpheres.push_back(spheres[light]);
+        clusterLightIds.push_back(uint32_t(light));
+    }
+    clusters.assign(reinterpret_cast<const float*>(clusterSpheres.data()), sizeof(XMFLOAT4), clusterSpheres.size(), &view._11, MAX_CLUSTER_INDICES);
+
+    // Without lights the empty ranges below are all the shaders read, nothing is indexed.
+    if (!spheres.empty()) {
+        ClusterLight* lightData = reinterpret_cast<ClusterLight*>(commands.writeBuffer(g_pClusterLights, UINT(sizeof(ClusterLight) * spheres.size())));
+        for (size_t i = 0; i < spheres.size(); i++) {
+            lightData[i].positionRange = spheres[i];
+            lightData[i].color = colors[i];
+        }
+    }
+
+    const std::vector<ClusterRange>& ranges = clusters.getRanges();
+    memcpy(commands.writeBuffer(g_pClusterRanges, UINT(sizeof(ClusterRange) * ranges.size())), ranges.data(), sizeof(ClusterRange) * ranges.size());
+    // The clusters count the visible lights, the shaders index all of them.
+    const std::vector<uint32_t>& indices = clusters.getIndices();
+    if (!indices.empty()) {
+        uint32_t* indexData = reinterpret_cast<uint32_t*>(commands.writeBuffer(g_pClusterIndices, UINT(sizeof(uint32_t) * indices.size())));
+        for (size_t i = 0; i < indices.size(); i++)
+            indexData[i] = clusterLightIds[indices[i]];
+    }
+
+    ID3D11ShaderResourceView* views[] = { g_pClusterLightsSRV, g_pClusterRangesSRV, g_pClusterIndicesSRV };
+    commands.setShaderResources(SHADER_STAGE_PIXEL, 8, 3, views);
+}
+
+void Light::writeClusterConstants(SceneCB& sceneBuffer) const {
+    sceneBuffer.clusterGrid = XMINT4(int(clusters.getTilesX()), int(clusters.getTilesY()), int(clusters.getSlices()), 0);
+    sceneBuffer.clusterScale = XMFLOAT4(float(clusters.getTilesX()) / screenWidth, float(clusters.getTilesY()) / screenHeight,
+        clusters.getSliceScale(), clusters.getSliceBias());
+}
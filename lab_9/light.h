@@ -1,43 +1,83 @@
-#pragma once
-
-#include <d3dcompiler.h>
-#include <dxgi.h>
-#include <d3d11.h>
-#include <directxmath.h>
-#include <vector>
-
-#include "structures.h"
-
-using namespace DirectX;
-
-class Light {
-public:
-	HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight,
-		const std::vector<XMFLOAT4>& colors, const std::vector<XMFLOAT4>& positions);
-	void realize();
-	void resize(int screenWidth, int screenHeight) {};
-	void render(ID3D11DeviceContext* context);
-	bool frame(ID3D11DeviceContext* context, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos);
-	const std::vector<XMFLOAT4>& getColors() const { return colors; };
-	const std::vector<XMFLOAT4>& getPositions() const { return positions; };
-private:
-	void generateSphere(UINT LatLines, UINT LongLines, std::vector<SimpleVertex>& vertices, std::vector<UINT>& indices);
-
-	ID3D11Buffer* g_pVertexBuffer = nullptr;
-	ID3D11Buffer* g_pIndexBuffer = nullptr;
-	ID3D11Buffer* g_pWorldMatrixBuffer = nullptr;
-	ID3D11Buffer* g_pSceneMatrixBuffer = nullptr;
-	ID3D11Buffer* g_pGeomBuffer = nullptr;
-	ID3D11RasterizerState* g_pRasterizerState = nullptr;
-
-	ID3D11InputLayout* g_pVertexLayout = nullptr;
-	ID3D11VertexShader* g_pVertexShader = nullptr;
-	ID3D11PixelShader* g_pPixelShader = nullptr;
-
-	UINT numSphereVertices = 0;
-	UINT numSphereFaces = 0;
-	float radius = 0.1f;
-
-	std::vector<XMFLOAT4> colors;
-	std::vector<XMFLOAT4> positions;
-};
+#pragma once
+
+#include <d3dcompiler.h>
+#include <dxgi.h>
+#include <d3d11.h>
+#include <directxmath.h>
+#include <vector>
+
+#include "structures.h"
+#include "meshLod.h"
+#include "lightClusters.h"
+#include "renderQueue.h"
+#include "commandList.h"
+
+using namespace DirectX;
+
+class Light {
+public:
+	HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight,
+		const std::vector<XMFLOAT4>& colors, const std::vector<XMFLOAT4>& positions);
+	void realize();
+	void resize(int screenWidth, int screenHeight) { this->screenWidth = screenWidth; this->screenHeight = screenHeight; };
+	void submit(RenderQueue& queue, uint32_t object) const;
+	void bind(CommandList& commands);
+	void draw(CommandList& commands, uint32_t item);
+	bool frame(CommandList& commands, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos);
+	// Bins the lights of `visibleLights` (indices into getSpheres) into the clusters; the
+	// buffer of all the lights is uploaded as well, the clusters index it.
+	void assignClusters(CommandList& commands, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, const std::vector<int>& visibleLights);
+	void writeClusterConstants(SceneCB& sceneBuffer) const;
+	const std::vector<XMFLOAT4>& getColors() const { return colors; };
+	const std::vector<XMFLOAT4>& getPositions() const { return positions; };
+	// Positions with the influence radius in w.
+	const std::vector<XMFLOAT4>& getSpheres() const { return spheres; };
+	float getRadius() const { return radius; };
+	const LodStats& getLodStats() const { return lodSelector.getStats(); };
+	const ClusterStats& getClusterStats() const { return clusters.getStats(); };
+private:
+	HRESULT initClusterBuffers(ID3D11Device* device);
+
+	// Index range of a LOD level and how many lights use it this frame.
+	struct LodRange {
+		UINT firstIndex;
+		UINT indexCount;
+		INT baseVertex;
+		UINT firstInstance;
+		UINT instanceCount;
+	};
+
+	ID3D11Buffer* g_pVertexBuffer = nullptr;
+	ID3D11Buffer* g_pIndexBuffer = nullptr;
+	ID3D11Buffer* g_pInstanceBuffer = nullptr;
+	ID3D11Buffer* g_pGeomBuffer = nullptr;
+	ID3D11Buffer* g_pClusterLights = nullptr;
+	ID3D11Buffer* g_pClusterRanges = nullptr;
+	ID3D11Buffer* g_pClusterIndices = nullptr;
+	ID3D11ShaderResourceView* g_pClusterLightsSRV = nullptr;
+	ID3D11ShaderResourceView* g_pClusterRangesSRV = nullptr;
+	ID3D11ShaderResourceView* g_pClusterIndicesSRV = nullptr;
+	ID3D11RasterizerState* g_pRasterizerState = nullptr;
+
+	ID3D11InputLayout* g_pVertexLayout = nullptr;
+	ID3D11VertexShader* g_pVertexShader = nullptr;
+	ID3D11PixelShader* g_pPixelShader = nullptr;
+
+	uint32_t worldBlock = newConstantBlock();
+
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT;
+	std::vector<LodRange> lodRanges;
+	LodSelector lodSelector;
+	std::vector<uint8_t> lodLevels;
+	float radius = 0.1f;
+	int screenWidth = 1;
+	int screenHeight = 1;
+
+	// Set once by init and never animated, the static cubes have these lights baked.
+	std::vector<XMFLOAT4> colors;
+	std::vector<XMFLOAT4> positions;
+	std::vector<XMFLOAT4> spheres; // position and influence radius
+	LightClusters clusters;
+	std::vector<XMFLOAT4> clusterSpheres; // of the visible lights
+	std::vector<uint32_t> clusterLightIds; // light index of every clusterSpheres entry
+};
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "lightBaker.h"
+#include "environmentLighting.h"
+#include "jobSystem.h"
+
+static const float PI = 3.14159265358979f;
+
+// Bumped whenever the baking or the file layout changes, so old assets are baked again.
+static const uint32_t BAKE_MAGIC = 0x454B4142; // "BAKE"
+static const uint32_t BAKE_VERSION = 1;
+
+struct BakeHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint64_t count;
+};
+
+static float getRadicalInverse(uint32_t bits) {
+    bits = (bits << 16) | (bits >> 16);
+    bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+    bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+    bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+    bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+    return float(bits) * 2.3283064365386963e-10f;
+}
+
+// Any two unit vectors t, b that make a right-handed frame with n.
+static void getTangentFrame(const float n[3], float t[3], float b[3]) {
+    float up[3] = { 0.0f, 0.0f, 1.0f };
+    if (fabsf(n[2]) > 0.999f) {
+        up[0] = 1.0f;
+        up[2] = 0.0f;
+    }
+    t[0] = up[1] * n[2] - up[2] * n[1];
+    t[1] = up[2] * n[0] - up[0] * n[2];
+    t[2] = up[0] * n[1] - up[1] * n[0];
+    float invLength = 1.0f / sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+    for (int a = 0; a < 3; a++)
+        t[a] *= invLength;
+    b[0] = n[1] * t[2] - n[2] * t[1];
+    b[1] = n[2] * t[0] - n[0] * t[2];
+    b[2] = n[0] * t[1] - n[1] * t[0];
+}
+
+void LightBaker::setInstances(const float* matrices, size_t stride, size_t count, const float localMin[3], const float localMax[3]) {
+    world.resize(count * 12);
+    inverse.resize(count * 12);
+    for (int a = 0; a < 3; a++) {
+        boxMin[a] = localMin[a];
+        boxMax[a] = localMax[a];
+    }
+    for (size_t i = 0; i < count; i++) {
+        const float* m = reinterpret_cast<const float*>(reinterpret_cast<const char*>(matrices) + i * stride);
+        float* w = &world[i * 12];
+        for (int r = 0; r < 4; r++)
+            for (int c = 0; c < 3; c++)
+                w[r * 3 + c] = m[r * 4 + c];
+
+        // Inverse of the upper 3x3 by cofactors; the translation is subtracted first.
+        float* inv = &inverse[i * 12];
+        inv[0] = w[4] * w[8] - w[5] * w[7];
+        inv[1] = w[2] * w[7] - w[1] * w[8];
+        inv[2] = w[1] * w[5] - w[2] * w[4];
+        inv[3] = w[5] * w[6] - w[3] * w[8];
+        inv[4] = w[0] * w[8] - w[2] * w[6];
+        inv[5] = w[2] * w[3] - w[0] * w[5];
+        inv[6] = w[3] * w[7] - w[4] * w[6];
+        inv[7] = w[1] * w[6] - w[0] * w[7];
+        inv[8] = w[0] * w[4] - w[1] * w[3];
+        float det = w[0] * inv[0] + w[1] * inv[3] + w[2] * inv[6];
+        float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+        for (int k = 0; k < 9; k++)
+            inv[k] *= invDet;
+        inv[9] = w[9];
+        inv[10] = w[10];
+        inv[11] = w[11];
+    }
+
+    bounds.resize(count);
+    if (count > 0)
+        bounds.transform(matrices, stride, count, localMin, localMax);
+    bvh.build(bounds);
+}
+
+void LightBaker::setLights(const float* spheres, size_t stride, const float* colors, size_t colorStride, size_t count) {
+    lightSpheres.resize(count * 4);
+    lightColors.resize(count * 3);
+    for (size_t i = 0; i < count; i++) {
+        const float* sphere = reinterpret_cast<const float*>(reinterpret_cast<const char*>(spheres) + i * stride);
+        const float* color = reinterpret_cast<const float*>(reinterpret_cast<const char*>(colors) + i * colorStride);
+        memcpy(&lightSpheres[i * 4], sphere, sizeof(float) * 4);
+        memcpy(&lightColors[i * 3], color, sizeof(float) * 3);
+    }
+}
+
+// Slab test of the segment against the box in the local space of the instance; the
+// parameter t is the same in both spaces.
+bool LightBaker::isOccluded(const float origin[3], const float dir[3], float tMax, int skip) const {
+    return bvh.intersectSegment(origin, dir, tMax, [&](int i) {
+        if (i == skip)
+            return false;
+        const float* inv = &inverse[size_t(i) * 12];
+        float o[3] = { origin[0] - inv[9], origin[1] - inv[10], origin[2] - inv[11] };
+        float tNear = 0.0f, tFar = tMax;
+        for (int a = 0; a < 3; a++) {
+            float localOrigin = o[0] * inv[a] + o[1] * inv[3 + a] + o[2] * inv[6 + a];
+            float localDir = dir[0] * inv[a] + dir[1] * inv[3 + a] + dir[2] * inv[6 + a];
+            float invDir = 1.0f / localDir;
+            float t0 = (boxMin[a] - localOrigin) * invDir;
+            float t1 = (boxMax[a] - localOrigin) * invDir;
+            tNear = (std::max)(tNear, (std::min)(t0, t1));
+            tFar = (std::min)(tFar, (std::max)(t0, t1));
+        }
+        return tNear <= tFar;
+    });
+}
+
+// The sky rays are cosine-distributed, so the open fraction is the cosine-weighted
+// visibility the diffuse sky light needs. The pattern is turned by a different angle at
+// every vertex to trade banding for noise.
+void LightBaker::bakeVertex(size_t instance, const float* position, const float* normal, uint32_t sampleOffset,
+        const BakeSettings& settings, BakedVertex& baked) const {
+    const float* w = &world[instance * 12];
+    const float* inv = &inverse[instance * 12];
+    float p[3], n[3];
+    for (int a = 0; a < 3; a++) {
+        p[a] = position[0] * w[a] + position[1] * w[3 + a] + position[2] * w[6 + a] + w[9 + a];
+        // normals go through the inverse transpose
+        n[a] = inv[a * 3] * normal[0] + inv[a * 3 + 1] * normal[1] + inv[a * 3 + 2] * normal[2];
+    }
+    float invLength = 1.0f / sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float origin[3];
+    for (int a = 0; a < 3; a++) {
+        n[a] *= invLength;
+        origin[a] = p[a] + n[a] * settings.surfaceOffset;
+    }
+    float t[3], b[3];
+    getTangentFrame(n, t, b);
+    int skip = int(instance);
+
+    float rotation = float(sampleOffset) * 0.618034f;
+    rotation -= floorf(rotation);
+    uint32_t open = 0;
+    for (uint32_t k = 0; k < settings.occlusionRays; k++) {
+        float u = (k + 0.5f) / settings.occlusionRays;
+        float v = getRadicalInverse(k) + rotation;
+        float r = sqrtf(u), phi = 2.0f * PI * v;
+        float x = r * cosf(phi), y = r * sinf(phi), z = sqrtf(1.0f - u);
+        float dir[3] = { t[0] * x + b[0] * y + n[0] * z, t[1] * x + b[1] * y + n[1] * z, t[2] * x + b[2] * y + n[2] * z };
+        if (!isOccluded(origin, dir, settings.occlusionDistance, skip))
+            open++;
+    }
+    baked.skyVisibility = settings.occlusionRays > 0 ? float(open) / settings.occlusionRays : 1.0f;
+
+    // Same falloff as ShadeLight, times the part of the light's sphere the vertex sees.
+    baked.light[0] = baked.light[1] = baked.light[2] = 0.0f;
+    size_t lightsCount = lightColors.size() / 3;
+    for (size_t j = 0; j < lightsCount; j++) {
+        const float* sphere = &lightSpheres[j * 4];
+        float d[3] = { sphere[0] - p[0], sphere[1] - p[1], sphere[2] - p[2] };
+        float dist = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        if (!(dist < sphere[3]) || dist <= 0.0f)
+            continue;
+        float cosine = (n[0] * d[0] + n[1] * d[1] + n[2] * d[2]) / dist;
+        if (cosine <= 0.0f)
+            continue;
+        float falloff = dist / sphere[3];
+        float window = (std::max)(1.0f - falloff * falloff * falloff * falloff, 0.0f);
+        window *= window;
+        float atten = (std::min)(1.0f / (dist * dist), 1.0f) * window;
+
+        uint32_t visible = 0;
+        uint32_t shadowRays = (std::max)(settings.shadowRays, 1u);
+        for (uint32_t k = 0; k < shadowRays; k++) {
+            // Fibonacci points on the light's sphere
+            float z = 1.0f - (2.0f * k + 1.0f) / shadowRays;
+            float r = sqrtf((std::max)(1.0f - z * z, 0.0f));
+            float phi = 2.399963f * k;
+            float target[3] = {
+                sphere[0] + settings.lightSize * r * cosf(phi),
+                sphere[1] + settings.lightSize * r * sinf(phi),
+                sphere[2] + settings.lightSize * z,
+            };
+            float dir[3] = { target[0] - origin[0], target[1] - origin[1], target[2] - origin[2] };
+            float length = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+            if (length <= 0.0f || n[0] * dir[0] + n[1] * dir[1] + n[2] * dir[2] <= 0.0f)
+                continue;
+            for (int a = 0; a < 3; a++)
+                dir[a] /= length;
+            if (!isOccluded(origin, dir, length, skip))
+                visible++;
+        }
+
+        float scale = cosine * atten * float(visible) / shadowRays;
+        for (int c = 0; c < 3; c++)
+            baked.light[c] += lightColors[j * 3 + c] * scale;
+    }
+}
+
+void LightBaker::bake(const float* positions, const float* normals, size_t vertexStride, size_t vertexCount,
+        const BakeSettings& settings, std::vector<BakedVertex>& baked) {
+    auto start = std::chrono::steady_clock::now();
+    size_t instances = world.size() / 12;
+    size_t count = instances * vertexCount;
+    baked.resize(count);
+
+    std::atomic<size_t> rays(0);
+    size_t lightsCount = lightColors.size() / 3;
+    JobSystem::GetInstance().parallelFor(count, 16, [&](size_t begin, size_t end) {
+        size_t chunkRays = 0;
+        for (size_t v = begin; v < end; v++) {
+            size_t instance = v / vertexCount, vertex = v % vertexCount;
+            const float* position = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * vertexStride);
+            const float* normal = reinterpret_cast<const float*>(reinterpret_cast<const char*>(normals) + vertex * vertexStride);
+            bakeVertex(instance, position, normal, uint32_t(v), settings, baked[v]);
+            chunkRays += settings.occlusionRays + lightsCount * settings.shadowRays;
+        }
+        rays += chunkRays;
+    });
+
+    stats.instances = instances;
+    stats.vertices = count;
+    stats.rays = rays;
+    stats.cached = false;
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool LightBaker::bakeCached(const std::string& path, const float* positions, const float* normals, size_t vertexStride, size_t vertexCount,
+        const BakeSettings& settings, std::vector<BakedVertex>& baked) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = world.size() / 12 * vertexCount;
+
+    uint64_t hash = hashContent(&BAKE_VERSION, sizeof(BAKE_VERSION));
+    hash = hashContent(world.data(), world.size() * sizeof(float), hash);
+    hash = hashContent(boxMin, sizeof(boxMin), hash);
+    hash = hashContent(boxMax, sizeof(boxMax), hash);
+    hash = hashContent(lightSpheres.data(), lightSpheres.size() * sizeof(float), hash);
+    hash = hashContent(lightColors.data(), lightColors.size() * sizeof(float), hash);
+    for (size_t v = 0; v < vertexCount; v++) {
+        hash = hashContent(reinterpret_cast<const char*>(positions) + v * vertexStride, sizeof(float) * 3, hash);
+        hash = hashContent(reinterpret_cast<const char*>(normals) + v * vertexStride, sizeof(float) * 3, hash);
+    }
+    float key[5] = { float(settings.occlusionRays), settings.occlusionDistance, float(settings.shadowRays), settings.lightSize, settings.surfaceOffset };
+    hash = hashContent(key, sizeof(key), hash);
+
+    std::ifstream input(path, std::ios::binary);
+    BakeHeader header;
+    if (input && input.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+            header.magic == BAKE_MAGIC && header.version == BAKE_VERSION && header.hash == hash && header.count == count) {
+        baked.resize(count);
+        if (input.read(reinterpret_cast<char*>(baked.data()), std::streamsize(count * sizeof(BakedVertex)))) {
+            stats.instances = world.size() / 12;
+            stats.vertices = count;
+            stats.rays = 0;
+            stats.cached = true;
+            stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return true;
+        }
+    }
+    input.close();
+
+    bake(positions, normals, vertexStride, vertexCount, settings, baked);
+
+    header = { BAKE_MAGIC, BAKE_VERSION, hash, count };
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(baked.data()), std::streamsize(count * sizeof(BakedVertex)));
+    return bool(output);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "instanceBounds.h"
+#include "instanceBvh.h"
+
+struct BakeSettings {
+	uint32_t occlusionRays = 64;  // cosine-distributed over the hemisphere of a vertex
+	float occlusionDistance = 1.0f; // farther occluders do not darken the sky light
+	uint32_t shadowRays = 16;     // per light, aimed at points of the light's sphere
+	float lightSize = 0.1f;       // radius of that sphere
+	float surfaceOffset = 1e-3f;  // rays start this far off the surface along the normal
+};
+
+struct BakeStats {
+	size_t instances = 0;
+	size_t vertices = 0;
+	size_t rays = 0;
+	bool cached = false; // read back from the asset instead of baked
+	double milliseconds = 0.0;
+};
+
+// What a static vertex receives: the diffuse light of the baked lights for a white surface,
+// summed the way CalculateColor does it but with shadows, and the part of the sky it sees.
+struct BakedVertex {
+	float light[3];
+	float skyVisibility;
+};
+
+// Offline lighting of static instances. The instances are boxes placed by world matrices;
+// they are both what gets baked and what casts shadows, found with an InstanceBVH over
+// their bounds and then tested exactly in the local space of each box. Every vertex of the
+// mesh of every instance is baked on the job system, with fixed sample patterns so the
+// result is the same on every run and thread count.
+class LightBaker {
+public:
+	// Row-major world matrices with the row-vector convention (as XMMATRIX) of `count` copies
+	// of the local box [localMin, localMax], read `stride` bytes apart.
+	void setInstances(const float* matrices, size_t stride, size_t count, const float localMin[3], const float localMax[3]);
+	// Spheres are read `stride` bytes apart as x, y, z, influence radius, colors as rgb.
+	void setLights(const float* spheres, size_t stride, const float* colors, size_t colorStride, size_t count);
+
+	// Bakes the `vertexCount` vertices of the mesh (positions and normals in the local space
+	// of the box, read `vertexStride` bytes apart) for every instance; the vertices of
+	// instance i start at i * vertexCount.
+	void bake(const float* positions, const float* normals, size_t vertexStride, size_t vertexCount,
+		const BakeSettings& settings, std::vector<BakedVertex>& baked);
+	// Same, but reads the asset at `path` back when it was baked from the same instances,
+	// lights, mesh and settings, and writes it otherwise.
+	bool bakeCached(const std::string& path, const float* positions, const float* normals, size_t vertexStride, size_t vertexCount,
+		const BakeSettings& settings, std::vector<BakedVertex>& baked);
+
+	// True when an instance other than `skip` crosses origin + t * dir, 0 <= t <= tMax.
+	bool isOccluded(const float origin[3], const float dir[3], float tMax, int skip) const;
+
+	const BakeStats& getStats() const { return stats; };
+
+private:
+	void bakeVertex(size_t instance, const float* position, const float* normal, uint32_t sampleOffset,
+		const BakeSettings& settings, BakedVertex& baked) const;
+
+	// Per instance: the world matrix (3x4, rows x, y, z, translation) and its inverse.
+	std::vector<float> world;
+	std::vector<float> inverse;
+	float boxMin[3] = {};
+	float boxMax[3] = {};
+	InstanceBounds bounds;
+	InstanceBVH bvh;
+
+	std::vector<float> lightSpheres; // x, y, z, influence radius
+	std::vector<float> lightColors;  // r, g, b
+	BakeStats stats;
+};
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "lightClusters.h"
+#include "jobSystem.h"
+#include "simd.h"
+
+// Lights reaching closer than this are bounded on screen as if they stopped here.
+static const float MIN_DEPTH = 1e-4f;
+
+float getInfluenceRadius(float intensity, float threshold) {
+    return intensity > 0.0f ? sqrtf(intensity / threshold) : 0.0f;
+}
+
+static inline uint16_t clampTile(float tile, uint32_t count) {
+    if (tile < 0.0f)
+        return 0;
+    if (tile >= float(count))
+        return uint16_t(count - 1);
+    return uint16_t(tile);
+}
+
+static inline uint32_t countBits(uint32_t mask) {
+    mask = mask - ((mask >> 1) & 0x55555555u);
+    mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+    return (((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+}
+
+// Distance along one axis from c to the range [lo, hi], zero inside it.
+static inline float axisDistance(float c, float lo, float hi) {
+    return (std::max)((std::max)(lo - c, c - hi), 0.0f);
+}
+
+void LightClusters::setGrid(uint32_t tilesX, uint32_t tilesY, uint32_t slices, float tanHalfFovX, float tanHalfFovY, float nearZ, float farZ) {
+    this->tilesX = tilesX;
+    this->tilesY = tilesY;
+    this->slices = slices;
+    tanX = tanHalfFovX;
+    tanY = tanHalfFovY;
+    this->nearZ = nearZ;
+    this->farZ = farZ;
+    sliceScale = float(slices) / logf(farZ / nearZ);
+    sliceBias = -logf(nearZ) * sliceScale;
+
+    minZ.resize(slices);
+    maxZ.resize(slices);
+    for (uint32_t k = 0; k < slices; k++) {
+        minZ[k] = k == 0 ? 0.0f : nearZ * powf(farZ / nearZ, float(k) / float(slices));
+        maxZ[k] = nearZ * powf(farZ / nearZ, float(k + 1) / float(slices));
+    }
+
+    // A tile is a pyramid: its box spans the tile's side planes at both ends of the slice.
+    minX.resize(size_t(slices) * tilesX);
+    maxX.resize(size_t(slices) * tilesX);
+    for (uint32_t k = 0; k < slices; k++) {
+        for (uint32_t i = 0; i < tilesX; i++) {
+            float left = (2.0f * i / tilesX - 1.0f) * tanX;
+            float right = (2.0f * (i + 1) / tilesX - 1.0f) * tanX;
+            minX[k * tilesX + i] = (std::min)(left * minZ[k], left * maxZ[k]);
+            maxX[k * tilesX + i] = (std::max)(right * minZ[k], right * maxZ[k]);
+        }
+    }
+
+    minY.resize(size_t(slices) * tilesY);
+    maxY.resize(size_t(slices) * tilesY);
+    for (uint32_t k = 0; k < slices; k++) {
+        for (uint32_t j = 0; j < tilesY; j++) {
+            float top = (1.0f - 2.0f * j / tilesY) * tanY;
+            float bottom = (1.0f - 2.0f * (j + 1) / tilesY) * tanY;
+            minY[k * tilesY + j] = (std::min)(bottom * minZ[k], bottom * maxZ[k]);
+            maxY[k * tilesY + j] = (std::max)(top * minZ[k], top * maxZ[k]);
+        }
+    }
+}
+
+int LightClusters::getSlice(float z) const {
+    if (z <= nearZ)
+        return 0;
+    int slice = int(floorf(logf(z) * sliceScale + sliceBias));
+    return (std::min)((std::max)(slice, 0), int(slices) - 1);
+}
+
+// The sphere lies in the box [c - r, c + r] cut to the grid depths, and x / z over such a box
+// is extreme at its corners, so the slopes at the two ends bound the tiles it can touch.
+void LightClusters::boundLights(const float* spheres, size_t stride, const float view[16], size_t begin, size_t end) {
+    for (size_t l = begin; l < end; l++) {
+        const float* sphere = reinterpret_cast<const float*>(reinterpret_cast<const char*>(spheres) + l * stride);
+        float x = sphere[0], y = sphere[1], z = sphere[2], r = sphere[3];
+        float cx = x * view[0] + y * view[4] + z * view[8] + view[12];
+        float cy = x * view[1] + y * view[5] + z * view[9] + view[13];
+        float cz = x * view[2] + y * view[6] + z * view[10] + view[14];
+        lightX[l] = cx;
+        lightY[l] = cy;
+        lightZ[l] = cz;
+        lightR[l] = r;
+
+        LightRect& rect = rects[l];
+        rect = { 1, 0, 1, 0, 1, 0 };
+        if (r <= 0.0f || cz + r <= MIN_DEPTH || cz - r >= farZ)
+            continue;
+
+        float z0 = (std::max)(cz - r, MIN_DEPTH);
+        float z1 = (std::min)(cz + r, farZ);
+        float invZ0 = 1.0f / z0, invZ1 = 1.0f / z1;
+        float left = (std::min)((cx - r) * invZ0, (cx - r) * invZ1);
+        float right = (std::max)((cx + r) * invZ0, (cx + r) * invZ1);
+        float bottom = (std::min)((cy - r) * invZ0, (cy - r) * invZ1);
+        float top = (std::max)((cy + r) * invZ0, (cy + r) * invZ1);
+        if (right < -tanX || left > tanX || top < -tanY || bottom > tanY)
+            continue;
+
+        rect.x0 = clampTile((left / tanX + 1.0f) * 0.5f * tilesX, tilesX);
+        rect.x1 = clampTile((right / tanX + 1.0f) * 0.5f * tilesX, tilesX);
+        rect.y0 = clampTile((1.0f - top / tanY) * 0.5f * tilesY, tilesY);
+        rect.y1 = clampTile((1.0f - bottom / tanY) * 0.5f * tilesY, tilesY);
+        rect.z0 = uint16_t(getSlice(z0));
+        rect.z1 = uint16_t(getSlice(z1));
+    }
+}
+
+// Candidates are in light order, so every cluster lists its lights in ascending order. In a row
+// of the slice the y and z distances are fixed and only the x distance is left to test.
+void LightClusters::binSlice(uint32_t k) {
+    SliceBins& bin = bins[k];
+    size_t pairs = 0;
+
+    uint32_t sliceClusters = tilesX * tilesY;
+    uint32_t* sliceCounts = &counts[size_t(k) * sliceClusters];
+    memset(sliceCounts, 0, sizeof(uint32_t) * sliceClusters);
+    const float* sliceMinX = &minX[size_t(k) * tilesX];
+    const float* sliceMaxX = &maxX[size_t(k) * tilesX];
+    const float* sliceMinY = &minY[size_t(k) * tilesY];
+    const float* sliceMaxY = &maxY[size_t(k) * tilesY];
+
+    for (uint32_t l : bin.candidates) {
+        const LightRect& rect = rects[l];
+        float cx = lightX[l], cy = lightY[l];
+        float dz = axisDistance(lightZ[l], minZ[k], maxZ[k]);
+        float rest = lightR[l] * lightR[l] - dz * dz;
+        if (rest < 0.0f)
+            continue;
+
+        for (uint32_t j = rect.y0; j <= rect.y1; j++) {
+            float dy = axisDistance(cy, sliceMinY[j], sliceMaxY[j]);
+            float limit = rest - dy * dy;
+            if (limit < 0.0f)
+                continue;
+
+            if (bin.clusters.size() < pairs + tilesX) {
+                bin.clusters.resize((std::max)(bin.clusters.size() * 2, pairs + tilesX));
+                bin.lights.resize(bin.clusters.size());
+            }
+
+            // Column sides grow with i, so the sphere touches one run of columns: those past the
+            // ones whose right side is left of cx - s, up to the last whose left side is not
+            // right of cx + s. Both are counted over the row instead of testing every box.
+            float reach = sqrtf(limit);
+            float leftEdge = cx - reach, rightEdge = cx + reach;
+            uint32_t before = 0, upTo = 0;
+            uint32_t i = rect.x0;
+#if defined(SIMD_AVX)
+            __m256 leftEdge8 = _mm256_set1_ps(leftEdge);
+            __m256 rightEdge8 = _mm256_set1_ps(rightEdge);
+            for (; i + 8 <= uint32_t(rect.x1) + 1; i += 8) {
+                before += countBits(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(sliceMaxX + i), leftEdge8, _CMP_LT_OQ)));
+                upTo += countBits(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(sliceMinX + i), rightEdge8, _CMP_LE_OQ)));
+            }
+#endif
+#if defined(SIMD_SSE)
+            __m128 leftEdge4 = _mm_set1_ps(leftEdge);
+            __m128 rightEdge4 = _mm_set1_ps(rightEdge);
+            for (; i + 4 <= uint32_t(rect.x1) + 1; i += 4) {
+                before += countBits(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(sliceMaxX + i), leftEdge4)));
+                upTo += countBits(_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(sliceMinX + i), rightEdge4)));
+            }
+#endif
+            for (; i <= rect.x1; i++) {
+                before += sliceMaxX[i] < leftEdge ? 1 : 0;
+                upTo += sliceMinX[i] <= rightEdge ? 1 : 0;
+            }
+
+            uint32_t row = j * tilesX;
+            for (uint32_t column = rect.x0 + before; column < rect.x0 + upTo; column++) {
+                bin.clusters[pairs] = row + column;
+                bin.lights[pairs] = l;
+                sliceCounts[row + column]++;
+                pairs++;
+            }
+        }
+    }
+
+    // Counting sort of the pairs by cluster; ends[c] is where the lights of cluster c stop.
+    bin.ends.resize(sliceClusters);
+    uint32_t start = 0;
+    for (uint32_t c = 0; c < sliceClusters; c++) {
+        bin.ends[c] = start;
+        start += sliceCounts[c];
+    }
+    bin.sorted.resize(pairs);
+    for (size_t p = 0; p < pairs; p++)
+        bin.sorted[bin.ends[bin.clusters[p]]++] = bin.lights[p];
+}
+
+void LightClusters::assign(const float* spheres, size_t stride, size_t count, const float view[16], size_t capacity) {
+    lightX.resize(count);
+    lightY.resize(count);
+    lightZ.resize(count);
+    lightR.resize(count);
+    rects.resize(count);
+
+    JobSystem& jobs = JobSystem::GetInstance();
+    jobs.parallelFor(count, 256, [&](size_t begin, size_t end) {
+        boundLights(spheres, stride, view, begin, end);
+    });
+
+    bins.resize(slices);
+    for (SliceBins& bin : bins)
+        bin.candidates.clear();
+    stats = ClusterStats();
+    for (uint32_t l = 0; l < uint32_t(count); l++) {
+        const LightRect& rect = rects[l];
+        if (rect.x0 > rect.x1)
+            continue;
+        stats.lights++;
+        for (uint32_t k = rect.z0; k <= rect.z1; k++)
+            bins[k].candidates.push_back(l);
+    }
+
+    size_t clusters = getClustersCount();
+    counts.resize(clusters);
+    ranges.resize(clusters);
+    jobs.parallelFor(slices, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++)
+            binSlice(uint32_t(k));
+    });
+
+    // Offsets are laid out in cluster order, so a full list always drops the same references.
+    size_t offset = 0;
+    for (size_t c = 0; c < clusters; c++) {
+        size_t stored = (std::min)(size_t(counts[c]), capacity - offset);
+        ranges[c].offset = uint32_t(offset);
+        ranges[c].count = uint32_t(stored);
+        offset += stored;
+        stats.dropped += counts[c] - stored;
+        stats.occupied += counts[c] ? 1 : 0;
+        stats.maxPerCluster = (std::max)(stats.maxPerCluster, size_t(counts[c]));
+    }
+    stats.indices = offset;
+
+    indices.resize(offset);
+    uint32_t sliceClusters = tilesX * tilesY;
+    jobs.parallelFor(slices, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            const SliceBins& bin = bins[k];
+            const ClusterRange& first = ranges[k * sliceClusters];
+            const ClusterRange& last = ranges[(k + 1) * sliceClusters - 1];
+            if (last.offset + last.count - first.offset == bin.sorted.size()) {
+                if (!bin.sorted.empty())
+                    memcpy(&indices[first.offset], bin.sorted.data(), sizeof(uint32_t) * bin.sorted.size());
+                continue;
+            }
+            for (uint32_t c = 0; c < sliceClusters; c++) {
+                const ClusterRange& range = ranges[k * sliceClusters + c];
+                if (range.count)
+                    memcpy(&indices[range.offset], &bin.sorted[bin.ends[c] - counts[k * sliceClusters + c]], sizeof(uint32_t) * range.count);
+            }
+        }
+    });
+}
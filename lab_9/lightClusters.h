@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Distance at which a light of `intensity` falling off as 1/d^2 drops to `threshold`.
+float getInfluenceRadius(float intensity, float threshold);
+
+// Lights of one cluster: `count` entries of the index list starting at `offset`.
+struct ClusterRange {
+	uint32_t offset;
+	uint32_t count;
+};
+
+struct ClusterStats {
+	size_t lights = 0;        // whose bounds overlap the grid
+	size_t indices = 0;       // stored in the index list
+	size_t dropped = 0;       // references that did not fit in the capacity
+	size_t occupied = 0;      // clusters with at least one light
+	size_t maxPerCluster = 0;
+};
+
+// Clustered light assignment. The view frustum is cut into tilesX x tilesY screen tiles
+// (row 0 at the top of the screen) and `slices` depth slices spaced exponentially between
+// nearZ and farZ; the first slice also takes everything closer than nearZ. Every cluster is
+// bounded by a view-space AABB, and a light sphere goes to the clusters whose box it touches.
+//
+// Cluster (i, j, k) is number (k * tilesY + j) * tilesX + i. A shader finds the slice of
+// view depth z as floor(log(z) * getSliceScale() + getSliceBias()).
+class LightClusters {
+public:
+	void setGrid(uint32_t tilesX, uint32_t tilesY, uint32_t slices, float tanHalfFovX, float tanHalfFovY, float nearZ, float farZ);
+
+	// Spheres are read `stride` bytes apart as world-space x, y, z, radius. `view` is the
+	// row-major world to view matrix applied to row vectors (an XMFLOAT4X4). The index list
+	// holds at most `capacity` entries; clusters past it get fewer lights, later ones none.
+	void assign(const float* spheres, size_t stride, size_t count, const float view[16], size_t capacity);
+
+	uint32_t getTilesX() const { return tilesX; };
+	uint32_t getTilesY() const { return tilesY; };
+	uint32_t getSlices() const { return slices; };
+	size_t getClustersCount() const { return size_t(tilesX) * tilesY * slices; };
+	float getSliceScale() const { return sliceScale; };
+	float getSliceBias() const { return sliceBias; };
+
+	const std::vector<ClusterRange>& getRanges() const { return ranges; };
+	const std::vector<uint32_t>& getIndices() const { return indices; };
+	const ClusterStats& getStats() const { return stats; };
+
+private:
+	// Clusters a light may touch, empty when x0 > x1.
+	struct LightRect {
+		uint16_t x0, x1, y0, y1, z0, z1;
+	};
+
+	// Lights whose depth range reaches the slice, the (cluster in the slice, light) pairs
+	// they touch, then the lights grouped by cluster.
+	struct SliceBins {
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> clusters;
+		std::vector<uint32_t> lights;
+		std::vector<uint32_t> sorted;
+		std::vector<uint32_t> ends;
+	};
+
+	void boundLights(const float* spheres, size_t stride, const float view[16], size_t begin, size_t end);
+	void binSlice(uint32_t k);
+	int getSlice(float z) const;
+
+	uint32_t tilesX = 0;
+	uint32_t tilesY = 0;
+	uint32_t slices = 0;
+	float tanX = 1.0f;
+	float tanY = 1.0f;
+	float nearZ = 0.1f;
+	float farZ = 100.0f;
+	float sliceScale = 0.0f;
+	float sliceBias = 0.0f;
+
+	// Cluster boxes: x by (slice, column), y by (slice, row), z by slice.
+	std::vector<float> minX, maxX;
+	std::vector<float> minY, maxY;
+	std::vector<float> minZ, maxZ;
+
+	// Lights in view space.
+	std::vector<float> lightX, lightY, lightZ, lightR;
+	std::vector<LightRect> rects;
+
+	std::vector<SliceBins> bins;
+	std::vector<uint32_t> counts; // per cluster, before the capacity
+	std::vector<ClusterRange> ranges;
+	std::vector<uint32_t> indices;
+	ClusterStats stats;
+};
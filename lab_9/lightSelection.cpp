@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "lightSelection.h"
+#include "jobSystem.h"
+#include "simd.h"
+
+const uint16_t LightSelector::NO_LIGHT;
+
+static const uint32_t MAX_SELECTED = 16;
+
+// The k best so far, brightest first. A light only goes in when it beats the last one, so
+// of two equal scores the one seen first (the lower index) stays ahead.
+struct TopLights {
+    float scores[MAX_SELECTED];
+    uint16_t lights[MAX_SELECTED];
+    uint32_t k;
+
+    void reset(uint32_t k) {
+        this->k = k;
+        for (uint32_t i = 0; i < k; i++) {
+            scores[i] = 0.0f;
+            lights[i] = LightSelector::NO_LIGHT;
+        }
+    };
+
+    float getThreshold() const { return scores[k - 1]; };
+
+    void insert(float score, uint16_t light) {
+        if (!(score > scores[k - 1]))
+            return;
+        uint32_t pos = k - 1;
+        for (; pos > 0 && scores[pos - 1] < score; pos--) {
+            scores[pos] = scores[pos - 1];
+            lights[pos] = lights[pos - 1];
+        }
+        scores[pos] = score;
+        lights[pos] = light;
+    };
+};
+
+void LightSelector::setLights(const float* spheres, size_t stride, const float* colors, size_t colorStride, size_t count) {
+    assert(count < NO_LIGHT);
+    lightsCount = count;
+    size_t padded = (count + 7) & ~size_t(7);
+    lightX.assign(padded, 0.0f);
+    lightY.assign(padded, 0.0f);
+    lightZ.assign(padded, 0.0f);
+    range.assign(padded, 0.0f);
+    invRange2.assign(padded, 0.0f);
+    intensity.assign(padded, 0.0f);
+    for (size_t i = 0; i < count; i++) {
+        const float* sphere = reinterpret_cast<const float*>(reinterpret_cast<const char*>(spheres) + i * stride);
+        const float* color = reinterpret_cast<const float*>(reinterpret_cast<const char*>(colors) + i * colorStride);
+        lightX[i] = sphere[0];
+        lightY[i] = sphere[1];
+        lightZ[i] = sphere[2];
+        range[i] = (std::max)(sphere[3], 0.0f);
+        invRange2[i] = sphere[3] > 0.0f ? 1.0f / (sphere[3] * sphere[3]) : 0.0f;
+        intensity[i] = sphere[3] > 0.0f ? (std::max)((std::max)(color[0], color[1]), color[2]) : 0.0f;
+    }
+}
+
+// Most lights do not reach a given instance: a group is only scored when one of its lights is
+// closer than its radius plus the instance's. Every width computes the same IEEE operations in
+// the same order, so the picks do not depend on the instruction set.
+void LightSelector::selectRange(const InstanceBounds& bounds, uint32_t k, size_t begin, size_t end, uint16_t* out) const {
+    size_t padded = lightX.size();
+    TopLights top;
+    for (size_t i = begin; i < end; i++) {
+        top.reset(k);
+        float cx = bounds.centerX[i], cy = bounds.centerY[i], cz = bounds.centerZ[i];
+        float radius = bounds.radius[i];
+        size_t j = 0;
+        if (radius < 0.0f)
+            j = padded;
+
+#if defined(SIMD_AVX)
+        __m256 cx8 = _mm256_set1_ps(cx), cy8 = _mm256_set1_ps(cy), cz8 = _mm256_set1_ps(cz);
+        __m256 radius8 = _mm256_set1_ps(radius);
+        __m256 one8 = _mm256_set1_ps(1.0f);
+        for (; j + 8 <= padded; j += 8) {
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&lightX[j]), cx8);
+            __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&lightY[j]), cy8);
+            __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&lightZ[j]), cz8);
+            __m256 dist2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            __m256 reach = _mm256_add_ps(_mm256_loadu_ps(&range[j]), radius8);
+            if (!_mm256_movemask_ps(_mm256_cmp_ps(dist2, _mm256_mul_ps(reach, reach), _CMP_LT_OQ)))
+                continue;
+            __m256 dist = _mm256_sqrt_ps(dist2);
+            __m256 d = _mm256_max_ps(_mm256_sub_ps(dist, radius8), _mm256_setzero_ps());
+            __m256 d2 = _mm256_mul_ps(d, d);
+            __m256 f2 = _mm256_mul_ps(d2, _mm256_loadu_ps(&invRange2[j]));
+            __m256 window = _mm256_max_ps(_mm256_sub_ps(one8, _mm256_mul_ps(f2, f2)), _mm256_setzero_ps());
+            window = _mm256_mul_ps(window, window);
+            __m256 score = _mm256_div_ps(_mm256_mul_ps(_mm256_loadu_ps(&intensity[j]), window), _mm256_max_ps(d2, one8));
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(score, _mm256_set1_ps(top.getThreshold()), _CMP_GT_OQ));
+            if (mask) {
+                float scores[8];
+                _mm256_storeu_ps(scores, score);
+                for (int b = 0; b < 8; b++) {
+                    if (mask & (1 << b))
+                        top.insert(scores[b], uint16_t(j + b));
+                }
+            }
+        }
+#endif
+#if defined(SIMD_SSE)
+        __m128 cx4 = _mm_set1_ps(cx), cy4 = _mm_set1_ps(cy), cz4 = _mm_set1_ps(cz);
+        __m128 radius4 = _mm_set1_ps(radius);
+        __m128 one4 = _mm_set1_ps(1.0f);
+        for (; j + 4 <= padded; j += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(&lightX[j]), cx4);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(&lightY[j]), cy4);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(&lightZ[j]), cz4);
+            __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 reach = _mm_add_ps(_mm_loadu_ps(&range[j]), radius4);
+            if (!_mm_movemask_ps(_mm_cmplt_ps(dist2, _mm_mul_ps(reach, reach))))
+                continue;
+            __m128 dist = _mm_sqrt_ps(dist2);
+            __m128 d = _mm_max_ps(_mm_sub_ps(dist, radius4), _mm_setzero_ps());
+            __m128 d2 = _mm_mul_ps(d, d);
+            __m128 f2 = _mm_mul_ps(d2, _mm_loadu_ps(&invRange2[j]));
+            __m128 window = _mm_max_ps(_mm_sub_ps(one4, _mm_mul_ps(f2, f2)), _mm_setzero_ps());
+            window = _mm_mul_ps(window, window);
+            __m128 score = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&intensity[j]), window), _mm_max_ps(d2, one4));
+            int mask = _mm_movemask_ps(_mm_cmpgt_ps(score, _mm_set1_ps(top.getThreshold())));
+            if (mask) {
+                float scores[4];
+                _mm_storeu_ps(scores, score);
+                for (int b = 0; b < 4; b++) {
+                    if (mask & (1 << b))
+                        top.insert(scores[b], uint16_t(j + b));
+                }
+            }
+        }
+#endif
+        for (; j < padded; j++) {
+            float dx = lightX[j] - cx, dy = lightY[j] - cy, dz = lightZ[j] - cz;
+            float dist2 = dx * dx + dy * dy + dz * dz;
+            float reach = range[j] + radius;
+            if (!(dist2 < reach * reach))
+                continue;
+            float d = (std::max)(sqrtf(dist2) - radius, 0.0f);
+            float d2 = d * d;
+            float f2 = d2 * invRange2[j];
+            float window = (std::max)(1.0f - f2 * f2, 0.0f);
+            window *= window;
+            top.insert(intensity[j] * window / (std::max)(d2, 1.0f), uint16_t(j));
+        }
+
+        for (uint32_t s = 0; s < k; s++)
+            out[i * k + s] = top.lights[s];
+    }
+}
+
+void LightSelector::select(const InstanceBounds& bounds, uint32_t k, std::vector<uint16_t>& lights) {
+    assert(k > 0 && k <= MAX_SELECTED);
+    size_t count = bounds.size();
+    lights.resize(count * k);
+    JobSystem::GetInstance().parallelFor(count, 256, [&](size_t begin, size_t end) {
+        selectRange(bounds, k, begin, end, lights.data());
+    });
+
+    stats.instances = count;
+    stats.lights = lightsCount;
+    stats.selected = count * k - size_t(std::count(lights.begin(), lights.end(), NO_LIGHT));
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "instanceBounds.h"
+
+struct LightSelectionStats {
+	size_t instances = 0;
+	size_t lights = 0;
+	size_t selected = 0; // light slots filled over all the instances
+};
+
+// Per-instance light selection for forward shading: every instance keeps the `k` lights that
+// reach it brightest. A light is scored by its attenuation at the point of the instance
+// bounding sphere nearest to it, intensity / max(d^2, 1) faded to zero at the light's
+// influence radius like the shaders do. Lights that do not reach an instance are never picked.
+class LightSelector {
+public:
+	static const uint16_t NO_LIGHT = 0xFFFF;
+
+	// Spheres are read `stride` bytes apart as x, y, z, influence radius; colors are read
+	// `colorStride` bytes apart and their largest rgb component is the intensity.
+	void setLights(const float* spheres, size_t stride, const float* colors, size_t colorStride, size_t count);
+
+	// `lights` gets `k` entries per instance, the brightest first, padded with NO_LIGHT. Equal
+	// scores keep the lower light index. Instances with a negative radius get no lights.
+	void select(const InstanceBounds& bounds, uint32_t k, std::vector<uint16_t>& lights);
+
+	const LightSelectionStats& getStats() const { return stats; };
+
+private:
+	void selectRange(const InstanceBounds& bounds, uint32_t k, size_t begin, size_t end, uint16_t* out) const;
+
+	// Padded to a multiple of 8 with lights of zero intensity, which never score.
+	std::vector<float> lightX, lightY, lightZ;
+	std::vector<float> range;
+	std::vector<float> invRange2; // 1 / range^2
+	std::vector<float> intensity;
+	size_t lightsCount = 0;
+	LightSelectionStats stats;
+};
@@ -1,154 +1,154 @@
-﻿#include <windows.h>
-#include <windowsx.h>
-#include <xstring>
-#include <mmsystem.h>
-
-#include "Resource.h"
-#include "framework.h"
-#include "Renderer.h"
-
-#include "imgui/imgui.h"
-#include "imgui/imgui_impl_dx11.h"
-#include "imgui/imgui_impl_win32.h"
-
-
-constexpr int start_w = 1280;
-constexpr int start_h = 720;
-
-HINSTANCE       g_hInst = nullptr;
-HWND            g_hWnd = nullptr;
-
-extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-
-LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
-
-
-HRESULT InitWindow(HINSTANCE hInstance, int nCmdShow)
-{
-    WNDCLASSEX wcex;
-    wcex.cbSize = sizeof(WNDCLASSEX);
-    wcex.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;
-    wcex.lpfnWndProc = WndProc;
-    wcex.cbClsExtra = 0;
-    wcex.cbWndExtra = 0;
-    wcex.hInstance = hInstance;
-    wcex.hIcon = LoadIcon(hInstance, MAKEINTRESOURCE(IDI_LAB));
-    wcex.hIconSm = LoadIcon(wcex.hInstance, MAKEINTRESOURCE(IDI_LAB));
-    wcex.hIconSm = nullptr;
-    wcex.hCursor = LoadCursor(nullptr, IDC_ARROW);
-    wcex.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1);
-    wcex.lpszMenuName = nullptr;
-    wcex.lpszClassName = L"Window";
-    if (!RegisterClassEx(&wcex))
-        return E_FAIL;
-
-    g_hInst = hInstance;
-    RECT rc = { 0, 0, start_w, start_h };
-    AdjustWindowRect(&rc, WS_OVERLAPPEDWINDOW, FALSE);
-    g_hWnd = CreateWindow(L"Window", L"Lab_9, AfanasyevAV, 5030102/10201",
-        WS_OVERLAPPED | WS_CAPTION | WS_THICKFRAME | WS_SYSMENU | WS_MINIMIZEBOX,
-        CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top, nullptr, nullptr, hInstance,
-        nullptr);
-    if (!g_hWnd)
-        return E_FAIL;
-
-    ShowWindow(g_hWnd, nCmdShow);
-    SetForegroundWindow(g_hWnd);
-    SetFocus(g_hWnd);
-
-    return S_OK;
-}
-
-int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
-{
-    UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
-
-    if (FAILED(InitWindow(hInstance, nCmdShow)))
-        return 0;
-
-    if (FAILED(Renderer::getInstance().init(g_hWnd, g_hInst, start_w, start_h)))
-    {
-        Renderer::getInstance().deviceCleanup();
-        return 0;
-    }
-
-    MSG msg = { 0 };
-    while (WM_QUIT != msg.message)
-    {
-        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
-        {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
-        }
-        if (Renderer::getInstance().frame()) Renderer::getInstance().render();
-    }
-
-    Renderer::getInstance().deviceCleanup();
-
-    return (int)msg.wParam;
-}
-
-LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
-{
-
-    if (ImGui_ImplWin32_WndProcHandler(hWnd, message, wParam, lParam))
-        return true;
-
-    PAINTSTRUCT ps;
-    HDC hdc;
-
-    switch (message)
-    {
-    case WM_PAINT:
-        hdc = BeginPaint(hWnd, &ps);
-        EndPaint(hWnd, &ps);
-        break;
-
-
-    case WM_GETMINMAXINFO:
-    {
-        LPMINMAXINFO lpMMI = (LPMINMAXINFO)lParam;
-        lpMMI->ptMinTrackSize.x = 256;
-        lpMMI->ptMinTrackSize.y = 256;
-        break;
-    }
-
-    case WM_DESTROY:
-        PostQuitMessage(0);
-        break;
-
-    case WM_SIZE:
-        Renderer::getInstance().resizeWindow(g_hWnd);
-        break;
-
-    case WM_RBUTTONDOWN:
-        Renderer::getInstance().mouseRBPressed(true, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
-        break;
-
-    case WM_LBUTTONDOWN:
-        Renderer::getInstance().mouseRBPressed(true, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
-        break;
-
-    case WM_RBUTTONUP:
-        Renderer::getInstance().mouseRBPressed(false, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
-        break;
-
-    case WM_LBUTTONUP:
-        Renderer::getInstance().mouseRBPressed(false, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
-        break;
-
-    case WM_MOUSEMOVE:
-        Renderer::getInstance().mouseMoved(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
-        break;
-
-    case WM_MOUSEWHEEL:
-        Renderer::getInstance().mouseWheel(GET_WHEEL_DELTA_WPARAM(wParam));
-        break;
-
-    default:
-        return DefWindowProc(hWnd, message, wParam, lParam);
-    }
-
-    return 0;
-}
+﻿#include <windows.h>
+#include <windowsx.h>
+#include <xstring>
+#include <mmsystem.h>
+
+#include "Resource.h"
+#include "framework.h"
+#include "Renderer.h"
+
+#include "imgui/imgui.h"
+#include "imgui/imgui_impl_dx11.h"
+#include "imgui/imgui_impl_win32.h"
+
+
+constexpr int start_w = 1280;
+constexpr int start_h = 720;
+
+HINSTANCE       g_hInst = nullptr;
+HWND            g_hWnd = nullptr;
+
+extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
+
+
+HRESULT InitWindow(HINSTANCE hInstance, int nCmdShow)
+{
+    WNDCLASSEX wcex;
+    wcex.cbSize = sizeof(WNDCLASSEX);
+    wcex.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;
+    wcex.lpfnWndProc = WndProc;
+    wcex.cbClsExtra = 0;
+    wcex.cbWndExtra = 0;
+    wcex.hInstance = hInstance;
+    wcex.hIcon = LoadIcon(hInstance, MAKEINTRESOURCE(IDI_LAB));
+    wcex.hIconSm = LoadIcon(wcex.hInstance, MAKEINTRESOURCE(IDI_LAB));
+    wcex.hIconSm = nullptr;
+    wcex.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    wcex.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1);
+    wcex.lpszMenuName = nullptr;
+    wcex.lpszClassName = L"Window";
+    if (!RegisterClassEx(&wcex))
+        return E_FAIL;
+
+    g_hInst = hInstance;
+    RECT rc = { 0, 0, start_w, start_h };
+    AdjustWindowRect(&rc, WS_OVERLAPPEDWINDOW, FALSE);
+    g_hWnd = CreateWindow(L"Window", L"Lab_9, AfanasyevAV, 5030102/10201",
+        WS_OVERLAPPED | WS_CAPTION | WS_THICKFRAME | WS_SYSMENU | WS_MINIMIZEBOX,
+        CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top, nullptr, nullptr, hInstance,
+        nullptr);
+    if (!g_hWnd)
+        return E_FAIL;
+
+    ShowWindow(g_hWnd, nCmdShow);
+    SetForegroundWindow(g_hWnd);
+    SetFocus(g_hWnd);
+
+    return S_OK;
+}
+
+int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
+{
+    UNREFERENCED_PARAMETER(hPrevInstance);
+    UNREFERENCED_PARAMETER(lpCmdLine);
+
+    if (FAILED(InitWindow(hInstance, nCmdShow)))
+        return 0;
+
+    if (FAILED(Renderer::getInstance().init(g_hWnd, g_hInst, start_w, start_h)))
+    {
+        Renderer::getInstance().deviceCleanup();
+        return 0;
+    }
+
+    MSG msg = { 0 };
+    while (WM_QUIT != msg.message)
+    {
+        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+        {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        if (Renderer::getInstance().frame()) Renderer::getInstance().render();
+    }
+
+    Renderer::getInstance().deviceCleanup();
+
+    return (int)msg.wParam;
+}
+
+LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
+{
+
+    if (ImGui_ImplWin32_WndProcHandler(hWnd, message, wParam, lParam))
+        return true;
+
+    PAINTSTRUCT ps;
+    HDC hdc;
+
+    switch (message)
+    {
+    case WM_PAINT:
+        hdc = BeginPaint(hWnd, &ps);
+        EndPaint(hWnd, &ps);
+        break;
+
+
+    case WM_GETMINMAXINFO:
+    {
+        LPMINMAXINFO lpMMI = (LPMINMAXINFO)lParam;
+        lpMMI->ptMinTrackSize.x = 256;
+        lpMMI->ptMinTrackSize.y = 256;
+        break;
+    }
+
+    case WM_DESTROY:
+        PostQuitMessage(0);
+        break;
+
+    case WM_SIZE:
+        Renderer::getInstance().resizeWindow(g_hWnd);
+        break;
+
+    case WM_RBUTTONDOWN:
+        Renderer::getInstance().mouseRBPressed(true, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+        break;
+
+    case WM_LBUTTONDOWN:
+        Renderer::getInstance().mouseRBPressed(true, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+        break;
+
+    case WM_RBUTTONUP:
+        Renderer::getInstance().mouseRBPressed(false, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+        break;
+
+    case WM_LBUTTONUP:
+        Renderer::getInstance().mouseRBPressed(false, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+        break;
+
+    case WM_MOUSEMOVE:
+        Renderer::getInstance().mouseMoved(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+        break;
+
+    case WM_MOUSEWHEEL:
+        Renderer::getInstance().mouseWheel(GET_WHEEL_DELTA_WPARAM(wParam));
+        break;
+
+    default:
+        return DefWindowProc(hWnd, message, wParam, lParam);
+    }
+
+    return 0;
+}
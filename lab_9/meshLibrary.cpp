@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "meshLibrary.h"
+
+static const float PI = 3.14159265358979f;
+
+static void setDirection(MeshVertex& vertex, float x, float y, float z) {
+    vertex.position[0] = vertex.normal[0] = x;
+    vertex.position[1] = vertex.normal[1] = y;
+    vertex.position[2] = vertex.normal[2] = z;
+}
+
+// Longitude as the uv sphere measures it: the ring point at yaw y is (sin y, -cos y) * r.
+static void setSphereFrame(MeshVertex& vertex) {
+    float x = vertex.position[0], y = vertex.position[1], z = vertex.position[2];
+    float ring = sqrtf(x * x + y * y);
+    float yaw = ring > 0.0f ? atan2f(x, -y) : 0.0f;
+    if (yaw < 0.0f)
+        yaw += 2.0f * PI;
+    vertex.uv[0] = yaw / (2.0f * PI);
+    vertex.uv[1] = acosf((std::max)((std::min)(z, 1.0f), -1.0f)) / PI;
+    vertex.tangent[0] = ring > 0.0f ? cosf(yaw) : 1.0f;
+    vertex.tangent[1] = ring > 0.0f ? sinf(yaw) : 0.0f;
+    vertex.tangent[2] = 0.0f;
+}
+
+static void pushTriangle(std::vector<uint32_t>& indices, uint32_t a, uint32_t b, uint32_t c) {
+    indices.push_back(a);
+    indices.push_back(b);
+    indices.push_back(c);
+}
+
+// The layout Light and Skybox used to build by hand: pole, rings from +z to -z, pole. The
+// old band triangles were wound against the caps, here all of them face outwards.
+static void buildUVSphere(uint32_t latLines, uint32_t longLines, Mesh& mesh) {
+    latLines = (std::max)(latLines, 3u);
+    longLines = (std::max)(longLines, 3u);
+    uint32_t rings = latLines - 2;
+    uint32_t verticesCount = rings * longLines + 2;
+    uint32_t last = verticesCount - 1;
+
+    mesh.vertices.resize(verticesCount);
+    setDirection(mesh.vertices[0], 0.0f, 0.0f, 1.0f);
+    for (uint32_t i = 0; i < rings; i++) {
+        float pitch = (i + 1) * (PI / (latLines - 1));
+        for (uint32_t j = 0; j < longLines; j++) {
+            float yaw = j * (2.0f * PI / longLines);
+            setDirection(mesh.vertices[i * longLines + j + 1], sinf(pitch) * sinf(yaw), -sinf(pitch) * cosf(yaw), cosf(pitch));
+        }
+    }
+    setDirection(mesh.vertices[last], 0.0f, 0.0f, -1.0f);
+    for (auto& vertex : mesh.vertices)
+        setSphereFrame(vertex);
+
+    for (uint32_t j = 0; j < longLines; j++)
+        pushTriangle(mesh.indices, 0, j + 1, (j + 1) % longLines + 1);
+
+    for (uint32_t i = 0; i + 1 < rings; i++) {
+        for (uint32_t j = 0; j < longLines; j++) {
+            uint32_t a = i * longLines + j + 1;
+            uint32_t b = i * longLines + (j + 1) % longLines + 1;
+            pushTriangle(mesh.indices, a, a + longLines, b);
+            pushTriangle(mesh.indices, a + longLines, b + longLines, b);
+        }
+    }
+
+    uint32_t lastRing = (rings - 1) * longLines + 1;
+    for (uint32_t j = 0; j < longLines; j++)
+        pushTriangle(mesh.indices, last, lastRing + (longLines - 1 - j), lastRing + (2 * longLines - 2 - j) % longLines);
+}
+
+static void buildIcosphere(uint32_t subdivisions, Mesh& mesh) {
+    const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+    const float corners[12][3] = {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+        { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+        { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+    };
+    const uint32_t faces[20][3] = {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+        { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+        { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 },
+    };
+
+    auto addVertex = [&](float x, float y, float z) {
+        float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+        MeshVertex vertex;
+        setDirection(vertex, x * invLength, y * invLength, z * invLength);
+        mesh.vertices.push_back(vertex);
+        return uint32_t(mesh.vertices.size() - 1);
+    };
+
+    for (auto& corner : corners)
+        addVertex(corner[0], corner[1], corner[2]);
+    for (auto& face : faces)
+        pushTriangle(mesh.indices, face[0], face[1], face[2]);
+
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    for (uint32_t level = 0; level < subdivisions; level++) {
+        midpoints.clear();
+        auto midpoint = [&](uint32_t a, uint32_t b) {
+            uint64_t key = (uint64_t((std::min)(a, b)) << 32) | (std::max)(a, b);
+            auto found = midpoints.find(key);
+            if (found != midpoints.end())
+                return found->second;
+            const float* pa = mesh.vertices[a].position;
+            const float* pb = mesh.vertices[b].position;
+            uint32_t index = addVertex(pa[0] + pb[0], pa[1] + pb[1], pa[2] + pb[2]);
+            midpoints.emplace(key, index);
+            return index;
+        };
+
+        std::vector<uint32_t> split;
+        split.reserve(mesh.indices.size() * 4);
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+            uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            pushTriangle(split, a, ab, ca);
+            pushTriangle(split, b, bc, ab);
+            pushTriangle(split, c, ca, bc);
+            pushTriangle(split, ab, bc, ca);
+        }
+        mesh.indices.swap(split);
+    }
+
+    for (auto& vertex : mesh.vertices)
+        setSphereFrame(vertex);
+}
+
+static void buildCube(Mesh& mesh) {
+    mesh.vertices = {
+        {{-0.5, -0.5,  0.5}, {0, 1}, {0, -1, 0}, {1, 0, 0}},
+        {{ 0.5, -0.5,  0.5}, {1, 1}, {0, -1, 0}, {1, 0, 0}},
+        {{ 0.5, -0.5, -0.5}, {1, 0}, {0, -1, 0}, {1, 0, 0}},
+        {{-0.5, -0.5, -0.5}, {0, 0}, {0, -1, 0}, {1, 0, 0}},
+
+        {{-0.5,  0.5, -0.5}, {1, 1}, {0, 1, 0}, {1, 0, 0}},
+        {{ 0.5,  0.5, -0.5}, {0, 1}, {0, 1, 0}, {1, 0, 0}},
+        {{ 0.5,  0.5,  0.5}, {0, 0}, {0, 1, 0}, {1, 0, 0}},
+        {{-0.5,  0.5,  0.5}, {1, 0}, {0, 1, 0}, {1, 0, 0}},
+
+        {{ 0.5, -0.5, -0.5}, {0, 1}, {1, 0, 0}, {0, 0, 1}},
+        {{ 0.5, -0.5,  0.5}, {1, 1}, {1, 0, 0}, {0, 0, 1}},
+        {{ 0.5,  0.5,  0.5}, {1, 0}, {1, 0, 0}, {0, 0, 1}},
+        {{ 0.5,  0.5, -0.5}, {0, 0}, {1, 0, 0}, {0, 0, 1}},
+
+        {{-0.5, -0.5,  0.5}, {0, 1}, {-1, 0, 0}, {0, 0, -1}},
+        {{-0.5, -0.5, -0.5}, {1, 1}, {-1, 0, 0}, {0, 0, -1}},
+        {{-0.5,  0.5, -0.5}, {1, 0}, {-1, 0, 0}, {0, 0, -1}},
+        {{-0.5,  0.5,  0.5}, {0, 0}, {-1, 0, 0}, {0, 0, -1}},
+
+        {{ 0.5, -0.5,  0.5}, {1, 1}, {0, 0, 1}, {-1, 0, 0}},
+        {{-0.5, -0.5,  0.5}, {0, 1}, {0, 0, 1}, {-1, 0, 0}},
+        {{-0.5,  0.5,  0.5}, {0, 0}, {0, 0, 1}, {-1, 0, 0}},
+        {{ 0.5,  0.5,  0.5}, {1, 0}, {0, 0, 1}, {-1, 0, 0}},
+
+        {{-0.5, -0.5, -0.5}, {1, 1}, {0, 0, -1}, {1, 0, 0}},
+        {{ 0.5, -0.5, -0.5}, {0, 1}, {0, 0, -1}, {1, 0, 0}},
+        {{ 0.5,  0.5, -0.5}, {0, 0}, {0, 0, -1}, {1, 0, 0}},
+        {{-0.5,  0.5, -0.5}, {1, 0}, {0, 0, -1}, {1, 0, 0}}
+    };
+
+    for (uint32_t face = 0; face < 6; face++) {
+        uint32_t first = face * 4;
+        pushTriangle(mesh.indices, first, first + 2, first + 1);
+        pushTriangle(mesh.indices, first, first + 3, first + 2);
+    }
+}
+
+static void buildQuad(Mesh& mesh) {
+    mesh.vertices = {
+        {{-0.5, -0.5, 0}, {0, 1}, {0, 0, -1}, {1, 0, 0}},
+        {{ 0.5, -0.5, 0}, {1, 1}, {0, 0, -1}, {1, 0, 0}},
+        {{ 0.5,  0.5, 0}, {1, 0}, {0, 0, -1}, {1, 0, 0}},
+        {{-0.5,  0.5, 0}, {0, 0}, {0, 0, -1}, {1, 0, 0}}
+    };
+    mesh.indices = { 0, 2, 1, 0, 3, 2 };
+}
+
+static void measure(const Mesh& mesh, float& acmr, float& atvr) {
+    size_t misses = countCacheMisses(mesh.indices, mesh.vertices.size(), MeshLibrary::CACHE_SIZE);
+    std::vector<uint8_t> used(mesh.vertices.size(), 0);
+    size_t usedCount = 0;
+    for (uint32_t index : mesh.indices) {
+        usedCount += used[index] ? 0 : 1;
+        used[index] = 1;
+    }
+    acmr = mesh.indices.empty() ? 0.0f : float(misses) / float(mesh.indices.size() / 3);
+    atvr = usedCount == 0 ? 0.0f : float(misses) / float(usedCount);
+}
+
+static void optimize(Mesh& mesh) {
+    measure(mesh, mesh.stats.acmrBefore, mesh.stats.atvrBefore);
+    optimizeVertexCache(mesh.indices, mesh.vertices.size(), MeshLibrary::CACHE_SIZE);
+    optimizeVertexFetch(mesh.vertices, mesh.indices);
+    measure(mesh, mesh.stats.acmr, mesh.stats.atvr);
+
+    if (mesh.vertices.size() <= 0x10000u)
+        mesh.shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+}
+
+const Mesh& MeshLibrary::getUVSphere(uint32_t latLines, uint32_t longLines) {
+    return getMesh(Shape::UVSphere, latLines, longLines);
+}
+
+const Mesh& MeshLibrary::getIcosphere(uint32_t subdivisions) {
+    return getMesh(Shape::Icosphere, subdivisions, 0);
+}
+
+const Mesh& MeshLibrary::getCube() {
+    return getMesh(Shape::Cube, 0, 0);
+}
+
+const Mesh& MeshLibrary::getQuad() {
+    return getMesh(Shape::Quad, 0, 0);
+}
+
+const Mesh& MeshLibrary::getMesh(Shape shape, uint32_t first, uint32_t second) {
+    uint64_t key = (uint64_t(shape) << 56) | (uint64_t(first) << 28) | uint64_t(second);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = meshes.find(key);
+    if (found != meshes.end())
+        return found->second;
+
+    Mesh& mesh = meshes[key];
+    switch (shape) {
+    case Shape::UVSphere:
+        buildUVSphere(first, second, mesh);
+        break;
+    case Shape::Icosphere:
+        buildIcosphere(first, mesh);
+        break;
+    case Shape::Cube:
+        buildCube(mesh);
+        break;
+    case Shape::Quad:
+        buildQuad(mesh);
+        break;
+    }
+    optimize(mesh);
+    return mesh;
+}
+
+// Tipsify: fan out the triangles around the current vertex, then continue from the
+// emitted vertex that is still in the cache and has the most triangles left, or from the
+// most recently emitted vertex that still has some (dead-end stack), or from the next
+// unfinished vertex in order. Every vertex gets a timestamp when it enters the cache.
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t verticesCount, size_t cacheSize) {
+    size_t trianglesCount = indices.size() / 3;
+    if (trianglesCount == 0 || verticesCount == 0)
+        return;
+
+    std::vector<uint32_t> live(verticesCount, 0);
+    for (size_t i = 0; i < trianglesCount * 3; i++)
+        live[indices[i]]++;
+
+    std::vector<uint32_t> offsets(verticesCount + 1, 0);
+    for (size_t v = 0; v < verticesCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<uint32_t> adjacency(trianglesCount * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < trianglesCount * 3; i++)
+        adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+
+    std::vector<size_t> cacheTime(verticesCount, 0);
+    std::vector<uint8_t> emitted(trianglesCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    deadEnd.reserve(trianglesCount * 3);
+    result.reserve(trianglesCount * 3);
+
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+    long long fan = 0;
+    while (fan >= 0) {
+        candidates.clear();
+        for (uint32_t k = offsets[size_t(fan)]; k < offsets[size_t(fan) + 1]; k++) {
+            uint32_t triangle = adjacency[k];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = 1;
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = indices[triangle * 3 + c];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        fan = -1;
+        size_t bestPriority = 0;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0)
+                continue;
+            // A vertex that would leave the cache before its fan is done gets no priority.
+            size_t age = time - cacheTime[v];
+            size_t priority = age + 2 * live[v] <= cacheSize ? age : 0;
+            if (fan < 0 || priority > bestPriority) {
+                fan = v;
+                bestPriority = priority;
+            }
+        }
+
+        while (fan < 0 && !deadEnd.empty()) {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                fan = v;
+        }
+        while (fan < 0 && cursor < verticesCount) {
+            if (live[cursor] > 0)
+                fan = (long long)cursor;
+            cursor++;
+        }
+    }
+
+    indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<MeshVertex> reordered;
+    reordered.reserve(vertices.size());
+    for (auto& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = uint32_t(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+
+size_t countCacheMisses(const std::vector<uint32_t>& indices, size_t verticesCount, size_t cacheSize) {
+    // A vertex is in the FIFO while fewer than cacheSize vertices have entered after it.
+    std::vector<size_t> entered(verticesCount, 0); // miss count after it entered, 0 = never
+    size_t misses = 0;
+    for (uint32_t index : indices) {
+        if (entered[index] != 0 && misses - entered[index] < cacheSize)
+            continue;
+        misses++;
+        entered[index] = misses;
+    }
+    return misses;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Same layout as TexVertex, so a mesh can go straight to packVertices (vertexPacking.h).
+struct MeshVertex {
+	float position[3];
+	float uv[2];
+	float normal[3];
+	float tangent[3];
+};
+
+// Post-transform cache efficiency of the index buffer on a FIFO cache of
+// MeshLibrary::CACHE_SIZE entries: ACMR is transformed vertices per triangle, ATVR per
+// unique vertex (1 is the best possible). `before` is the order the generator emitted.
+struct MeshStats {
+	float acmrBefore = 0.0f;
+	float atvrBefore = 0.0f;
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+// Indexed triangle list, front faces have cross(b - a, c - a) pointing outwards.
+struct Mesh {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint16_t> shortIndices; // the same indices when every vertex fits in 16 bits
+	MeshStats stats;
+
+	bool hasShortIndices() const { return !shortIndices.empty(); };
+	const void* getIndexData() const { return hasShortIndices() ? (const void*)shortIndices.data() : (const void*)indices.data(); };
+	size_t getIndexSize() const { return hasShortIndices() ? sizeof(uint16_t) : sizeof(uint32_t); };
+	size_t getIndexCount() const { return indices.size(); };
+};
+
+// Procedural meshes built on first request and then shared. Every mesh is reordered for the
+// post-transform cache (Tipsify) and then for vertex fetch (vertices in first use order).
+// Meshes are never freed or changed, so the references stay valid.
+class MeshLibrary {
+public:
+	static const size_t CACHE_SIZE = 16;
+
+	static MeshLibrary& GetInstance() {
+		static MeshLibrary meshLibraryInstance;
+		return meshLibraryInstance;
+	};
+
+	// Unit sphere with a vertex at each pole, latLines rings from pole to pole (poles
+	// included) and longLines vertices per ring; the uv seam is not split.
+	const Mesh& getUVSphere(uint32_t latLines, uint32_t longLines);
+	// Unit sphere from an icosahedron with every triangle split into 4, `subdivisions` times.
+	const Mesh& getIcosphere(uint32_t subdivisions);
+	// Cube [-0.5, 0.5]^3, four vertices per face.
+	const Mesh& getCube();
+	// Quad [-0.5, 0.5]^2 in the z = 0 plane facing -z.
+	const Mesh& getQuad();
+
+private:
+	enum class Shape : uint32_t { UVSphere, Icosphere, Cube, Quad };
+
+	MeshLibrary() = default;
+	MeshLibrary(const MeshLibrary&) = delete;
+	MeshLibrary& operator=(const MeshLibrary&) = delete;
+
+	const Mesh& getMesh(Shape shape, uint32_t first, uint32_t second);
+
+	std::map<uint64_t, Mesh> meshes;
+	std::mutex mutex;
+};
+
+// Reorders the triangles for a post-transform cache of `cacheSize` entries (Sander et al.,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"). Winding is kept.
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t verticesCount, size_t cacheSize);
+// Renumbers the vertices in the order the indices first use them; unused ones are dropped.
+void optimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+// Transformed vertices for the index buffer on a FIFO cache of `cacheSize` entries.
+size_t countCacheMisses(const std::vector<uint32_t>& indices, size_t verticesCount, size_t cacheSize);
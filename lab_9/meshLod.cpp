@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "meshLod.h"
+
+static const float PI = 3.14159265358979f;
+static const uint32_t MIN_LINES = 5;
+
+// A facet spans pi / (latLines - 1) in latitude and 2 pi / longLines in longitude; its
+// center sits lower than its corners by about the product of both half-angle cosines.
+float getUVSphereError(uint32_t latLines, uint32_t longLines) {
+    latLines = (std::max)(latLines, 3u);
+    longLines = (std::max)(longLines, 3u);
+    float latHalf = PI / (latLines - 1) * 0.5f;
+    float longHalf = PI / longLines;
+    return 1.0f - cosf(latHalf) * cosf(longHalf);
+}
+
+// Every level has about 0.6 of the lines of the previous one.
+void buildUVSphereLods(uint32_t latLines, uint32_t longLines, size_t levels, std::vector<MeshLod>& chain) {
+    chain.clear();
+    for (size_t level = 0; level < levels; level++) {
+        MeshLod lod;
+        lod.mesh = &MeshLibrary::GetInstance().getUVSphere(latLines, longLines);
+        lod.error = getUVSphereError(latLines, longLines);
+        chain.push_back(lod);
+
+        uint32_t nextLat = (std::max)(uint32_t(latLines * 0.6f + 0.5f), MIN_LINES);
+        uint32_t nextLong = (std::max)(uint32_t(longLines * 0.6f + 0.5f), MIN_LINES);
+        if (nextLat == latLines && nextLong == longLines)
+            break;
+        latLines = nextLat;
+        longLines = nextLong;
+    }
+}
+
+void LodSelector::setChain(const std::vector<MeshLod>& chain) {
+    errors.resize(chain.size());
+    triangles.resize(chain.size());
+    for (size_t i = 0; i < chain.size(); i++) {
+        errors[i] = chain[i].error;
+        triangles[i] = chain[i].mesh->getIndexCount() / 3;
+    }
+}
+
+void LodSelector::select(const float* centers, size_t stride, size_t count, float radius, float scale,
+        const float eye[3], float pixelsPerUnit, std::vector<uint8_t>& levels) {
+    stats = LodStats();
+    stats.instances = count;
+    levels.resize(count, 0);
+    if (errors.empty())
+        return;
+
+    const char* bytes = reinterpret_cast<const char*>(centers);
+    const size_t coarsest = errors.size() - 1;
+    const float coarsenError = pixelError * (1.0f - hysteresis);
+
+    for (size_t i = 0; i < count; i++) {
+        const float* center = reinterpret_cast<const float*>(bytes + i * stride);
+        float dx = center[0] - eye[0], dy = center[1] - eye[1], dz = center[2] - eye[2];
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz) - radius * scale;
+        // Inside the bounding sphere nothing but the finest level is safe.
+        float pixelsPerObjectUnit = distance > FLT_EPSILON ? scale * pixelsPerUnit / distance : FLT_MAX;
+
+        size_t current = (std::min)(size_t(levels[i]), coarsest);
+        size_t level = current;
+        if (errors[current] * pixelsPerObjectUnit > pixelError) {
+            while (level > 0 && errors[level] * pixelsPerObjectUnit > pixelError)
+                level--;
+        }
+        else {
+            while (level < coarsest && errors[level + 1] * pixelsPerObjectUnit <= coarsenError)
+                level++;
+        }
+
+        stats.changes += level != size_t(levels[i]) ? 1 : 0;
+        levels[i] = uint8_t(level);
+        stats.triangles += triangles[level];
+        stats.fullTriangles += triangles[0];
+    }
+}
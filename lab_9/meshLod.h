@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "meshLibrary.h"
+
+// One level of a LOD chain. `error` is the largest distance between the mesh and the
+// surface it approximates, in object units.
+struct MeshLod {
+	const Mesh* mesh;
+	float error;
+};
+
+// UV spheres from latLines x longLines down to `levels` coarser tessellations (finest first).
+void buildUVSphereLods(uint32_t latLines, uint32_t longLines, size_t levels, std::vector<MeshLod>& chain);
+// Largest distance of a latLines x longLines UV sphere facet from the unit sphere.
+float getUVSphereError(uint32_t latLines, uint32_t longLines);
+
+struct LodStats {
+	size_t instances = 0;
+	size_t triangles = 0;     // drawn with the selected levels
+	size_t fullTriangles = 0; // had every instance used the finest level
+	size_t changes = 0;       // instances that switched level this frame
+
+	size_t getSavedTriangles() const { return fullTriangles - triangles; };
+};
+
+// Screen-space error LOD selection. The error of a level is projected at the distance of the
+// nearest point of the instance bounding sphere; the coarsest level within `pixelError`
+// pixels is wanted. To stop popping, an instance only moves to a coarser level once that
+// level is within (1 - hysteresis) * pixelError, and only moves back to a finer one once
+// its current level goes over pixelError.
+class LodSelector {
+public:
+	void setChain(const std::vector<MeshLod>& chain);
+	void setPixelError(float pixels, float hysteresis) { pixelError = pixels; this->hysteresis = hysteresis; };
+
+	// Centers are read `stride` bytes apart; every instance is a sphere of `radius` around
+	// its center with object units scaled by `scale`. `pixelsPerUnit` is the size in pixels
+	// of one world unit at distance 1 (half the viewport height times projection._22).
+	// `levels` keeps the state between frames and is resized to `count`, new instances
+	// start at the finest level.
+	void select(const float* centers, size_t stride, size_t count, float radius, float scale,
+		const float eye[3], float pixelsPerUnit, std::vector<uint8_t>& levels);
+
+	size_t getLevelsCount() const { return errors.size(); };
+	const LodStats& getStats() const { return stats; };
+
+private:
+	std::vector<float> errors;
+	std::vector<size_t> triangles;
+	float pixelError = 1.0f;
+	float hysteresis = 0.25f;
+	LodStats stats;
+};
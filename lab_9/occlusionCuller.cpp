@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "occlusionCuller.h"
+#include "jobSystem.h"
+#include "simd.h"
+
+static const size_t OCCLUDER_CHUNK = 32;
+static const int BAND_ROWS = 8;
+static const size_t TEST_CHUNK = 256;
+// Boxes smaller than this (bounding radius over view depth) are not worth rasterizing.
+static const float MIN_OCCLUDER_SIZE = 0.05f;
+
+// Corner k of a box takes bit 0 for x, bit 1 for y and bit 2 for z from the max corner.
+// Faces wind around their outward normal; seen from the front they have a positive area on
+// screen (x right, y down).
+static const int boxFaces[6][4] = {
+    { 0, 4, 6, 2 }, { 1, 3, 7, 5 },
+    { 0, 1, 5, 4 }, { 2, 6, 7, 3 },
+    { 0, 2, 3, 1 }, { 4, 5, 7, 6 },
+};
+
+// clip = (x, y, z, 1) * matrix
+static inline void transformPoint(const float matrix[16], float x, float y, float z, float clip[4]) {
+    for (int j = 0; j < 4; j++)
+        clip[j] = x * matrix[j] + y * matrix[4 + j] + z * matrix[8 + j] + matrix[12 + j];
+}
+
+static inline void multiply(const float a[16], const float b[16], float result[16]) {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++)
+            result[i * 4 + j] = a[i * 4] * b[j] + a[i * 4 + 1] * b[4 + j] + a[i * 4 + 2] * b[8 + j] + a[i * 4 + 3] * b[12 + j];
+    }
+}
+
+void OcclusionCuller::beginFrame(const float matrix[16]) {
+    for (int i = 0; i < 16; i++)
+        viewProjection[i] = matrix[i];
+
+    if (levels.empty()) {
+        for (int width = WIDTH, height = HEIGHT; width >= 1 && height >= 1; width /= 2, height /= 2) {
+            Level level;
+            level.width = width;
+            level.height = height;
+            level.minDepth.resize(size_t(width) * height);
+            if (!levels.empty())
+                level.maxDepth.resize(size_t(width) * height);
+            levels.push_back(level);
+        }
+    }
+
+    std::fill(levels[0].minDepth.begin(), levels[0].minDepth.end(), 0.0f);
+    stats = OcclusionStats();
+}
+
+void OcclusionCuller::selectOccluders(const InstanceBounds& bounds, const std::vector<int>& visible, size_t maxCount, std::vector<int>& occluders) const {
+    std::vector<std::pair<float, int>> candidates;
+    candidates.reserve(visible.size());
+    for (int i : visible) {
+        float clip[4];
+        transformPoint(viewProjection, bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], clip);
+        // A box around the camera would need near-plane clipping, it is never an occluder.
+        if (clip[3] <= bounds.radius[i])
+            continue;
+
+        float size = bounds.radius[i] / clip[3];
+        if (size >= MIN_OCCLUDER_SIZE)
+            candidates.push_back(std::make_pair(-size, i));
+    }
+
+    if (candidates.size() > maxCount) {
+        std::nth_element(candidates.begin(), candidates.begin() + maxCount, candidates.end());
+        candidates.resize(maxCount);
+    }
+    // Largest first, ties by id, so the selection does not depend on the order of `visible`.
+    std::sort(candidates.begin(), candidates.end());
+
+    occluders.resize(candidates.size());
+    for (size_t k = 0; k < candidates.size(); k++)
+        occluders[k] = candidates[k].second;
+}
+
+// Occluders crossing the near plane are dropped rather than clipped: losing one only makes
+// the culling less effective.
+void OcclusionCuller::setupOccluders(const float* matrices, size_t stride, const int* ids, size_t count,
+        const float localMin[3], const float localMax[3], std::vector<Triangle>& triangles) const {
+    triangles.clear();
+    for (size_t n = 0; n < count; n++) {
+        const float* world = reinterpret_cast<const float*>(reinterpret_cast<const char*>(matrices) + size_t(ids[n]) * stride);
+        float matrix[16];
+        multiply(world, viewProjection, matrix);
+
+        float screen[8][3];
+        bool clipped = false;
+        for (int k = 0; k < 8 && !clipped; k++) {
+            float clip[4];
+            transformPoint(matrix, (k & 1) ? localMax[0] : localMin[0], (k & 2) ? localMax[1] : localMin[1],
+                (k & 4) ? localMax[2] : localMin[2], clip);
+            clipped = clip[3] <= 0.0f || clip[2] > clip[3];
+            float invW = 1.0f / clip[3];
+            screen[k][0] = (clip[0] * invW * 0.5f + 0.5f) * WIDTH;
+            screen[k][1] = (0.5f - clip[1] * invW * 0.5f) * HEIGHT;
+            screen[k][2] = clip[2] * invW;
+        }
+        if (clipped)
+            continue;
+
+        for (int f = 0; f < 6; f++) {
+            for (int t = 0; t < 2; t++) {
+                const float* v0 = screen[boxFaces[f][0]];
+                const float* v1 = screen[boxFaces[f][t + 1]];
+                const float* v2 = screen[boxFaces[f][t + 2]];
+
+                float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+                if (area <= 1e-6f)
+                    continue;
+
+                Triangle triangle;
+                triangle.minX = (std::max)(int(floorf((std::min)({ v0[0], v1[0], v2[0] }))), 0);
+                triangle.maxX = (std::min)(int(ceilf((std::max)({ v0[0], v1[0], v2[0] }))), WIDTH - 1);
+                triangle.minY = (std::max)(int(floorf((std::min)({ v0[1], v1[1], v2[1] }))), 0);
+                triangle.maxY = (std::min)(int(ceilf((std::max)({ v0[1], v1[1], v2[1] }))), HEIGHT - 1);
+                if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+                    continue;
+
+                const float* v[3] = { v0, v1, v2 };
+                for (int e = 0; e < 3; e++) {
+                    const float* a = v[e];
+                    const float* b = v[(e + 1) % 3];
+                    triangle.edgeA[e] = a[1] - b[1];
+                    triangle.edgeB[e] = b[0] - a[0];
+                    triangle.edgeC[e] = -(triangle.edgeA[e] * a[0] + triangle.edgeB[e] * a[1]) + 0.5f * (triangle.edgeA[e] + triangle.edgeB[e]);
+                }
+
+                float invArea = 1.0f / area;
+                float dzdx = ((v1[2] - v0[2]) * (v2[1] - v0[1]) - (v2[2] - v0[2]) * (v1[1] - v0[1])) * invArea;
+                float dzdy = ((v2[2] - v0[2]) * (v1[0] - v0[0]) - (v1[2] - v0[2]) * (v2[0] - v0[0])) * invArea;
+                triangle.depth[0] = v0[2] - dzdx * v0[0] - dzdy * v0[1] + 0.5f * (dzdx + dzdy);
+                triangle.depth[1] = dzdx;
+                triangle.depth[2] = dzdy;
+                triangles.push_back(triangle);
+            }
+        }
+    }
+}
+
+// Every band owns its rows of the depth buffer, so bands are rasterized without locking.
+void OcclusionCuller::rasterizeBand(int firstRow, int lastRow) {
+    float* depthBuffer = levels[0].minDepth.data();
+    for (const auto& triangles : chunkTriangles) {
+        for (const Triangle& t : triangles) {
+            int minY = (std::max)(t.minY, firstRow);
+            int maxY = (std::min)(t.maxY, lastRow);
+
+#if defined(SIMD_AVX)
+            const int LANES = 8;
+#elif defined(SIMD_SSE)
+            const int LANES = 4;
+#else
+            const int LANES = 1;
+#endif
+            int minX = t.minX & ~(LANES - 1);
+
+            for (int y = minY; y <= maxY; y++) {
+                float* row = depthBuffer + y * WIDTH;
+                float e0 = t.edgeA[0] * minX + t.edgeB[0] * y + t.edgeC[0];
+                float e1 = t.edgeA[1] * minX + t.edgeB[1] * y + t.edgeC[1];
+                float e2 = t.edgeA[2] * minX + t.edgeB[2] * y + t.edgeC[2];
+                float z = t.depth[0] + t.depth[1] * minX + t.depth[2] * y;
+
+#if defined(SIMD_AVX)
+                const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+                __m256 edge0 = _mm256_add_ps(_mm256_set1_ps(e0), _mm256_mul_ps(lane, _mm256_set1_ps(t.edgeA[0])));
+                __m256 edge1 = _mm256_add_ps(_mm256_set1_ps(e1), _mm256_mul_ps(lane, _mm256_set1_ps(t.edgeA[1])));
+                __m256 edge2 = _mm256_add_ps(_mm256_set1_ps(e2), _mm256_mul_ps(lane, _mm256_set1_ps(t.edgeA[2])));
+                __m256 depth = _mm256_add_ps(_mm256_set1_ps(z), _mm256_mul_ps(lane, _mm256_set1_ps(t.depth[1])));
+                const __m256 step0 = _mm256_set1_ps(t.edgeA[0] * 8.0f);
+                const __m256 step1 = _mm256_set1_ps(t.edgeA[1] * 8.0f);
+                const __m256 step2 = _mm256_set1_ps(t.edgeA[2] * 8.0f);
+                const __m256 stepDepth = _mm256_set1_ps(t.depth[1] * 8.0f);
+                for (int x = minX; x <= t.maxX; x += 8) {
+                    __m256 inside = _mm256_and_ps(_mm256_and_ps(
+                        _mm256_cmp_ps(edge0, _mm256_setzero_ps(), _CMP_GE_OQ),
+                        _mm256_cmp_ps(edge1, _mm256_setzero_ps(), _CMP_GE_OQ)),
+                        _mm256_cmp_ps(edge2, _mm256_setzero_ps(), _CMP_GE_OQ));
+                    __m256 old = _mm256_loadu_ps(row + x);
+                    _mm256_storeu_ps(row + x, _mm256_max_ps(old, _mm256_and_ps(inside, depth)));
+
+                    edge0 = _mm256_add_ps(edge0, step0);
+                    edge1 = _mm256_add_ps(edge1, step1);
+                    edge2 = _mm256_add_ps(edge2, step2);
+                    depth = _mm256_add_ps(depth, stepDepth);
+                }
+#elif defined(SIMD_SSE)
+                const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+                __m128 edge0 = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(lane, _mm_set1_ps(t.edgeA[0])));
+                __m128 edge1 = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(lane, _mm_set1_ps(t.edgeA[1])));
+                __m128 edge2 = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(lane, _mm_set1_ps(t.edgeA[2])));
+                __m128 depth = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(lane, _mm_set1_ps(t.depth[1])));
+                const __m128 step0 = _mm_set1_ps(t.edgeA[0] * 4.0f);
+                const __m128 step1 = _mm_set1_ps(t.edgeA[1] * 4.0f);
+                const __m128 step2 = _mm_set1_ps(t.edgeA[2] * 4.0f);
+                const __m128 stepDepth = _mm_set1_ps(t.depth[1] * 4.0f);
+                for (int x = minX; x <= t.maxX; x += 4) {
+                    __m128 inside = _mm_and_ps(_mm_and_ps(
+                        _mm_cmpge_ps(edge0, _mm_setzero_ps()),
+                        _mm_cmpge_ps(edge1, _mm_setzero_ps())),
+                        _mm_cmpge_ps(edge2, _mm_setzero_ps()));
+                    __m128 old = _mm_loadu_ps(row + x);
+                    _mm_storeu_ps(row + x, _mm_max_ps(old, _mm_and_ps(inside, depth)));
+
+                    edge0 = _mm_add_ps(edge0, step0);
+                    edge1 = _mm_add_ps(edge1, step1);
+                    edge2 = _mm_add_ps(edge2, step2);
+                    depth = _mm_add_ps(depth, stepDepth);
+                }
+#else
+                for (int x = minX; x <= t.maxX; x++) {
+                    if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+                        row[x] = (std::max)(row[x], z);
+                    e0 += t.edgeA[0];
+                    e1 += t.edgeA[1];
+                    e2 += t.edgeA[2];
+                    z += t.depth[1];
+                }
+#endif
+            }
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid() {
+    for (size_t k = 1; k < levels.size(); k++) {
+        const Level& src = levels[k - 1];
+        Level& dst = levels[k];
+        const float* srcMin = src.minDepth.data();
+        const float* srcMax = k == 1 ? src.minDepth.data() : src.maxDepth.data();
+
+        for (int y = 0; y < dst.height; y++) {
+            const float* min0 = srcMin + (2 * y) * src.width;
+            const float* min1 = min0 + src.width;
+            const float* max0 = srcMax + (2 * y) * src.width;
+            const float* max1 = max0 + src.width;
+            float* dstMin = dst.minDepth.data() + y * dst.width;
+            float* dstMax = dst.maxDepth.data() + y * dst.width;
+
+            int x = 0;
+#if defined(SIMD_SSE)
+            for (; x + 4 <= dst.width; x += 4) {
+                __m128 lo = _mm_min_ps(_mm_loadu_ps(min0 + 2 * x), _mm_loadu_ps(min1 + 2 * x));
+                __m128 hi = _mm_min_ps(_mm_loadu_ps(min0 + 2 * x + 4), _mm_loadu_ps(min1 + 2 * x + 4));
+                _mm_storeu_ps(dstMin + x, _mm_min_ps(
+                    _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))));
+
+                lo = _mm_max_ps(_mm_loadu_ps(max0 + 2 * x), _mm_loadu_ps(max1 + 2 * x));
+                hi = _mm_max_ps(_mm_loadu_ps(max0 + 2 * x + 4), _mm_loadu_ps(max1 + 2 * x + 4));
+                _mm_storeu_ps(dstMax + x, _mm_max_ps(
+                    _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))));
+            }
+#endif
+            for (; x < dst.width; x++) {
+                dstMin[x] = (std::min)((std::min)(min0[2 * x], min0[2 * x + 1]), (std::min)(min1[2 * x], min1[2 * x + 1]));
+                dstMax[x] = (std::max)((std::max)(max0[2 * x], max0[2 * x + 1]), (std::max)(max1[2 * x], max1[2 * x + 1]));
+            }
+        }
+    }
+}
+
+void OcclusionCuller::renderOccluders(const float* matrices, size_t stride, const std::vector<int>& ids, const float localMin[3], const float localMax[3]) {
+    JobSystem& jobs = JobSystem::GetInstance();
+
+    chunkTriangles.resize((ids.size() + OCCLUDER_CHUNK - 1) / OCCLUDER_CHUNK);
+    jobs.parallelFor(ids.size(), OCCLUDER_CHUNK, [&](size_t begin, size_t end) {
+        setupOccluders(matrices, stride, ids.data() + begin, end - begin, localMin, localMax, chunkTriangles[begin / OCCLUDER_CHUNK]);
+    });
+
+    stats.occluders = ids.size();
+    for (const auto& triangles : chunkTriangles)
+        stats.triangles += triangles.size();
+
+    jobs.parallelFor(HEIGHT / BAND_ROWS, 1, [&](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; band++)
+            rasterizeBand(int(band) * BAND_ROWS, int(band + 1) * BAND_ROWS - 1);
+    });
+
+    buildPyramid();
+}
+
+// Screen rectangle (min x, min y, max x, max y in pixels) and the largest depth of the box
+// corners. False when the box reaches behind the near plane and has no usable rectangle.
+bool OcclusionCuller::projectBox(const float bbMin[3], const float bbMax[3], float rect[4], float& nearestDepth) const {
+    const float* m = viewProjection;
+#if defined(SIMD_SSE)
+    // Lanes are the corners 0-3 (z from bbMin) and 4-7 (z from bbMax).
+    __m128 x = _mm_setr_ps(bbMin[0], bbMax[0], bbMin[0], bbMax[0]);
+    __m128 y = _mm_setr_ps(bbMin[1], bbMin[1], bbMax[1], bbMax[1]);
+    __m128 clip[2][4];
+    for (int j = 0; j < 4; j++) {
+        __m128 xy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m[j])), _mm_mul_ps(y, _mm_set1_ps(m[4 + j]))), _mm_set1_ps(m[12 + j]));
+        clip[0][j] = _mm_add_ps(xy, _mm_set1_ps(bbMin[2] * m[8 + j]));
+        clip[1][j] = _mm_add_ps(xy, _mm_set1_ps(bbMax[2] * m[8 + j]));
+    }
+
+    __m128 minX = _mm_set1_ps(FLT_MAX), minY = _mm_set1_ps(FLT_MAX);
+    __m128 maxX = _mm_set1_ps(-FLT_MAX), maxY = _mm_set1_ps(-FLT_MAX), maxZ = _mm_setzero_ps();
+    int clipped = 0;
+    for (int h = 0; h < 2; h++) {
+        __m128 w = clip[h][3];
+        clipped |= _mm_movemask_ps(_mm_or_ps(_mm_cmple_ps(w, _mm_setzero_ps()), _mm_cmpgt_ps(clip[h][2], w)));
+        __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), w);
+        __m128 sx = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[h][0], invW), _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f)), _mm_set1_ps(float(WIDTH)));
+        __m128 sy = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(_mm_mul_ps(clip[h][1], invW), _mm_set1_ps(0.5f))), _mm_set1_ps(float(HEIGHT)));
+        minX = _mm_min_ps(minX, sx);
+        maxX = _mm_max_ps(maxX, sx);
+        minY = _mm_min_ps(minY, sy);
+        maxY = _mm_max_ps(maxY, sy);
+        maxZ = _mm_max_ps(maxZ, _mm_mul_ps(clip[h][2], invW));
+    }
+    if (clipped)
+        return false;
+
+    float lanes[5][4];
+    _mm_storeu_ps(lanes[0], minX);
+    _mm_storeu_ps(lanes[1], minY);
+    _mm_storeu_ps(lanes[2], maxX);
+    _mm_storeu_ps(lanes[3], maxY);
+    _mm_storeu_ps(lanes[4], maxZ);
+    for (int r = 0; r < 4; r++)
+        rect[r] = r < 2 ? (std::min)((std::min)(lanes[r][0], lanes[r][1]), (std::min)(lanes[r][2], lanes[r][3]))
+                        : (std::max)((std::max)(lanes[r][0], lanes[r][1]), (std::max)(lanes[r][2], lanes[r][3]));
+    nearestDepth = (std::max)((std::max)(lanes[4][0], lanes[4][1]), (std::max)(lanes[4][2], lanes[4][3]));
+#else
+    rect[0] = rect[1] = FLT_MAX;
+    rect[2] = rect[3] = -FLT_MAX;
+    nearestDepth = 0.0f;
+    for (int k = 0; k < 8; k++) {
+        float clip[4];
+        transformPoint(m, (k & 1) ? bbMax[0] : bbMin[0], (k & 2) ? bbMax[1] : bbMin[1], (k & 4) ? bbMax[2] : bbMin[2], clip);
+        if (clip[3] <= 0.0f || clip[2] > clip[3])
+            return false;
+
+        float invW = 1.0f / clip[3];
+        float sx = (clip[0] * invW * 0.5f + 0.5f) * WIDTH;
+        float sy = (0.5f - clip[1] * invW * 0.5f) * HEIGHT;
+        rect[0] = (std::min)(rect[0], sx);
+        rect[1] = (std::min)(rect[1], sy);
+        rect[2] = (std::max)(rect[2], sx);
+        rect[3] = (std::max)(rect[3], sy);
+        nearestDepth = (std::max)(nearestDepth, clip[2] * invW);
+    }
+#endif
+    return true;
+}
+
+// The box is first tested at the level where its rectangle spans at most 2x2 texels. The min
+// depth there decides occlusion, the max depth a box in front of everything; a box between
+// the two is tested again two levels finer, where the min depth is tighter.
+bool OcclusionCuller::isBoxVisible(const float bbMin[3], const float bbMax[3]) const {
+    float rect[4];
+    float nearestDepth;
+    if (!projectBox(bbMin, bbMax, rect, nearestDepth))
+        return true;
+    if (rect[2] < 0.0f || rect[3] < 0.0f || rect[0] >= WIDTH || rect[1] >= HEIGHT)
+        return true;
+
+    int x0 = (std::max)(int(rect[0]), 0);
+    int y0 = (std::max)(int(rect[1]), 0);
+    int x1 = (std::min)(int(rect[2]), WIDTH - 1);
+    int y1 = (std::min)(int(rect[3]), HEIGHT - 1);
+
+    int level = 0;
+    while (level + 1 < int(levels.size()) && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        level++;
+
+    auto regionDepth = [&](int k, float& minDepth, float& maxDepth) {
+        const Level& l = levels[k];
+        const float* maxData = k == 0 ? l.minDepth.data() : l.maxDepth.data();
+        minDepth = FLT_MAX;
+        maxDepth = 0.0f;
+        for (int y = y0 >> k; y <= (y1 >> k); y++) {
+            for (int x = x0 >> k; x <= (x1 >> k); x++) {
+                minDepth = (std::min)(minDepth, l.minDepth[y * l.width + x]);
+                maxDepth = (std::max)(maxDepth, maxData[y * l.width + x]);
+            }
+        }
+    };
+
+    float minDepth, maxDepth;
+    regionDepth(level, minDepth, maxDepth);
+    if (nearestDepth < minDepth)
+        return false;
+    if (nearestDepth >= maxDepth || level == 0)
+        return true;
+
+    regionDepth((std::max)(level - 2, 0), minDepth, maxDepth);
+    return nearestDepth >= minDepth;
+}
+
+size_t OcclusionCuller::cull(const InstanceBounds& bounds, std::vector<int>& visible) {
+    stats.tested = visible.size();
+    if (stats.triangles == 0)
+        return visible.size();
+
+    occludedFlags.resize(visible.size());
+    JobSystem::GetInstance().parallelFor(visible.size(), TEST_CHUNK, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            float bbMin[3], bbMax[3];
+            bounds.getBox(visible[k], bbMin, bbMax);
+            occludedFlags[k] = !isBoxVisible(bbMin, bbMax);
+        }
+    });
+
+    size_t count = 0;
+    for (size_t k = 0; k < visible.size(); k++) {
+        visible[count] = visible[k];
+        count += !occludedFlags[k];
+    }
+    stats.occluded = visible.size() - count;
+    visible.resize(count);
+
+    return count;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "instanceBounds.h"
+
+struct OcclusionStats {
+	size_t occluders = 0;
+	size_t triangles = 0; // occluder triangles that reached the rasterizer
+	size_t tested = 0;
+	size_t occluded = 0;
+};
+
+// Software occlusion culling on a small depth buffer. The largest visible boxes are
+// rasterized as occluders, the depth is reduced to a min/max pyramid and every candidate box
+// is then tested against the pyramid level where its screen rectangle covers a few texels.
+//
+// Depth follows the renderer: reversed (1 at the near plane, 0 at the far plane) and tested
+// with GREATER_EQUAL, so the buffer is cleared to 0 and occluders keep the larger value.
+// Matrices are row-major with the row-vector convention, as XMMATRIX.
+class OcclusionCuller {
+public:
+	static const int WIDTH = 256;
+	static const int HEIGHT = 128;
+
+	// Clears the depth buffer for the view-projection of the frame.
+	void beginFrame(const float viewProjection[16]);
+
+	// Picks up to `maxCount` of the `visible` boxes that look the largest on screen.
+	void selectOccluders(const InstanceBounds& bounds, const std::vector<int>& visible, size_t maxCount, std::vector<int>& occluders) const;
+
+	// Rasterizes the boxes [localMin, localMax] placed by the world matrices of `ids`.
+	// Matrices are read `stride` bytes apart, as InstanceBounds::transform. Builds the pyramid.
+	void renderOccluders(const float* matrices, size_t stride, const std::vector<int>& ids, const float localMin[3], const float localMax[3]);
+
+	// Conservative: false only when the box is behind the occluders everywhere it covers.
+	bool isBoxVisible(const float bbMin[3], const float bbMax[3]) const;
+
+	// Removes the occluded boxes from `visible`, keeping the order of the rest.
+	size_t cull(const InstanceBounds& bounds, std::vector<int>& visible);
+
+	// WIDTH x HEIGHT occluder depth, rows top to bottom.
+	const float* getDepth() const { return levels[0].minDepth.data(); };
+	const OcclusionStats& getStats() const { return stats; };
+
+private:
+	// Edge k is inside when edgeA[k] * x + edgeB[k] * y + edgeC[k] >= 0 for the pixel (x, y),
+	// the pixel center offset is folded into edgeC and depth[0].
+	struct Triangle {
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depth[3]; // depth[0] + depth[1] * x + depth[2] * y
+		int minX, maxX, minY, maxY;
+	};
+
+	// Level 0 is the depth buffer itself and only keeps minDepth.
+	struct Level {
+		int width;
+		int height;
+		std::vector<float> minDepth;
+		std::vector<float> maxDepth;
+	};
+
+	void setupOccluders(const float* matrices, size_t stride, const int* ids, size_t count,
+		const float localMin[3], const float localMax[3], std::vector<Triangle>& triangles) const;
+	void rasterizeBand(int firstRow, int lastRow);
+	void buildPyramid();
+	bool projectBox(const float bbMin[3], const float bbMax[3], float rect[4], float& nearestDepth) const;
+
+	float viewProjection[16];
+	std::vector<Level> levels;
+	std::vector<std::vector<Triangle>> chunkTriangles; // setup output of every occluder chunk
+	std::vector<uint8_t> occludedFlags;
+	OcclusionStats stats;
+};
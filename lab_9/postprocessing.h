@@ -1,31 +1,67 @@
-#pragma once
-
-#include <d3d11.h>
-#include <d3dcompiler.h>
-#include <directxmath.h>
-
-#include "timer.h"
-
-using namespace DirectX;
-
-struct PostprocessingCB {
-	XMINT4 params; // x - use posteffect, y - screen width, z - screen height
-};
-
-class Postprocessing {
-public:
-	HRESULT init(ID3D11Device* device, HWND hwnd, int screenWidth, int screenHeight);
-	void realize();
-	void render(ID3D11DeviceContext* context, ID3D11ShaderResourceView* sourceTexture, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport);
-	bool frame(ID3D11DeviceContext* context, bool usePosteffect);
-	void resize(int screenWidth, int screenHeight);
-
-private:
-	ID3D11VertexShader* g_pVertexShader = nullptr;
-	ID3D11PixelShader* g_pPixelShader = nullptr;
-	ID3D11SamplerState* g_pSamplerState = nullptr;
-	ID3D11Buffer* g_pPostprocessingCB = nullptr;
-
-	int m_screenWidth;
-	int m_screenHeight;
-};
\ No newline at end of file
+#pragma once
+
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <directxmath.h>
+#include <vector>
+
+#include "timer.h"
+#include "commandList.h"
+#include "renderTargetPool.h"
+
+using namespace DirectX;
+
+enum PostEffect {
+	POST_EFFECT_SOBEL = 0,
+	POST_EFFECT_BLUR = 1,     // separable gaussian, a horizontal and a vertical pass
+	POST_EFFECT_TONE_MAP = 2, // exposure and Reinhard
+	POST_EFFECT_COUNT
+};
+
+// Pass of PostprocessingPixelShader, params.x of PostprocessingCB
+enum PostPass {
+	POST_PASS_COPY = 0,
+	POST_PASS_SOBEL = 1,
+	POST_PASS_BLUR = 2,
+	POST_PASS_TONE_MAP = 3,
+};
+
+struct PostprocessingCB {
+	XMINT4 params;     // x - pass, y - screen width, z - screen height, w - blur direction (0 - x, 1 - y)
+	XMFLOAT4 settings; // x - exposure
+};
+
+// Runs an ordered chain of effects over the scene texture. Every pass but the last draws into
+// a target of the RenderTargetPool and the next one samples it, so the passes alternate
+// between two pooled targets however long the chain is; the last pass draws into the given
+// render target, and an empty chain copies the scene there.
+class Postprocessing {
+public:
+	HRESULT init(ID3D11Device* device, HWND hwnd, int screenWidth, int screenHeight, RenderTargetPool* targetPool);
+	void realize();
+	void render(CommandList& commands, ID3D11ShaderResourceView* sourceTexture, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport);
+	void frame(const std::vector<PostEffect>& effects, float exposure);
+	void resize(int screenWidth, int screenHeight);
+
+	size_t getPassCount() const { return passes.size(); };
+
+private:
+	struct Pass {
+		PostPass pass;
+		int direction;
+	};
+
+	void renderPass(CommandList& commands, const Pass& pass, ID3D11ShaderResourceView* sourceTexture, ID3D11RenderTargetView* renderTarget, D3D11_VIEWPORT viewport);
+
+	ID3D11VertexShader* g_pVertexShader = nullptr;
+	ID3D11PixelShader* g_pPixelShader = nullptr;
+	ID3D11SamplerState* g_pSamplerState = nullptr;
+	uint32_t constantsBlock = newConstantBlock();
+
+	RenderTargetPool* pool = nullptr;
+	std::vector<Pass> passes;
+	float m_exposure = 1.0f;
+
+	int m_screenWidth;
+	int m_screenHeight;
+};
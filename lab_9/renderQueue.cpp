@@ -0,0 +1,62 @@
+#include <cstring>
+#include <utility>
+
+#include "renderQueue.h"
+
+// Bits of a non-negative float order like the float itself.
+static inline uint32_t depthBits(float depth) {
+    if (!(depth > 0.0f))
+        return 0;
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits;
+}
+
+uint64_t makeOpaqueKey(RenderPass pass, uint32_t shader, uint32_t material, float depth) {
+    return (uint64_t(pass & 0xF) << 60) | (uint64_t(shader & 0xFFF) << 48) | (uint64_t(material & 0xFFFF) << 32) |
+        uint64_t(depthBits(depth));
+}
+
+uint64_t makeTransparentKey(RenderPass pass, float depth, uint32_t shader, uint32_t material) {
+    return (uint64_t(pass & 0xF) << 60) | (uint64_t(~depthBits(depth)) << 28) | (uint64_t(shader & 0xFFF) << 16) |
+        uint64_t(material & 0xFFFF);
+}
+
+void radixSort(DrawPacket* packets, DrawPacket* scratch, size_t count) {
+    if (count < 2)
+        return;
+
+    size_t histograms[8][256] = {};
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = packets[i].key;
+        for (int pass = 0; pass < 8; pass++)
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+    }
+
+    DrawPacket* source = packets;
+    DrawPacket* destination = scratch;
+    for (int pass = 0; pass < 8; pass++) {
+        size_t* histogram = histograms[pass];
+        uint8_t firstByte = uint8_t(source[0].key >> (pass * 8));
+        if (histogram[firstByte] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            size_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; i++)
+            destination[histogram[(source[i].key >> (pass * 8)) & 0xFF]++] = source[i];
+        std::swap(source, destination);
+    }
+
+    if (source != packets)
+        memcpy(packets, source, count * sizeof(DrawPacket));
+}
+
+void RenderQueue::sort() {
+    scratch.resize(packets.size());
+    radixSort(packets.data(), scratch.data(), packets.size());
+}
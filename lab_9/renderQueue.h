@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum RenderPass : uint32_t {
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_SKY = 1,
+	RENDER_PASS_TRANSPARENT = 2,
+};
+
+// `object` says who draws the packet and `item` what it draws, both are up to the submitter.
+struct DrawPacket {
+	uint64_t key;
+	uint32_t object;
+	uint32_t item;
+};
+
+// Keys sort ascending. The pass is in the top 4 bits, then
+//   opaque and sky: shader (12 bits), material (16 bits), depth front to back (32 bits)
+//   transparent:    depth back to front (32 bits), shader (12 bits), material (16 bits)
+// Depth is the view distance, negative distances count as 0.
+uint64_t makeOpaqueKey(RenderPass pass, uint32_t shader, uint32_t material, float depth);
+uint64_t makeTransparentKey(RenderPass pass, float depth, uint32_t shader, uint32_t material);
+
+// Stable LSD radix sort by key, 8 bits per pass; passes where every key has the same byte
+// are skipped. `scratch` must hold `count` packets; the result ends up in `packets`.
+void radixSort(DrawPacket* packets, DrawPacket* scratch, size_t count);
+
+// Packets of one frame: submitted in any order, sorted once, then replayed in key order.
+class RenderQueue {
+public:
+	void clear() { packets.clear(); };
+	void submit(uint64_t key, uint32_t object, uint32_t item) { packets.push_back({ key, object, item }); };
+	void sort();
+
+	const std::vector<DrawPacket>& getPackets() const { return packets; };
+
+private:
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+};
@@ -0,0 +1,78 @@
+#include "renderTargetPool.h"
+
+#include <cassert>
+
+void RenderTargetPool::init(RenderTargetDevice* targetDevice, uint32_t idleFrames) {
+    device = targetDevice;
+    maxIdleFrames = idleFrames;
+}
+
+void RenderTargetPool::clear() {
+    for (Entry& entry : entries) {
+        assert(!entry.inUse);
+        if (entry.live)
+            destroy(entry);
+    }
+    entries.clear();
+}
+
+int RenderTargetPool::acquire(const RenderTargetDesc& desc) {
+    int slot = -1;
+    for (size_t i = 0; i < entries.size(); i++) {
+        Entry& entry = entries[i];
+        if (entry.live && !entry.inUse && entry.desc == desc) {
+            entry.inUse = true;
+            entry.idleFrames = 0;
+            stats.reused++;
+            stats.inUse++;
+            return (int)i;
+        }
+        if (!entry.live && slot < 0)
+            slot = (int)i;
+    }
+
+    Entry entry = {};
+    entry.desc = desc;
+    if (!device || !device->create(desc, entry.target))
+        return -1;
+    entry.live = true;
+    entry.inUse = true;
+
+    if (slot < 0) {
+        slot = (int)entries.size();
+        entries.push_back(entry);
+    }
+    else {
+        entries[slot] = entry;
+    }
+    stats.created++;
+    stats.live++;
+    stats.inUse++;
+    return slot;
+}
+
+void RenderTargetPool::release(int target) {
+    Entry& entry = entries[target];
+    assert(entry.live && entry.inUse);
+    entry.inUse = false;
+    stats.inUse--;
+}
+
+void RenderTargetPool::endFrame() {
+    for (Entry& entry : entries) {
+        if (!entry.live || entry.inUse)
+            continue;
+        if (++entry.idleFrames > maxIdleFrames)
+            destroy(entry);
+    }
+    while (!entries.empty() && !entries.back().live)
+        entries.pop_back();
+}
+
+void RenderTargetPool::destroy(Entry& entry) {
+    device->release(entry.target);
+    entry.target = RenderTarget();
+    entry.live = false;
+    stats.released++;
+    stats.live--;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "commandList.h"
+
+// A texture that is drawn to and then sampled; the handles are the backend's.
+struct RenderTarget {
+	GpuHandle texture = nullptr;
+	GpuHandle renderTargetView = nullptr;
+	GpuHandle shaderResourceView = nullptr;
+};
+
+// What pooled targets are told apart by; `format` is the backend's, a DXGI_FORMAT on D3D11.
+struct RenderTargetDesc {
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+
+	bool operator==(const RenderTargetDesc& other) const { return width == other.width && height == other.height && format == other.format; };
+};
+
+// Creates and releases the textures behind a RenderTargetPool, D3D11RenderTargetDevice on D3D11.
+class RenderTargetDevice {
+public:
+	virtual ~RenderTargetDevice() {};
+	virtual bool create(const RenderTargetDesc& desc, RenderTarget& target) = 0;
+	virtual void release(RenderTarget& target) = 0;
+};
+
+struct RenderTargetPoolStats {
+	size_t created = 0;  // over the life of the pool
+	size_t released = 0;
+	size_t reused = 0;   // acquires served by a free target
+	size_t live = 0;     // targets held now
+	size_t inUse = 0;
+};
+
+// Transient render targets. acquire hands out a free target of the same size and format, or
+// creates one, and release gives it back, so a pass can take the target an earlier pass of the
+// same frame is done with: effects that alternate between two targets never hold more than
+// two. Free targets no acquire asked for during `maxIdleFrames` frames are released by
+// endFrame, which is how the targets of an old window size go after a resize while those of
+// the sizes still in use stay.
+class RenderTargetPool {
+public:
+	void init(RenderTargetDevice* device, uint32_t maxIdleFrames = 2);
+	// Releases every target; none may be in use.
+	void clear();
+
+	// Index of the target, -1 when the device could not create one.
+	int acquire(const RenderTargetDesc& desc);
+	void release(int target);
+	void endFrame();
+
+	const RenderTarget& getTarget(int target) const { return entries[target].target; };
+	const RenderTargetDesc& getDesc(int target) const { return entries[target].desc; };
+	const RenderTargetPoolStats& getStats() const { return stats; };
+
+private:
+	struct Entry {
+		RenderTargetDesc desc;
+		RenderTarget target;
+		uint32_t idleFrames;
+		bool live;
+		bool inUse;
+	};
+
+	void destroy(Entry& entry);
+
+	RenderTargetDevice* device = nullptr;
+	uint32_t maxIdleFrames = 2;
+	std::vector<Entry> entries; // the slots of released targets are taken by the next ones created
+	RenderTargetPoolStats stats;
+};
@@ -1,22 +1,44 @@
-#pragma once
-
-#include <d3d11.h>
-
-class RenderTexture {
-public:
-	HRESULT init(ID3D11Device* device, int screenWidth, int screenHeight);
-	void realize();
-	void resize(ID3D11Device* device, int screenWidth, int screenHeight);
-	void setRenderTarget(ID3D11DeviceContext* deviceContext, ID3D11DepthStencilView* depthStencilView) { deviceContext->OMSetRenderTargets(1, &g_pRenderTargetView, depthStencilView); };
-	void clearRenderTarget(ID3D11DeviceContext* deviceContext, ID3D11DepthStencilView* depthStencilView, float red, float green, float blue, float alpha);
-	ID3D11Texture2D* getRenderTarget() { return g_pRenderTargetTexture; };
-	ID3D11RenderTargetView* getRenderTargetView() { return g_pRenderTargetView; };
-	ID3D11ShaderResourceView* getShaderResourceView() { return g_pShaderResourceView; };
-	D3D11_VIEWPORT getViewPort() { return g_viewport; };
-
-private:
-	ID3D11Texture2D* g_pRenderTargetTexture = nullptr;
-	ID3D11RenderTargetView* g_pRenderTargetView = nullptr;
-	ID3D11ShaderResourceView* g_pShaderResourceView = nullptr;
-	D3D11_VIEWPORT g_viewport;
+#pragma once
+
+#include <d3d11.h>
+
+#include "commandList.h"
+#include "renderTargetPool.h"
+
+// A texture of `format` with its render target and shader resource views.
+HRESULT createRenderTargetTexture(ID3D11Device* device, UINT width, UINT height, DXGI_FORMAT format,
+	ID3D11Texture2D** texture, ID3D11RenderTargetView** renderTargetView, ID3D11ShaderResourceView** shaderResourceView);
+
+// Creates the targets of a RenderTargetPool with createRenderTargetTexture.
+class D3D11RenderTargetDevice : public RenderTargetDevice {
+public:
+	void init(ID3D11Device* device) { g_pDevice = device; };
+	bool create(const RenderTargetDesc& desc, RenderTarget& target) override;
+	void release(RenderTarget& target) override;
+
+private:
+	ID3D11Device* g_pDevice = nullptr;
+};
+
+class RenderTexture {
+public:
+	HRESULT init(ID3D11Device* device, int screenWidth, int screenHeight);
+	void realize();
+	// Keeps the texture when the size did not change.
+	HRESULT resize(ID3D11Device* device, int screenWidth, int screenHeight);
+	void setRenderTarget(CommandList& commands, ID3D11DepthStencilView* depthStencilView) { commands.setRenderTargets(1, &g_pRenderTargetView, depthStencilView); };
+	void clearRenderTarget(CommandList& commands, ID3D11DepthStencilView* depthStencilView, float red, float green, float blue, float alpha);
+	ID3D11Texture2D* getRenderTarget() { return g_pRenderTargetTexture; };
+	ID3D11RenderTargetView* getRenderTargetView() { return g_pRenderTargetView; };
+	ID3D11ShaderResourceView* getShaderResourceView() { return g_pShaderResourceView; };
+	D3D11_VIEWPORT getViewPort() { return g_viewport; };
+
+private:
+	ID3D11Texture2D* g_pRenderTargetTexture = nullptr;
+	ID3D11RenderTargetView* g_pRenderTargetView = nullptr;
+	ID3D11ShaderResourceView* g_pShaderResourceView = nullptr;
+	D3D11_VIEWPORT g_viewport;
+
+	int m_width = 0;
+	int m_height = 0;
 };
\ No newline at end of file
@@ -1,400 +1,481 @@
-#include "Renderer.h"
-#include "imgui/imgui.h"
-#include "imgui/imgui_impl_dx11.h"
-#include "imgui/imgui_impl_win32.h"
-
-using namespace DirectX;
-
-Renderer& Renderer::getInstance() {
-    static Renderer rendererInstance;
-    return rendererInstance;
-}
-
-HRESULT Renderer::initDevice(const HWND& g_hWnd) {
-    HRESULT hr = S_OK;
-
-    RECT rc;
-    GetClientRect(g_hWnd, &rc);
-    UINT width = rc.right - rc.left;
-    UINT height = rc.bottom - rc.top;
-
-    UINT createDeviceFlags = 0;
-
-#ifdef _DEBUG
-    createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
-
-    D3D_DRIVER_TYPE driverTypes[] =
-    {
-        D3D_DRIVER_TYPE_HARDWARE,
-        D3D_DRIVER_TYPE_WARP,
-        D3D_DRIVER_TYPE_REFERENCE,
-    };
-    UINT numDriverTypes = ARRAYSIZE(driverTypes);
-
-    D3D_FEATURE_LEVEL featureLevels[] =
-    {
-        D3D_FEATURE_LEVEL_11_1,
-        D3D_FEATURE_LEVEL_11_0,
-        D3D_FEATURE_LEVEL_10_1,
-        D3D_FEATURE_LEVEL_10_0,
-    };
-    UINT numFeatureLevels = ARRAYSIZE(featureLevels);
-
-    for (UINT driverTypeIndex = 0; driverTypeIndex < numDriverTypes; driverTypeIndex++)
-    {
-        g_driverType = driverTypes[driverTypeIndex];
-        hr = D3D11CreateDevice(nullptr, g_driverType, nullptr, createDeviceFlags, featureLevels, numFeatureLevels,
-            D3D11_SDK_VERSION, &g_pd3dDevice, &g_featureLevel, &g_pImmediateContext);
-
-        if (hr == E_INVALIDARG)
-        {
-            hr = D3D11CreateDevice(nullptr, g_driverType, nullptr, createDeviceFlags, &featureLevels[1], numFeatureLevels - 1,
-                D3D11_SDK_VERSION, &g_pd3dDevice, &g_featureLevel, &g_pImmediateContext);
-        }
-
-        if (SUCCEEDED(hr))
-            break;
-    }
-    if (FAILED(hr))
-        return hr;
-
-    IDXGIFactory1* dxgiFactory = nullptr;
-    {
-        IDXGIDevice* dxgiDevice = nullptr;
-        hr = g_pd3dDevice->QueryInterface(__uuidof(IDXGIDevice), reinterpret_cast<void**>(&dxgiDevice));
-        if (SUCCEEDED(hr))
-        {
-            IDXGIAdapter* adapter = nullptr;
-            hr = dxgiDevice->GetAdapter(&adapter);
-            if (SUCCEEDED(hr))
-            {
-                hr = adapter->GetParent(__uuidof(IDXGIFactory1), reinterpret_cast<void**>(&dxgiFactory));
-                adapter->Release();
-            }
-            dxgiDevice->Release();
-        }
-    }
-    if (FAILED(hr))
-        return hr;
-
-    IDXGIFactory2* dxgiFactory2 = nullptr;
-    hr = dxgiFactory->QueryInterface(__uuidof(IDXGIFactory2), reinterpret_cast<void**>(&dxgiFactory2));
-    if (dxgiFactory2)
-    {
-        hr = g_pd3dDevice->QueryInterface(__uuidof(ID3D11Device1), reinterpret_cast<void**>(&g_pd3dDevice1));
-        if (SUCCEEDED(hr))
-        {
-            (void)g_pImmediateContext->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&g_pImmediateContext1));
-        }
-
-        DXGI_SWAP_CHAIN_DESC1 sd;
-        ZeroMemory(&sd, sizeof(sd));
-        sd.Width = width;
-        sd.Height = height;
-        sd.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        sd.SampleDesc.Count = 1;
-        sd.SampleDesc.Quality = 0;
-        sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-        sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
-        sd.BufferCount = 2;
-
-        hr = dxgiFactory2->CreateSwapChainForHwnd(g_pd3dDevice, g_hWnd, &sd, nullptr, nullptr, &g_pSwapChain1);
-        if (SUCCEEDED(hr))
-        {
-            hr = g_pSwapChain1->QueryInterface(__uuidof(IDXGISwapChain), reinterpret_cast<void**>(&g_pSwapChain));
-        }
-
-        dxgiFactory2->Release();
-    }
-    else
-    {
-        DXGI_SWAP_CHAIN_DESC sd;
-        ZeroMemory(&sd, sizeof(sd));
-        sd.BufferCount = 2;
-        sd.BufferDesc.Width = width;
-        sd.BufferDesc.Height = height;
-        sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        sd.BufferDesc.RefreshRate.Numerator = 60;
-        sd.BufferDesc.RefreshRate.Denominator = 1;
-        sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-        sd.OutputWindow = g_hWnd;
-        sd.SampleDesc.Count = 1;
-        sd.SampleDesc.Quality = 0;
-        sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
-        sd.Windowed = TRUE;
-
-        hr = dxgiFactory->CreateSwapChain(g_pd3dDevice, &sd, &g_pSwapChain);
-    }
-
-    dxgiFactory->MakeWindowAssociation(g_hWnd, DXGI_MWA_NO_ALT_ENTER);
-
-    dxgiFactory->Release();
-
-    if (FAILED(hr))
-        return hr;
-
-    hr = initBackBuffer();
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_VIEWPORT vp;
-    vp.Width = (FLOAT)width;
-    vp.Height = (FLOAT)height;
-    vp.MinDepth = 0.0f;
-    vp.MaxDepth = 1.0f;
-    vp.TopLeftX = 0;
-    vp.TopLeftY = 0;
-    g_pImmediateContext->RSSetViewports(1, &vp);
-
-    scene.init(g_pd3dDevice, g_pImmediateContext, width, height);
-
-    return S_OK;
-}
-
-HRESULT Renderer::initBackBuffer() {
-    ID3D11Texture2D* pBackBuffer = NULL;
-    HRESULT hr = g_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    hr = g_pd3dDevice->CreateRenderTargetView(pBackBuffer, NULL, &g_pRenderTargetView);
-    if (pBackBuffer) pBackBuffer->Release();
-    if (FAILED(hr))
-        return hr;
-
-    g_pImmediateContext->OMSetRenderTargets(1, &g_pRenderTargetView, nullptr);
-
-    if (g_pDepthBuffer) g_pDepthBuffer->Release();
-    if (g_pDepthBufferDSV) g_pDepthBufferDSV->Release();
-
-    D3D11_TEXTURE2D_DESC desc = {};
-    desc.Format = DXGI_FORMAT_D32_FLOAT;
-    desc.ArraySize = 1;
-    desc.MipLevels = 1;
-    desc.Usage = D3D11_USAGE_DEFAULT;
-    desc.Height = m_height;
-    desc.Width = m_width;
-    desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-    desc.CPUAccessFlags = 0;
-    desc.MiscFlags = 0;
-    desc.SampleDesc.Count = 1;
-    desc.SampleDesc.Quality = 0;
-
-    hr = g_pd3dDevice->CreateTexture2D(&desc, NULL, &g_pDepthBuffer);
-    if (FAILED(hr))
-        return hr;
-
-    hr = g_pd3dDevice->CreateDepthStencilView(g_pDepthBuffer, NULL, &g_pDepthBufferDSV);
-    return hr;
-}
-
-HRESULT Renderer::init(const HWND& g_hWnd, const HINSTANCE& g_hInstance, UINT screenWidth, UINT screenHeight) {
-    resize(screenWidth, screenHeight);
-
-    m_fixFrustumCulling = false;
-    m_usePosteffect = false;
-
-    m_rbPressed = false;
-    m_prevMouseX = 0;
-    m_prevMouseY = 0;
-
-    m_modes[0] = "CPU";
-    m_modes[1] = "Instancing";
-    m_modes[2] = "GPU Culling + Instancing";
-
-    m_totalFrameTime[0] = 0;
-    m_totalFrameTime[1] = 0;
-    m_totalFrameTime[2] = 0;
-
-    m_totalRenderTime[0] = 0;
-    m_totalRenderTime[1] = 0;
-    m_totalRenderTime[2] = 0;
-
-    m_frameCount[0] = 0;
-    m_frameCount[1] = 0;
-    m_frameCount[2] = 0;
-
-    HRESULT hr = camera.init();
-    if (FAILED(hr))
-        return hr;
-
-    hr = initDevice(g_hWnd);
-    if (FAILED(hr))
-        return hr;
-
-    hr = renderTexture.init(g_pd3dDevice, screenWidth, screenHeight);
-    if (FAILED(hr))
-        return hr;
-
-    hr = postprocessing.init(g_pd3dDevice, g_hWnd, screenWidth, screenHeight);
-    if (FAILED(hr))
-        return hr;
-
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    ImGui::StyleColorsDark();
-    ImGui_ImplWin32_Init(g_hWnd);
-    ImGui_ImplDX11_Init(g_pd3dDevice, g_pImmediateContext);
-    
-    return S_OK;
-}
-
-void Renderer::mouseMoved(int x, int y) {
-    if (m_rbPressed) {
-        float dx = (float)(x - m_prevMouseX) * angle_velocity;
-        float dy = (float)(y - m_prevMouseY) * angle_velocity;
-
-        m_prevMouseX = x;
-        m_prevMouseY = y;
-        camera.move(dx, dy);
-    }
-}
-
-void Renderer::mouseRBPressed(bool pressed, int x, int y) {
-    m_rbPressed = pressed;
-
-    if (m_rbPressed) {
-        m_prevMouseX = x;
-        m_prevMouseY = y;
-    }
-}
-
-void Renderer::mouseWheel(int wheel) {
-    camera.updateDistance((float)wheel);
-}
-
-bool Renderer::frame() {
-    ImGui_ImplDX11_NewFrame();
-    ImGui_ImplWin32_NewFrame();
-    ImGui::NewFrame();
-    {
-        ImGui::Begin("ImGui");
-        ImGui::Text(("The count of rendered cubes: " + std::to_string(scene.getRenderedCount())).c_str());
-#ifdef _DEBUG
-        ImGui::Checkbox("Fix Frustum Culling", &m_fixFrustumCulling);
-#endif
-        ImGui::Checkbox("Sobel filter", &m_usePosteffect);
-        ImGui::Combo("Draw mode", &m_currentMode, m_modes, IM_ARRAYSIZE(m_modes));
-        if (m_frameCount[m_currentMode]) {
-            ImGui::Text((std::string(m_modes[m_currentMode]) + " average frame time: " + std::to_string(m_totalFrameTime[m_currentMode] / m_frameCount[m_currentMode])).c_str());
-            ImGui::Text((std::string(m_modes[m_currentMode]) + " average render time: " + std::to_string(m_totalRenderTime[m_currentMode] / m_frameCount[m_currentMode])).c_str());
-        }
-        ImGui::Text(m_modes[m_currentMode]);
-        ImGui::Text(std::to_string(m_frameCount[m_currentMode]).c_str());
-        ImGui::End();
-    }
-    auto start = std::chrono::high_resolution_clock::now();
-    postprocessing.frame(g_pImmediateContext, m_usePosteffect);
-    camera.frame();
-
-    XMMATRIX mView;
-    camera.getViewMatrix(mView);
-
-
-    XMMATRIX mProjection = XMMatrixPerspectiveFovLH(XM_PIDIV2, (FLOAT)m_width / (FLOAT)m_height, 100.0f, 0.01f);
-    HRESULT hr = scene.frame(g_pImmediateContext, mView, mProjection, camera.getPos(), m_fixFrustumCulling);
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    m_totalFrameTime[m_currentMode] += duration.count();
-    if (FAILED(hr))
-        return FAILED(hr);
-
-    return SUCCEEDED(hr);
-}
-
-void Renderer::render() {
-    auto start = std::chrono::high_resolution_clock::now();
-    g_pImmediateContext->ClearState();
-
-    D3D11_VIEWPORT viewport;
-    viewport.TopLeftX = 0;
-    viewport.TopLeftY = 0;
-    viewport.Width = (FLOAT)m_width;
-    viewport.Height = (FLOAT)m_height;
-    viewport.MinDepth = 0.0f;
-    viewport.MaxDepth = 1.0f;
-    g_pImmediateContext->RSSetViewports(1, &viewport);
-
-    D3D11_RECT rect;
-    rect.left = 0;
-    rect.top = 0;
-    rect.right = m_width;
-    rect.bottom = m_height;
-    g_pImmediateContext->RSSetScissorRects(1, &rect);
-
-    renderTexture.setRenderTarget(g_pImmediateContext, g_pDepthBufferDSV);
-    renderTexture.clearRenderTarget(g_pImmediateContext, g_pDepthBufferDSV, 0.0f, 0.0f, 0.0f, 1.0f);
-
-    scene.render(g_pImmediateContext);
-
-    ID3D11RenderTargetView* views[] = { g_pRenderTargetView };
-    g_pImmediateContext->OMSetRenderTargets(1, views, g_pDepthBufferDSV);
-
-    static const FLOAT BackColor[4] = { 0.1f, 0.1f, 0.1f, 1.0f };
-    g_pImmediateContext->ClearRenderTargetView(g_pRenderTargetView, BackColor);
-    g_pImmediateContext->ClearDepthStencilView(g_pDepthBufferDSV, D3D11_CLEAR_DEPTH, 0.0f, 0);
-
-    postprocessing.render(g_pImmediateContext, renderTexture.getShaderResourceView(), g_pRenderTargetView, viewport);
-
-    ImGui::Render();
-    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
-
-    g_pSwapChain->Present(0, 0);
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    m_totalRenderTime[m_currentMode] += duration.count();
-    m_frameCount[m_currentMode]++;
-}
-
-void Renderer::resize(UINT screenWidth, UINT screenHeight) {
-    m_width = screenWidth;
-    m_height = screenHeight;
-}
-
-void Renderer::deviceCleanup() {
-    ImGui_ImplDX11_Shutdown();
-    ImGui_ImplWin32_Shutdown();
-    ImGui::DestroyContext();
-
-    camera.realize();
-    scene.realize();
-    renderTexture.realize();
-    postprocessing.realize();
-    if (g_pImmediateContext) g_pImmediateContext->ClearState();
-
-    if (g_pRenderTargetView) g_pRenderTargetView->Release();
-    if (g_pDepthBuffer) g_pDepthBuffer->Release();
-    if (g_pDepthBufferDSV) g_pDepthBufferDSV->Release();
-    if (g_pSwapChain1) g_pSwapChain1->Release();
-    if (g_pSwapChain) g_pSwapChain->Release();
-    if (g_pImmediateContext1) g_pImmediateContext1->Release();
-    if (g_pImmediateContext) g_pImmediateContext->Release();
-    if (g_pd3dDevice1) g_pd3dDevice1->Release();
-    if (g_pd3dDevice) g_pd3dDevice->Release();
-}
-
-void Renderer::resizeWindow(const HWND& g_hWnd) {
-    RECT rc;
-    GetClientRect(g_hWnd, &rc);
-    UINT width = rc.right - rc.left;
-    UINT height = rc.bottom - rc.top;
-
-    if (g_pSwapChain && (width != m_width || height != m_height)) {
-
-        if (g_pRenderTargetView) g_pRenderTargetView->Release();
-
-        HRESULT hr = g_pSwapChain->ResizeBuffers(2, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0);
-        assert(SUCCEEDED(hr));
-        if (SUCCEEDED(hr)) {
-            resize(width, height);
-
-            hr = initBackBuffer();
-            resize(width, height);
-            scene.resize(width, height);
-            renderTexture.resize(g_pd3dDevice, width, height);
-            postprocessing.resize(width, height);
-        }
-    }
+#include "Renderer.h"
+#include "imgui/imgui.h"
+#include "imgui/imgui_impl_dx11.h"
+#include "imgui/imgui_impl_win32.h"
+
+using namespace DirectX;
+
+Renderer& Renderer::getInstance() {
+    static Renderer rendererInstance;
+    return rendererInstance;
+}
+
+HRESULT Renderer::initDevice(const HWND& g_hWnd) {
+    HRESULT hr = S_OK;
+
+    RECT rc;
+    GetClientRect(g_hWnd, &rc);
+    UINT width = rc.right - rc.left;
+    UINT height = rc.bottom - rc.top;
+
+    UINT createDeviceFlags = 0;
+
+#ifdef _DEBUG
+    createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+    D3D_DRIVER_TYPE driverTypes[] =
+    {
+        D3D_DRIVER_TYPE_HARDWARE,
+        D3D_DRIVER_TYPE_WARP,
+        D3D_DRIVER_TYPE_REFERENCE,
+    };
+    UINT numDriverTypes = ARRAYSIZE(driverTypes);
+
+    D3D_FEATURE_LEVEL featureLevels[] =
+    {
+        D3D_FEATURE_LEVEL_11_1,
+        D3D_FEATURE_LEVEL_11_0,
+        D3D_FEATURE_LEVEL_10_1,
+        D3D_FEATURE_LEVEL_10_0,
+    };
+    UINT numFeatureLevels = ARRAYSIZE(featureLevels);
+
+    for (UINT driverTypeIndex = 0; driverTypeIndex < numDriverTypes; driverTypeIndex++)
+    {
+        g_driverType = driverTypes[driverTypeIndex];
+        hr = D3D11CreateDevice(nullptr, g_driverType, nullptr, createDeviceFlags, featureLevels, numFeatureLevels,
+            D3D11_SDK_VERSION, &g_pd3dDevice, &g_featureLevel, &g_pImmediateContext);
+
+        if (hr == E_INVALIDARG)
+        {
+            hr = D3D11CreateDevice(nullptr, g_driverType, nullptr, createDeviceFlags, &featureLevels[1], numFeatureLevels - 1,
+                D3D11_SDK_VERSION, &g_pd3dDevice, &g_featureLevel, &g_pImmediateContext);
+        }
+
+        if (SUCCEEDED(hr))
+            break;
+    }
+    if (FAILED(hr))
+        return hr;
+
+    IDXGIFactory1* dxgiFactory = nullptr;
+    {
+        IDXGIDevice* dxgiDevice = nullptr;
+        hr = g_pd3dDevice->QueryInterface(__uuidof(IDXGIDevice), reinterpret_cast<void**>(&dxgiDevice));
+        if (SUCCEEDED(hr))
+        {
+            IDXGIAdapter* adapter = nullptr;
+            hr = dxgiDevice->GetAdapter(&adapter);
+            if (SUCCEEDED(hr))
+            {
+                hr = adapter->GetParent(__uuidof(IDXGIFactory1), reinterpret_cast<void**>(&dxgiFactory));
+                adapter->Release();
+            }
+            dxgiDevice->Release();
+        }
+    }
+    if (FAILED(hr))
+        return hr;
+
+    IDXGIFactory2* dxgiFactory2 = nullptr;
+    hr = dxgiFactory->QueryInterface(__uuidof(IDXGIFactory2), reinterpret_cast<void**>(&dxgiFactory2));
+    if (dxgiFactory2)
+    {
+        hr = g_pd3dDevice->QueryInterface(__uuidof(ID3D11Device1), reinterpret_cast<void**>(&g_pd3dDevice1));
+        if (SUCCEEDED(hr))
+        {
+            (void)g_pImmediateContext->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&g_pImmediateContext1));
+        }
+
+        DXGI_SWAP_CHAIN_DESC1 sd;
+        ZeroMemory(&sd, sizeof(sd));
+        sd.Width = width;
+        sd.Height = height;
+        sd.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        sd.SampleDesc.Count = 1;
+        sd.SampleDesc.Quality = 0;
+        sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+        sd.BufferCount = 2;
+
+        hr = dxgiFactory2->CreateSwapChainForHwnd(g_pd3dDevice, g_hWnd, &sd, nullptr, nullptr, &g_pSwapChain1);
+        if (SUCCEEDED(hr))
+        {
+            hr = g_pSwapChain1->QueryInterface(__uuidof(IDXGISwapChain), reinterpret_cast<void**>(&g_pSwapChain));
+        }
+
+        dxgiFactory2->Release();
+    }
+    else
+    {
+        DXGI_SWAP_CHAIN_DESC sd;
+        ZeroMemory(&sd, sizeof(sd));
+        sd.BufferCount = 2;
+        sd.BufferDesc.Width = width;
+        sd.BufferDesc.Height = height;
+        sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        sd.BufferDesc.RefreshRate.Numerator = 60;
+        sd.BufferDesc.RefreshRate.Denominator = 1;
+        sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        sd.OutputWindow = g_hWnd;
+        sd.SampleDesc.Count = 1;
+        sd.SampleDesc.Quality = 0;
+        sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+        sd.Windowed = TRUE;
+
+        hr = dxgiFactory->CreateSwapChain(g_pd3dDevice, &sd, &g_pSwapChain);
+    }
+
+    dxgiFactory->MakeWindowAssociation(g_hWnd, DXGI_MWA_NO_ALT_ENTER);
+
+    dxgiFactory->Release();
+
+    if (FAILED(hr))
+        return hr;
+
+    hr = initBackBuffer();
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_VIEWPORT vp;
+    vp.Width = (FLOAT)width;
+    vp.Height = (FLOAT)height;
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    vp.TopLeftX = 0;
+    vp.TopLeftY = 0;
+    g_pImmediateContext->RSSetViewports(1, &vp);
+
+    hr = d3d11Backend.init(g_pd3dDevice, g_pImmediateContext);
+    if (FAILED(hr))
+        return hr;
+    stateFilter.setBackend(&d3d11Backend);
+    scene.init(g_pd3dDevice, g_pImmediateContext, width, height);
+
+    return S_OK;
+}
+
+HRESULT Renderer::initBackBuffer() {
+    ID3D11Texture2D* pBackBuffer = NULL;
+    HRESULT hr = g_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&pBackBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    hr = g_pd3dDevice->CreateRenderTargetView(pBackBuffer, NULL, &g_pRenderTargetView);
+    if (pBackBuffer) pBackBuffer->Release();
+    if (FAILED(hr))
+        return hr;
+
+    g_pImmediateContext->OMSetRenderTargets(1, &g_pRenderTargetView, nullptr);
+
+    if (g_pDepthBuffer) g_pDepthBuffer->Release();
+    if (g_pDepthBufferDSV) g_pDepthBufferDSV->Release();
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Format = DXGI_FORMAT_D32_FLOAT;
+    desc.ArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.Height = m_height;
+    desc.Width = m_width;
+    desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = 0;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+
+    hr = g_pd3dDevice->CreateTexture2D(&desc, NULL, &g_pDepthBuffer);
+    if (FAILED(hr))
+        return hr;
+
+    hr = g_pd3dDevice->CreateDepthStencilView(g_pDepthBuffer, NULL, &g_pDepthBufferDSV);
+    return hr;
+}
+
+HRESULT Renderer::init(const HWND& g_hWnd, const HINSTANCE& g_hInstance, UINT screenWidth, UINT screenHeight) {
+    resize(screenWidth, screenHeight);
+
+    m_fixFrustumCulling = false;
+    m_occlusionCulling = false;
+    m_effectNames[POST_EFFECT_SOBEL] = "Sobel filter";
+    m_effectNames[POST_EFFECT_BLUR] = "Blur";
+    m_effectNames[POST_EFFECT_TONE_MAP] = "Tone mapping";
+
+    m_rbPressed = false;
+    m_prevMouseX = 0;
+    m_prevMouseY = 0;
+
+    m_modes[0] = "CPU";
+    m_modes[1] = "Instancing";
+    m_modes[2] = "GPU Culling + Instancing";
+
+    m_lightingModes[LIGHTING_CLUSTERED] = "Clustered";
+    m_lightingModes[LIGHTING_INSTANCE] = "Brightest lights per cube";
+
+    m_totalFrameTime[0] = 0;
+    m_totalFrameTime[1] = 0;
+    m_totalFrameTime[2] = 0;
+
+    m_totalRenderTime[0] = 0;
+    m_totalRenderTime[1] = 0;
+    m_totalRenderTime[2] = 0;
+
+    m_frameCount[0] = 0;
+    m_frameCount[1] = 0;
+    m_frameCount[2] = 0;
+
+    HRESULT hr = camera.init();
+    if (FAILED(hr))
+        return hr;
+
+    hr = initDevice(g_hWnd);
+    if (FAILED(hr))
+        return hr;
+
+    hr = renderTexture.init(g_pd3dDevice, screenWidth, screenHeight);
+    if (FAILED(hr))
+        return hr;
+
+    renderTargetDevice.init(g_pd3dDevice);
+    renderTargetPool.init(&renderTargetDevice);
+
+    hr = postprocessing.init(g_pd3dDevice, g_hWnd, screenWidth, screenHeight, &renderTargetPool);
+    if (FAILED(hr))
+        return hr;
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO(); (void)io;
+    ImGui::StyleColorsDark();
+    ImGui_ImplWin32_Init(g_hWnd);
+    ImGui_ImplDX11_Init(g_pd3dDevice, g_pImmediateContext);
+    
+    return S_OK;
+}
+
+void Renderer::mouseMoved(int x, int y) {
+    if (m_rbPressed) {
+        float dx = (float)(x - m_prevMouseX) * angle_velocity;
+        float dy = (float)(y - m_prevMouseY) * angle_velocity;
+
+        m_prevMouseX = x;
+        m_prevMouseY = y;
+        camera.move(dx, dy);
+    }
+}
+
+void Renderer::mouseRBPressed(bool pressed, int x, int y) {
+    m_rbPressed = pressed;
+
+    if (m_rbPressed) {
+        m_prevMouseX = x;
+        m_prevMouseY = y;
+    }
+}
+
+void Renderer::mouseWheel(int wheel) {
+    camera.updateDistance((float)wheel);
+}
+
+bool Renderer::frame() {
+    ImGui_ImplDX11_NewFrame();
+    ImGui_ImplWin32_NewFrame();
+    ImGui::NewFrame();
+    {
+        ImGui::Begin("ImGui");
+        ImGui::Text(("The count of rendered cubes: " + std::to_string(scene.getRenderedCount())).c_str());
+#ifdef _DEBUG
+        ImGui::Checkbox("Fix Frustum Culling", &m_fixFrustumCulling);
+#endif
+        // The effects run top to bottom, the arrow moves one up
+        for (int i = 0; i < POST_EFFECT_COUNT; i++) {
+            ImGui::PushID(i);
+            if (i > 0 && ImGui::ArrowButton("up", ImGuiDir_Up))
+                std::swap(m_effectOrder[i - 1], m_effectOrder[i]);
+            if (i > 0)
+                ImGui::SameLine();
+            ImGui::Checkbox(m_effectNames[m_effectOrder[i]], &m_effectEnabled[m_effectOrder[i]]);
+            ImGui::PopID();
+        }
+        if (m_effectEnabled[POST_EFFECT_TONE_MAP])
+            ImGui::SliderFloat("Exposure", &m_exposure, 0.1f, 8.0f);
+        const RenderTargetPoolStats& targets = renderTargetPool.getStats();
+        ImGui::Text(("Post passes: " + std::to_string(postprocessing.getPassCount()) + ", pooled targets: " + std::to_string(targets.live) +
+            ", created: " + std::to_string(targets.created) + ", reused: " + std::to_string(targets.reused)).c_str());
+        ImGui::Combo("Draw mode", &m_currentMode, m_modes, IM_ARRAYSIZE(m_modes));
+        if (m_frameCount[m_currentMode]) {
+            ImGui::Text((std::string(m_modes[m_currentMode]) + " average frame time: " + std::to_string(m_totalFrameTime[m_currentMode] / m_frameCount[m_currentMode])).c_str());
+            ImGui::Text((std::string(m_modes[m_currentMode]) + " average render time: " + std::to_string(m_totalRenderTime[m_currentMode] / m_frameCount[m_currentMode])).c_str());
+        }
+        if (m_currentMode != 2) {
+            const CullingStats& culling = scene.getCullingStats();
+            ImGui::Text(("Static BVH plane cache hit rate: " + std::to_string(int(culling.getHitRate() * 100.0f)) + "% of " + std::to_string(culling.cached)).c_str());
+            ImGui::Checkbox("Occlusion culling", &m_occlusionCulling);
+            if (m_occlusionCulling) {
+                const OcclusionStats& occlusion = scene.getOcclusionStats();
+                ImGui::Text(("Occluded cubes: " + std::to_string(occlusion.occluded) + " of " + std::to_string(occlusion.tested) +
+                    ", occluders: " + std::to_string(occlusion.occluders)).c_str());
+            }
+        }
+        const LodStats& lightLod = scene.getLightLodStats();
+        ImGui::Text(("Light sphere triangles: " + std::to_string(lightLod.triangles) + ", saved by LOD: " +
+            std::to_string(lightLod.getSavedTriangles())).c_str());
+        const ClusterStats& clusters = scene.getLightClusterStats();
+        ImGui::Text(("Light cluster indices: " + std::to_string(clusters.indices) + ", most per cluster: " +
+            std::to_string(clusters.maxPerCluster) + ", dropped: " + std::to_string(clusters.dropped)).c_str());
+        ImGui::Combo("Cube lighting", &m_lightingMode, m_lightingModes, IM_ARRAYSIZE(m_lightingModes));
+        if (m_lightingMode == LIGHTING_INSTANCE) {
+            const LightSelectionStats& selection = scene.getLightSelectionStats();
+            ImGui::Text(("Cube lights selected: " + std::to_string(selection.selected) + " for " + std::to_string(selection.instances) +
+                " cubes of " + std::to_string(selection.lights) + " lights").c_str());
+        }
+        ImGui::SliderFloat("Sky light", &m_skyLight, 0.0f, 1.0f);
+        const EnvironmentStats& environment = scene.getEnvironmentStats();
+        ImGui::Text(("Sky lighting " + std::string(environment.cached ? "read from the cache" : "computed") + " in " +
+            std::to_string(int(environment.milliseconds)) + " ms").c_str());
+        const BakeStats& bake = scene.getBakeStats();
+        ImGui::Text(("Static cube lighting " + std::string(bake.cached ? "read from the bake" : "baked") + ": " + std::to_string(bake.vertices) +
+            " vertices, " + std::to_string(bake.rays) + " rays in " + std::to_string(int(bake.milliseconds)) + " ms").c_str());
+        const ShadowCasterStats& casters = scene.getShadowCasterStats();
+        ImGui::Text(("Shadow casters: " + std::to_string(casters.casters) + " in " + std::to_string(casters.activeFaces) + " faces of " +
+            std::to_string(casters.activeLights) + " of " + std::to_string(casters.lights) + " lights").c_str());
+        const StateFilterStats& binds = stateFilter.getStats();
+        ImGui::Text(("State binds issued: " + std::to_string(binds.issued) + ", skipped: " + std::to_string(binds.skipped)).c_str());
+        ImGui::Text(("Constants uploaded: " + std::to_string(d3d11Backend.getUploadBytes()) + " bytes").c_str());
+        ImGui::Text(m_modes[m_currentMode]);
+        ImGui::Text(std::to_string(m_frameCount[m_currentMode]).c_str());
+        ImGui::End();
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    frameCommands.clear();
+    m_postEffects.clear();
+    for (int i = 0; i < POST_EFFECT_COUNT; i++) {
+        if (m_effectEnabled[m_effectOrder[i]])
+            m_postEffects.push_back((PostEffect)m_effectOrder[i]);
+    }
+    postprocessing.frame(m_postEffects, m_exposure);
+    camera.frame();
+
+    XMMATRIX mView;
+    camera.getViewMatrix(mView);
+
+
+    XMMATRIX mProjection = XMMatrixPerspectiveFovLH(XM_PIDIV2, (FLOAT)m_width / (FLOAT)m_height, 100.0f, 0.01f);
+    scene.setLightingMode(m_lightingMode);
+    scene.setSkyLight(m_skyLight);
+    HRESULT hr = scene.frame(g_pImmediateContext, frameCommands, mView, mProjection, camera.getPos(), m_fixFrustumCulling, m_currentMode == 2, m_occlusionCulling);
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    m_totalFrameTime[m_currentMode] += duration.count();
+    if (FAILED(hr))
+        return FAILED(hr);
+
+    return SUCCEEDED(hr);
+}
+
+// The frame was recorded into frameCommands by frame() and here; it is issued all at once
+// before ImGui, which draws on the context directly. ClearState resets what the state filter
+// knows to be bound.
+void Renderer::render() {
+    auto start = std::chrono::high_resolution_clock::now();
+    g_pImmediateContext->ClearState();
+    stateFilter.reset();
+
+    D3D11_VIEWPORT viewport;
+    viewport.TopLeftX = 0;
+    viewport.TopLeftY = 0;
+    viewport.Width = (FLOAT)m_width;
+    viewport.Height = (FLOAT)m_height;
+    viewport.MinDepth = 0.0f;
+    viewport.MaxDepth = 1.0f;
+    frameCommands.setViewport(viewport.TopLeftX, viewport.TopLeftY, viewport.Width, viewport.Height, viewport.MinDepth, viewport.MaxDepth);
+
+    D3D11_RECT rect;
+    rect.left = 0;
+    rect.top = 0;
+    rect.right = m_width;
+    rect.bottom = m_height;
+    g_pImmediateContext->RSSetScissorRects(1, &rect);
+
+    renderTexture.setRenderTarget(frameCommands, g_pDepthBufferDSV);
+    renderTexture.clearRenderTarget(frameCommands, g_pDepthBufferDSV, 0.0f, 0.0f, 0.0f, 1.0f);
+
+    scene.render(frameCommands);
+
+    ID3D11RenderTargetView* views[] = { g_pRenderTargetView };
+    frameCommands.setRenderTargets(1, views, g_pDepthBufferDSV);
+
+    static const FLOAT BackColor[4] = { 0.1f, 0.1f, 0.1f, 1.0f };
+    frameCommands.clearRenderTarget(g_pRenderTargetView, BackColor);
+    frameCommands.clearDepth(g_pDepthBufferDSV, 0.0f);
+
+    postprocessing.render(frameCommands, renderTexture.getShaderResourceView(), g_pRenderTargetView, viewport);
+
+    d3d11Backend.beginFrame();
+    frameCommands.replay(stateFilter);
+    d3d11Backend.endFrame();
+    renderTargetPool.endFrame();
+
+    ImGui::Render();
+    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+
+    g_pSwapChain->Present(0, 0);
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    m_totalRenderTime[m_currentMode] += duration.count();
+    m_frameCount[m_currentMode]++;
+}
+
+void Renderer::resize(UINT screenWidth, UINT screenHeight) {
+    m_width = screenWidth;
+    m_height = screenHeight;
+}
+
+void Renderer::deviceCleanup() {
+    ImGui_ImplDX11_Shutdown();
+    ImGui_ImplWin32_Shutdown();
+    ImGui::DestroyContext();
+
+    camera.realize();
+    scene.realize();
+    renderTexture.realize();
+    renderTargetPool.clear();
+    postprocessing.realize();
+    d3d11Backend.realize();
+    if (g_pImmediateContext) g_pImmediateContext->ClearState();
+
+    if (g_pRenderTargetView) g_pRenderTargetView->Release();
+    if (g_pDepthBuffer) g_pDepthBuffer->Release();
+    if (g_pDepthBufferDSV) g_pDepthBufferDSV->Release();
+    if (g_pSwapChain1) g_pSwapChain1->Release();
+    if (g_pSwapChain) g_pSwapChain->Release();
+    if (g_pImmediateContext1) g_pImmediateContext1->Release();
+    if (g_pImmediateContext) g_pImmediateContext->Release();
+    if (g_pd3dDevice1) g_pd3dDevice1->Release();
+    if (g_pd3dDevice) g_pd3dDevice->Release();
+}
+
+void Renderer::resizeWindow(const HWND& g_hWnd) {
+    RECT rc;
+    GetClientRect(g_hWnd, &rc);
+    UINT width = rc.right - rc.left;
+    UINT height = rc.bottom - rc.top;
+
+    if (g_pSwapChain && (width != m_width || height != m_height)) {
+
+        if (g_pRenderTargetView) g_pRenderTargetView->Release();
+
+        HRESULT hr = g_pSwapChain->ResizeBuffers(2, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0);
+        assert(SUCCEEDED(hr));
+        if (SUCCEEDED(hr)) {
+            resize(width, height);
+
+            hr = initBackBuffer();
+            resize(width, height);
+            scene.resize(width, height);
+            renderTexture.resize(g_pd3dDevice, width, height);
+            postprocessing.resize(width, height);
+        }
+    }
 }
\ No newline at end of file
@@ -1,95 +1,196 @@
-#include "scene.h"
-
-HRESULT Scene::init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight) {
-    std::vector<XMFLOAT4> cubePositions = std::vector<XMFLOAT4>(MAX_CUBES);
-    for (int i = 0; i < MAX_CUBES; i++) {
-        cubePositions[i] = XMFLOAT4(
-            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
-            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
-            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f), 1.f);
-    }
-    HRESULT hr = cube.init(device, context, screenWidth, screenHeight, { L"./cat.dds", L"./cat.dds"}, L"./texture_norm.dds", 32.f, cubePositions);
-    if (FAILED(hr))
-        return hr;
-
-    std::vector<XMFLOAT4> planeColors = {
-      XMFLOAT4(1.f, 0.f, 0.f, 0.5f),
-      XMFLOAT4(0.f, 1.f, 0.f, 0.5f),
-      XMFLOAT4(0.f, 0.f, 1.f, 0.5f),
-    };
-
-    hr = planes.init(device, context, screenWidth, screenHeight, 3, planeColors);
-    if (FAILED(hr))
-        return hr;
-
-    hr = skybox.init(device, context, screenWidth, screenHeight);
-
-    std::vector<XMFLOAT4> colors = std::vector<XMFLOAT4>(MAX_LIGHTS);
-    std::vector<XMFLOAT4> positions = std::vector<XMFLOAT4>(MAX_LIGHTS);
-
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        colors[i] = XMFLOAT4(
-            (float)(0.5f + rand() / (float)(RAND_MAX + 1) * 0.5f),
-            (float)(0.5f + rand() / (float)(RAND_MAX + 1) * 0.5f),
-            (float)(0.5f + rand() / (float)(RAND_MAX + 1) * 0.5f), 1.f);
-        positions[i] = XMFLOAT4(
-            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
-            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
-            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f), 1.f);
-    }
-    hr = lights.init(device, context, screenWidth, screenHeight, colors, positions);
-
-    return hr;
-}
-
-void Scene::realize() {
-    cube.realize();
-    planes.realize();
-    skybox.realize();
-    lights.realize();
-}
-
-void Scene::render(ID3D11DeviceContext* context) {
-    cube.render(context);
-    lights.render(context);
-    skybox.render(context);
-    planes.render(context);
-}
-
-bool Scene::framePlanes(ID3D11DeviceContext* context, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos) {
-    auto duration = Timer::GetInstance().Clock();
-    std::vector<XMMATRIX> worldMatricies = std::vector<XMMATRIX>(3);
-
-    worldMatricies[0] = XMMatrixTranslation(1.25f, (float)(3.5 * sqrtf(2.0) * cos(duration) / (1.0 + sin(duration) * sin(duration))), (float)(3.5*sqrtf(2.0)*sin(duration)*cos(duration)/(1+ sin(duration)* sin(duration))));
-    worldMatricies[1] = XMMatrixTranslation(-1.25f, (float)(sin(duration * 2) * 2.0), (float)(sin(duration * 2) * -2.0));
-    worldMatricies[2] = XMMatrixTranslation(1.5f, (float)(sin(duration * 2) * 2.0), (float)(sin(duration * 2) * 2.0));
-
-    bool failed = planes.frame(context, worldMatricies, viewMatrix, projectionMatrix, cameraPos, lights);
-
-    return failed;
-}
-
-bool Scene::frame(ID3D11DeviceContext* context, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos, bool fixFrustumCulling) {
-    bool failed = cube.frame(context, viewMatrix, projectionMatrix, cameraPos, lights, fixFrustumCulling);
-    if (failed)
-        return false;
-
-    failed = framePlanes(context, viewMatrix, projectionMatrix, cameraPos);
-    if (failed)
-        return false;
-
-    failed = skybox.frame(context, viewMatrix, projectionMatrix, cameraPos);
-    if (failed)
-        return false;
-
-    failed = lights.frame(context, viewMatrix, projectionMatrix, cameraPos);
-
-    return failed;
-}
-
-void Scene::resize(int screenWidth, int screenHeight) {
-    cube.resize(screenWidth, screenHeight);
-    planes.resize(screenWidth, screenHeight);
-    skybox.resize(screenWidth, screenHeight);
-    lights.resize(screenWidth, screenHeight);
+#include "scene.h"
+
+HRESULT Scene::init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight) {
+    std::vector<XMFLOAT4> cubePositions = std::vector<XMFLOAT4>(CUBES_COUNT);
+    for (int i = 0; i < CUBES_COUNT; i++) {
+        cubePositions[i] = XMFLOAT4(
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f), 1.f);
+    }
+    cube.setSpatialGrid(&sceneGrid);
+    HRESULT hr = cube.init(device, context, screenWidth, screenHeight, { L"./cat.dds", L"./cat.dds"}, L"./texture_norm.dds", 32.f, cubePositions);
+    if (FAILED(hr))
+        return hr;
+
+    std::vector<XMFLOAT4> planeColors = {
+      XMFLOAT4(1.f, 0.f, 0.f, 0.5f),
+      XMFLOAT4(0.f, 1.f, 0.f, 0.5f),
+      XMFLOAT4(0.f, 0.f, 1.f, 0.5f),
+    };
+
+    hr = planes.init(device, context, screenWidth, screenHeight, 3, planeColors);
+    if (FAILED(hr))
+        return hr;
+
+    hr = skybox.init(device, context, screenWidth, screenHeight);
+
+    std::vector<XMFLOAT4> colors = std::vector<XMFLOAT4>(MAX_LIGHTS);
+    std::vector<XMFLOAT4> positions = std::vector<XMFLOAT4>(MAX_LIGHTS);
+
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        colors[i] = XMFLOAT4(
+            (float)(0.5f + rand() / (float)(RAND_MAX + 1) * 0.5f),
+            (float)(0.5f + rand() / (float)(RAND_MAX + 1) * 0.5f),
+            (float)(0.5f + rand() / (float)(RAND_MAX + 1) * 0.5f), 1.f);
+        positions[i] = XMFLOAT4(
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f), 1.f);
+    }
+    hr = lights.init(device, context, screenWidth, screenHeight, colors, positions);
+    if (FAILED(hr))
+        return hr;
+
+    // A light is found by the reach of its light, not by the size of its mesh.
+    for (int i = 0; i < MAX_LIGHTS; i++)
+        sceneGrid.insert(i | SPATIAL_LIGHT_BIT, &lights.getSpheres()[i].x, lights.getSpheres()[i].w);
+
+    // The static cubes and the lights never move, so the light between them is baked once.
+    for (int i = 0; i < STATIC_CUBES_COUNT; i++) {
+        cube.addCube(XMFLOAT4(
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f),
+            (rand() / (float)(RAND_MAX + 1) * SCENE_SIZE - SCENE_SIZE / 2.f), 1.f), true);
+    }
+    hr = cube.bakeStaticLighting(device, lights.getSpheres(), lights.getColors(), lights.getRadius());
+
+    return hr;
+}
+
+void Scene::realize() {
+    cube.realize();
+    planes.realize();
+    skybox.realize();
+    lights.realize();
+}
+
+// Packets come sorted, so the state of an object is only bound when the owner changes. Every
+// run of packets of one owner is recorded as its own part, in parallel.
+void Scene::render(CommandList& commands) {
+    const std::vector<DrawPacket>& packets = renderQueue.getPackets();
+    renderRuns.clear();
+    for (size_t i = 0; i < packets.size(); i++) {
+        if (renderRuns.empty() || packets[i].object != packets[renderRuns.back().first].object)
+            renderRuns.push_back({ i, i });
+        renderRuns.back().second = i + 1;
+    }
+
+    recordParallel(commands, renderCommands, renderRuns.size(), [&](size_t part, CommandList& list) {
+        uint32_t object = packets[renderRuns[part].first].object;
+        bindObject(list, object);
+        for (size_t i = renderRuns[part].first; i < renderRuns[part].second; i++)
+            drawObject(list, object, packets[i].item);
+    });
+}
+
+void Scene::bindObject(CommandList& commands, uint32_t object) {
+    switch (object) {
+    case RENDER_OBJECT_CUBES: cube.bind(commands); break;
+    case RENDER_OBJECT_LIGHTS: lights.bind(commands); break;
+    case RENDER_OBJECT_SKYBOX: skybox.bind(commands); break;
+    case RENDER_OBJECT_PLANES: planes.bind(commands); break;
+    }
+}
+
+void Scene::drawObject(CommandList& commands, uint32_t object, uint32_t item) {
+    switch (object) {
+    case RENDER_OBJECT_CUBES: cube.draw(commands, item); break;
+    case RENDER_OBJECT_LIGHTS: lights.draw(commands, item); break;
+    case RENDER_OBJECT_SKYBOX: skybox.draw(commands, item); break;
+    case RENDER_OBJECT_PLANES: planes.draw(commands, item); break;
+    }
+}
+
+void Scene::fillRenderQueue(XMFLOAT3 cameraPos) {
+    renderQueue.clear();
+    cube.submit(renderQueue, RENDER_OBJECT_CUBES);
+    lights.submit(renderQueue, RENDER_OBJECT_LIGHTS);
+    skybox.submit(renderQueue, RENDER_OBJECT_SKYBOX);
+    planes.submit(renderQueue, RENDER_OBJECT_PLANES, cameraPos);
+    renderQueue.sort();
+}
+
+bool Scene::framePlanes(CommandList& commands) {
+    auto duration = Timer::GetInstance().Clock();
+    std::vector<XMMATRIX> worldMatricies = std::vector<XMMATRIX>(3);
+
+    worldMatricies[0] = XMMatrixTranslation(1.25f, (float)(3.5 * sqrtf(2.0) * cos(duration) / (1.0 + sin(duration) * sin(duration))), (float)(3.5*sqrtf(2.0)*sin(duration)*cos(duration)/(1+ sin(duration)* sin(duration))));
+    worldMatricies[1] = XMMatrixTranslation(-1.25f, (float)(sin(duration * 2) * 2.0), (float)(sin(duration * 2) * -2.0));
+    worldMatricies[2] = XMMatrixTranslation(1.5f, (float)(sin(duration * 2) * 2.0), (float)(sin(duration * 2) * 2.0));
+
+    bool failed = planes.frame(commands, worldMatricies);
+
+    return failed;
+}
+
+// The view, the light clusters and the sky light go to the shaders once, in slot 1 of the
+// vertex and pixel stages and t8-t11 of the pixel stage; the objects only upload what is
+// their own and leave those slots alone.
+void Scene::writeSceneConstants(CommandList& commands, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos) {
+    // Only the lights whose influence reaches the view can touch a cluster.
+    XMFLOAT4X4 viewProjection;
+    XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(viewMatrix, projectionMatrix));
+    float viewPlanes[6][4];
+    extractFrustumPlanes(&viewProjection._11, viewPlanes);
+    sceneGrid.queryFrustum(viewPlanes, visibleIds);
+    visibleLights.clear();
+    for (int id : visibleIds) {
+        if (id & SPATIAL_LIGHT_BIT)
+            visibleLights.push_back(id & ~SPATIAL_LIGHT_BIT);
+    }
+    lights.assignClusters(commands, viewMatrix, projectionMatrix, visibleLights);
+
+    SceneCB& sceneBuffer = *reinterpret_cast<SceneCB*>(commands.writeConstants(sceneBlock, sizeof(SceneCB)));
+    sceneBuffer.viewProjectionMatrix = XMMatrixMultiply(viewMatrix, projectionMatrix);
+    sceneBuffer.cameraPos = XMFLOAT4(cameraPos.x, cameraPos.y, cameraPos.z, 1.0f);
+    lights.writeClusterConstants(sceneBuffer);
+    sceneBuffer.clusterGrid.w = lightingMode;
+    // The sky lights the cubes through CalculateAmbient only; it must not tint the point lights.
+    sceneBuffer.ambientColor = XMFLOAT4(0.9f, 0.9f, 0.4f, 1.0f);
+    const EnvironmentLighting& environment = skybox.getEnvironment();
+    memcpy(sceneBuffer.irradianceSH, environment.getIrradiance(), sizeof(sceneBuffer.irradianceSH));
+    sceneBuffer.environmentParams = XMFLOAT4(float(environment.getSpecularLevels() - 1), skyLight, 0.0f, 0.0f);
+    skybox.bindEnvironment(commands);
+
+    commands.setConstantBlocks(SHADER_STAGE_VERTEX, 1, 1, &sceneBlock);
+    commands.setConstantBlocks(SHADER_STAGE_PIXEL, 1, 1, &sceneBlock);
+}
+
+bool Scene::frame(ID3D11DeviceContext* context, CommandList& commands, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos, bool fixFrustumCulling, bool gpuCulling, bool occlusionCulling) {
+    writeSceneConstants(commands, viewMatrix, projectionMatrix, cameraPos);
+
+    bool failed = cube.frame(context, commands, viewMatrix, projectionMatrix, cameraPos, fixFrustumCulling, gpuCulling, occlusionCulling);
+    if (failed)
+        return false;
+
+    // The transparent planes always use the clusters, so those are built in both modes.
+    if (lightingMode == LIGHTING_INSTANCE)
+        cube.selectLights(commands, lights.getSpheres(), lights.getColors());
+
+    cube.cullShadowCasters(lights.getSpheres());
+
+    // The cubes spread their own work over the job system; the rest is recorded side by side.
+    bool partFailed[3] = {};
+    recordParallel(commands, frameCommands, 3, [&](size_t part, CommandList& list) {
+        switch (part) {
+        case 0: partFailed[0] = framePlanes(list); break;
+        case 1: partFailed[1] = skybox.frame(list); break;
+        case 2: partFailed[2] = lights.frame(list, projectionMatrix, cameraPos); break;
+        }
+    });
+    failed = partFailed[0] || partFailed[1] || partFailed[2];
+    if (failed)
+        return false;
+
+    fillRenderQueue(cameraPos);
+
+    return failed;
+}
+
+void Scene::resize(int screenWidth, int screenHeight) {
+    cube.resize(screenWidth, screenHeight);
+    planes.resize(screenWidth, screenHeight);
+    skybox.resize(screenWidth, screenHeight);
+    lights.resize(screenWidth, screenHeight);
 };
\ No newline at end of file
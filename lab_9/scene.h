@@ -1,37 +1,76 @@
-#pragma once
-
-#include <windows.h>
-#include <d3dcompiler.h>
-#include <dxgi.h>
-#include <d3d11.h>
-#include <directxmath.h>
-#include <string>
-#include <vector>
-
-#include "skybox.h"
-#include "cube.h"
-#include "plane.h"
-#include "timer.h"
-#include "texture.h"
-#include "light.h"
-
-using namespace DirectX;
-
-class Scene {
-public:
-    HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight);
-    void realize();
-    void resize(int screenWidth, int screenHeight);
-    void render(ID3D11DeviceContext* context);
-    bool frame(ID3D11DeviceContext* context, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos, bool fixFrustumCulling);
-    int getRenderedCount() { return cube.getRenderedCubesCount(); };
-private:
-    bool framePlanes(ID3D11DeviceContext* context, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos);
-
-    Cube cube;
-    Plane planes;
-    Skybox skybox;
-    Light lights;
-
-    float angle_velocity = XM_PIDIV2;
+#pragma once
+
+#include <windows.h>
+#include <d3dcompiler.h>
+#include <dxgi.h>
+#include <d3d11.h>
+#include <directxmath.h>
+#include <string>
+#include <vector>
+
+#include "skybox.h"
+#include "cube.h"
+#include "plane.h"
+#include "timer.h"
+#include "texture.h"
+#include "light.h"
+#include "spatialGrid.h"
+
+using namespace DirectX;
+
+// Ids in the scene spatial grid: cube slots as is, light indices with this bit set.
+static const int SPATIAL_LIGHT_BIT = 0x40000000;
+
+// Owners of the render queue packets; the id also serves as the shader part of the sort key.
+enum RenderObject : uint32_t {
+    RENDER_OBJECT_CUBES = 0,
+    RENDER_OBJECT_LIGHTS = 1,
+    RENDER_OBJECT_SKYBOX = 2,
+    RENDER_OBJECT_PLANES = 3,
+};
+
+class Scene {
+public:
+    HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight);
+    void realize();
+    void resize(int screenWidth, int screenHeight);
+    void render(CommandList& commands);
+    bool frame(ID3D11DeviceContext* context, CommandList& commands, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos, bool fixFrustumCulling, bool gpuCulling, bool occlusionCulling);
+    int getRenderedCount() { return cube.getRenderedCubesCount(); };
+    const CullingStats& getCullingStats() const { return cube.getCullingStats(); };
+    const OcclusionStats& getOcclusionStats() const { return cube.getOcclusionStats(); };
+    const LodStats& getLightLodStats() const { return lights.getLodStats(); };
+    const ClusterStats& getLightClusterStats() const { return lights.getClusterStats(); };
+    const LightSelectionStats& getLightSelectionStats() const { return cube.getLightSelectionStats(); };
+    const BakeStats& getBakeStats() const { return cube.getBakeStats(); };
+    const ShadowCasterStats& getShadowCasterStats() const { return cube.getShadowCasters().getStats(); };
+    // LIGHTING_CLUSTERED or LIGHTING_INSTANCE, how the cubes find their lights.
+    void setLightingMode(int mode) { lightingMode = mode; };
+    // Scale of the image-based ambient light from the skybox.
+    void setSkyLight(float intensity) { skyLight = intensity; };
+    const EnvironmentStats& getEnvironmentStats() const { return skybox.getEnvironment().getStats(); };
+private:
+    void fillRenderQueue(XMFLOAT3 cameraPos);
+    void bindObject(CommandList& commands, uint32_t object);
+    void drawObject(CommandList& commands, uint32_t object, uint32_t item);
+    bool framePlanes(CommandList& commands);
+    void writeSceneConstants(CommandList& commands, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos);
+
+    Cube cube;
+    Plane planes;
+    Skybox skybox;
+    Light lights;
+    uint32_t sceneBlock = newConstantBlock();
+
+    RenderQueue renderQueue;
+    std::vector<std::pair<size_t, size_t>> renderRuns; // packet range of one owner
+    std::vector<CommandList> renderCommands;
+    std::vector<CommandList> frameCommands;
+    SpatialGrid sceneGrid; // the cubes keep theirs up to date, the lights are inserted once
+    std::vector<int> visibleIds;
+    std::vector<int> visibleLights;
+
+    float angle_velocity = XM_PIDIV2;
+    int lightingMode = LIGHTING_CLUSTERED;
+    float skyLight = 0.25f;
 };
\ No newline at end of file
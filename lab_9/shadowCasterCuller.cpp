@@ -0,0 +1,462 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "shadowCasterCuller.h"
+#include "jobSystem.h"
+#include "simd.h"
+
+const uint32_t ShadowCasterCuller::FACES;
+
+static const int MAX_GRID_SIZE = 64;
+// Padding lights sit this far away, so the sphere test of a padding lane is always false.
+static const float FAR_AWAY = 1e30f;
+
+// Faces of a box at (dx, dy, dz) from the light with half extents (ex, ey, ez). A box can be
+// on the positive side of the plane s = 0 when s + r >= 0 and on the negative side when
+// s - r <= 0; the face pyramids are the sign patterns of x - y, x + y, x - z, x + z, y - z and
+// y + z. The same tests, in the same order, as the SIMD paths.
+static uint32_t getFaceBits(float dx, float dy, float dz, float ex, float ey, float ez, float r) {
+    float ax = (std::max)(fabsf(dx) - ex, 0.0f);
+    float ay = (std::max)(fabsf(dy) - ey, 0.0f);
+    float az = (std::max)(fabsf(dz) - ez, 0.0f);
+    if (!(ax * ax + ay * ay + az * az <= r * r))
+        return 0;
+
+    float rxy = ex + ey, rxz = ex + ez, ryz = ey + ez;
+    float a = dx - dy, b = dx + dy, c = dx - dz, d = dx + dz, e = dy - dz, f = dy + dz;
+    bool pa = a >= -rxy, na = a <= rxy;
+    bool pb = b >= -rxy, nb = b <= rxy;
+    bool pc = c >= -rxz, nc = c <= rxz;
+    bool pd = d >= -rxz, nd = d <= rxz;
+    bool pe = e >= -ryz, ne = e <= ryz;
+    bool pf = f >= -ryz, nf = f <= ryz;
+
+    uint32_t bits = 0;
+    bits |= (pa && pb && pc && pd) ? 1u : 0u;        // +X
+    bits |= (na && nb && nc && nd) ? 2u : 0u;        // -X
+    bits |= (na && pb && pe && pf) ? 4u : 0u;        // +Y
+    bits |= (pa && nb && ne && nf) ? 8u : 0u;        // -Y
+    bits |= (nc && pd && ne && pf) ? 16u : 0u;       // +Z
+    bits |= (pc && nd && pe && nf) ? 32u : 0u;       // -Z
+    return bits | 64u;                               // inside the sphere
+}
+
+static const uint32_t NO_CELL = 0xFFFFFFFF;
+
+static uint32_t packCell(int x, int y, int z) {
+    return uint32_t(x) | uint32_t(y) << 10 | uint32_t(z) << 20;
+}
+
+// Clamped to the grid first, so the truncation is a floor.
+int ShadowCasterCuller::getCell(float x, int axis) const {
+    float t = (std::min)((std::max)((x - gridMin[axis]) * invCellSize, 0.0f), float(gridSize[axis] - 1));
+    return int(t);
+}
+
+size_t ShadowCasterCuller::getCellIndex(uint32_t packed) const {
+    return (size_t(packed >> 20) * gridSize[1] + (packed >> 10 & 1023)) * gridSize[0] + (packed & 1023);
+}
+
+// A light is active when its sphere is not behind any camera plane. Its face pyramid, cut at
+// the influence radius, lies in the hull of the light and the four corners of the cube face
+// at that radius; a face is skipped when all five points are behind one plane.
+void ShadowCasterCuller::selectLights(const float* spheres, size_t stride, size_t lightsCount, const float planes[6][4]) {
+    activeLights.clear();
+    lightX.clear();
+    lightY.clear();
+    lightZ.clear();
+    lightR.clear();
+    faceMasks.clear();
+    stats.activeFaces = 0;
+
+    for (size_t l = 0; l < lightsCount; l++) {
+        const float* sphere = reinterpret_cast<const float*>(reinterpret_cast<const char*>(spheres) + l * stride);
+        float r = sphere[3];
+        if (!(r > 0.0f))
+            continue;
+
+        uint32_t mask = (1u << FACES) - 1;
+        for (int p = 0; p < 6 && mask; p++) {
+            const float* plane = planes[p];
+            float center = plane[0] * sphere[0] + plane[1] * sphere[1] + plane[2] * sphere[2] + plane[3];
+            if (center < -r) {
+                mask = 0;
+                break;
+            }
+            if (center >= 0.0f)
+                continue;
+            float nx = fabsf(plane[0]), ny = fabsf(plane[1]), nz = fabsf(plane[2]);
+            float axis[FACES] = { plane[0], -plane[0], plane[1], -plane[1], plane[2], -plane[2] };
+            float side[FACES] = { ny + nz, ny + nz, nx + nz, nx + nz, nx + ny, nx + ny };
+            for (uint32_t face = 0; face < FACES; face++) {
+                if (center + r * (axis[face] + side[face]) < 0.0f)
+                    mask &= ~(1u << face);
+            }
+        }
+        if (!mask)
+            continue;
+
+        activeLights.push_back(uint32_t(l));
+        lightX.push_back(sphere[0]);
+        lightY.push_back(sphere[1]);
+        lightZ.push_back(sphere[2]);
+        lightR.push_back(r);
+        faceMasks.push_back(uint8_t(mask));
+        for (uint32_t face = 0; face < FACES; face++)
+            stats.activeFaces += (mask >> face) & 1;
+    }
+}
+
+// Cells are about as large as an average light, at most MAX_GRID_SIZE along every axis, and
+// a light goes to every cell its bounding box touches.
+void ShadowCasterCuller::buildGrid() {
+    size_t count = activeLights.size();
+    float bbMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float bbMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    double diameters = 0.0;
+    for (size_t l = 0; l < count; l++) {
+        float center[3] = { lightX[l], lightY[l], lightZ[l] };
+        for (int k = 0; k < 3; k++) {
+            bbMin[k] = (std::min)(bbMin[k], center[k] - lightR[l]);
+            bbMax[k] = (std::max)(bbMax[k], center[k] + lightR[l]);
+        }
+        diameters += 2.0 * lightR[l];
+    }
+
+    cellSize = float(diameters / double(count));
+    for (int k = 0; k < 3; k++)
+        cellSize = (std::max)(cellSize, (bbMax[k] - bbMin[k]) / float(MAX_GRID_SIZE));
+    invCellSize = 1.0f / cellSize;
+    for (int k = 0; k < 3; k++) {
+        gridMin[k] = bbMin[k];
+        gridSize[k] = (std::min)((std::max)(int(ceilf((bbMax[k] - bbMin[k]) * invCellSize)), 1), MAX_GRID_SIZE);
+    }
+
+    size_t cells = size_t(gridSize[0]) * gridSize[1] * gridSize[2];
+    cellStarts.assign(cells + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t l = 0; l < count; l++) {
+            float center[3] = { lightX[l], lightY[l], lightZ[l] };
+            int lo[3], hi[3];
+            for (int k = 0; k < 3; k++) {
+                lo[k] = getCell(center[k] - lightR[l], k);
+                hi[k] = getCell(center[k] + lightR[l], k);
+            }
+            for (int z = lo[2]; z <= hi[2]; z++) {
+                for (int y = lo[1]; y <= hi[1]; y++) {
+                    for (int x = lo[0]; x <= hi[0]; x++) {
+                        size_t cell = (size_t(z) * gridSize[1] + y) * gridSize[0] + x;
+                        if (pass == 0) {
+                            cellStarts[cell + 1]++;
+                            continue;
+                        }
+                        uint32_t slot = cellStarts[cell]++;
+                        cellX[slot] = lightX[l];
+                        cellY[slot] = lightY[l];
+                        cellZ[slot] = lightZ[l];
+                        cellR[slot] = lightR[l];
+                        cellLights[slot] = uint32_t(l);
+                        cellFirsts[slot] = packCell(lo[0], lo[1], lo[2]);
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            uint32_t start = 0;
+            for (size_t cell = 0; cell < cells; cell++) {
+                uint32_t padded = (cellStarts[cell + 1] + 7) & ~7u;
+                cellStarts[cell] = start;
+                start += padded;
+            }
+            cellStarts[cells] = start;
+            cellX.assign(start, FAR_AWAY);
+            cellY.assign(start, FAR_AWAY);
+            cellZ.assign(start, FAR_AWAY);
+            cellR.assign(start, 0.0f);
+            cellLights.assign(start, 0);
+            cellFirsts.assign(start, 0);
+        } else {
+            // The fill moved every start to the end of its lights; shift them back.
+            for (size_t cell = cells; cell > 0; cell--)
+                cellStarts[cell] = cellStarts[cell - 1];
+            cellStarts[0] = 0;
+            for (size_t cell = 1; cell <= cells; cell++)
+                cellStarts[cell] = (cellStarts[cell] + 7) & ~7u;
+        }
+    }
+}
+
+// The first and the last cell of the box of every instance, then the instances that reach the
+// grid copied out in the order of their first cell, so that the culling reads them in a row
+// and neighbours meet the same lights one after another.
+void ShadowCasterCuller::binInstances(const InstanceBounds& bounds) {
+    size_t count = bounds.size();
+    instanceCells.resize(count * 2);
+    float gridMax[3];
+    for (int k = 0; k < 3; k++)
+        gridMax[k] = gridMin[k] + gridSize[k] * cellSize;
+
+    JobSystem::GetInstance().parallelFor(count, 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float center[3] = { bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] };
+            float extent[3] = { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] };
+            int lo[3], hi[3];
+            bool outside = bounds.radius[i] < 0.0f;
+            for (int k = 0; k < 3; k++) {
+                float bbMin = center[k] - extent[k], bbMax = center[k] + extent[k];
+                outside |= !(bbMax >= gridMin[k] && bbMin <= gridMax[k]);
+                lo[k] = getCell(bbMin, k);
+                hi[k] = getCell(bbMax, k);
+            }
+            instanceCells[i * 2] = outside ? NO_CELL : packCell(lo[0], lo[1], lo[2]);
+            instanceCells[i * 2 + 1] = packCell(hi[0], hi[1], hi[2]);
+        }
+    });
+
+    size_t cells = size_t(gridSize[0]) * gridSize[1] * gridSize[2];
+    cellCounts.assign(cells + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t first = instanceCells[i * 2];
+        if (first != NO_CELL)
+            cellCounts[getCellIndex(first) + 1]++;
+    }
+    for (size_t cell = 0; cell < cells; cell++)
+        cellCounts[cell + 1] += cellCounts[cell];
+    binned.resize(cellCounts[cells]);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t first = instanceCells[i * 2];
+        if (first == NO_CELL)
+            continue;
+        BinnedInstance& instance = binned[cellCounts[getCellIndex(first)]++];
+        instance.center[0] = bounds.centerX[i];
+        instance.center[1] = bounds.centerY[i];
+        instance.center[2] = bounds.centerZ[i];
+        instance.extent[0] = bounds.extentX[i];
+        instance.extent[1] = bounds.extentY[i];
+        instance.extent[2] = bounds.extentZ[i];
+        instance.first = first;
+        instance.last = instanceCells[i * 2 + 1];
+        instance.index = uint32_t(i);
+    }
+}
+
+// Every instance visits the cells its box touches. A light that shares several of them with
+// the box is only taken in the first one, the per-axis larger of the two first cells.
+void ShadowCasterCuller::cullRange(size_t begin, size_t end, CasterChunk& chunk) const {
+    chunk.lists.clear();
+    chunk.instances.clear();
+    chunk.counts.assign(activeLights.size() * FACES, 0);
+    chunk.candidates = 0;
+
+    for (size_t p = begin; p < end; p++) {
+        const BinnedInstance& instance = binned[p];
+        const float* center = instance.center;
+        const float* extent = instance.extent;
+        uint32_t i = instance.index, first = instance.first, last = instance.last;
+        int lo[3] = { int(first & 1023), int(first >> 10 & 1023), int(first >> 20) };
+        int hi[3] = { int(last & 1023), int(last >> 10 & 1023), int(last >> 20) };
+        bool single = first == last;
+
+        // The SIMD loops only note the lanes that hit, as slot << 6 | faces; the lists are
+        // appended to once the cells are done.
+        size_t lanes = 0;
+        for (int z = lo[2]; z <= hi[2]; z++) {
+            for (int y = lo[1]; y <= hi[1]; y++) {
+                size_t row = (size_t(z) * gridSize[1] + y) * gridSize[0];
+                lanes += cellStarts[row + hi[0] + 1] - cellStarts[row + lo[0]];
+            }
+        }
+        if (chunk.hits.size() < lanes)
+            chunk.hits.resize(lanes);
+        uint32_t* hits = chunk.hits.data();
+        size_t hitsCount = 0;
+        auto record = [&](size_t slot, uint32_t bits, int x, int y, int z) {
+            uint32_t lightFirst = cellFirsts[slot];
+            if (!single && packCell((std::max)(int(lightFirst & 1023), lo[0]), (std::max)(int(lightFirst >> 10 & 1023), lo[1]),
+                (std::max)(int(lightFirst >> 20), lo[2])) != packCell(x, y, z))
+                return;
+            hits[hitsCount++] = uint32_t(slot) << 6 | bits;
+        };
+
+#if defined(SIMD_AVX)
+        __m256 sign8 = _mm256_set1_ps(-0.0f);
+        __m256 zero8 = _mm256_setzero_ps();
+        __m256 cx8 = _mm256_set1_ps(center[0]), cy8 = _mm256_set1_ps(center[1]), cz8 = _mm256_set1_ps(center[2]);
+        __m256 ex8 = _mm256_set1_ps(extent[0]), ey8 = _mm256_set1_ps(extent[1]), ez8 = _mm256_set1_ps(extent[2]);
+        __m256 rxy8 = _mm256_add_ps(ex8, ey8), rxz8 = _mm256_add_ps(ex8, ez8), ryz8 = _mm256_add_ps(ey8, ez8);
+        __m256 nrxy8 = _mm256_xor_ps(rxy8, sign8), nrxz8 = _mm256_xor_ps(rxz8, sign8), nryz8 = _mm256_xor_ps(ryz8, sign8);
+#endif
+#if defined(SIMD_SSE)
+        __m128 sign4 = _mm_set1_ps(-0.0f);
+        __m128 zero4 = _mm_setzero_ps();
+        __m128 cx4 = _mm_set1_ps(center[0]), cy4 = _mm_set1_ps(center[1]), cz4 = _mm_set1_ps(center[2]);
+        __m128 ex4 = _mm_set1_ps(extent[0]), ey4 = _mm_set1_ps(extent[1]), ez4 = _mm_set1_ps(extent[2]);
+        __m128 rxy4 = _mm_add_ps(ex4, ey4), rxz4 = _mm_add_ps(ex4, ez4), ryz4 = _mm_add_ps(ey4, ez4);
+        __m128 nrxy4 = _mm_xor_ps(rxy4, sign4), nrxz4 = _mm_xor_ps(rxz4, sign4), nryz4 = _mm_xor_ps(ryz4, sign4);
+#endif
+
+        for (int z = lo[2]; z <= hi[2]; z++) {
+            for (int y = lo[1]; y <= hi[1]; y++) {
+                for (int x = lo[0]; x <= hi[0]; x++) {
+                    size_t cell = (size_t(z) * gridSize[1] + y) * gridSize[0] + x;
+                    size_t j = cellStarts[cell], cellEnd = cellStarts[cell + 1];
+
+#if defined(SIMD_AVX)
+                    for (; j + 8 <= cellEnd; j += 8) {
+                        __m256 dx = _mm256_sub_ps(cx8, _mm256_loadu_ps(&cellX[j]));
+                        __m256 dy = _mm256_sub_ps(cy8, _mm256_loadu_ps(&cellY[j]));
+                        __m256 dz = _mm256_sub_ps(cz8, _mm256_loadu_ps(&cellZ[j]));
+                        __m256 r = _mm256_loadu_ps(&cellR[j]);
+                        __m256 ax = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign8, dx), ex8), zero8);
+                        __m256 ay = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign8, dy), ey8), zero8);
+                        __m256 az = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign8, dz), ez8), zero8);
+                        __m256 dist2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, ax), _mm256_mul_ps(ay, ay)), _mm256_mul_ps(az, az));
+                        __m256 inside = _mm256_cmp_ps(dist2, _mm256_mul_ps(r, r), _CMP_LE_OQ);
+                        int any = _mm256_movemask_ps(inside);
+                        if (!any)
+                            continue;
+
+                        __m256 a = _mm256_sub_ps(dx, dy), b = _mm256_add_ps(dx, dy);
+                        __m256 c = _mm256_sub_ps(dx, dz), d = _mm256_add_ps(dx, dz);
+                        __m256 e = _mm256_sub_ps(dy, dz), f = _mm256_add_ps(dy, dz);
+                        __m256 pa = _mm256_cmp_ps(a, nrxy8, _CMP_GE_OQ), na = _mm256_cmp_ps(a, rxy8, _CMP_LE_OQ);
+                        __m256 pb = _mm256_cmp_ps(b, nrxy8, _CMP_GE_OQ), nb = _mm256_cmp_ps(b, rxy8, _CMP_LE_OQ);
+                        __m256 pc = _mm256_cmp_ps(c, nrxz8, _CMP_GE_OQ), nc = _mm256_cmp_ps(c, rxz8, _CMP_LE_OQ);
+                        __m256 pd = _mm256_cmp_ps(d, nrxz8, _CMP_GE_OQ), nd = _mm256_cmp_ps(d, rxz8, _CMP_LE_OQ);
+                        __m256 pe = _mm256_cmp_ps(e, nryz8, _CMP_GE_OQ), ne = _mm256_cmp_ps(e, ryz8, _CMP_LE_OQ);
+                        __m256 pf = _mm256_cmp_ps(f, nryz8, _CMP_GE_OQ), nf = _mm256_cmp_ps(f, ryz8, _CMP_LE_OQ);
+                        int faces[FACES] = {
+                            _mm256_movemask_ps(_mm256_and_ps(_mm256_and_ps(pa, pb), _mm256_and_ps(pc, pd))),
+                            _mm256_movemask_ps(_mm256_and_ps(_mm256_and_ps(na, nb), _mm256_and_ps(nc, nd))),
+                            _mm256_movemask_ps(_mm256_and_ps(_mm256_and_ps(na, pb), _mm256_and_ps(pe, pf))),
+                            _mm256_movemask_ps(_mm256_and_ps(_mm256_and_ps(pa, nb), _mm256_and_ps(ne, nf))),
+                            _mm256_movemask_ps(_mm256_and_ps(_mm256_and_ps(nc, pd), _mm256_and_ps(ne, pf))),
+                            _mm256_movemask_ps(_mm256_and_ps(_mm256_and_ps(pc, nd), _mm256_and_ps(pe, nf))),
+                        };
+                        for (; any; any &= any - 1) {
+                            int lane = findLowestBit(uint32_t(any));
+                            uint32_t bits = 0;
+                            for (uint32_t face = 0; face < FACES; face++)
+                                bits |= uint32_t(faces[face] >> lane & 1) << face;
+                            record(j + lane, bits, x, y, z);
+                        }
+                    }
+#endif
+#if defined(SIMD_SSE)
+                    for (; j + 4 <= cellEnd; j += 4) {
+                        __m128 dx = _mm_sub_ps(cx4, _mm_loadu_ps(&cellX[j]));
+                        __m128 dy = _mm_sub_ps(cy4, _mm_loadu_ps(&cellY[j]));
+                        __m128 dz = _mm_sub_ps(cz4, _mm_loadu_ps(&cellZ[j]));
+                        __m128 r = _mm_loadu_ps(&cellR[j]);
+                        __m128 ax = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign4, dx), ex4), zero4);
+                        __m128 ay = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign4, dy), ey4), zero4);
+                        __m128 az = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign4, dz), ez4), zero4);
+                        __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay)), _mm_mul_ps(az, az));
+                        __m128 inside = _mm_cmple_ps(dist2, _mm_mul_ps(r, r));
+                        int any = _mm_movemask_ps(inside);
+                        if (!any)
+                            continue;
+
+                        __m128 a = _mm_sub_ps(dx, dy), b = _mm_add_ps(dx, dy);
+                        __m128 c = _mm_sub_ps(dx, dz), d = _mm_add_ps(dx, dz);
+                        __m128 e = _mm_sub_ps(dy, dz), f = _mm_add_ps(dy, dz);
+                        __m128 pa = _mm_cmpge_ps(a, nrxy4), na = _mm_cmple_ps(a, rxy4);
+                        __m128 pb = _mm_cmpge_ps(b, nrxy4), nb = _mm_cmple_ps(b, rxy4);
+                        __m128 pc = _mm_cmpge_ps(c, nrxz4), nc = _mm_cmple_ps(c, rxz4);
+                        __m128 pd = _mm_cmpge_ps(d, nrxz4), nd = _mm_cmple_ps(d, rxz4);
+                        __m128 pe = _mm_cmpge_ps(e, nryz4), ne = _mm_cmple_ps(e, ryz4);
+                        __m128 pf = _mm_cmpge_ps(f, nryz4), nf = _mm_cmple_ps(f, ryz4);
+                        int faces[FACES] = {
+                            _mm_movemask_ps(_mm_and_ps(_mm_and_ps(pa, pb), _mm_and_ps(pc, pd))),
+                            _mm_movemask_ps(_mm_and_ps(_mm_and_ps(na, nb), _mm_and_ps(nc, nd))),
+                            _mm_movemask_ps(_mm_and_ps(_mm_and_ps(na, pb), _mm_and_ps(pe, pf))),
+                            _mm_movemask_ps(_mm_and_ps(_mm_and_ps(pa, nb), _mm_and_ps(ne, nf))),
+                            _mm_movemask_ps(_mm_and_ps(_mm_and_ps(nc, pd), _mm_and_ps(ne, pf))),
+                            _mm_movemask_ps(_mm_and_ps(_mm_and_ps(pc, nd), _mm_and_ps(pe, nf))),
+                        };
+                        for (; any; any &= any - 1) {
+                            int lane = findLowestBit(uint32_t(any));
+                            uint32_t bits = 0;
+                            for (uint32_t face = 0; face < FACES; face++)
+                                bits |= uint32_t(faces[face] >> lane & 1) << face;
+                            record(j + lane, bits, x, y, z);
+                        }
+                    }
+#endif
+                    for (; j < cellEnd; j++) {
+                        uint32_t bits = getFaceBits(center[0] - cellX[j], center[1] - cellY[j], center[2] - cellZ[j],
+                            extent[0], extent[1], extent[2], cellR[j]);
+                        if (bits)
+                            record(j, bits & 63u, x, y, z);
+                    }
+                }
+            }
+        }
+
+        chunk.candidates += hitsCount;
+        for (size_t h = 0; h < hitsCount; h++) {
+            uint32_t light = cellLights[hits[h] >> 6];
+            for (uint32_t bits = hits[h] & faceMasks[light]; bits; bits &= bits - 1) {
+                uint32_t list = light * FACES + uint32_t(findLowestBit(bits));
+                chunk.lists.push_back(list);
+                chunk.instances.push_back(i);
+                chunk.counts[list]++;
+            }
+        }
+    }
+}
+
+void ShadowCasterCuller::cull(const InstanceBounds& bounds, const float* spheres, size_t stride, size_t lightsCount, const float planes[6][4]) {
+    stats = ShadowCasterStats();
+    stats.lights = lightsCount;
+    stats.instances = bounds.size();
+    selectLights(spheres, stride, lightsCount, planes);
+    stats.activeLights = activeLights.size();
+
+    size_t lists = activeLights.size() * FACES;
+    ranges.assign(lists, CasterRange{ 0, 0 });
+    casters.clear();
+    if (activeLights.empty())
+        return;
+    buildGrid();
+    binInstances(bounds);
+
+    // Few large chunks keep the per-chunk list counts small next to the pairs.
+    size_t count = binned.size();
+    size_t grain = (std::max)(size_t(1024), (count + 63) / 64);
+    size_t chunksCount = (count + grain - 1) / grain;
+    if (chunks.size() < chunksCount)
+        chunks.resize(chunksCount);
+    JobSystem& jobs = JobSystem::GetInstance();
+    jobs.parallelFor(count, grain, [&](size_t begin, size_t end) {
+        cullRange(begin, end, chunks[begin / grain]);
+    });
+
+    // The lists follow each other in light and face order, and inside a list the chunks in
+    // binned order; the counts of every chunk become its first write position per list.
+    uint32_t offset = 0;
+    for (size_t list = 0; list < lists; list++) {
+        ranges[list].offset = offset;
+        for (size_t k = 0; k < chunksCount; k++) {
+            uint32_t chunkCount = chunks[k].counts[list];
+            chunks[k].counts[list] = offset;
+            offset += chunkCount;
+        }
+        ranges[list].count = offset - ranges[list].offset;
+    }
+    casters.resize(offset);
+
+    jobs.parallelFor(chunksCount, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            CasterChunk& chunk = chunks[k];
+            for (size_t p = 0; p < chunk.lists.size(); p++)
+                casters[chunk.counts[chunk.lists[p]]++] = chunk.instances[p];
+        }
+    });
+
+    for (size_t k = 0; k < chunksCount; k++)
+        stats.candidates += chunks[k].candidates;
+    stats.casters = offset;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "instanceBounds.h"
+
+// Casters of one cube face of one light: `count` entries of the caster list starting at `offset`.
+struct CasterRange {
+	uint32_t offset;
+	uint32_t count;
+};
+
+struct ShadowCasterStats {
+	size_t lights = 0;
+	size_t activeLights = 0; // whose influence sphere touches the camera frustum
+	size_t activeFaces = 0;  // faces of those lights that see part of the camera frustum
+	size_t instances = 0;
+	size_t candidates = 0;   // instance-light pairs inside the influence sphere
+	size_t casters = 0;      // entries over all the face lists
+};
+
+// Shadow-caster culling for point lights rendered as six 90 degree cube-face views, in the
+// D3D face order +X, -X, +Y, -Y, +Z, -Z. Lights whose sphere misses the camera frustum are
+// skipped, and so are the faces whose pyramid does not reach it. The active lights are binned
+// into a uniform grid, so every instance only meets the lights of its own cells, and each of
+// those is tested once against all six faces at a time: the face pyramids are bounded by the
+// six planes x = +-y, x = +-z, y = +-z through the light, so six plane tests and the sphere
+// test give a bitmask of the faces that see the box. Instances are visited grouped by grid
+// cell, which keeps the lights of a cell in cache, and the lists hold them in that order, by
+// cell and then by index, on every run and thread count.
+class ShadowCasterCuller {
+public:
+	static const uint32_t FACES = 6;
+
+	// Spheres are read `stride` bytes apart as x, y, z, influence radius. `planes` is the
+	// camera frustum, a point is inside when a * x + b * y + c * z + d >= 0 for all six.
+	void cull(const InstanceBounds& bounds, const float* spheres, size_t stride, size_t lightsCount, const float planes[6][4]);
+
+	// Light indices of the active lights, in increasing order.
+	const std::vector<uint32_t>& getActiveLights() const { return activeLights; };
+	// Per active light * FACES + face, empty for the faces that were skipped.
+	const std::vector<CasterRange>& getRanges() const { return ranges; };
+	// Instance indices, grouped by the grid cell of their lower corner.
+	const std::vector<uint32_t>& getCasters() const { return casters; };
+	const ShadowCasterStats& getStats() const { return stats; };
+
+private:
+	// Output of one chunk of instances: its (list, instance) pairs and, per list, how many of
+	// them it has and then where they go.
+	struct CasterChunk {
+		std::vector<uint32_t> lists;
+		std::vector<uint32_t> instances;
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> hits; // of one instance
+		size_t candidates = 0;
+	};
+
+	struct BinnedInstance {
+		float center[3];
+		float extent[3];
+		uint32_t first, last; // cells
+		uint32_t index;
+	};
+
+	void selectLights(const float* spheres, size_t stride, size_t lightsCount, const float planes[6][4]);
+	void buildGrid();
+	void binInstances(const InstanceBounds& bounds);
+	int getCell(float x, int axis) const;
+	size_t getCellIndex(uint32_t packed) const;
+	void cullRange(size_t begin, size_t end, CasterChunk& chunk) const;
+
+	std::vector<uint32_t> activeLights;
+	std::vector<float> lightX, lightY, lightZ, lightR; // per active light
+	std::vector<uint8_t> faceMasks;                    // faces that reach the camera frustum
+
+	// Cells hold their lights padded to a multiple of 8 with lights that never pass,
+	// cell c in [cellStarts[c], cellStarts[c + 1]).
+	float gridMin[3] = {};
+	float cellSize = 1.0f;
+	float invCellSize = 1.0f;
+	int gridSize[3] = {};
+	std::vector<uint32_t> cellStarts;
+	std::vector<float> cellX, cellY, cellZ, cellR;
+	std::vector<uint32_t> cellLights;  // active light index
+	std::vector<uint32_t> cellFirsts;  // first cell of the light, x | y << 10 | z << 20
+
+	std::vector<uint32_t> instanceCells; // first and last cell per instance, packed the same way
+	std::vector<BinnedInstance> binned;  // instances that reach the grid, by their first cell
+	std::vector<uint32_t> cellCounts;
+
+	std::vector<CasterChunk> chunks;
+	std::vector<CasterRange> ranges;
+	std::vector<uint32_t> casters;
+	ShadowCasterStats stats;
+};
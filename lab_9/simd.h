@@ -0,0 +1,27 @@
+#pragma once
+
+// Instruction set selection for the CPU kernels. SSE2 is always present on x64,
+// AVX is used only when the compiler is allowed to emit it (/arch:AVX, -mavx).
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <immintrin.h>
+#endif
+
+#if defined(SIMD_SSE) && defined(__AVX__)
+#define SIMD_AVX 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit of a movemask result, which must not be zero.
+static inline int findLowestBit(unsigned int mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return int(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
@@ -1,42 +1,52 @@
-#pragma once
-
-#include <d3dcompiler.h>
-#include <dxgi.h>
-#include <d3d11.h>
-#include <directxmath.h>
-#include <string>
-#include <vector>
-
-#include "structures.h"
-#include "texture.h"
-
-using namespace DirectX;
-
-class Skybox {
-public:
-	HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight);
-	void realize();
-	void resize(int screenWidth, int screenHeight);
-	void render(ID3D11DeviceContext* context);
-	bool frame(ID3D11DeviceContext* context, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, XMFLOAT3 cameraPos);
-
-private:
-	void generateSphere(UINT LatLines, UINT LongLines, std::vector<SimpleVertex>& vertices, std::vector<UINT>& indices);
-
-	ID3D11Buffer* g_pVertexBuffer = nullptr;
-	ID3D11Buffer* g_pIndexBuffer = nullptr;
-	ID3D11Buffer* g_pWorldMatrixBuffer = nullptr;
-	ID3D11Buffer* g_pSceneMatrixBuffer = nullptr;
-	ID3D11RasterizerState* g_pRasterizerState = nullptr;
-	ID3D11SamplerState* g_pSamplerState = nullptr;
-
-	ID3D11InputLayout* g_pVertexLayout = nullptr;
-	ID3D11VertexShader* g_pVertexShader = nullptr;
-	ID3D11PixelShader* g_pPixelShader = nullptr;
-
-	Texture texture;
-
-	UINT numSphereVertices = 0;
-	UINT numSphereFaces = 0;
-	float radius = 1.0f;
+#pragma once
+
+#include <d3dcompiler.h>
+#include <dxgi.h>
+#include <d3d11.h>
+#include <directxmath.h>
+#include <string>
+#include <vector>
+
+#include "structures.h"
+#include "meshLibrary.h"
+#include "renderQueue.h"
+#include "commandList.h"
+#include "texture.h"
+#include "environmentLighting.h"
+
+using namespace DirectX;
+
+class Skybox {
+public:
+	HRESULT init(ID3D11Device* device, ID3D11DeviceContext* context, int screenWidth, int screenHeight);
+	void realize();
+	void resize(int screenWidth, int screenHeight);
+	void submit(RenderQueue& queue, uint32_t object) const;
+	void bind(CommandList& commands);
+	void draw(CommandList& commands, uint32_t item);
+	bool frame(CommandList& commands);
+	// The prefiltered sky in t11 of the pixel stage, for the image-based ambient light.
+	void bindEnvironment(CommandList& commands);
+
+	const EnvironmentLighting& getEnvironment() const { return environment; };
+
+private:
+	ID3D11Buffer* g_pVertexBuffer = nullptr;
+	ID3D11Buffer* g_pIndexBuffer = nullptr;
+	ID3D11RasterizerState* g_pRasterizerState = nullptr;
+	ID3D11SamplerState* g_pSamplerState = nullptr;
+
+	ID3D11InputLayout* g_pVertexLayout = nullptr;
+	ID3D11VertexShader* g_pVertexShader = nullptr;
+	ID3D11PixelShader* g_pPixelShader = nullptr;
+
+	uint32_t worldBlock = newConstantBlock();
+
+	Texture texture;
+	Texture environmentTexture;
+	EnvironmentLighting environment;
+
+	UINT indexCount = 0;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT;
+	float radius = 1.0f;
 };
\ No newline at end of file
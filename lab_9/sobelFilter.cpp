@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "sobelFilter.h"
+#include "jobSystem.h"
+#include "simd.h"
+
+static const float UNORM_SCALE = 1.0f / 255.0f;
+
+static uint8_t* getRow(const ImageView& image, uint32_t y) {
+    return static_cast<uint8_t*>(image.data) + size_t(y) * image.pitch;
+}
+
+static void loadPixel(const ImageView& source, const uint8_t* row, uint32_t x, float* pixel) {
+    if (source.format == IMAGE_RGBA32F) {
+        memcpy(pixel, row + size_t(x) * 16, 16);
+        return;
+    }
+    for (int c = 0; c < 4; c++)
+        pixel[c] = float(row[size_t(x) * 4 + c]) * UNORM_SCALE;
+}
+
+// Round to nearest even, as the conversion instructions of the SIMD paths do by default.
+static uint8_t toUnorm(float value) {
+    value = (std::min)((std::max)(value, 0.0f), 1.0f);
+    return uint8_t(lrintf(value * 255.0f));
+}
+
+void SobelFilter::setTileSize(uint32_t width, uint32_t height) {
+    tileWidth = (std::max)(width, 1u);
+    tileHeight = (std::max)(height, 1u);
+}
+
+// Pixels x0 - 1 to x1 of row y as floats, the outer two clamped to the image.
+void SobelFilter::loadRow(const ImageView& source, uint32_t y, uint32_t x0, uint32_t x1, float* line) const {
+    const uint8_t* row = getRow(source, y);
+    loadPixel(source, row, x0 > 0 ? x0 - 1 : 0, line);
+    loadPixel(source, row, (std::min)(x1, source.width - 1), line + size_t(x1 - x0 + 1) * 4);
+    float* pixels = line + 4;
+    if (source.format == IMAGE_RGBA32F) {
+        memcpy(pixels, row + size_t(x0) * 16, size_t(x1 - x0) * 16);
+        return;
+    }
+
+    const uint8_t* bytes = row + size_t(x0) * 4;
+    size_t count = size_t(x1 - x0) * 4;
+    size_t i = 0;
+#if defined(SIMD_SSE)
+    __m128i zero = _mm_setzero_si128();
+    __m128 scale = _mm_set1_ps(UNORM_SCALE);
+    for (; i + 16 <= count; i += 16) {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        __m128i low = _mm_unpacklo_epi8(packed, zero);
+        __m128i high = _mm_unpackhi_epi8(packed, zero);
+        _mm_storeu_ps(pixels + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+        _mm_storeu_ps(pixels + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+        _mm_storeu_ps(pixels + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+        _mm_storeu_ps(pixels + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
+    }
+#endif
+    for (; i < count; i++)
+        pixels[i] = float(bytes[i]) * UNORM_SCALE;
+}
+
+// Row y of the result from the filtered rows y - 1, y and y + 1: the x gradient is the
+// [1 2 1] column sum of the horizontal differences, the y gradient the difference of the
+// row sums below and above.
+void SobelFilter::storeRow(const ImageView& target, uint32_t y, uint32_t x0, uint32_t x1, const float* dx[3], const float* sum[3]) const {
+    uint8_t* row = getRow(target, y);
+    size_t count = size_t(x1 - x0) * 4;
+    size_t i = 0;
+
+    if (target.format == IMAGE_RGBA32F) {
+        float* pixels = reinterpret_cast<float*>(row) + size_t(x0) * 4;
+#if defined(SIMD_AVX)
+        __m256 two8 = _mm256_set1_ps(2.0f);
+        __m256 one8 = _mm256_set1_ps(1.0f);
+        for (; i + 8 <= count; i += 8) {
+            __m256 gx = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(dx[0] + i), _mm256_loadu_ps(dx[2] + i)), _mm256_mul_ps(two8, _mm256_loadu_ps(dx[1] + i)));
+            __m256 gy = _mm256_sub_ps(_mm256_loadu_ps(sum[2] + i), _mm256_loadu_ps(sum[0] + i));
+            __m256 magnitude = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy)));
+            _mm256_storeu_ps(pixels + i, _mm256_blend_ps(magnitude, one8, 0x88));
+        }
+#endif
+#if defined(SIMD_SSE)
+        __m128 two4 = _mm_set1_ps(2.0f);
+        __m128 rgb4 = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        __m128 alpha4 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 gx = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(dx[0] + i), _mm_loadu_ps(dx[2] + i)), _mm_mul_ps(two4, _mm_loadu_ps(dx[1] + i)));
+            __m128 gy = _mm_sub_ps(_mm_loadu_ps(sum[2] + i), _mm_loadu_ps(sum[0] + i));
+            __m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+            _mm_storeu_ps(pixels + i, _mm_or_ps(_mm_and_ps(magnitude, rgb4), alpha4));
+        }
+#endif
+        for (; i < count; i++) {
+            float gx = dx[0][i] + dx[2][i] + 2.0f * dx[1][i];
+            float gy = sum[2][i] - sum[0][i];
+            pixels[i] = (i & 3) == 3 ? 1.0f : sqrtf(gx * gx + gy * gy);
+        }
+        return;
+    }
+
+    uint8_t* pixels = row + size_t(x0) * 4;
+#if defined(SIMD_SSE)
+    __m128 two4 = _mm_set1_ps(2.0f);
+    __m128 zero4 = _mm_setzero_ps();
+    __m128 one4 = _mm_set1_ps(1.0f);
+    __m128 scale4 = _mm_set1_ps(255.0f);
+    __m128i alpha = _mm_set1_epi32(int(0xFF000000));
+    auto getUnorm = [&](size_t f) {
+        __m128 gx = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(dx[0] + f), _mm_loadu_ps(dx[2] + f)), _mm_mul_ps(two4, _mm_loadu_ps(dx[1] + f)));
+        __m128 gy = _mm_sub_ps(_mm_loadu_ps(sum[2] + f), _mm_loadu_ps(sum[0] + f));
+        __m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+        return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(magnitude, zero4), one4), scale4));
+    };
+    for (; i + 16 <= count; i += 16) {
+        __m128i low = _mm_packs_epi32(getUnorm(i), getUnorm(i + 4));
+        __m128i high = _mm_packs_epi32(getUnorm(i + 8), getUnorm(i + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_or_si128(_mm_packus_epi16(low, high), alpha));
+    }
+    for (; i + 4 <= count; i += 4) {
+        __m128i packed = _mm_packs_epi32(getUnorm(i), _mm_setzero_si128());
+        int value = _mm_cvtsi128_si32(_mm_or_si128(_mm_packus_epi16(packed, packed), alpha));
+        memcpy(pixels + i, &value, 4);
+    }
+#endif
+    for (; i < count; i++) {
+        float gx = dx[0][i] + dx[2][i] + 2.0f * dx[1][i];
+        float gy = sum[2][i] - sum[0][i];
+        pixels[i] = (i & 3) == 3 ? 255 : toUnorm(sqrtf(gx * gx + gy * gy));
+    }
+}
+
+// The rows of a tile and the one above and below it pass through a ring of three filtered
+// rows, so every source pixel is loaded and filtered horizontally once per tile.
+void SobelFilter::applyTile(const ImageView& source, const ImageView& target, uint32_t x0, uint32_t y0, float* scratch) const {
+    uint32_t x1 = (std::min)(x0 + tileWidth, source.width);
+    uint32_t y1 = (std::min)(y0 + tileHeight, source.height);
+    size_t count = size_t(x1 - x0) * 4;
+    size_t stride = size_t(tileWidth) * 4;
+    float* line = scratch;
+    float* dxRows = line + stride + 8;
+    float* sumRows = dxRows + 3 * stride;
+
+    auto filterRow = [&](int y, uint32_t slot) {
+        uint32_t clamped = uint32_t((std::min)((std::max)(y, 0), int(source.height) - 1));
+        loadRow(source, clamped, x0, x1, line);
+        float* dx = dxRows + slot * stride;
+        float* sum = sumRows + slot * stride;
+        size_t i = 0;
+#if defined(SIMD_AVX)
+        __m256 two8 = _mm256_set1_ps(2.0f);
+        for (; i + 8 <= count; i += 8) {
+            __m256 left = _mm256_loadu_ps(line + i);
+            __m256 right = _mm256_loadu_ps(line + i + 8);
+            _mm256_storeu_ps(dx + i, _mm256_sub_ps(right, left));
+            _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_add_ps(left, right), _mm256_mul_ps(two8, _mm256_loadu_ps(line + i + 4))));
+        }
+#endif
+#if defined(SIMD_SSE)
+        __m128 two4 = _mm_set1_ps(2.0f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 left = _mm_loadu_ps(line + i);
+            __m128 right = _mm_loadu_ps(line + i + 8);
+            _mm_storeu_ps(dx + i, _mm_sub_ps(right, left));
+            _mm_storeu_ps(sum + i, _mm_add_ps(_mm_add_ps(left, right), _mm_mul_ps(two4, _mm_loadu_ps(line + i + 4))));
+        }
+#endif
+        for (; i < count; i++) {
+            dx[i] = line[i + 8] - line[i];
+            sum[i] = line[i] + line[i + 8] + 2.0f * line[i + 4];
+        }
+    };
+
+    filterRow(int(y0) - 1, 0);
+    filterRow(int(y0), 1);
+    for (uint32_t y = y0; y < y1; y++) {
+        uint32_t above = (y - y0) % 3, center = (y - y0 + 1) % 3, below = (y - y0 + 2) % 3;
+        filterRow(int(y) + 1, below);
+        const float* dx[3] = { dxRows + above * stride, dxRows + center * stride, dxRows + below * stride };
+        const float* sum[3] = { sumRows + above * stride, sumRows + center * stride, sumRows + below * stride };
+        storeRow(target, y, x0, x1, dx, sum);
+    }
+}
+
+void SobelFilter::apply(const ImageView& source, const ImageView& target) {
+    assert(source.width == target.width && source.height == target.height);
+    auto start = std::chrono::steady_clock::now();
+    stats = SobelStats();
+    if (source.width == 0 || source.height == 0)
+        return;
+
+    uint32_t tilesX = (source.width + tileWidth - 1) / tileWidth;
+    uint32_t tilesY = (source.height + tileHeight - 1) / tileHeight;
+    size_t tiles = size_t(tilesX) * tilesY;
+    // The line with its two border pixels, then three rows of differences and three of sums.
+    size_t scratchSize = size_t(tileWidth) * 4 * 7 + 8;
+    JobSystem::GetInstance().parallelFor(tiles, 1, [&](size_t begin, size_t end) {
+        std::vector<float> scratch(scratchSize);
+        for (size_t t = begin; t < end; t++)
+            applyTile(source, target, uint32_t(t % tilesX) * tileWidth, uint32_t(t / tilesX) * tileHeight, scratch.data());
+    });
+
+    stats.pixels = size_t(source.width) * source.height;
+    stats.tiles = tiles;
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum ImageFormat {
+	IMAGE_RGBA8 = 0,   // unorm, as DXGI_FORMAT_R8G8B8A8_UNORM
+	IMAGE_RGBA32F = 1, // as DXGI_FORMAT_R32G32B32A32_FLOAT
+};
+
+// Rows of `width` RGBA pixels, `pitch` bytes apart, like a mapped D3D11 subresource.
+struct ImageView {
+	void* data;
+	size_t pitch;
+	uint32_t width;
+	uint32_t height;
+	ImageFormat format;
+};
+
+struct SobelStats {
+	size_t pixels = 0;
+	size_t tiles = 0;
+	double milliseconds = 0.0;
+
+	double getMegapixelsPerSecond() const { return milliseconds > 0.0 ? double(pixels) / (milliseconds * 1000.0) : 0.0; };
+};
+
+// CPU version of the Sobel effect of PostprocessingPixelShader: per color channel the
+// magnitude of the 3x3 Sobel gradient, alpha 1, edges clamped like the point sampler of
+// Postprocessing. Both kernels are separable, so every source row is read once per tile into
+// floats, its horizontal difference and [1 2 1] sum are kept for three rows, and the vertical
+// pass combines them. The image is cut into tiles whose rows stay in cache, and the tiles are
+// spread over the job system. Unorm results are rounded to nearest like the GPU stores them,
+// so an RGBA8 target is within one step of the shader output.
+class SobelFilter {
+public:
+	void setTileSize(uint32_t width, uint32_t height);
+
+	// Both views have the same size and must not overlap; any mix of the formats works.
+	void apply(const ImageView& source, const ImageView& target);
+
+	const SobelStats& getStats() const { return stats; };
+
+private:
+	void applyTile(const ImageView& source, const ImageView& target, uint32_t x0, uint32_t y0, float* scratch) const;
+	void loadRow(const ImageView& source, uint32_t y, uint32_t x0, uint32_t x1, float* line) const;
+	void storeRow(const ImageView& target, uint32_t y, uint32_t x0, uint32_t x1, const float* dx[3], const float* sum[3]) const;
+
+	uint32_t tileWidth = 256;
+	uint32_t tileHeight = 64;
+	SobelStats stats;
+};
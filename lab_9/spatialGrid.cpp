@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "spatialGrid.h"
+#include "frustumCuller.h"
+
+// 21 bits per axis, enough for +-1M cells.
+static uint64_t cellKey(int x, int y, int z) {
+    return (uint64_t(x & 0x1FFFFF) << 42) | (uint64_t(y & 0x1FFFFF) << 21) | uint64_t(z & 0x1FFFFF);
+}
+
+int SpatialGrid::getCell(const float center[3]) {
+    int coord[3];
+    for (int a = 0; a < 3; a++)
+        coord[a] = int(floorf(center[a] / cellSize));
+
+    uint64_t key = cellKey(coord[0], coord[1], coord[2]);
+    auto it = cellMap.find(key);
+    if (it != cellMap.end())
+        return it->second;
+
+    Cell cell;
+    for (int a = 0; a < 3; a++)
+        cell.coord[a] = coord[a];
+    cell.head = -1;
+    cell.count = 0;
+    cell.maxRadius = 0.0f;
+
+    int index = int(cells.size());
+    cells.push_back(cell);
+    cellMap[key] = index;
+    return index;
+}
+
+void SpatialGrid::link(int handle, int cellIndex) {
+    Object& object = objects[handle];
+    Cell& cell = cells[cellIndex];
+
+    object.cell = cellIndex;
+    object.prev = -1;
+    object.next = cell.head;
+    if (cell.head >= 0)
+        objects[cell.head].prev = handle;
+    cell.head = handle;
+    cell.count++;
+    cell.maxRadius = (std::max)(cell.maxRadius, object.radius);
+}
+
+void SpatialGrid::unlink(int handle) {
+    Object& object = objects[handle];
+    Cell& cell = cells[object.cell];
+
+    if (object.prev >= 0)
+        objects[object.prev].next = object.next;
+    else
+        cell.head = object.next;
+    if (object.next >= 0)
+        objects[object.next].prev = object.prev;
+
+    // Cells are kept when they empty out, only their radius bound is reset.
+    if (--cell.count == 0)
+        cell.maxRadius = 0.0f;
+    object.cell = -1;
+}
+
+int SpatialGrid::insert(int id, const float center[3], float radius) {
+    int handle;
+    if (!freeObjects.empty()) {
+        handle = freeObjects.back();
+        freeObjects.pop_back();
+    }
+    else {
+        handle = int(objects.size());
+        objects.push_back(Object());
+    }
+
+    Object& object = objects[handle];
+    for (int a = 0; a < 3; a++)
+        object.center[a] = center[a];
+    object.radius = radius;
+    object.id = id;
+    maxRadius = (std::max)(maxRadius, radius);
+
+    link(handle, getCell(center));
+    return handle;
+}
+
+// Like remove, a stale handle (removed, or never inserted) is ignored: its object belongs to no cell.
+void SpatialGrid::move(int handle, const float center[3], float radius) {
+    if (handle < 0 || handle >= int(objects.size()) || objects[handle].cell < 0)
+        return;
+
+    Object& object = objects[handle];
+    const Cell& cell = cells[object.cell];
+    bool sameCell = true;
+    for (int a = 0; a < 3; a++)
+        sameCell = sameCell && int(floorf(center[a] / cellSize)) == cell.coord[a];
+
+    for (int a = 0; a < 3; a++)
+        object.center[a] = center[a];
+    object.radius = radius;
+    maxRadius = (std::max)(maxRadius, radius);
+
+    if (sameCell) {
+        cells[object.cell].maxRadius = (std::max)(cell.maxRadius, radius);
+        return;
+    }
+
+    unlink(handle);
+    link(handle, getCell(center));
+}
+
+void SpatialGrid::remove(int handle) {
+    if (handle < 0 || handle >= int(objects.size()) || objects[handle].cell < 0)
+        return;
+
+    unlink(handle);
+    freeObjects.push_back(handle);
+}
+
+bool SpatialGrid::cellOverlapsBox(const Cell& cell, const float bbMin[3], const float bbMax[3]) const {
+    for (int a = 0; a < 3; a++) {
+        float cellMin = cell.coord[a] * cellSize - cell.maxRadius;
+        float cellMax = (cell.coord[a] + 1) * cellSize + cell.maxRadius;
+        if (cellMin > bbMax[a] || cellMax < bbMin[a])
+            return false;
+    }
+
+    return true;
+}
+
+// Visits the non-empty cells whose loose box overlaps [bbMin, bbMax]. Small ranges are
+// looked up cell by cell, ranges with more cells than the grid holds scan the cell list.
+template <typename F>
+void SpatialGrid::forEachCell(const float bbMin[3], const float bbMax[3], F visit) const {
+    int first[3], last[3];
+    double range = 1.0;
+    for (int a = 0; a < 3; a++) {
+        double lo = floor((double(bbMin[a]) - maxRadius) / cellSize);
+        double hi = floor((double(bbMax[a]) + maxRadius) / cellSize);
+        range *= hi - lo + 1.0;
+        first[a] = int((std::max)(lo, -1048576.0));
+        last[a] = int((std::min)(hi, 1048575.0));
+    }
+
+    if (range > double(cells.size())) {
+        for (const auto& cell : cells) {
+            if (cell.count > 0 && cellOverlapsBox(cell, bbMin, bbMax))
+                visit(cell);
+        }
+        return;
+    }
+
+    for (int x = first[0]; x <= last[0]; x++) {
+        for (int y = first[1]; y <= last[1]; y++) {
+            for (int z = first[2]; z <= last[2]; z++) {
+                auto it = cellMap.find(cellKey(x, y, z));
+                if (it == cellMap.end())
+                    continue;
+
+                const Cell& cell = cells[it->second];
+                if (cell.count > 0 && cellOverlapsBox(cell, bbMin, bbMax))
+                    visit(cell);
+            }
+        }
+    }
+}
+
+// Corner shared by three planes, false when two of them are parallel.
+static bool intersectPlanes(const float a[4], const float b[4], const float c[4], float point[3]) {
+    float bc[3] = { b[1] * c[2] - b[2] * c[1], b[2] * c[0] - b[0] * c[2], b[0] * c[1] - b[1] * c[0] };
+    float ca[3] = { c[1] * a[2] - c[2] * a[1], c[2] * a[0] - c[0] * a[2], c[0] * a[1] - c[1] * a[0] };
+    float ab[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    float det = a[0] * bc[0] + a[1] * bc[1] + a[2] * bc[2];
+    if (fabsf(det) < 1e-6f)
+        return false;
+
+    for (int i = 0; i < 3; i++)
+        point[i] = -(a[3] * bc[i] + b[3] * ca[i] + c[3] * ab[i]) / det;
+    return true;
+}
+
+// The frustum corners bound the cell range; every cell in it is then tested as a loose box.
+void SpatialGrid::queryFrustum(const float planes[6][4], std::vector<int>& ids) const {
+    ids.clear();
+    float bbMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float bbMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int corner = 0; corner < 8; corner++) {
+        float point[3];
+        if (!intersectPlanes(planes[corner & 1], planes[2 + ((corner >> 1) & 1)], planes[4 + (corner >> 2)], point)) {
+            for (int a = 0; a < 3; a++) {
+                bbMin[a] = -FLT_MAX;
+                bbMax[a] = FLT_MAX;
+            }
+            break;
+        }
+        for (int a = 0; a < 3; a++) {
+            bbMin[a] = (std::min)(bbMin[a], point[a]);
+            bbMax[a] = (std::max)(bbMax[a], point[a]);
+        }
+    }
+
+    float half = cellSize * 0.5f;
+    forEachCell(bbMin, bbMax, [&](const Cell& cell) {
+        float extent = half + cell.maxRadius;
+        if (!FrustumCuller::isBoxVisible(planes, cell.coord[0] * cellSize + half, cell.coord[1] * cellSize + half,
+                cell.coord[2] * cellSize + half, extent, extent, extent))
+            return;
+
+        for (int handle = cell.head; handle >= 0; handle = objects[handle].next) {
+            const Object& object = objects[handle];
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++) {
+                inside = planes[p][0] * object.center[0] + planes[p][1] * object.center[1] +
+                    planes[p][2] * object.center[2] + planes[p][3] >= -object.radius;
+            }
+            if (inside)
+                ids.push_back(object.id);
+        }
+    });
+}
+
+void SpatialGrid::querySphere(const float center[3], float radius, std::vector<int>& ids) const {
+    ids.clear();
+    float bbMin[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+    float bbMax[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+    forEachCell(bbMin, bbMax, [&](const Cell& cell) {
+        for (int handle = cell.head; handle >= 0; handle = objects[handle].next) {
+            const Object& object = objects[handle];
+            float dx = object.center[0] - center[0];
+            float dy = object.center[1] - center[1];
+            float dz = object.center[2] - center[2];
+            float r = object.radius + radius;
+            if (dx * dx + dy * dy + dz * dz <= r * r)
+                ids.push_back(object.id);
+        }
+    });
+}
+
+void SpatialGrid::queryBox(const float bbMin[3], const float bbMax[3], std::vector<int>& ids) const {
+    ids.clear();
+    forEachCell(bbMin, bbMax, [&](const Cell& cell) {
+        for (int handle = cell.head; handle >= 0; handle = objects[handle].next) {
+            const Object& object = objects[handle];
+            float dist = 0.0f;
+            for (int a = 0; a < 3; a++) {
+                float d = (std::max)((std::max)(bbMin[a] - object.center[a], object.center[a] - bbMax[a]), 0.0f);
+                dist += d * d;
+            }
+            if (dist <= object.radius * object.radius)
+                ids.push_back(object.id);
+        }
+    });
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Hashed uniform grid of bounding spheres. An object lives in the single cell that holds its
+// center, so cells are "loose": each one remembers the largest radius it holds and queries
+// test the cell box grown by that radius. Moving an object is O(1): its sphere is updated in
+// place and it is relinked only when the center crosses into another cell.
+// Queries report the ids given to insert, in no particular order.
+class SpatialGrid {
+public:
+	explicit SpatialGrid(float cellSize = 4.0f) : cellSize(cellSize) {};
+
+	// Returns the handle used by move/remove. Both ignore -1 and handles already removed.
+	int insert(int id, const float center[3], float radius);
+	void move(int handle, const float center[3], float radius);
+	void remove(int handle);
+
+	size_t size() const { return objects.size() - freeObjects.size(); };
+	size_t getCellsCount() const { return cells.size(); };
+
+	// Planes as built by Cube::getFrustum (near, far, left, right, top, bottom), inside when
+	// a*x + b*y + c*z + d >= 0. The corners of the pairs bound the cells that are visited.
+	void queryFrustum(const float planes[6][4], std::vector<int>& ids) const;
+	void querySphere(const float center[3], float radius, std::vector<int>& ids) const;
+	void queryBox(const float bbMin[3], const float bbMax[3], std::vector<int>& ids) const;
+
+private:
+	struct Object {
+		float center[3];
+		float radius;
+		int id;
+		int cell;  // -1 for a free object
+		int prev;
+		int next;
+	};
+
+	struct Cell {
+		int coord[3];
+		int head;
+		int count;
+		float maxRadius;
+	};
+
+	int getCell(const float center[3]);
+	void link(int handle, int cell);
+	void unlink(int handle);
+	bool cellOverlapsBox(const Cell& cell, const float bbMin[3], const float bbMax[3]) const;
+	template <typename F>
+	void forEachCell(const float bbMin[3], const float bbMax[3], F visit) const;
+
+	float cellSize;
+	float maxRadius = 0.0f; // largest radius ever inserted, bounds the cell range of box queries
+
+	std::unordered_map<uint64_t, int> cellMap;
+	std::vector<Cell> cells;
+	std::vector<Object> objects;
+	std::vector<int> freeObjects;
+};
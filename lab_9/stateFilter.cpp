@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cstring>
+
+#include "stateFilter.h"
+
+// Never a real object, so the first bind after a reset always goes through.
+static GpuHandle const UNKNOWN = reinterpret_cast<GpuHandle>(~uintptr_t(0));
+
+static void forget(GpuHandle* handles, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        handles[i] = UNKNOWN;
+}
+
+// Pointers are aligned, so an odd value never collides with a bound buffer.
+static GpuHandle blockHandle(uint32_t block) {
+    return reinterpret_cast<GpuHandle>((uintptr_t(block) << 1) | 1);
+}
+
+void StateFilter::reset() {
+    stats = StateFilterStats();
+
+    const ValueState unknown = { UNKNOWN, { 0, 0 } };
+    for (StageState& stage : stages) {
+        stage.shader = unknown;
+        forget(stage.constantBuffers, FILTER_CONSTANT_BUFFER_SLOTS);
+        forget(stage.shaderResources, FILTER_SHADER_RESOURCE_SLOTS);
+        forget(stage.samplers, FILTER_SAMPLER_SLOTS);
+    }
+    forget(unorderedAccessViews, FILTER_UNORDERED_ACCESS_SLOTS);
+    for (ValueState& vertexBuffer : vertexBuffers)
+        vertexBuffer = unknown;
+    inputLayout = unknown;
+    topology = unknown;
+    indexBuffer = unknown;
+    rasterizerState = unknown;
+    depthStencilState = unknown;
+    blendState = unknown;
+    forget(renderTargets, FILTER_RENDER_TARGET_SLOTS + 1);
+    renderTargetsCount = 0;
+    viewportKnown = false;
+}
+
+void StateFilter::issue(const CommandList& list, const Command& command) {
+    stats.issued++;
+    backend->execute(list, command);
+}
+
+// Only the span from the first to the last changed slot is bound.
+void StateFilter::filterHandles(const CommandList& list, const Command& command, GpuHandle* cache, uint32_t cacheSize) {
+    const GpuHandle* handles = list.getHandles(command);
+    if (command.slot + command.count > cacheSize) {
+        for (uint32_t i = command.slot; i < cacheSize; i++)
+            cache[i] = UNKNOWN;
+        issue(list, command);
+        return;
+    }
+
+    uint32_t first = command.count;
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < command.count; i++) {
+        if (cache[command.slot + i] != handles[i]) {
+            cache[command.slot + i] = handles[i];
+            first = (std::min)(first, i);
+            last = i;
+        }
+    }
+    if (first == command.count) {
+        stats.skipped++;
+        return;
+    }
+
+    Command changed = command;
+    changed.slot = uint16_t(command.slot + first);
+    changed.first = command.first + first;
+    changed.count = last - first + 1;
+    issue(list, changed);
+}
+
+void StateFilter::filterConstantBlocks(const CommandList& list, const Command& command) {
+    GpuHandle* cache = stages[command.stage].constantBuffers;
+    const uint32_t* blocks = static_cast<const uint32_t*>(list.getPayload(command.first));
+    if (command.slot + command.count > FILTER_CONSTANT_BUFFER_SLOTS) {
+        for (uint32_t i = command.slot; i < FILTER_CONSTANT_BUFFER_SLOTS; i++)
+            cache[i] = UNKNOWN;
+        issue(list, command);
+        return;
+    }
+
+    uint32_t first = command.count;
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < command.count; i++) {
+        if (cache[command.slot + i] != blockHandle(blocks[i])) {
+            cache[command.slot + i] = blockHandle(blocks[i]);
+            first = (std::min)(first, i);
+            last = i;
+        }
+    }
+    if (first == command.count) {
+        stats.skipped++;
+        return;
+    }
+
+    Command changed = command;
+    changed.slot = uint16_t(command.slot + first);
+    changed.first = command.first + first * sizeof(uint32_t);
+    changed.count = last - first + 1;
+    issue(list, changed);
+}
+
+void StateFilter::forgetConstantBlock(uint32_t block) {
+    for (StageState& stage : stages) {
+        for (GpuHandle& handle : stage.constantBuffers) {
+            if (handle == blockHandle(block))
+                handle = UNKNOWN;
+        }
+    }
+}
+
+void StateFilter::filterVertexBuffers(const CommandList& list, const Command& command) {
+    const GpuHandle* buffers = list.getHandles(command);
+    const uint32_t* strides = static_cast<const uint32_t*>(list.getPayload(command.args[0]));
+    const uint32_t* offsets = static_cast<const uint32_t*>(list.getPayload(command.args[1]));
+    if (command.slot + command.count > FILTER_VERTEX_BUFFER_SLOTS) {
+        for (uint32_t i = command.slot; i < FILTER_VERTEX_BUFFER_SLOTS; i++)
+            vertexBuffers[i].object = UNKNOWN;
+        issue(list, command);
+        return;
+    }
+
+    uint32_t first = command.count;
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < command.count; i++) {
+        ValueState& cache = vertexBuffers[command.slot + i];
+        if (cache.object != buffers[i] || cache.args[0] != strides[i] || cache.args[1] != offsets[i]) {
+            cache = { buffers[i], { strides[i], offsets[i] } };
+            first = (std::min)(first, i);
+            last = i;
+        }
+    }
+    if (first == command.count) {
+        stats.skipped++;
+        return;
+    }
+
+    Command changed = command;
+    changed.slot = uint16_t(command.slot + first);
+    changed.first = command.first + first;
+    changed.count = last - first + 1;
+    changed.args[0] = command.args[0] + first * sizeof(uint32_t);
+    changed.args[1] = command.args[1] + first * sizeof(uint32_t);
+    issue(list, changed);
+}
+
+void StateFilter::filterValue(const CommandList& list, const Command& command, ValueState& cache, size_t argsCount) {
+    bool same = cache.object == command.object;
+    for (size_t i = 0; i < argsCount; i++)
+        same = same && cache.args[i] == command.args[i];
+    if (same) {
+        stats.skipped++;
+        return;
+    }
+
+    cache.object = command.object;
+    for (size_t i = 0; i < argsCount; i++)
+        cache.args[i] = command.args[i];
+    issue(list, command);
+}
+
+void StateFilter::filterRenderTargets(const CommandList& list, const Command& command) {
+    const GpuHandle* views = list.getHandles(command);
+    if (command.count > FILTER_RENDER_TARGET_SLOTS) {
+        forget(renderTargets, FILTER_RENDER_TARGET_SLOTS + 1);
+        issue(list, command);
+        return;
+    }
+
+    bool same = renderTargetsCount == command.count && renderTargets[FILTER_RENDER_TARGET_SLOTS] == command.object;
+    for (uint32_t i = 0; i < command.count; i++)
+        same = same && renderTargets[i] == views[i];
+    if (same) {
+        stats.skipped++;
+        return;
+    }
+
+    for (uint32_t i = 0; i < command.count; i++)
+        renderTargets[i] = views[i];
+    renderTargets[FILTER_RENDER_TARGET_SLOTS] = command.object;
+    renderTargetsCount = command.count;
+    issue(list, command);
+}
+
+void StateFilter::filterViewport(const CommandList& list, const Command& command) {
+    const void* values = list.getPayload(command.first);
+    if (viewportKnown && memcmp(viewport, values, sizeof(viewport)) == 0) {
+        stats.skipped++;
+        return;
+    }
+
+    memcpy(viewport, values, sizeof(viewport));
+    viewportKnown = true;
+    issue(list, command);
+}
+
+void StateFilter::execute(const CommandList& list, const Command& command) {
+    StageState& stage = stages[command.stage < SHADER_STAGE_COUNT ? command.stage : 0];
+    switch (command.type) {
+    case COMMAND_SET_SHADER: filterValue(list, command, stage.shader, 0); break;
+    case COMMAND_SET_CONSTANT_BUFFERS: filterHandles(list, command, stage.constantBuffers, FILTER_CONSTANT_BUFFER_SLOTS); break;
+    case COMMAND_SET_CONSTANT_BLOCKS: filterConstantBlocks(list, command); break;
+    case COMMAND_SET_SHADER_RESOURCES: filterHandles(list, command, stage.shaderResources, FILTER_SHADER_RESOURCE_SLOTS); break;
+    case COMMAND_SET_SAMPLERS: filterHandles(list, command, stage.samplers, FILTER_SAMPLER_SLOTS); break;
+    case COMMAND_SET_UNORDERED_ACCESS_VIEWS: filterHandles(list, command, unorderedAccessViews, FILTER_UNORDERED_ACCESS_SLOTS); break;
+    case COMMAND_SET_INPUT_LAYOUT: filterValue(list, command, inputLayout, 0); break;
+    case COMMAND_SET_PRIMITIVE_TOPOLOGY: filterValue(list, command, topology, 1); break;
+    case COMMAND_SET_VERTEX_BUFFERS: filterVertexBuffers(list, command); break;
+    case COMMAND_SET_INDEX_BUFFER: filterValue(list, command, indexBuffer, 2); break;
+    case COMMAND_SET_RASTERIZER_STATE: filterValue(list, command, rasterizerState, 0); break;
+    case COMMAND_SET_DEPTH_STENCIL_STATE: filterValue(list, command, depthStencilState, 1); break;
+    case COMMAND_SET_BLEND_STATE: filterValue(list, command, blendState, 1); break;
+    case COMMAND_SET_RENDER_TARGETS: filterRenderTargets(list, command); break;
+    case COMMAND_SET_VIEWPORT: filterViewport(list, command); break;
+    case COMMAND_WRITE_CONSTANTS:
+        forgetConstantBlock(command.args[0]);
+        backend->execute(list, command);
+        break;
+    default: backend->execute(list, command); break;
+    }
+}
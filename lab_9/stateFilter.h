@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "commandList.h"
+
+// Slots tracked per stage; binds past them are always passed on.
+static const uint32_t FILTER_CONSTANT_BUFFER_SLOTS = 14;
+static const uint32_t FILTER_SHADER_RESOURCE_SLOTS = 32;
+static const uint32_t FILTER_SAMPLER_SLOTS = 16;
+static const uint32_t FILTER_UNORDERED_ACCESS_SLOTS = 8;
+static const uint32_t FILTER_VERTEX_BUFFER_SLOTS = 16;
+static const uint32_t FILTER_RENDER_TARGET_SLOTS = 8;
+
+struct StateFilterStats {
+	size_t issued = 0;
+	size_t skipped = 0;
+};
+
+// Sits in front of a backend and drops the binds that would not change what is bound. Array
+// binds are cut down to the slots that change. Everything starts unknown after reset(), so
+// call it whenever the context state is cleared behind the filter's back (ClearState, ImGui).
+// Constant blocks share the constant buffer slots; writing a block again forgets the slots it
+// was bound to, since the new copy lives elsewhere in the upload ring.
+// Unbinds made by the runtime itself (a resource bound for output leaving its input slots)
+// are not seen; callers unbind such resources explicitly.
+class StateFilter : public CommandBackend {
+public:
+	void setBackend(CommandBackend* backend) { this->backend = backend; };
+	void reset();
+	void execute(const CommandList& list, const Command& command) override;
+
+	// Bind commands since the last reset.
+	const StateFilterStats& getStats() const { return stats; };
+
+private:
+	// One bound value: the object and up to two arguments (stride and offset, format and
+	// offset, stencil ref, sample mask, topology).
+	struct ValueState {
+		GpuHandle object;
+		uint32_t args[2];
+	};
+
+	struct StageState {
+		ValueState shader;
+		GpuHandle constantBuffers[FILTER_CONSTANT_BUFFER_SLOTS];
+		GpuHandle shaderResources[FILTER_SHADER_RESOURCE_SLOTS];
+		GpuHandle samplers[FILTER_SAMPLER_SLOTS];
+	};
+
+	void filterHandles(const CommandList& list, const Command& command, GpuHandle* cache, uint32_t cacheSize);
+	void filterConstantBlocks(const CommandList& list, const Command& command);
+	void forgetConstantBlock(uint32_t block);
+	void filterVertexBuffers(const CommandList& list, const Command& command);
+	void filterValue(const CommandList& list, const Command& command, ValueState& cache, size_t argsCount);
+	void filterRenderTargets(const CommandList& list, const Command& command);
+	void filterViewport(const CommandList& list, const Command& command);
+	void issue(const CommandList& list, const Command& command);
+
+	CommandBackend* backend = nullptr;
+	StateFilterStats stats;
+
+	StageState stages[SHADER_STAGE_COUNT];
+	GpuHandle unorderedAccessViews[FILTER_UNORDERED_ACCESS_SLOTS];
+	ValueState vertexBuffers[FILTER_VERTEX_BUFFER_SLOTS];
+	ValueState inputLayout;
+	ValueState topology;
+	ValueState indexBuffer;
+	ValueState rasterizerState;
+	ValueState depthStencilState;
+	ValueState blendState;
+	GpuHandle renderTargets[FILTER_RENDER_TARGET_SLOTS + 1]; // the depth view last
+	uint32_t renderTargetsCount;
+	float viewport[6];
+	bool viewportKnown;
+};
@@ -1,69 +1,58 @@
-#pragma once
-
-#include <directxmath.h>
-
-#include "Consts.h"
-
-using namespace DirectX;
-
-struct WorldMatrixBuffer {
-	XMMATRIX worldMatrix;
-	XMFLOAT4 color;
-};
-
-struct SceneMatrixBuffer {
-	XMMATRIX viewProjectionMatrix;
-};
-
-struct CubeSceneMatrixBuffer {
-	XMMATRIX viewProjectionMatrix;
-	XMFLOAT4 planes[6];
-};
-
-struct CullingParams {
-	XMINT4 numShapes; // x - objects count;
-	XMFLOAT4 bbMin[MAX_CUBES];
-	XMFLOAT4 bbMax[MAX_CUBES];
-};
-
-struct GeomBuffer {
-	XMMATRIX worldMatrix;
-	XMMATRIX norm;
-	XMFLOAT4 params;
-};
-
-struct CubeModel {
-	XMFLOAT4 pos;
-	XMFLOAT4 params;
-};
-
-struct TexVertex
-{
-	XMFLOAT3 pos;
-	XMFLOAT2 uv;
-	XMFLOAT3 normal;
-	XMFLOAT3 tangent;
-};
-
-struct LightableCB {
-	XMFLOAT4 cameraPos;
-	XMINT4 lightCount;
-	XMFLOAT4 lightPos[MAX_LIGHTS];
-	XMFLOAT4 lightColor[MAX_LIGHTS];
-	XMFLOAT4 ambientColor;
-};
-
-struct SimpleVertex
-{
-	float x, y, z;
-};
-
-struct SBWorldMatrixBuffer {
-	XMMATRIX worldMatrix;
-	XMFLOAT4 size;
-};
-
-struct SBSceneMatrixBuffer {
-	XMMATRIX viewProjectionMatrix;
-	XMFLOAT4 cameraPos;
-};
+#pragma once
+
+#include <directxmath.h>
+
+#include "Consts.h"
+
+using namespace DirectX;
+
+struct WorldMatrixBuffer {
+	XMMATRIX worldMatrix;
+	XMFLOAT4 color;
+};
+
+// Per-view constants of the frame, built once and bound to every pass (SceneCB.hlsli).
+struct SceneCB {
+	XMMATRIX viewProjectionMatrix;
+	XMFLOAT4 cameraPos;
+	XMINT4 clusterGrid;     // tiles across, tiles down, depth slices, LIGHTING_* mode of the cubes
+	XMFLOAT4 clusterScale;  // pixel to tile x, y; log view depth to slice scale, bias
+	XMFLOAT4 ambientColor;  // tint of the point and baked light on the cubes, the sky comes from irradianceSH
+	XMFLOAT4 irradianceSH[7];  // EnvironmentLighting::getIrradiance()
+	XMFLOAT4 environmentParams; // last prefiltered mip of the sky, sky light scale
+};
+
+// A point light as the pixel shaders read it, w of the position is the influence radius.
+struct ClusterLight {
+	XMFLOAT4 positionRange;
+	XMFLOAT4 color;
+};
+
+struct CullingParams {
+	XMINT4 numShapes; // x - objects count;
+	XMFLOAT4 planes[6];
+};
+
+struct TexVertex
+{
+	XMFLOAT3 pos;
+	XMFLOAT2 uv;
+	XMFLOAT3 normal;
+	XMFLOAT3 tangent;
+};
+
+// VertexQuantization of the mesh, for the shaders that read PackedVertex.
+struct MeshQuantizationCB {
+	XMFLOAT4 positionScale;
+	XMFLOAT4 positionOffset;
+};
+
+struct SimpleVertex
+{
+	float x, y, z;
+};
+
+struct SBWorldMatrixBuffer {
+	XMMATRIX worldMatrix;
+	XMFLOAT4 size;
+};
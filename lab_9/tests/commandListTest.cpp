@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "commandList.h"
+#include "testing.h"
+
+// What one cube-like object binds and draws
+struct Object {
+    GpuHandle vertexShader;
+    GpuHandle pixelShader;
+    GpuHandle constantBuffers[2];
+    GpuHandle views[2];
+    GpuHandle vertexBuffer;
+    GpuHandle indexBuffer;
+};
+
+static void record(CommandList& list, const Object& object, const float* matrix) {
+    float* constants = static_cast<float*>(list.writeBuffer(object.constantBuffers[0], 32 * sizeof(float)));
+    memcpy(constants, matrix, 32 * sizeof(float));
+    uint32_t stride = 20, offset = 0;
+    list.setVertexBuffers(0, 1, &object.vertexBuffer, &stride, &offset);
+    list.setIndexBuffer(object.indexBuffer, 57, 0);
+    list.setShader(SHADER_STAGE_VERTEX, object.vertexShader);
+    list.setShader(SHADER_STAGE_PIXEL, object.pixelShader);
+    list.setConstantBuffers(SHADER_STAGE_VERTEX, 0, 2, object.constantBuffers);
+    list.setShaderResources(SHADER_STAGE_PIXEL, 0, 2, object.views);
+    list.drawIndexed(36, 0, 0);
+}
+
+// Checks every replayed command against the objects it was recorded from
+class CheckingBackend : public CommandBackend {
+public:
+    explicit CheckingBackend(const std::vector<Object>& objects) : objects(objects) {};
+
+    void execute(const CommandList& list, const Command& command) override {
+        const Object& object = objects[index];
+        switch (command.type) {
+        case COMMAND_WRITE_BUFFER: {
+            CHECK(command.object == object.constantBuffers[0] && command.count == 32 * sizeof(float));
+            const float* constants = static_cast<const float*>(list.getPayload(command.first));
+            CHECK(constants[0] == float(index) && constants[31] == -float(index));
+            break;
+        }
+        case COMMAND_SET_CONSTANT_BUFFERS:
+            CHECK(command.count == 2 && list.getHandles(command)[0] == object.constantBuffers[0] &&
+                list.getHandles(command)[1] == object.constantBuffers[1]);
+            break;
+        case COMMAND_SET_SHADER_RESOURCES:
+            CHECK(command.stage == SHADER_STAGE_PIXEL && list.getHandles(command)[1] == object.views[1]);
+            break;
+        case COMMAND_SET_SHADER:
+            CHECK(command.object == (command.stage == SHADER_STAGE_VERTEX ? object.vertexShader : object.pixelShader));
+            break;
+        case COMMAND_DRAW_INDEXED:
+            CHECK(command.args[0] == 36);
+            index++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    size_t index = 0;
+
+private:
+    const std::vector<Object>& objects;
+};
+
+int main(int argc, char** argv) {
+    const size_t count = isFullRun(argc, argv) ? 1000000 : 100000;
+    std::vector<Object> objects(count);
+    for (size_t i = 0; i < count; i++) {
+        char* base = reinterpret_cast<char*>((i + 1) * 64);
+        objects[i] = { base, base + 1, { base + 2, base + 3 }, { base + 4, base + 5 }, base + 6, base + 7 };
+    }
+
+    // The second half is recorded into a nested list, replayed inline
+    CommandList list, nested;
+    float matrix[32] = {};
+    double recordMilliseconds = 1e9, replayMilliseconds = 1e9;
+    for (int run = 0; run < 3; run++) {
+        Stopwatch stopwatch;
+        list.clear();
+        nested.clear();
+        for (size_t i = 0; i < count; i++) {
+            matrix[0] = float(i);
+            matrix[31] = -float(i);
+            record(i < count / 2 ? list : nested, objects[i], matrix);
+        }
+        list.executeList(nested);
+        recordMilliseconds = (std::min)(recordMilliseconds, stopwatch.getMilliseconds());
+
+        CheckingBackend checker(objects);
+        list.replay(checker);
+        CHECK(checker.index == count);
+
+        CountingBackend counter;
+        stopwatch.restart();
+        list.replay(counter);
+        replayMilliseconds = (std::min)(replayMilliseconds, stopwatch.getMilliseconds());
+        const CommandStats& stats = counter.getStats();
+        CHECK(stats.getTotal() == count * 8 && stats.getDraws() == count && stats.getBinds() == count * 6);
+        CHECK(stats.uploadBytes == count * 32 * sizeof(float));
+        CHECK(stats.commands[COMMAND_EXECUTE_LIST] == 0);
+    }
+
+    std::printf("%zu objects, 8 commands each: record %.2f ms, replay %.2f ms, payload %zu KB\n",
+        count, recordMilliseconds, replayMilliseconds, (list.getPayloadSize() + nested.getPayloadSize()) / 1024);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "cubeAnimator.h"
+#include "testing.h"
+
+// The chain Cube::frame used to multiply, in double precision
+struct Matrix {
+    double m[4][4];
+};
+
+static Matrix identity() {
+    Matrix r = {};
+    for (int i = 0; i < 4; i++)
+        r.m[i][i] = 1.0;
+    return r;
+}
+
+static Matrix multiply(const Matrix& a, const Matrix& b) {
+    Matrix r = {};
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            for (int k = 0; k < 4; k++)
+                r.m[i][j] += a.m[i][k] * b.m[k][j];
+    return r;
+}
+
+static Matrix translation(double x, double y, double z) {
+    Matrix r = identity();
+    r.m[3][0] = x;
+    r.m[3][1] = y;
+    r.m[3][2] = z;
+    return r;
+}
+
+static Matrix rotation(int axis, double angle) {
+    Matrix r = identity();
+    int a = (axis + 1) % 3, b = (axis + 2) % 3;
+    r.m[a][a] = cos(angle);
+    r.m[a][b] = sin(angle);
+    r.m[b][a] = -sin(angle);
+    r.m[b][b] = cos(angle);
+    return r;
+}
+
+// CubeModel: pos, then params
+struct Model {
+    float pos[4];
+    float params[4];
+};
+
+// Same stride as the GeomBuffer the animator writes into
+struct Instance {
+    float world[16];
+    float params[4];
+};
+
+static Matrix referenceChain(const Model& model, double t, float angleVelocity) {
+    float time = float(t);
+    double speed = model.params[1];
+    Matrix r = multiply(rotation(0, time * model.params[0] * 0.01f), translation(sin(t) * 0.5, cos(t) * 0.5, sin(t) * 0.5));
+    r = multiply(r, rotation(1, time * model.params[1] * 1.5f));
+    r = multiply(r, rotation(2, sin(t * speed * 0.3) * 0.25));
+    r = multiply(r, translation(sin(t * angleVelocity * speed), sin(t * speed * 0.3) * 0.25, cos(t) * 3.0));
+    return multiply(r, translation(model.pos[0], model.pos[1], model.pos[2]));
+}
+
+int main(int argc, char** argv) {
+    const size_t count = isFullRun(argc, argv) ? 100000 : 20000;
+    const float angleVelocity = 1.5707963f;
+    Random random(1);
+    std::vector<Model> models(count);
+    for (Model& model : models) {
+        for (int k = 0; k < 3; k++)
+            model.pos[k] = float(int(random.below(100)) - 50);
+        model.pos[3] = 1.0f;
+        model.params[0] = float(random.below(100));
+        model.params[1] = float(int(random.below(10)) - 5);
+    }
+    std::vector<Instance> out(count);
+
+    // Batched and scalar paths against the chain; an odd count covers the scalar tail
+    const size_t checked = 1003;
+    double maxError = 0.0;
+    for (double t : { 0.0, 0.37, 12.5, 300.0, 3000.0 }) {
+        CubeAnimator animator;
+        animator.setTime(t, angleVelocity);
+        animator.animate(models[0].pos, sizeof(Model), checked, out[0].world, sizeof(Instance));
+        // float time loses digits as it grows, the chain is evaluated from the same float
+        double tolerance = t > 100.0 ? 1e-2 : 1e-4;
+        for (size_t i = 0; i < checked; i++) {
+            Matrix reference = referenceChain(models[i], t, angleVelocity);
+            float one[16];
+            animator.animateOne(models[i].pos, models[i].params[0], models[i].params[1], one);
+            for (int k = 0; k < 16; k++) {
+                double error = fabs(out[i].world[k] - reference.m[k / 4][k % 4]);
+                CHECK(error <= tolerance);
+                CHECK(fabs(one[k] - out[i].world[k]) <= (t > 100.0 ? 1e-2 : 1e-5));
+                if (t < 100.0)
+                    maxError = (std::max)(maxError, error);
+            }
+        }
+    }
+
+    const int frames = 20;
+    Stopwatch stopwatch;
+    for (int frame = 0; frame < frames; frame++) {
+        CubeAnimator animator;
+        animator.setTime(1.0 + frame * 0.016, angleVelocity);
+        animator.animate(models[0].pos, sizeof(Model), count, out[0].world, sizeof(Instance));
+    }
+    double batched = count * frames / stopwatch.getMilliseconds() * 1e-3;
+
+    stopwatch.restart();
+    for (int frame = 0; frame < frames; frame++) {
+        double t = 1.0 + frame * 0.016;
+        for (size_t i = 0; i < count; i++) {
+            Matrix reference = referenceChain(models[i], t, angleVelocity);
+            for (int k = 0; k < 16; k++)
+                out[i].world[k] = float(reference.m[k / 4][k % 4]);
+        }
+    }
+    double chain = count * frames / stopwatch.getMilliseconds() * 1e-3;
+
+    std::printf("max error for t < 100: %g; %zu instances: batched %.1f M matrices/s, double chain %.1f M matrices/s\n",
+        maxError, count, batched, chain);
+    return 0;
+}
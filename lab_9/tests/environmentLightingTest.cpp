@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "environmentLighting.h"
+#include "testing.h"
+
+// The D3D face layout the header describes, s and t in [-1, 1] from the top left
+static void getDirection(uint32_t face, float s, float t, float dir[3]) {
+    switch (face) {
+    case 0: dir[0] = 1.0f; dir[1] = -t; dir[2] = -s; break;
+    case 1: dir[0] = -1.0f; dir[1] = -t; dir[2] = s; break;
+    case 2: dir[0] = s; dir[1] = 1.0f; dir[2] = t; break;
+    case 3: dir[0] = s; dir[1] = -1.0f; dir[2] = -t; break;
+    case 4: dir[0] = s; dir[1] = -t; dir[2] = 1.0f; break;
+    default: dir[0] = -s; dir[1] = -t; dir[2] = -1.0f; break;
+    }
+    float length = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+    for (int c = 0; c < 3; c++)
+        dir[c] /= length;
+}
+
+// Red 1 + y / 2 and green 0.3 are linear, so SH9 holds them exactly; blue is max(z, 0)
+static void getSky(const float dir[3], float color[3]) {
+    color[0] = 1.0f + 0.5f * dir[1];
+    color[1] = 0.3f;
+    color[2] = (std::max)(dir[2], 0.0f);
+}
+
+static void write32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+    memcpy(&data[offset], &value, sizeof(value));
+}
+
+// A DDS with the DX10 header: one cube of `faceBytes` per face, the texels left to the caller
+static std::vector<uint8_t> makeDds(uint32_t size, uint32_t dxgiFormat, size_t faceBytes) {
+    std::vector<uint8_t> data(4 + 124 + 20 + faceBytes * 6, 0);
+    write32(data, 0, 0x20534444);
+    write32(data, 4, 124);
+    write32(data, 4 + 8, size);
+    write32(data, 4 + 12, size);
+    write32(data, 4 + 24, 1);
+    write32(data, 4 + 72, 32);
+    write32(data, 4 + 76, 0x4);
+    write32(data, 4 + 80, 0x30315844); // "DX10"
+    write32(data, 128, dxgiFormat);
+    write32(data, 132, 3);
+    write32(data, 136, 0x4); // a cube
+    write32(data, 140, 1);
+    return data;
+}
+
+static std::vector<uint8_t> makeSkyDds(uint32_t size) {
+    std::vector<uint8_t> data = makeDds(size, 2, size_t(size) * size * 16);
+    float* texels = reinterpret_cast<float*>(&data[148]);
+    for (uint32_t face = 0; face < 6; face++) {
+        for (uint32_t y = 0; y < size; y++) {
+            for (uint32_t x = 0; x < size; x++) {
+                float dir[3];
+                getDirection(face, (2.0f * x + 1.0f) / size - 1.0f, (2.0f * y + 1.0f) / size - 1.0f, dir);
+                float* texel = texels + ((size_t(face) * size + y) * size + x) * 4;
+                getSky(dir, texel);
+                texel[3] = 1.0f;
+            }
+        }
+    }
+    return data;
+}
+
+// The polynomial the shaders evaluate
+static void evaluate(const float* irradiance, const float n[3], float color[3]) {
+    const float n1[4] = { n[0], n[1], n[2], 1.0f }, n2[4] = { n[0] * n[1], n[1] * n[2], n[2] * n[2], n[2] * n[0] };
+    for (int c = 0; c < 3; c++) {
+        color[c] = irradiance[24 + c] * (n[0] * n[0] - n[1] * n[1]);
+        for (int i = 0; i < 4; i++)
+            color[c] += irradiance[c * 4 + i] * n1[i] + irradiance[(3 + c) * 4 + i] * n2[i];
+    }
+}
+
+static bool writeFile(const char* path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+}
+
+int main(int argc, char** argv) {
+    EnvironmentSettings settings;
+    settings.specularSize = 32;
+    const char* path = "environmentLightingTest.dds";
+    CHECK(writeFile(path, makeSkyDds(64)));
+    remove("environmentLightingTest.dds.ibl");
+
+    EnvironmentLighting environment;
+    CHECK(environment.load(path, settings) && !environment.getStats().cached);
+    CHECK(environment.getSpecularSize() == 32 && environment.getSpecularLevels() == 6);
+
+    // The linear channels come out exact: the cosine lobe scales the linear band by 2/3
+    Random random(21);
+    float error = 0.0f;
+    for (int i = 0; i < 200; i++) {
+        float n[3], color[3];
+        getDirection(random.below(6), random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f), n);
+        evaluate(environment.getIrradiance(), n, color);
+        error = (std::max)(error, fabsf(color[0] - (1.0f + n[1] / 3.0f)));
+        error = (std::max)(error, fabsf(color[1] - 0.3f));
+    }
+    CHECK(error < 1e-3f);
+    // The clamped cosine through SH9: 1/4 + z/3 + 5/128 (3z^2 - 1)
+    float up[3] = { 0.0f, 0.0f, 1.0f }, down[3] = { 0.0f, 0.0f, -1.0f }, color[3];
+    evaluate(environment.getIrradiance(), up, color);
+    CHECK(fabsf(color[2] - (0.25f + 1.0f / 3.0f + 10.0f / 128.0f)) < 2e-3f);
+    evaluate(environment.getIrradiance(), down, color);
+    CHECK(fabsf(color[2] - (0.25f - 1.0f / 3.0f + 10.0f / 128.0f)) < 2e-3f);
+
+    // The average over the sphere
+    float average[3];
+    environment.getAverage(average);
+    CHECK(fabsf(average[0] - 1.0f) < 1e-3f && fabsf(average[1] - 0.3f) < 1e-3f && fabsf(average[2] - 0.25f) < 1e-3f);
+
+    // A lobe around the texel direction d turns the red gradient into 1 + k d.y / 2: k is 1 for
+    // mip 0, the sky itself, and falls as the mips get rougher. The constant green stays.
+    float previous = 1.01f;
+    for (uint32_t level = 0; level < environment.getSpecularLevels(); level++) {
+        uint32_t size = environment.getSpecularSize() >> level;
+        uint32_t x = size / 2, y = size / 2;
+        float dir[3];
+        getDirection(2, (2.0f * x + 1.0f) / size - 1.0f, (2.0f * y + 1.0f) / size - 1.0f, dir);
+        const float* texel = environment.getSpecular(2, level) + (size_t(y) * size + x) * 4;
+        float k = (texel[0] - 1.0f) / (0.5f * dir[1]);
+        CHECK(k < previous && k > 0.0f);
+        CHECK(level > 0 || k > 0.999f);
+        CHECK(fabsf(texel[1] - 0.3f) < 1e-3f);
+        previous = k;
+    }
+
+    // Read back from the cache, the same to the bit; other settings compute it again
+    EnvironmentLighting cached;
+    CHECK(cached.load(path, settings) && cached.getStats().cached);
+    CHECK(cached.getStats().hash == environment.getStats().hash);
+    CHECK(memcmp(cached.getIrradiance(), environment.getIrradiance(), 28 * sizeof(float)) == 0);
+    for (uint32_t face = 0; face < 6; face++) {
+        for (uint32_t level = 0; level < environment.getSpecularLevels(); level++) {
+            uint32_t size = environment.getSpecularSize() >> level;
+            CHECK(memcmp(cached.getSpecular(face, level), environment.getSpecular(face, level), size_t(size) * size * 16) == 0);
+        }
+    }
+    settings.samples = 64;
+    EnvironmentLighting changed;
+    CHECK(changed.load(path, settings) && !changed.getStats().cached);
+    settings.samples = 256;
+    remove(path);
+    remove("environmentLightingTest.dds.ibl");
+
+    // BC1: red and blue end points, every texel at index 2, two thirds red and one third blue
+    std::vector<uint8_t> bc1 = makeDds(4, 71, 8);
+    for (uint32_t face = 0; face < 6; face++) {
+        const uint8_t block[8] = { 0x00, 0xF8, 0x1F, 0x00, 0xAA, 0xAA, 0xAA, 0xAA };
+        memcpy(&bc1[148 + face * 8], block, 8);
+    }
+    CubeImage image;
+    CHECK(decodeCubeDds(bc1.data(), bc1.size(), image) && image.size == 4);
+    for (size_t i = 0; i < image.texels.size(); i += 4)
+        CHECK(fabsf(image.texels[i] - 2.0f / 3.0f) < 1e-2f && image.texels[i + 1] == 0.0f && fabsf(image.texels[i + 2] - 1.0f / 3.0f) < 1e-2f);
+    // Not a cube
+    write32(bc1, 136, 0);
+    CHECK(!decodeCubeDds(bc1.data(), bc1.size(), image));
+
+    // A constant sky lights evenly with its color, which is also the average
+    const float constant[3] = { 0.9f, 0.9f, 0.4f };
+    EnvironmentLighting flat;
+    flat.setConstant(constant);
+    flat.getAverage(average);
+    for (int i = 0; i < 20; i++) {
+        float n[3];
+        getDirection(random.below(6), random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f), n);
+        evaluate(flat.getIrradiance(), n, color);
+        for (int c = 0; c < 3; c++)
+            CHECK(fabsf(color[c] - constant[c]) < 1e-5f && fabsf(average[c] - constant[c]) < 1e-5f);
+    }
+
+    const uint32_t size = isFullRun(argc, argv) ? 512 : 128;
+    std::vector<uint8_t> sky = makeSkyDds(size);
+    CHECK(decodeCubeDds(sky.data(), sky.size(), image));
+    Stopwatch stopwatch;
+    EnvironmentLighting big;
+    big.compute(image, EnvironmentSettings());
+    std::printf("irradiance error %.2e; %u^2 sky: SH9 and %u prefiltered mips of %u^2 in %.1f ms\n", error, size,
+        big.getSpecularLevels(), big.getSpecularSize(), stopwatch.getMilliseconds());
+    return 0;
+}
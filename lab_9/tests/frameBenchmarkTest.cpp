@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "cubeFrame.h"
+#include "testing.h"
+
+static void multiply(const float* a, const float* b, float* out) {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            out[i * 4 + j] = 0.0f;
+            for (int k = 0; k < 4; k++)
+                out[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
+        }
+    }
+}
+
+// Left-handed look-at and the reversed-depth projection of the renderer
+// (XMMatrixPerspectiveFovLH(pi / 4, 16 / 9, 100, 0.01)), row vectors
+static void viewProjection(const float eye[3], const float at[3], float out[16]) {
+    float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+    float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (float& v : z)
+        v /= length;
+    float x[3] = { z[2], 0.0f, -z[0] };
+    length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+    x[0] /= length;
+    x[2] /= length;
+    float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    const float view[16] = {
+        x[0], y[0], z[0], 0.0f, x[1], y[1], z[1], 0.0f, x[2], y[2], z[2], 0.0f,
+        -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]), -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+        -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f,
+    };
+    float nearZ = 100.0f, farZ = 0.01f, h = 1.0f / tanf(3.14159265f / 8.0f), w = h / (16.0f / 9.0f), r = farZ / (farZ - nearZ);
+    const float projection[16] = { w, 0, 0, 0, 0, h, 0, 0, 0, 0, r, 1, 0, 0, -r * nearZ, 0 };
+    multiply(view, projection, out);
+}
+
+// The CPU half of Cube::frame recorded into a CountingBackend: the cubes are animated, bounded,
+// kept in the grid, culled, sorted and their uploads recorded, as the app does every frame.
+int main(int argc, char** argv) {
+    const bool full = isFullRun(argc, argv);
+    const size_t count = full ? 1000000 : 100000;
+    const size_t staticCount = count / 8;
+    const int frames = full ? 60 : 20;
+    const float size = 2.0f * cbrtf(float(count));
+    Random random(7);
+
+    SpatialGrid grid;
+    CubeFrame cubes;
+    cubes.setSpatialGrid(&grid);
+    cubes.reserve(count + staticCount);
+    for (size_t i = 0; i < count + staticCount; i++) {
+        float pos[3] = { random.range(-0.5f, 0.5f) * size, random.range(-0.5f, 0.5f) * size, random.range(-0.5f, 0.5f) * size };
+        float texture = float(random.below(2));
+        float params[4] = { 32.0f, float(int(random.below(10)) - 5), texture, texture > 0.0f ? 0.0f : 1.0f };
+        cubes.add(pos, params, i >= count);
+    }
+    for (size_t i = 0; i < count; i += 101)
+        cubes.remove(uint32_t(i));
+
+    // Fake handles, the CountingBackend never looks behind them
+    GpuHandle instances = reinterpret_cast<GpuHandle>(1);
+    GpuHandle bounds = reinterpret_cast<GpuHandle>(2);
+    GpuHandle visibleIds = reinterpret_cast<GpuHandle>(3);
+    GpuHandle argsSource = reinterpret_cast<GpuHandle>(4);
+    GpuHandle args = reinterpret_cast<GpuHandle>(5);
+    const uint32_t indexCount = 36;
+
+    FrustumCuller flat;
+    CommandList commands;
+    CountingBackend counter;
+    std::vector<int> flatVisible, expected, sorted, frustumVisible;
+    std::vector<uint8_t> isVisible;
+    double updateMilliseconds = 0.0, cullMilliseconds = 0.0, occlusionMilliseconds = 0.0, recordMilliseconds = 0.0, replayMilliseconds = 0.0;
+    size_t visibleCount = 0, occludedCount = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        float angle = frame * 0.02f;
+        float eye[3] = { 0.8f * size * sinf(angle), 0.2f * size, -0.8f * size * cosf(angle) };
+        float at[3] = { 0.0f, 0.0f, 0.0f };
+        float vp[16], planes[6][4];
+        viewProjection(eye, at, vp);
+        extractFrustumPlanes(vp, planes);
+
+        Stopwatch stopwatch;
+        cubes.update(frame / 60.0, 1.5707963f);
+        double updateFrame = stopwatch.getMilliseconds();
+        stopwatch.restart();
+        cubes.cull(planes, nullptr, eye);
+        double cullFrame = stopwatch.getMilliseconds();
+        frustumVisible = cubes.getVisible();
+
+        // Moving cubes against the flat culler over every slot, static ones against the scalar
+        // test, which the BVH matches; free slots never show up.
+        const InstanceBounds& cubeBounds = cubes.getBounds();
+        flat.cull(cubeBounds, planes, flatVisible);
+        isVisible.assign(cubes.size(), 0);
+        for (int id : flatVisible)
+            isVisible[id] = 1;
+        expected.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (isVisible[i])
+                expected.push_back(int(i));
+        }
+        for (uint32_t slot : cubes.getStaticSlots()) {
+            if (FrustumCuller::isVisible(cubeBounds, planes, slot))
+                expected.push_back(int(slot));
+        }
+        std::sort(expected.begin(), expected.end());
+        sorted = frustumVisible;
+        std::sort(sorted.begin(), sorted.end());
+        CHECK(sorted == expected);
+        for (size_t i = 0; i < count; i += 101)
+            CHECK(!isVisible[i]);
+
+        // Front to back, to the 16 bits of depth the sort keeps up to the far plane
+        for (size_t i = 1; i < frustumVisible.size(); i++) {
+            float previous[3], current[3];
+            cubeBounds.getCenter(frustumVisible[i - 1], previous);
+            cubeBounds.getCenter(frustumVisible[i], current);
+            float dp = sqrtf((previous[0] - eye[0]) * (previous[0] - eye[0]) + (previous[1] - eye[1]) * (previous[1] - eye[1]) + (previous[2] - eye[2]) * (previous[2] - eye[2]));
+            float dc = sqrtf((current[0] - eye[0]) * (current[0] - eye[0]) + (current[1] - eye[1]) * (current[1] - eye[1]) + (current[2] - eye[2]) * (current[2] - eye[2]));
+            CHECK((std::min)(dp, 100.0f) <= (std::min)(dc, 100.0f) + 100.0f / 65535.0f * 2.0f);
+        }
+
+        // Occlusion only ever removes cubes
+        stopwatch.restart();
+        cubes.cull(planes, vp, eye);
+        double occlusionFrame = stopwatch.getMilliseconds();
+        sorted = cubes.getVisible();
+        std::sort(sorted.begin(), sorted.end());
+        CHECK(std::includes(expected.begin(), expected.end(), sorted.begin(), sorted.end()));
+
+        stopwatch.restart();
+        commands.clear();
+        cubes.recordUploads(commands, instances, bounds);
+        cubes.recordVisible(commands, visibleIds, argsSource, args, indexCount);
+        double recordFrame = stopwatch.getMilliseconds();
+        stopwatch.restart();
+        counter.reset();
+        commands.replay(counter);
+        double replayFrame = stopwatch.getMilliseconds();
+
+        // The first frame sends every slot, later ones at least the chunks of the moving cubes
+        const CommandStats& stats = counter.getStats();
+        size_t uploadedSlots = frame == 0 ? cubes.size() : count;
+        CHECK(stats.uploadBytes >= uploadedSlots * (sizeof(PackedInstance) + sizeof(CullingBounds)));
+        CHECK(stats.commands[COMMAND_COPY_RESOURCE] == 1 && stats.commands[COMMAND_EXECUTE_LIST] == 0);
+        if (frame > 0)
+            CHECK(stats.uploadBytes < cubes.size() * (sizeof(PackedInstance) + sizeof(CullingBounds)) + cubes.getVisible().size() * sizeof(uint32_t) + 64);
+
+        const IndexedIndirectArgs* recorded = nullptr;
+        for (const Command& command : commands.getCommands()) {
+            if (command.type == COMMAND_UPDATE_BUFFER && command.object == argsSource)
+                recorded = reinterpret_cast<const IndexedIndirectArgs*>(commands.getPayload(command.first));
+        }
+        CHECK(recorded && recorded->indexCountPerInstance == indexCount && recorded->instanceCount == cubes.getVisible().size());
+
+        if (frame > 0) {
+            updateMilliseconds += updateFrame;
+            cullMilliseconds += cullFrame;
+            occlusionMilliseconds += occlusionFrame;
+            recordMilliseconds += recordFrame;
+            replayMilliseconds += replayFrame;
+            visibleCount += frustumVisible.size();
+            occludedCount += frustumVisible.size() - cubes.getVisible().size();
+        }
+    }
+    CHECK(grid.size() == cubes.count());
+
+    const int timed = frames - 1;
+    std::printf("%zu cubes (%zu static), %zu visible, %zu occluded per frame: update %.2f ms, cull %.2f ms, cull with occlusion %.2f ms, record %.2f ms, replay %.2f ms\n",
+        cubes.count(), staticCount, visibleCount / timed, occludedCount / timed, updateMilliseconds / timed, cullMilliseconds / timed,
+        occlusionMilliseconds / timed, recordMilliseconds / timed, replayMilliseconds / timed);
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <vector>
+
+#include "frustumCuller.h"
+#include "testing.h"
+
+// The scalar test FrustumCuller replaced: a box is culled when all 8 corners are behind a plane.
+static bool isVisibleByCorners(const float planes[6][4], const float bbMin[3], const float bbMax[3]) {
+    for (int p = 0; p < 6; p++) {
+        bool anyInside = false;
+        for (int c = 0; c < 8; c++) {
+            float x = (c & 1) ? bbMax[0] : bbMin[0];
+            float y = (c & 2) ? bbMax[1] : bbMin[1];
+            float z = (c & 4) ? bbMax[2] : bbMin[2];
+            if (planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] >= 0.0f)
+                anyInside = true;
+        }
+        if (!anyInside)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = isFullRun(argc, argv) ? 1000003 : 100003;
+    float planes[6][4] = {
+        { 1.0f, 0.0f, 0.0f, 5.0f }, { -1.0f, 0.0f, 0.0f, 5.0f },
+        { 0.0f, 1.0f, 0.0f, 5.0f }, { 0.0f, -1.0f, 0.0f, 5.0f },
+        { 0.3f, 0.1f, 0.9f, 2.0f }, { 0.0f, 0.0f, -1.0f, 20.0f },
+    };
+    float length = sqrtf(0.3f * 0.3f + 0.1f * 0.1f + 0.9f * 0.9f);
+    for (int k = 0; k < 4; k++)
+        planes[4][k] /= length;
+
+    Random random(7);
+    InstanceBounds bounds;
+    bounds.resize(count);
+    std::vector<char> expected(count);
+    for (size_t i = 0; i < count; i++) {
+        float a[3], b[3];
+        for (int k = 0; k < 3; k++) {
+            a[k] = random.range(-30.0f, 30.0f);
+            b[k] = a[k] + random.range(-1.0f, 1.0f);
+        }
+        bounds.setBox(i, a, b);
+        float bbMin[3], bbMax[3];
+        bounds.getBox(i, bbMin, bbMax);
+        expected[i] = isVisibleByCorners(planes, bbMin, bbMax);
+    }
+    // Free slots are never visible
+    for (size_t i = 0; i < count; i += 97) {
+        bounds.hide(i);
+        expected[i] = 0;
+    }
+
+    FrustumCuller culler;
+    std::vector<int> visible;
+    Stopwatch stopwatch;
+    size_t visibleCount = culler.cull(bounds, planes, visible);
+    double milliseconds = stopwatch.getMilliseconds();
+
+    size_t expectedCount = 0;
+    for (size_t i = 0; i < count; i++)
+        expectedCount += expected[i];
+    CHECK(visibleCount == expectedCount);
+    for (size_t k = 0; k < visibleCount; k++) {
+        CHECK(expected[visible[k]]);
+        CHECK(k == 0 || visible[k] > visible[k - 1]);
+        CHECK(FrustumCuller::isVisible(bounds, planes, visible[k]));
+    }
+
+    stopwatch.restart();
+    size_t scalarCount = 0;
+    for (size_t i = 0; i < count; i++)
+        scalarCount += FrustumCuller::isVisible(bounds, planes, i);
+    double scalarMilliseconds = stopwatch.getMilliseconds();
+    CHECK(scalarCount == expectedCount);
+
+    // The planes of a left-handed perspective projection (90 degrees, near 0.1, far 100)
+    const float n = 0.1f, f = 100.0f, q = f / (f - n);
+    const float projection[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, q, 1.0f,
+        0.0f, 0.0f, -n * q, 0.0f,
+    };
+    float viewPlanes[6][4];
+    extractFrustumPlanes(projection, viewPlanes);
+    for (int p = 0; p < 6; p++)
+        CHECK(fabsf(viewPlanes[p][0] * viewPlanes[p][0] + viewPlanes[p][1] * viewPlanes[p][1] + viewPlanes[p][2] * viewPlanes[p][2] - 1.0f) < 1e-5f);
+    CHECK(FrustumCuller::isBoxVisible(viewPlanes, 0.0f, 0.0f, 5.0f, 0.1f, 0.1f, 0.1f));
+    CHECK(FrustumCuller::isBoxVisible(viewPlanes, 4.5f, -4.5f, 5.0f, 0.1f, 0.1f, 0.1f));
+    CHECK(!FrustumCuller::isBoxVisible(viewPlanes, 5.5f, 0.0f, 5.0f, 0.1f, 0.1f, 0.1f));
+    CHECK(!FrustumCuller::isBoxVisible(viewPlanes, 0.0f, -5.5f, 5.0f, 0.1f, 0.1f, 0.1f));
+    CHECK(!FrustumCuller::isBoxVisible(viewPlanes, 0.0f, 0.0f, -5.0f, 0.1f, 0.1f, 0.1f));
+    CHECK(!FrustumCuller::isBoxVisible(viewPlanes, 0.0f, 0.0f, 105.0f, 0.1f, 0.1f, 0.1f));
+
+    std::printf("%zu boxes, %zu visible: cull %.2f ms (%.2f ns/box), scalar isVisible %.2f ms\n",
+        count, visibleCount, milliseconds, milliseconds * 1e6 / count, scalarMilliseconds);
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "frustumCuller.h"
+#include "instanceBounds.h"
+#include "testing.h"
+
+static void multiply(const float* a, const float* b, float* out) {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            out[i * 4 + j] = 0.0f;
+            for (int k = 0; k < 4; k++)
+                out[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
+        }
+    }
+}
+
+// Exact test of the rotated unit cube against the planes: its projected half size along
+// each plane normal is the sum of the projected half axes.
+static bool isCubeVisible(const float planes[6][4], const float* m) {
+    for (int p = 0; p < 6; p++) {
+        float distance = planes[p][0] * m[12] + planes[p][1] * m[13] + planes[p][2] * m[14] + planes[p][3];
+        float reach = 0.0f;
+        for (int a = 0; a < 3; a++)
+            reach += fabsf(planes[p][0] * m[a * 4] + planes[p][1] * m[a * 4 + 1] + planes[p][2] * m[a * 4 + 2]) * 0.5f;
+        if (distance + reach < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = isFullRun(argc, argv) ? 200000 : 50000;
+    float planes[6][4] = {
+        { 1.0f, 0.0f, 0.0f, 5.0f }, { -1.0f, 0.0f, 0.0f, 5.0f },
+        { 0.0f, 1.0f, 0.0f, 5.0f }, { 0.0f, -1.0f, 0.0f, 5.0f },
+        { 0.3f, 0.2f, 0.9f, 1.0f }, { 0.0f, 0.0f, -1.0f, 5.0f },
+    };
+    float length = sqrtf(0.3f * 0.3f + 0.2f * 0.2f + 0.9f * 0.9f);
+    for (int k = 0; k < 4; k++)
+        planes[4][k] /= length;
+
+    // Rotated, uniformly scaled and moved unit cubes, row-vector matrices as in GeomBuffer
+    Random random(3);
+    std::vector<float> matrices(count * 16);
+    for (size_t i = 0; i < count; i++) {
+        float a = random.range(0.0f, 6.2832f), b = random.range(0.0f, 6.2832f);
+        float scale = random.range(0.5f, 2.5f);
+        const float rx[16] = { 1, 0, 0, 0, 0, cosf(a), sinf(a), 0, 0, -sinf(a), cosf(a), 0, 0, 0, 0, 1 };
+        const float ry[16] = { cosf(b), 0, -sinf(b), 0, 0, 1, 0, 0, sinf(b), 0, cosf(b), 0, 0, 0, 0, 1 };
+        float* m = &matrices[i * 16];
+        multiply(rx, ry, m);
+        for (int k = 0; k < 12; k++)
+            m[k] *= scale;
+        m[12] = random.range(-12.0f, 12.0f);
+        m[13] = random.range(-12.0f, 12.0f);
+        m[14] = random.range(-12.0f, 12.0f);
+    }
+
+    const float localMin[3] = { -0.5f, -0.5f, -0.5f };
+    const float localMax[3] = { 0.5f, 0.5f, 0.5f };
+    InstanceBounds bounds;
+    Stopwatch stopwatch;
+    bounds.transform(matrices.data(), 16 * sizeof(float), count, localMin, localMax);
+    double milliseconds = stopwatch.getMilliseconds();
+
+    // The boxes are the exact bounds of the 8 transformed corners, the spheres hold them all
+    InstanceBounds twoCorner;
+    twoCorner.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const float* m = &matrices[i * 16];
+        float bbMin[3] = { INFINITY, INFINITY, INFINITY }, bbMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+        float center[3] = { bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] };
+        for (int c = 0; c < 8; c++) {
+            float v[3] = { (c & 1) ? 0.5f : -0.5f, (c & 2) ? 0.5f : -0.5f, (c & 4) ? 0.5f : -0.5f };
+            float distance = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                float w = v[0] * m[k] + v[1] * m[4 + k] + v[2] * m[8 + k] + m[12 + k];
+                bbMin[k] = fminf(bbMin[k], w);
+                bbMax[k] = fmaxf(bbMax[k], w);
+                distance += (w - center[k]) * (w - center[k]);
+            }
+            CHECK(sqrtf(distance) <= bounds.radius[i] * 1.0001f + 1e-5f);
+        }
+        float got[2][3];
+        bounds.getBox(i, got[0], got[1]);
+        for (int k = 0; k < 3; k++) {
+            CHECK(fabsf(got[0][k] - bbMin[k]) < 1e-4f);
+            CHECK(fabsf(got[1][k] - bbMax[k]) < 1e-4f);
+        }
+
+        // What Cube::frame used to do: transform only the two extreme local corners
+        float a[3], b[3];
+        for (int k = 0; k < 3; k++) {
+            a[k] = -0.5f * (m[k] + m[4 + k] + m[8 + k]) + m[12 + k];
+            b[k] = 0.5f * (m[k] + m[4 + k] + m[8 + k]) + m[12 + k];
+        }
+        twoCorner.setBox(i, a, b);
+    }
+
+    FrustumCuller culler;
+    const InstanceBounds* tested[2] = { &twoCorner, &bounds };
+    const char* names[2] = { "two corners", "full matrix" };
+    for (int t = 0; t < 2; t++) {
+        std::vector<int> visible;
+        size_t visibleCount = culler.cull(*tested[t], planes, visible);
+        std::vector<char> kept(count);
+        for (size_t k = 0; k < visibleCount; k++)
+            kept[visible[k]] = 1;
+
+        size_t expected = 0, falseCulled = 0, falseKept = 0;
+        for (size_t i = 0; i < count; i++) {
+            bool exact = isCubeVisible(planes, &matrices[i * 16]);
+            expected += exact;
+            falseCulled += exact && !kept[i];
+            falseKept += !exact && kept[i];
+        }
+        if (t == 1)
+            CHECK(falseCulled == 0);
+        std::printf("%s: %zu of %zu visible, falsely culled %.2f%%, falsely kept %.2f%%\n",
+            names[t], expected, count, 100.0 * falseCulled / count, 100.0 * falseKept / count);
+    }
+    std::printf("transform: %.2f ms (%.2f ns/instance)\n", milliseconds, milliseconds * 1e6 / count);
+    return 0;
+}
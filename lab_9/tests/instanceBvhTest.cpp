@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "frustumCuller.h"
+#include "instanceBvh.h"
+#include "testing.h"
+
+// Camera at (x, 0, z) looking along (sin yaw, 0, cos yaw), unit normals, inside >= 0
+static void makePlanes(float planes[6][4], float x, float z, float yaw, float fov, float farZ) {
+    float fx = sinf(yaw), fz = cosf(yaw);
+    float rx = fz, rz = -fx;
+    float h = tanf(fov * 0.5f);
+    auto set = [&](int i, float nx, float ny, float nz, float px, float py, float pz) {
+        float length = sqrtf(nx * nx + ny * ny + nz * nz);
+        nx /= length;
+        ny /= length;
+        nz /= length;
+        planes[i][0] = nx;
+        planes[i][1] = ny;
+        planes[i][2] = nz;
+        planes[i][3] = -(nx * px + ny * py + nz * pz);
+    };
+    set(0, fx, 0.0f, fz, x + fx * 0.1f, 0.0f, z + fz * 0.1f);
+    set(1, -fx, 0.0f, -fz, x + fx * farZ, 0.0f, z + fz * farZ);
+    set(2, fx * h + rx, 0.0f, fz * h + rz, x, 0.0f, z);
+    set(3, fx * h - rx, 0.0f, fz * h - rz, x, 0.0f, z);
+    set(4, fx * h, 1.0f, fz * h, x, 0.0f, z);
+    set(5, fx * h, -1.0f, fz * h, x, 0.0f, z);
+}
+
+static bool crossesBox(const float origin[3], const float dir[3], float tMax, const float bbMin[3], const float bbMax[3]) {
+    float tNear = 0.0f, tFar = tMax;
+    for (int a = 0; a < 3; a++) {
+        float t0 = (bbMin[a] - origin[a]) / dir[a];
+        float t1 = (bbMax[a] - origin[a]) / dir[a];
+        tNear = (std::max)(tNear, (std::min)(t0, t1));
+        tFar = (std::min)(tFar, (std::max)(t0, t1));
+    }
+    return tNear <= tFar;
+}
+
+static std::vector<int> sorted(std::vector<int> v) {
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = isFullRun(argc, argv) ? 1000000 : 100000;
+    // The density of the cubes of the scene
+    const float size = 8.0f * sqrtf(count / 6.0f);
+    Random random(7);
+    InstanceBounds bounds;
+    bounds.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        float c[3] = { random.range(-size, size), random.range(-2.0f, 2.0f), random.range(-size, size) };
+        float a[3] = { c[0] - 0.7f, c[1] - 0.7f, c[2] - 0.7f };
+        float b[3] = { c[0] + 0.7f, c[1] + 0.7f, c[2] + 0.7f };
+        bounds.setBox(i, a, b);
+    }
+    for (size_t i = 0; i < count; i += 97)
+        bounds.hide(i);
+
+    // Runs of moving slots between static ones, as CubeFrame::cull sees them
+    std::vector<std::pair<size_t, size_t>> runs;
+    std::vector<uint32_t> fixed;
+    for (size_t i = 0; i < count;) {
+        size_t run = 1 + random.below(600);
+        size_t end = (std::min)(count, i + run);
+        if (random.below(2))
+            runs.push_back({ i, end - i });
+        else
+            for (size_t k = i; k < end; k++)
+                fixed.push_back(uint32_t(k));
+        i = end;
+    }
+
+    InstanceBVH all, statics;
+    Stopwatch stopwatch;
+    all.build(bounds);
+    double buildMilliseconds = stopwatch.getMilliseconds();
+    statics.build(bounds, fixed);
+    CHECK(statics.size() == fixed.size());
+
+    FrustumCuller flat, moving;
+    std::vector<int> expected, visible, movingVisible, staticVisible;
+    float planes[6][4];
+    for (int frame = 0; frame < 20; frame++) {
+        makePlanes(planes, 0.0f, 0.0f, frame * 0.3f, 1.2f, 100.0f);
+        flat.cull(bounds, planes, expected);
+        all.cull(bounds, planes, visible);
+        CHECK(sorted(visible) == expected);
+
+        // The split CubeFrame::cull does: flat over the runs, the tree over the rest
+        moving.cull(bounds, planes, runs, movingVisible);
+        for (size_t k = 1; k < movingVisible.size(); k++)
+            CHECK(movingVisible[k] > movingVisible[k - 1]);
+        statics.cull(bounds, planes, staticVisible);
+        movingVisible.insert(movingVisible.end(), staticVisible.begin(), staticVisible.end());
+        CHECK(sorted(movingVisible) == expected);
+    }
+
+    // Segments: the tree finds a box exactly when one of the boxes is crossed
+    for (int s = 0; s < 200; s++) {
+        float origin[3] = { random.range(-50.0f, 50.0f), random.range(-3.0f, 3.0f), random.range(-50.0f, 50.0f) };
+        float dir[3] = { random.range(-1.0f, 1.0f), random.range(-0.1f, 0.1f), random.range(-1.0f, 1.0f) };
+        float tMax = random.range(1.0f, 20.0f);
+        bool brute = false;
+        for (size_t i = 0; i < count && !brute; i++) {
+            float bbMin[3], bbMax[3];
+            bounds.getBox(i, bbMin, bbMax);
+            brute = bounds.radius[i] >= 0.0f && crossesBox(origin, dir, tMax, bbMin, bbMax);
+        }
+        bool found = all.intersectSegment(origin, dir, tMax, [&](int i) {
+            float bbMin[3], bbMax[3];
+            bounds.getBox(i, bbMin, bbMax);
+            return bounds.radius[i] >= 0.0f && crossesBox(origin, dir, tMax, bbMin, bbMax);
+        });
+        CHECK(found == brute);
+    }
+
+    // Geometrically spaced boxes make a lopsided tree; a segment along them reaches every one.
+    const int chain = 160;
+    InstanceBounds spaced;
+    spaced.resize(chain);
+    for (int i = 0; i < chain; i++) {
+        float x = powf(1.25f, float(i));
+        float a[3] = { x - 0.5f, -0.5f, -0.5f }, b[3] = { x + 0.5f, 0.5f, 0.5f };
+        spaced.setBox(i, a, b);
+    }
+    InstanceBVH deep;
+    deep.build(spaced);
+    const float origin[3] = { 0.0f, 0.0f, 0.0f }, dir[3] = { 1.0f, 0.0f, 0.0f };
+    int hits = 0;
+    deep.intersectSegment(origin, dir, powf(1.25f, float(chain)), [&](int) { hits++; return false; });
+    CHECK(hits == chain && deep.getDepth() >= 8);
+
+    // Costs per frame: moving instances need a refit before the tree can cull them
+    const int frames = 20;
+    double flatMilliseconds = 0.0, refitMilliseconds = 0.0, treeMilliseconds = 0.0;
+    for (int frame = 0; frame < frames; frame++) {
+        for (size_t i = 0; i < count; i++)
+            bounds.centerX[i] += 0.05f * sinf(float(i + frame));
+        makePlanes(planes, 0.0f, 0.0f, frame * 0.15f, 1.2f, 100.0f);
+        stopwatch.restart();
+        flat.cull(bounds, planes, expected);
+        flatMilliseconds += stopwatch.getMilliseconds();
+        stopwatch.restart();
+        all.refit(bounds);
+        refitMilliseconds += stopwatch.getMilliseconds();
+        stopwatch.restart();
+        all.cull(bounds, planes, visible);
+        treeMilliseconds += stopwatch.getMilliseconds();
+        CHECK(visible.size() == expected.size());
+    }
+
+    std::printf("%zu boxes, %zu nodes, build %.1f ms; per frame: flat %.3f ms, refit %.3f ms + tree cull %.3f ms; "
+        "spaced chain depth %d\n", count, all.getNodesCount(), buildMilliseconds, flatMilliseconds / frames,
+        refitMilliseconds / frames, treeMilliseconds / frames, deep.getDepth());
+    return 0;
+}
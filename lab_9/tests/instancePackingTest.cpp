@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "cubeAnimator.h"
+#include "instancePacking.h"
+#include "testing.h"
+
+// GeomBuffer: world matrix, then params
+struct Instance {
+    float world[16];
+    float params[4];
+};
+
+int main(int argc, char** argv) {
+    // Every half survives the round trip, NaNs aside
+    for (uint32_t h = 0; h < 65536; h++) {
+        bool nan = ((h >> 10) & 31) == 31 && (h & 0x3FF);
+        CHECK(nan || floatToHalf(halfToFloat(uint16_t(h))) == h);
+    }
+
+    // Random rotations from random unit quaternions, uniform scales and translations
+    const size_t count = isFullRun(argc, argv) ? (1 << 20) : (1 << 16);
+    Random random(1);
+    std::vector<Instance> instances(count);
+    for (size_t i = 0; i < count; i++) {
+        float q[4], length = 0.0f;
+        for (float& v : q) {
+            v = random.range(-1.0f, 1.0f);
+            length += v * v;
+        }
+        length = sqrtf(length);
+        for (float& v : q)
+            v /= length;
+        float x = q[0], y = q[1], z = q[2], w = q[3];
+        float s = i % 4 == 0 ? 1.0f : random.range(0.2f, 3.2f);
+        const float r[3][3] = {
+            { 1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w) },
+            { 2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w) },
+            { 2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y) },
+        };
+        Instance& instance = instances[i];
+        for (int row = 0; row < 3; row++) {
+            for (int c = 0; c < 3; c++)
+                instance.world[row * 4 + c] = r[row][c] * s;
+            instance.world[row * 4 + 3] = 0.0f;
+        }
+        for (int c = 0; c < 3; c++)
+            instance.world[12 + c] = random.range(-100.0f, 100.0f);
+        instance.world[15] = 1.0f;
+        instance.params[0] = 32.0f;
+        instance.params[1] = float(int(random.below(10)) - 5);
+        instance.params[2] = float(random.below(2));
+        instance.params[3] = random.range(0.0f, 100.0f);
+    }
+
+    // Batched and one-by-one packing agree bit for bit
+    std::vector<PackedInstance> packed(count), single(count);
+    packInstances(instances[0].world, sizeof(Instance), instances[0].params, sizeof(Instance), count, packed.data());
+    for (size_t i = 0; i < count; i++)
+        packInstances(instances[i].world, sizeof(Instance), instances[i].params, sizeof(Instance), 1, &single[i]);
+    CHECK(memcmp(packed.data(), single.data(), count * sizeof(PackedInstance)) == 0);
+
+    double maxRotation = 0.0, maxCorner = 0.0, maxParam = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        float m[16], params[4];
+        decodeInstance(packed[i], m, params);
+        const Instance& instance = instances[i];
+        for (int row = 0; row < 3; row++)
+            for (int c = 0; c < 3; c++)
+                maxRotation = (std::max)(maxRotation, fabs(m[row * 4 + c] - instance.world[row * 4 + c]) / packed[i].scale);
+        // Positions are stored as floats
+        for (int c = 0; c < 3; c++)
+            CHECK(m[12 + c] == instance.world[12 + c]);
+        // World position of the corner (0.5, 0.5, 0.5)
+        for (int c = 0; c < 3; c++) {
+            double a = 0.0, b = 0.0;
+            for (int row = 0; row < 3; row++) {
+                a += 0.5 * m[row * 4 + c];
+                b += 0.5 * instance.world[row * 4 + c];
+            }
+            maxCorner = (std::max)(maxCorner, fabs(a - b));
+        }
+        // Shines, speed and texture index are small integers, exact in a half
+        for (int k = 0; k < 3; k++)
+            CHECK(params[k] == instance.params[k]);
+        maxParam = (std::max)(maxParam, fabs(params[3] - instance.params[3]) / (std::max)(1e-3f, fabsf(instance.params[3])));
+    }
+    CHECK(maxRotation <= 1e-4);
+    CHECK(maxParam <= 1.0 / 2048.0);
+
+    // The matrices the animator writes are all rotations with a translation
+    const size_t animated = 4096;
+    CubeAnimator animator;
+    animator.setTime(12.3, 1.5707963f);
+    std::vector<float> models(8 * animated);
+    for (size_t i = 0; i < animated; i++) {
+        for (int c = 0; c < 3; c++)
+            models[i * 8 + c] = random.range(-4.0f, 4.0f);
+        models[i * 8 + 4] = 32.0f;
+        models[i * 8 + 5] = float(int(random.below(10)) - 5);
+    }
+    std::vector<Instance> moved(animated);
+    animator.animate(models.data(), 8 * sizeof(float), animated, moved[0].world, sizeof(Instance));
+    for (Instance& instance : moved) {
+        const float params[4] = { 32.0f, 1.0f, 0.0f, 1.0f };
+        memcpy(instance.params, params, sizeof(params));
+    }
+    std::vector<PackedInstance> movedPacked(animated);
+    packInstances(moved[0].world, sizeof(Instance), moved[0].params, sizeof(Instance), animated, movedPacked.data());
+    double maxAnimated = 0.0;
+    for (size_t i = 0; i < animated; i++) {
+        float m[16], params[4];
+        decodeInstance(movedPacked[i], m, params);
+        for (int k = 0; k < 15; k++)
+            maxAnimated = (std::max)(maxAnimated, double(fabsf(m[k] - moved[i].world[k])));
+    }
+    CHECK(maxAnimated <= 1e-4);
+
+    const int repeats = 10;
+    Stopwatch stopwatch;
+    for (int r = 0; r < repeats; r++)
+        packInstances(instances[0].world, sizeof(Instance), instances[0].params, sizeof(Instance), count, packed.data());
+    double milliseconds = stopwatch.getMilliseconds() / repeats;
+
+    std::printf("max rotation error %.2e, corner error %.2e, param relative error %.2e, animated matrix error %.2e\n",
+        maxRotation, maxCorner, maxParam, maxAnimated);
+    std::printf("%zu instances packed in %.3f ms (%.1f ns/instance), %zu bytes each instead of %zu\n",
+        count, milliseconds, milliseconds * 1e6 / count, sizeof(PackedInstance), sizeof(Instance) + sizeof(float) * 16);
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <utility>
+#include <vector>
+
+#include "instanceStore.h"
+#include "testing.h"
+
+// The size of a GeomBuffer: world matrix and params
+struct Instance {
+    float data[20];
+};
+
+typedef std::vector<std::pair<size_t, size_t>> Ranges;
+
+template <typename T>
+static Ranges flush(InstanceStore<T>& store) {
+    Ranges ranges;
+    store.flushDirty([&](size_t first, size_t count) { ranges.push_back({ first, count }); });
+    return ranges;
+}
+
+int main(int argc, char** argv) {
+    // Slots, reuse and growth
+    InstanceStore<int> store(4);
+    for (int i = 0; i < 10; i++)
+        CHECK(store.add(i) == uint32_t(i));
+    CHECK(store.capacity() == 16);
+    CHECK(store.consumeGrowth() && !store.consumeGrowth());
+    Ranges ranges = flush(store);
+    CHECK(ranges.size() == 1 && ranges[0] == std::make_pair(size_t(0), size_t(10)));
+    CHECK(flush(store).empty());
+
+    store.remove(5);
+    store.remove(5);
+    CHECK(store.count() == 9 && !store.isAlive(5));
+    ranges = flush(store);
+    CHECK(ranges.size() == 1 && ranges[0] == std::make_pair(size_t(4), size_t(4)));
+    CHECK(store.add(42) == 5 && store[5] == 42 && store.size() == 10 && store.isAlive(5));
+    flush(store);
+
+    // Adjacent dirty chunks merge into one range, the last one ends at size()
+    store.markDirty(1);
+    store.markDirty(9);
+    ranges = flush(store);
+    CHECK(ranges.size() == 2 && ranges[0] == std::make_pair(size_t(0), size_t(4)) && ranges[1] == std::make_pair(size_t(8), size_t(2)));
+    store.markDirty(3, 2);
+    ranges = flush(store);
+    CHECK(ranges.size() == 1 && ranges[0] == std::make_pair(size_t(0), size_t(8)));
+    store.markDirty(6, 0);
+    CHECK(flush(store).empty());
+
+    // Moving cubes then static ones, as the scene adds them: marking only the moving runs
+    // never uploads a chunk that holds static cubes only.
+    InstanceStore<Instance> cubes(1024);
+    const size_t moving = 5000, fixed = 3000;
+    for (size_t i = 0; i < moving + fixed; i++)
+        cubes.add(Instance());
+    flush(cubes);
+    cubes.markDirty(0, moving);
+    ranges = flush(cubes);
+    CHECK(ranges.size() == 1 && ranges[0].first == 0 && ranges[0].second == 5 * 1024);
+
+    // Timings at 1M instances
+    const size_t count = isFullRun(argc, argv) ? 1000000 : 200000;
+    InstanceStore<Instance> big(1024);
+    Stopwatch stopwatch;
+    for (size_t i = 0; i < count; i++)
+        big.add(Instance());
+    double addMilliseconds = stopwatch.getMilliseconds();
+    stopwatch.restart();
+    size_t removed = 0;
+    for (size_t i = 0; i < count; i += 3, removed++)
+        big.remove(uint32_t(i));
+    for (size_t i = 0; i < removed; i++)
+        CHECK(big.add(Instance()) < count);
+    double reuseMilliseconds = stopwatch.getMilliseconds();
+    CHECK(big.size() == count && big.count() == count);
+
+    flush(big);
+    big.markAllDirty();
+    size_t bytes = 0;
+    size_t calls = big.flushDirty([&](size_t, size_t slots) { bytes += slots * sizeof(Instance); });
+    CHECK(calls == 1 && bytes == count * sizeof(Instance));
+
+    std::printf("%zu adds %.1f ms, %zu removes + adds %.1f ms, full flush %zu call of %zu MB\n",
+        count, addMilliseconds, removed, reuseMilliseconds, calls, bytes >> 20);
+    return 0;
+}
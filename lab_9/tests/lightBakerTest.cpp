@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "lightBaker.h"
+#include "testing.h"
+
+struct Vertex {
+    float position[3];
+    float normal[3];
+};
+
+// Uniform scale, turn about y and translation, row-major with the row-vector convention
+static void place(float angle, float scale, float x, float y, float z, float* m) {
+    float c = cosf(angle) * scale, s = sinf(angle) * scale;
+    const float matrix[16] = { c, 0.0f, -s, 0.0f, 0.0f, scale, 0.0f, 0.0f, s, 0.0f, c, 0.0f, x, y, z, 1.0f };
+    memcpy(m, matrix, sizeof(matrix));
+}
+
+// Slab test of the segment against every box in its local space
+static bool isOccludedBrute(const std::vector<float>& matrices, const float origin[3], const float dir[3], float tMax) {
+    for (size_t i = 0; i < matrices.size() / 16; i++) {
+        const float* m = &matrices[i * 16];
+        float scale2 = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+        float tNear = 0.0f, tFar = tMax;
+        for (int a = 0; a < 3; a++) {
+            const float* axis = &m[a * 4];
+            float o = ((origin[0] - m[12]) * axis[0] + (origin[1] - m[13]) * axis[1] + (origin[2] - m[14]) * axis[2]) / scale2;
+            float d = (dir[0] * axis[0] + dir[1] * axis[1] + dir[2] * axis[2]) / scale2;
+            float t0 = (-0.5f - o) / d, t1 = (0.5f - o) / d;
+            tNear = (std::max)(tNear, (std::min)(t0, t1));
+            tFar = (std::min)(tFar, (std::max)(t0, t1));
+        }
+        if (tNear <= tFar)
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    const float localMin[3] = { -0.5f, -0.5f, -0.5f }, localMax[3] = { 0.5f, 0.5f, 0.5f };
+    // The corners of the top and the bottom face
+    std::vector<Vertex> mesh;
+    for (int i = 0; i < 8; i++) {
+        float y = i < 4 ? 0.5f : -0.5f;
+        mesh.push_back({ { (i & 1) ? 0.5f : -0.5f, y, (i & 2) ? 0.5f : -0.5f }, { 0.0f, y * 2.0f, 0.0f } });
+    }
+    const float light[4] = { 0.0f, 3.0f, 0.0f, 10.0f }, color[4] = { 1.0f, 0.5f, 0.25f, 1.0f };
+    const BakeSettings settings;
+    std::vector<BakedVertex> baked;
+
+    // A lone cube: the top gets ShadeLight's diffuse term, the bottom faces away
+    {
+        float matrix[16];
+        place(0.0f, 1.0f, 0.0f, 0.0f, 0.0f, matrix);
+        LightBaker baker;
+        baker.setInstances(matrix, sizeof(matrix), 1, localMin, localMax);
+        baker.setLights(light, sizeof(light), color, sizeof(color), 1);
+        baker.bake(mesh[0].position, mesh[0].normal, sizeof(Vertex), mesh.size(), settings, baked);
+        CHECK(baked.size() == mesh.size());
+
+        float dx = 0.5f, dy = 2.5f, dz = 0.5f, d = sqrtf(dx * dx + dy * dy + dz * dz);
+        float falloff = d / light[3] * d / light[3], window = (1.0f - falloff * falloff) * (1.0f - falloff * falloff);
+        float expected = dy / d / (d * d) * window;
+        // The light is a small sphere, not a point
+        CHECK(fabsf(baked[0].light[0] - expected) < expected * 0.02f);
+        CHECK(fabsf(baked[0].light[1] - 0.5f * baked[0].light[0]) < 1e-6f && fabsf(baked[0].light[2] - 0.25f * baked[0].light[0]) < 1e-6f);
+        CHECK(baked[4].light[0] == 0.0f);
+        for (const BakedVertex& vertex : baked)
+            CHECK(vertex.skyVisibility == 1.0f);
+    }
+
+    // A wider cube between the light and the top of the first one
+    {
+        float matrices[32];
+        place(0.0f, 1.0f, 0.0f, 0.0f, 0.0f, matrices);
+        place(0.3f, 1.5f, 0.0f, 1.5f, 0.0f, matrices + 16);
+        LightBaker baker;
+        baker.setInstances(matrices, 16 * sizeof(float), 2, localMin, localMax);
+        baker.setLights(light, sizeof(light), color, sizeof(color), 1);
+        baker.bake(mesh[0].position, mesh[0].normal, sizeof(Vertex), mesh.size(), settings, baked);
+        for (int i = 0; i < 4; i++) {
+            CHECK(baked[i].light[0] == 0.0f);
+            CHECK(baked[i].skyVisibility < 0.5f);
+            CHECK(baked[8 + i].light[0] > 0.0f && baked[8 + i].skyVisibility == 1.0f);
+        }
+    }
+
+    // Random scene: isOccluded against brute force
+    const size_t count = isFullRun(argc, argv) ? 2000 : 500;
+    Random random(22);
+    std::vector<float> matrices(count * 16);
+    for (size_t i = 0; i < count; i++)
+        place(random.range(0.0f, 6.28f), random.range(0.5f, 2.0f), random.range(-20.0f, 20.0f), random.range(-4.0f, 4.0f),
+            random.range(-20.0f, 20.0f), &matrices[i * 16]);
+    LightBaker baker;
+    baker.setInstances(matrices.data(), 16 * sizeof(float), count, localMin, localMax);
+    size_t hits = 0;
+    for (int ray = 0; ray < 20000; ray++) {
+        float origin[3] = { random.range(-20.0f, 20.0f), random.range(-4.0f, 4.0f), random.range(-20.0f, 20.0f) };
+        float dir[3] = { random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f) };
+        float length = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+        for (float& d : dir)
+            d /= length;
+        float tMax = random.range(2.5f, 10.0f);
+        bool occluded = isOccludedBrute(matrices, origin, dir, tMax);
+        CHECK(baker.isOccluded(origin, dir, tMax, -1) == occluded);
+        hits += occluded;
+    }
+
+    // Eight lights over the scene, baked twice to the same bits
+    float spheres[8 * 4], colors[8 * 4];
+    for (int i = 0; i < 8; i++) {
+        spheres[i * 4] = random.range(-20.0f, 20.0f);
+        spheres[i * 4 + 1] = 6.0f;
+        spheres[i * 4 + 2] = random.range(-20.0f, 20.0f);
+        spheres[i * 4 + 3] = 16.0f;
+        colors[i * 4] = colors[i * 4 + 1] = colors[i * 4 + 2] = 1.0f;
+    }
+    baker.setLights(spheres, 4 * sizeof(float), colors, 4 * sizeof(float), 8);
+    std::vector<BakedVertex> again;
+    baker.bake(mesh[0].position, mesh[0].normal, sizeof(Vertex), mesh.size(), settings, baked);
+    const BakeStats stats = baker.getStats();
+    CHECK(stats.instances == count && stats.vertices == count * mesh.size() && !stats.cached);
+    baker.bake(mesh[0].position, mesh[0].normal, sizeof(Vertex), mesh.size(), settings, again);
+    CHECK(memcmp(baked.data(), again.data(), baked.size() * sizeof(BakedVertex)) == 0);
+
+    // The asset: written on a miss, read back on a hit, baked again once a light moves
+    const char* path = "lightBakerTest.bake";
+    remove(path);
+    CHECK(baker.bakeCached(path, mesh[0].position, mesh[0].normal, sizeof(Vertex), mesh.size(), settings, again));
+    CHECK(!baker.getStats().cached);
+    again.clear();
+    CHECK(baker.bakeCached(path, mesh[0].position, mesh[0].normal, sizeof(Vertex), mesh.size(), settings, again));
+    CHECK(baker.getStats().cached && again.size() == baked.size());
+    CHECK(memcmp(baked.data(), again.data(), baked.size() * sizeof(BakedVertex)) == 0);
+    spheres[0] += 1.0f;
+    baker.setLights(spheres, 4 * sizeof(float), colors, 4 * sizeof(float), 8);
+    CHECK(baker.bakeCached(path, mesh[0].position, mesh[0].normal, sizeof(Vertex), mesh.size(), settings, again));
+    CHECK(!baker.getStats().cached);
+    remove(path);
+
+    std::printf("%d of 20000 segments occluded; %zu vertices, %zu rays: bake %.1f ms (%.0f ns per ray)\n", int(hits),
+        stats.vertices, stats.rays, stats.milliseconds, stats.milliseconds * 1e6 / stats.rays);
+    return 0;
+}
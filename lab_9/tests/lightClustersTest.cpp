@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "lightClusters.h"
+#include "testing.h"
+
+static const uint32_t TILES_X = 16, TILES_Y = 9, SLICES = 24;
+static const float TAN_Y = 1.0f, TAN_X = TAN_Y * 16.0f / 9.0f, NEAR_Z = 0.1f, FAR_Z = 100.0f;
+
+static void toView(const float* p, const float view[16], float out[3]) {
+    for (int c = 0; c < 3; c++)
+        out[c] = p[0] * view[c] + p[1] * view[4 + c] + p[2] * view[8 + c] + view[12 + c];
+}
+
+struct Box {
+    float low[3];
+    float high[3];
+};
+
+// View-space cluster boxes in cluster order, built the way the header describes them: the
+// tile's side planes at both ends of an exponential slice
+static std::vector<Box> buildBoxes() {
+    std::vector<Box> boxes;
+    for (uint32_t k = 0; k < SLICES; k++) {
+        float z0 = k == 0 ? 0.0f : NEAR_Z * powf(FAR_Z / NEAR_Z, float(k) / SLICES);
+        float z1 = NEAR_Z * powf(FAR_Z / NEAR_Z, float(k + 1) / SLICES);
+        for (uint32_t j = 0; j < TILES_Y; j++) {
+            float top = (1.0f - 2.0f * j / TILES_Y) * TAN_Y, bottom = (1.0f - 2.0f * (j + 1) / TILES_Y) * TAN_Y;
+            for (uint32_t i = 0; i < TILES_X; i++) {
+                float left = (2.0f * i / TILES_X - 1.0f) * TAN_X, right = (2.0f * (i + 1) / TILES_X - 1.0f) * TAN_X;
+                boxes.push_back({ { (std::min)(left * z0, left * z1), (std::min)(bottom * z0, bottom * z1), z0 },
+                    { (std::max)(right * z0, right * z1), (std::max)(top * z0, top * z1), z1 } });
+            }
+        }
+    }
+    return boxes;
+}
+
+static float distance2(const Box& box, const float* p) {
+    float result = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        float d = (std::max)((std::max)(box.low[c] - p[c], p[c] - box.high[c]), 0.0f);
+        result += d * d;
+    }
+    return result;
+}
+
+static bool contains(const LightClusters& clusters, size_t cluster, uint32_t light) {
+    const ClusterRange& range = clusters.getRanges()[cluster];
+    const uint32_t* first = clusters.getIndices().data() + range.offset;
+    return std::binary_search(first, first + range.count, light);
+}
+
+int main(int argc, char** argv) {
+    Random random(19);
+    LightClusters clusters;
+    clusters.setGrid(TILES_X, TILES_Y, SLICES, TAN_X, TAN_Y, NEAR_Z, FAR_Z);
+    const std::vector<Box> boxes = buildBoxes();
+    CHECK(clusters.getClustersCount() == boxes.size());
+
+    for (int run = 0; run < 20; run++) {
+        size_t count = 1 + random.below(3000);
+        std::vector<float> spheres(count * 4);
+        for (size_t l = 0; l < count; l++) {
+            spheres[l * 4] = random.range(-30.0f, 30.0f);
+            spheres[l * 4 + 1] = random.range(-20.0f, 20.0f);
+            spheres[l * 4 + 2] = random.range(-10.0f, 100.0f);
+            spheres[l * 4 + 3] = random.range(0.01f, run % 2 ? 8.0f : 1.0f);
+        }
+        // A camera turned about y
+        float angle = random.range(0.0f, 6.28f), c = cosf(angle), s = sinf(angle);
+        const float view[16] = { c, 0.0f, -s, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, s, 0.0f, c, 0.0f, 1.0f, 2.0f, 3.0f, 1.0f };
+        clusters.assign(spheres.data(), 4 * sizeof(float), count, view, 1u << 24);
+
+        const std::vector<ClusterRange>& ranges = clusters.getRanges();
+        const std::vector<uint32_t>& indices = clusters.getIndices();
+        const ClusterStats& stats = clusters.getStats();
+        CHECK(ranges.size() == clusters.getClustersCount() && stats.dropped == 0 && stats.indices == indices.size());
+        size_t occupied = 0, maxPerCluster = 0;
+        for (const ClusterRange& range : ranges) {
+            CHECK(range.offset + range.count <= indices.size());
+            // Ascending, so a shader walks the lights in a fixed order
+            for (uint32_t q = 1; q < range.count; q++)
+                CHECK(indices[range.offset + q] > indices[range.offset + q - 1]);
+            occupied += range.count > 0;
+            maxPerCluster = (std::max)(maxPerCluster, size_t(range.count));
+        }
+        CHECK(stats.occupied == occupied && stats.maxPerCluster == maxPerCluster);
+
+        for (uint32_t l = 0; l < count; l++) {
+            float center[3];
+            toView(&spheres[l * 4], view, center);
+            float radius = spheres[l * 4 + 3];
+            // Never in a cluster whose box the sphere misses
+            for (size_t cluster = 0; cluster < boxes.size(); cluster++) {
+                if (distance2(boxes[cluster], center) > radius * radius * 1.001f + 1e-6f)
+                    CHECK(!contains(clusters, cluster, l));
+            }
+            // Points inside the sphere find the light in the cluster the shader picks for them
+            for (int p = 0; p < 30; p++) {
+                float d[3];
+                do {
+                    for (float& v : d)
+                        v = random.range(-1.0f, 1.0f);
+                } while (d[0] * d[0] + d[1] * d[1] + d[2] * d[2] > 1.0f);
+                float x = center[0] + d[0] * radius * 0.999f, y = center[1] + d[1] * radius * 0.999f, z = center[2] + d[2] * radius * 0.999f;
+                if (z < 0.01f || z > FAR_Z || fabsf(x / z) >= TAN_X || fabsf(y / z) >= TAN_Y)
+                    continue;
+                int i = int((x / z / TAN_X + 1.0f) * 0.5f * TILES_X), j = int((1.0f - y / z / TAN_Y) * 0.5f * TILES_Y);
+                int k = int(floorf(logf(z) * clusters.getSliceScale() + clusters.getSliceBias()));
+                k = (std::min)((std::max)(k, 0), int(SLICES) - 1);
+                CHECK(contains(clusters, (size_t(k) * TILES_Y + j) * TILES_X + i, l));
+            }
+        }
+
+        // A full index list: clusters past the capacity lose lights, the count is kept
+        size_t total = stats.indices;
+        clusters.assign(spheres.data(), 4 * sizeof(float), count, view, total / 2);
+        CHECK(clusters.getStats().indices == total / 2 && clusters.getStats().dropped == total - total / 2);
+        CHECK(clusters.getIndices().size() <= total / 2);
+    }
+
+    // No light in view (Light::assignClusters passes the visible ones only): every range is
+    // empty and nothing is read through the null spheres
+    {
+        const float view[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+        clusters.assign(nullptr, 4 * sizeof(float), 0, view, 65536);
+        CHECK(clusters.getIndices().empty() && clusters.getRanges().size() == boxes.size());
+        for (const ClusterRange& range : clusters.getRanges())
+            CHECK(range.count == 0);
+        CHECK(clusters.getStats().lights == 0 && clusters.getStats().indices == 0);
+    }
+
+    // Lights spread over a 100^3 volume in front of the camera
+    const size_t largest = isFullRun(argc, argv) ? 4096 : 1024;
+    const float view[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 50.0f, 1.0f };
+    for (size_t count = 1024; count <= largest; count *= 2) {
+        for (float radius : { 1.0f, 4.0f }) {
+            std::vector<float> spheres(count * 4);
+            for (size_t l = 0; l < count; l++) {
+                for (int c = 0; c < 3; c++)
+                    spheres[l * 4 + c] = random.range(-50.0f, 50.0f);
+                spheres[l * 4 + 3] = radius;
+            }
+            clusters.assign(spheres.data(), 4 * sizeof(float), count, view, 65536);
+            const int repeats = 100;
+            Stopwatch stopwatch;
+            for (int r = 0; r < repeats; r++)
+                clusters.assign(spheres.data(), 4 * sizeof(float), count, view, 65536);
+            double microseconds = stopwatch.getMilliseconds() * 1000.0 / repeats;
+
+            // Every light against every cluster box
+            stopwatch.restart();
+            size_t touched = 0;
+            for (size_t l = 0; l < count; l++) {
+                float center[3];
+                toView(&spheres[l * 4], view, center);
+                for (const Box& box : boxes)
+                    touched += distance2(box, center) <= radius * radius;
+            }
+            double bruteMilliseconds = stopwatch.getMilliseconds();
+            const ClusterStats& stats = clusters.getStats();
+            CHECK(stats.indices <= touched && stats.dropped == 0);
+            std::printf("%zu lights r=%.0f: assign %.1f us, %zu in the grid, %zu indices (%zu boxes touched), max %zu per cluster; "
+                "all lights against all boxes %.1f ms\n", count, radius, microseconds, stats.lights, stats.indices, touched,
+                stats.maxPerCluster, bruteMilliseconds);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "lightSelection.h"
+#include "testing.h"
+
+// The score as the header defines it, for one instance and one light
+static float score(const InstanceBounds& bounds, size_t i, const float* sphere, const float* color) {
+    float dx = sphere[0] - bounds.centerX[i], dy = sphere[1] - bounds.centerY[i], dz = sphere[2] - bounds.centerZ[i];
+    float range = sphere[3];
+    float reach = range + bounds.radius[i];
+    float distance2 = dx * dx + dy * dy + dz * dz;
+    if (range <= 0.0f || !(distance2 < reach * reach))
+        return 0.0f;
+    float d = (std::max)(sqrtf(distance2) - bounds.radius[i], 0.0f);
+    float falloff = d * d / (range * range);
+    float window = (std::max)(1.0f - falloff * falloff, 0.0f);
+    float intensity = (std::max)((std::max)(color[0], color[1]), color[2]);
+    return intensity * window * window / (std::max)(d * d, 1.0f);
+}
+
+int main(int argc, char** argv) {
+    Random random(20);
+    // Random scenes against a full stable sort of the scores
+    for (int run = 0; run < 10; run++) {
+        size_t lightsCount = 1 + random.below(300), count = 1 + random.below(500);
+        uint32_t k = 1 + random.below(8);
+        std::vector<float> spheres(lightsCount * 4), colors(lightsCount * 4);
+        for (size_t l = 0; l < lightsCount; l++) {
+            for (int c = 0; c < 3; c++) {
+                spheres[l * 4 + c] = random.range(-20.0f, 20.0f);
+                // White lights give many equal scores
+                colors[l * 4 + c] = run % 3 == 0 ? 1.0f : random.next();
+            }
+            spheres[l * 4 + 3] = l % 17 == 0 ? 0.0f : random.range(0.0f, 16.0f);
+        }
+        InstanceBounds bounds;
+        bounds.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            float a[3], b[3];
+            for (int c = 0; c < 3; c++) {
+                a[c] = random.range(-20.0f, 20.0f);
+                b[c] = a[c] + random.next();
+            }
+            bounds.setBox(i, a, b);
+            if (i % 50 == 3)
+                bounds.hide(i);
+        }
+
+        LightSelector selector;
+        selector.setLights(spheres.data(), 4 * sizeof(float), colors.data(), 4 * sizeof(float), lightsCount);
+        std::vector<uint16_t> lights;
+        selector.select(bounds, k, lights);
+        CHECK(lights.size() == count * k);
+        size_t selected = 0;
+        for (size_t i = 0; i < count; i++) {
+            std::vector<std::pair<float, uint16_t>> scores;
+            if (bounds.radius[i] >= 0.0f) {
+                for (size_t l = 0; l < lightsCount; l++) {
+                    float s = score(bounds, i, &spheres[l * 4], &colors[l * 4]);
+                    if (s > 0.0f)
+                        scores.push_back({ s, uint16_t(l) });
+                }
+            }
+            std::stable_sort(scores.begin(), scores.end(),
+                [](const std::pair<float, uint16_t>& a, const std::pair<float, uint16_t>& b) { return a.first > b.first; });
+            for (uint32_t q = 0; q < k; q++)
+                CHECK(lights[i * k + q] == (q < scores.size() ? scores[q].second : LightSelector::NO_LIGHT));
+            selected += (std::min)(scores.size(), size_t(k));
+        }
+        const LightSelectionStats& stats = selector.getStats();
+        CHECK(stats.instances == count && stats.lights == lightsCount && stats.selected == selected);
+    }
+
+    // Lights of radius 16 spread over a 100^3 volume
+    const size_t lightsCount = 1000, count = isFullRun(argc, argv) ? 100000 : 10000;
+    std::vector<float> spheres(lightsCount * 4), colors(lightsCount * 4, 1.0f);
+    for (size_t l = 0; l < lightsCount; l++) {
+        for (int c = 0; c < 3; c++)
+            spheres[l * 4 + c] = random.range(-50.0f, 50.0f);
+        spheres[l * 4 + 3] = 16.0f;
+    }
+    InstanceBounds bounds;
+    bounds.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        float a[3], b[3];
+        for (int c = 0; c < 3; c++) {
+            a[c] = random.range(-50.0f, 50.0f);
+            b[c] = a[c] + 1.0f;
+        }
+        bounds.setBox(i, a, b);
+    }
+    LightSelector selector;
+    selector.setLights(spheres.data(), 4 * sizeof(float), colors.data(), 4 * sizeof(float), lightsCount);
+    std::vector<uint16_t> lights;
+    selector.select(bounds, 4, lights);
+    double milliseconds = 1e9;
+    for (int run = 0; run < 5; run++) {
+        Stopwatch stopwatch;
+        selector.select(bounds, 4, lights);
+        milliseconds = (std::min)(milliseconds, stopwatch.getMilliseconds());
+    }
+
+    std::printf("%zu instances x %zu lights, k = 4: %.1f ms (%.2f ns per pair), %zu lights selected\n", count,
+        lightsCount, milliseconds, milliseconds * 1e6 / (double(count) * lightsCount), selector.getStats().selected);
+    return 0;
+}
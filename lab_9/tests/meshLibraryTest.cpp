@@ -0,0 +1,82 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "meshLibrary.h"
+#include "testing.h"
+
+// Structure every library mesh shares; `outward` faces point away from the origin.
+static void checkMesh(const std::string& name, const Mesh& mesh, bool outward) {
+    CHECK(mesh.indices.size() % 3 == 0);
+    CHECK(mesh.hasShortIndices() == (mesh.vertices.size() <= 65536));
+    if (mesh.hasShortIndices())
+        CHECK(mesh.shortIndices.size() == mesh.indices.size());
+
+    // Vertices in first use order: each index is at most one past the largest before it
+    uint32_t next = 0;
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        CHECK(mesh.indices[i] <= next);
+        if (mesh.indices[i] == next)
+            next++;
+        if (mesh.hasShortIndices())
+            CHECK(mesh.shortIndices[i] == mesh.indices[i]);
+    }
+    CHECK(next == mesh.vertices.size());
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        const float* a = mesh.vertices[mesh.indices[i]].position;
+        const float* b = mesh.vertices[mesh.indices[i + 1]].position;
+        const float* c = mesh.vertices[mesh.indices[i + 2]].position;
+        float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] }, v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+        float d = outward ? n[0] * (a[0] + b[0] + c[0]) + n[1] * (a[1] + b[1] + c[1]) + n[2] * (a[2] + b[2] + c[2]) : -n[2];
+        wrong += d <= 0.0f;
+    }
+    CHECK(wrong == 0);
+
+    size_t triangles = mesh.indices.size() / 3;
+    size_t misses = countCacheMisses(mesh.indices, mesh.vertices.size(), MeshLibrary::CACHE_SIZE);
+    CHECK(fabsf(mesh.stats.acmr - float(misses) / triangles) < 1e-4f);
+    CHECK(mesh.stats.acmr <= mesh.stats.acmrBefore + 1e-4f);
+    std::printf("%-18s %7zu vertices %7zu triangles %2zu-bit  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f\n", name.c_str(),
+        mesh.vertices.size(), triangles, mesh.getIndexSize() * 8, mesh.stats.acmrBefore, mesh.stats.acmr,
+        mesh.stats.atvrBefore, mesh.stats.atvr);
+}
+
+static void checkUnitSphere(const Mesh& mesh) {
+    for (const MeshVertex& vertex : mesh.vertices) {
+        const float* p = vertex.position;
+        CHECK(fabsf(sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]) - 1.0f) < 1e-5f);
+    }
+}
+
+int main(int argc, char** argv) {
+    MeshLibrary& library = MeshLibrary::GetInstance();
+    for (uint32_t lines : { 10u, 30u, 100u, 300u }) {
+        const Mesh& sphere = library.getUVSphere(lines, lines);
+        CHECK(sphere.vertices.size() == (lines - 2) * lines + 2);
+        checkUnitSphere(sphere);
+        checkMesh("uv sphere " + std::to_string(lines) + "x" + std::to_string(lines), sphere, true);
+    }
+    for (uint32_t subdivisions = 0; subdivisions <= 5; subdivisions++) {
+        const Mesh& sphere = library.getIcosphere(subdivisions);
+        CHECK(sphere.indices.size() / 3 == 20u << (2 * subdivisions));
+        checkUnitSphere(sphere);
+        checkMesh("icosphere " + std::to_string(subdivisions), sphere, true);
+    }
+    checkMesh("cube", library.getCube(), true);
+    CHECK(library.getCube().vertices.size() == 24);
+    checkMesh("quad", library.getQuad(), false);
+
+    // Built once, then the same mesh
+    CHECK(&library.getUVSphere(30, 30) == &library.getUVSphere(30, 30));
+    CHECK(&library.getCube() == &library.getCube());
+
+    const uint32_t lines = isFullRun(argc, argv) ? 500 : 200;
+    Stopwatch stopwatch;
+    const Mesh& big = library.getUVSphere(lines, lines + 1);
+    std::printf("uv sphere %ux%u: %zu triangles built and reordered in %.1f ms\n", lines, lines + 1,
+        big.indices.size() / 3, stopwatch.getMilliseconds());
+    return 0;
+}
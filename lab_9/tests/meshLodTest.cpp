@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "meshLod.h"
+#include "testing.h"
+
+// Largest distance of the facets from the unit sphere, sampled over each triangle
+static double measureError(const Mesh& mesh) {
+    double error = 0.0;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        const float* a = mesh.vertices[mesh.indices[i]].position;
+        const float* b = mesh.vertices[mesh.indices[i + 1]].position;
+        const float* c = mesh.vertices[mesh.indices[i + 2]].position;
+        for (int s = 0; s <= 10; s++) {
+            for (int t = 0; t <= 10 - s; t++) {
+                double u = s / 10.0, v = t / 10.0, w = 1.0 - u - v;
+                double p[3];
+                for (int k = 0; k < 3; k++)
+                    p[k] = a[k] * w + b[k] * u + c[k] * v;
+                error = (std::max)(error, 1.0 - sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]));
+            }
+        }
+    }
+    return error;
+}
+
+int main(int argc, char** argv) {
+    std::vector<MeshLod> chain;
+    // 24, 14, 8 and 5 lines; the chain stops at the coarsest sphere
+    buildUVSphereLods(24, 24, 6, chain);
+    CHECK(chain.size() == 4);
+    for (size_t level = 0; level < chain.size(); level++) {
+        // The recorded error bounds the facets and is tight, coarser levels are cheaper and worse
+        double measured = measureError(*chain[level].mesh);
+        CHECK(measured <= chain[level].error + 1e-5);
+        CHECK(measured >= chain[level].error * 0.9);
+        if (level > 0) {
+            CHECK(chain[level].mesh->getIndexCount() < chain[level - 1].mesh->getIndexCount());
+            CHECK(chain[level].error > chain[level - 1].error);
+        }
+        std::printf("level %zu: %zu triangles, error %.4f (measured %.4f)\n", level, chain[level].mesh->getIndexCount() / 3,
+            chain[level].error, measured);
+    }
+
+    // A light sphere of radius 0.1 on a 720 pixel high viewport with a 90 degree fov
+    LodSelector selector;
+    selector.setChain(chain);
+    selector.setPixelError(1.0f, 0.25f);
+    const float eye[3] = { 0.0f, 0.0f, 0.0f };
+    const float pixelsPerUnit = 0.5f * 720.0f;
+    std::vector<uint8_t> levels;
+    float center[3] = { 0.0f, 0.0f, 0.0f };
+    uint8_t previous = 0;
+    for (float distance = 0.3f; distance < 60.0f; distance *= 1.25f) {
+        center[2] = distance;
+        selector.select(center, 3 * sizeof(float), 1, 1.0f, 0.1f, eye, pixelsPerUnit, levels);
+        CHECK(levels[0] >= previous);
+        previous = levels[0];
+    }
+    CHECK(previous == chain.size() - 1);
+
+    // The first distance a fresh instance leaves the finest level at
+    float boundary = 0.0f;
+    for (float distance = 0.5f; distance < 60.0f && boundary == 0.0f; distance += 0.001f) {
+        center[2] = distance;
+        levels.clear();
+        selector.select(center, 3 * sizeof(float), 1, 1.0f, 0.1f, eye, pixelsPerUnit, levels);
+        if (levels[0] != 0)
+            boundary = distance;
+    }
+    CHECK(boundary > 0.0f);
+
+    // Hysteresis: jitter around the boundary does not flip the level every frame
+    int flips = 0;
+    for (int frame = 0; frame < 1000; frame++) {
+        center[2] = boundary * (1.0f + 0.02f * sinf(frame * 0.3f));
+        uint8_t before = levels[0];
+        selector.select(center, 3 * sizeof(float), 1, 1.0f, 0.1f, eye, pixelsPerUnit, levels);
+        flips += before != levels[0];
+    }
+    CHECK(flips <= 2);
+
+    // Stats over many spheres
+    const size_t count = isFullRun(argc, argv) ? 1000000 : 100000;
+    Random random(11);
+    std::vector<float> centers(3 * count);
+    for (float& c : centers)
+        c = random.range(-30.0f, 30.0f);
+    levels.clear();
+    Stopwatch stopwatch;
+    selector.select(centers.data(), 3 * sizeof(float), count, 1.0f, 0.1f, eye, pixelsPerUnit, levels);
+    double milliseconds = stopwatch.getMilliseconds();
+    const LodStats& stats = selector.getStats();
+    CHECK(stats.instances == count && stats.triangles <= stats.fullTriangles);
+    CHECK(stats.fullTriangles == count * (chain[0].mesh->getIndexCount() / 3));
+
+    std::printf("jitter flips %d at boundary %.3f; %zu spheres: %.1f%% of the triangles saved, select %.2f ms\n",
+        flips, boundary, count, 100.0 * stats.getSavedTriangles() / stats.fullTriangles, milliseconds);
+    return 0;
+}
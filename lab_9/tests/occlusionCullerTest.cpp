@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "occlusionCuller.h"
+#include "testing.h"
+
+static void multiply(const float* a, const float* b, float* out) {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            out[i * 4 + j] = 0.0f;
+            for (int k = 0; k < 4; k++)
+                out[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
+        }
+    }
+}
+
+// Left-handed look-at and the reversed-depth projection of the renderer
+// (XMMatrixPerspectiveFovLH(pi / 4, 16 / 9, 100, 0.01)), row vectors
+static void viewProjection(const float eye[3], const float at[3], float out[16]) {
+    float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+    float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+    for (float& v : z)
+        v /= length;
+    float x[3] = { z[2], 0.0f, -z[0] };
+    length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+    x[0] /= length;
+    x[2] /= length;
+    float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    const float view[16] = {
+        x[0], y[0], z[0], 0.0f, x[1], y[1], z[1], 0.0f, x[2], y[2], z[2], 0.0f,
+        -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]), -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+        -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f,
+    };
+    float nearZ = 100.0f, farZ = 0.01f, h = 1.0f / tanf(3.14159265f / 8.0f), w = h / (16.0f / 9.0f), r = farZ / (farZ - nearZ);
+    const float projection[16] = { w, 0, 0, 0, 0, h, 0, 0, 0, 0, r, 1, 0, 0, -r * nearZ, 0 };
+    multiply(view, projection, out);
+}
+
+struct Matrix {
+    float m[16];
+};
+
+// Scale, rotation about x then y, translation
+static Matrix world(float s, float rx, float ry, float tx, float ty, float tz) {
+    const float scale[16] = { s, 0, 0, 0, 0, s, 0, 0, 0, 0, s, 0, 0, 0, 0, 1 };
+    const float rotX[16] = { 1, 0, 0, 0, 0, cosf(rx), sinf(rx), 0, 0, -sinf(rx), cosf(rx), 0, 0, 0, 0, 1 };
+    const float rotY[16] = { cosf(ry), 0, -sinf(ry), 0, 0, 1, 0, 0, sinf(ry), 0, cosf(ry), 0, 0, 0, 0, 1 };
+    const float move[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, tx, ty, tz, 1 };
+    float a[16], b[16];
+    Matrix result;
+    multiply(scale, rotX, a);
+    multiply(a, rotY, b);
+    multiply(b, move, result.m);
+    return result;
+}
+
+static const float localMin[3] = { -0.5f, -0.5f, -0.5f };
+static const float localMax[3] = { 0.5f, 0.5f, 0.5f };
+static const int W = OcclusionCuller::WIDTH;
+static const int H = OcclusionCuller::HEIGHT;
+
+int main(int argc, char** argv) {
+    // One 4x4x4 occluder 10 units in front of the camera
+    {
+        const float eye[3] = { 0.0f, 0.0f, 0.0f }, at[3] = { 0.0f, 0.0f, 1.0f };
+        float vp[16];
+        viewProjection(eye, at, vp);
+        Matrix occluder = world(4.0f, 0.0f, 0.0f, 0.0f, 0.0f, 10.0f);
+        OcclusionCuller culler;
+        culler.beginFrame(vp);
+        culler.renderOccluders(occluder.m, sizeof(Matrix), std::vector<int>{ 0 }, localMin, localMax);
+
+        float clip[4];
+        for (int j = 0; j < 4; j++)
+            clip[j] = 8.0f * vp[8 + j] + vp[12 + j];
+        float expected = clip[2] / clip[3];
+        CHECK(fabsf(culler.getDepth()[(H / 2) * W + W / 2] - expected) <= 1e-6f * expected);
+        CHECK(culler.getStats().triangles > 0);
+
+        auto isVisible = [&](float x, float y, float z, float e) {
+            float a[3] = { x - e, y - e, z - e }, b[3] = { x + e, y + e, z + e };
+            return culler.isBoxVisible(a, b);
+        };
+        CHECK(!isVisible(0.0f, 0.0f, 20.0f, 0.5f)); // behind
+        CHECK(isVisible(0.0f, 0.0f, 5.0f, 0.5f));   // in front
+        CHECK(isVisible(8.0f, 0.0f, 20.0f, 0.5f));  // beside
+        CHECK(isVisible(6.0f, 0.0f, 20.0f, 1.0f));  // straddling the silhouette
+        CHECK(isVisible(0.0f, 0.0f, 10.0f, 3.0f));  // the occluder itself
+    }
+
+    // Random scenes: every culled box is behind the depth buffer at every pixel it covers
+    const int count = isFullRun(argc, argv) ? 100000 : 20000;
+    const int scenes = 10;
+    Random random(7);
+    double renderMilliseconds = 0.0, testMilliseconds = 0.0;
+    size_t occluded = 0, tested = 0;
+    for (int scene = 0; scene < scenes; scene++) {
+        std::vector<Matrix> matrices(count);
+        for (Matrix& m : matrices)
+            m = world(random.range(0.3f, 2.3f), random.range(0.0f, 6.28f), random.range(0.0f, 6.28f),
+                random.range(-30.0f, 30.0f), random.range(-30.0f, 30.0f), random.range(-30.0f, 30.0f));
+        InstanceBounds bounds;
+        bounds.transform(matrices[0].m, sizeof(Matrix), count, localMin, localMax);
+
+        const float eye[3] = { random.range(-40.0f, 40.0f), random.range(-40.0f, 40.0f), -45.0f }, at[3] = { 0.0f, 0.0f, 0.0f };
+        float vp[16];
+        viewProjection(eye, at, vp);
+        std::vector<int> visible(count);
+        for (int i = 0; i < count; i++)
+            visible[i] = i;
+
+        OcclusionCuller culler;
+        culler.beginFrame(vp);
+        std::vector<int> occluders;
+        culler.selectOccluders(bounds, visible, 512, occluders);
+        Stopwatch stopwatch;
+        culler.renderOccluders(matrices[0].m, sizeof(Matrix), occluders, localMin, localMax);
+        renderMilliseconds += stopwatch.getMilliseconds();
+        stopwatch.restart();
+        culler.cull(bounds, visible);
+        testMilliseconds += stopwatch.getMilliseconds();
+        occluded += culler.getStats().occluded;
+        tested += culler.getStats().tested;
+        CHECK(std::is_sorted(visible.begin(), visible.end()));
+
+        std::vector<char> kept(count);
+        for (int i : visible)
+            kept[i] = 1;
+        const float* depth = culler.getDepth();
+        for (int i = 0; i < count; i++) {
+            if (kept[i])
+                continue;
+
+            float bbMin[3], bbMax[3];
+            bounds.getBox(i, bbMin, bbMax);
+            float rect[4] = { 1e9f, 1e9f, -1e9f, -1e9f }, nearest = 0.0f;
+            for (int k = 0; k < 8; k++) {
+                float p[3] = { (k & 1) ? bbMax[0] : bbMin[0], (k & 2) ? bbMax[1] : bbMin[1], (k & 4) ? bbMax[2] : bbMin[2] };
+                float c[4];
+                for (int j = 0; j < 4; j++)
+                    c[j] = p[0] * vp[j] + p[1] * vp[4 + j] + p[2] * vp[8 + j] + vp[12 + j];
+                // A box crossing the near plane is never culled
+                CHECK(c[3] > 0.0f && c[2] <= c[3]);
+                float x = (c[0] / c[3] * 0.5f + 0.5f) * W, y = (0.5f - c[1] / c[3] * 0.5f) * H;
+                rect[0] = (std::min)(rect[0], x);
+                rect[1] = (std::min)(rect[1], y);
+                rect[2] = (std::max)(rect[2], x);
+                rect[3] = (std::max)(rect[3], y);
+                nearest = (std::max)(nearest, c[2] / c[3]);
+            }
+            int x0 = (std::max)(0, int(rect[0])), y0 = (std::max)(0, int(rect[1]));
+            int x1 = (std::min)(W - 1, int(rect[2])), y1 = (std::min)(H - 1, int(rect[3]));
+            for (int y = y0; y <= y1; y++)
+                for (int x = x0; x <= x1; x++)
+                    CHECK(nearest < depth[y * W + x] * (1.0f + 1e-5f));
+        }
+    }
+
+    std::printf("%d boxes: render 512 occluders %.3f ms, test %.3f ms, %.1f%% occluded\n",
+        count, renderMilliseconds / scenes, testMilliseconds / scenes, 100.0 * occluded / tested);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "instanceBvh.h"
+#include "testing.h"
+
+static void normalize(float v[3]) {
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (int k = 0; k < 3; k++)
+        v[k] /= length;
+}
+
+// The planes of a camera orbiting the origin at `distance`, as Camera moves it
+static void orbitPlanes(float planes[6][4], float phi, float theta, float distance, float farZ) {
+    float eye[3] = { distance * cosf(theta) * cosf(phi), distance * sinf(theta), distance * cosf(theta) * sinf(phi) };
+    float f[3] = { -eye[0] / distance, -eye[1] / distance, -eye[2] / distance };
+    float r[3] = { f[2], 0.0f, -f[0] };
+    normalize(r);
+    float u[3] = { f[1] * r[2] - f[2] * r[1], f[2] * r[0] - f[0] * r[2], f[0] * r[1] - f[1] * r[0] };
+    float h = tanf(0.3926991f), w = h * 16.0f / 9.0f;
+    auto set = [&](int i, float nx, float ny, float nz, float distanceAlong) {
+        float n[3] = { nx, ny, nz };
+        normalize(n);
+        float o[3] = { eye[0] + f[0] * distanceAlong, eye[1] + f[1] * distanceAlong, eye[2] + f[2] * distanceAlong };
+        for (int k = 0; k < 3; k++)
+            planes[i][k] = n[k];
+        planes[i][3] = -(n[0] * o[0] + n[1] * o[1] + n[2] * o[2]);
+    };
+    set(0, f[0], f[1], f[2], 0.1f);
+    set(1, -f[0], -f[1], -f[2], farZ);
+    set(2, f[0] * w + r[0], f[1] * w + r[1], f[2] * w + r[2], 0.0f);
+    set(3, f[0] * w - r[0], f[1] * w - r[1], f[2] * w - r[2], 0.0f);
+    set(4, f[0] * h - u[0], f[1] * h - u[1], f[2] * h - u[2], 0.0f);
+    set(5, f[0] * h + u[0], f[1] * h + u[1], f[2] * h + u[2], 0.0f);
+}
+
+int main(int argc, char** argv) {
+    const bool full = isFullRun(argc, argv);
+    const size_t count = full ? 1000000 : 200000;
+    const int frames = full ? 600 : 120;
+    const float size = 200.0f;
+    Random random(3);
+    InstanceBounds bounds;
+    bounds.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        float c[3] = { random.range(-0.5f, 0.5f) * size, random.range(-0.5f, 0.5f) * size, random.range(-0.5f, 0.5f) * size };
+        float a[3] = { c[0] - 0.7f, c[1] - 0.7f, c[2] - 0.7f }, b[3] = { c[0] + 0.7f, c[1] + 0.7f, c[2] + 0.7f };
+        bounds.setBox(i, a, b);
+    }
+    for (size_t i = 0; i < count; i += 97)
+        bounds.hide(i);
+
+    InstanceBVH bvh;
+    bvh.build(bounds);
+
+    // A slowly orbiting camera: the BVH, whose nodes remember the plane that rejected them,
+    // must give the answer of the scalar test every frame. The SIMD flat culler adds in
+    // another order and may differ on boxes that touch a plane, so it is only timed.
+    FrustumCuller flat;
+    std::vector<int> expected, visible, flatVisible;
+    double flatMilliseconds = 0.0, bvhMilliseconds = 0.0;
+    size_t hits = 0, tried = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        float planes[6][4];
+        orbitPlanes(planes, frame * 0.01f, 0.5f, 150.0f, 120.0f);
+
+        expected.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (FrustumCuller::isVisible(bounds, planes, i))
+                expected.push_back(int(i));
+        }
+
+        Stopwatch stopwatch;
+        flat.cull(bounds, planes, flatVisible);
+        double flatFrame = stopwatch.getMilliseconds();
+        stopwatch.restart();
+        bvh.cull(bounds, planes, visible);
+        double bvhFrame = stopwatch.getMilliseconds();
+        std::sort(visible.begin(), visible.end());
+        CHECK(visible == expected);
+        if (frame > 0) {
+            flatMilliseconds += flatFrame;
+            bvhMilliseconds += bvhFrame;
+            hits += bvh.getStats().hits;
+            tried += bvh.getStats().cached;
+        }
+    }
+    CHECK(tried > 0 && hits > tried / 2);
+
+    std::printf("%zu boxes, %d frames: flat %.3f ms, cached BVH %.3f ms per frame, %.1f%% of %zu cached node tests hit\n",
+        count, frames, flatMilliseconds / (frames - 1), bvhMilliseconds / (frames - 1), 100.0 * hits / tried, tried / (frames - 1));
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "commandList.h"
+#include "jobSystem.h"
+#include "testing.h"
+
+// Flattens the replayed stream, with the handles and bytes each command points at
+class CaptureBackend : public CommandBackend {
+public:
+    void execute(const CommandList& list, const Command& command) override {
+        append(&command.type, sizeof(command.type));
+        append(&command.stage, sizeof(command.stage));
+        append(&command.slot, sizeof(command.slot));
+        append(&command.count, sizeof(command.count));
+        append(&command.object, sizeof(command.object));
+        append(command.args, sizeof(command.args));
+        if (command.type == COMMAND_UPDATE_BUFFER)
+            append(list.getPayload(command.first), command.count);
+        else if (command.type == COMMAND_SET_SHADER_RESOURCES)
+            append(list.getHandles(command), command.count * sizeof(GpuHandle));
+        commands++;
+    }
+
+    std::vector<char> stream;
+    size_t commands = 0;
+
+private:
+    void append(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        stream.insert(stream.end(), bytes, bytes + size);
+    }
+};
+
+int main(int argc, char** argv) {
+    const size_t count = isFullRun(argc, argv) ? 1000000 : 100000;
+    const size_t chunk = 1024;
+    // 32 bytes of instance data and 32 of bounds per cube, as CubeFrame::recordUploads uploads them
+    std::vector<char> instances(count * 32), bounds(count * 32);
+    Random random(15);
+    for (size_t i = 0; i < count * 32; i++) {
+        instances[i] = char(random.nextInt());
+        bounds[i] = char(random.nextInt());
+    }
+    GpuHandle instanceBuffer = reinterpret_cast<GpuHandle>(0x100), boundsBuffer = reinterpret_cast<GpuHandle>(0x200);
+
+    size_t parts = (count + chunk - 1) / chunk;
+    auto record = [&](size_t part, CommandList& list) {
+        size_t first = part * chunk, size = (std::min)(chunk, count - first);
+        list.updateBufferRange(instanceBuffer, instances.data() + first * 32, uint32_t(first * 32), uint32_t(size * 32));
+        // Uneven parts, so the workers finish out of order
+        if (part % 7 == 0)
+            list.updateBufferRange(boundsBuffer, bounds.data() + first * 32, uint32_t(first * 32), uint32_t(size * 32));
+        GpuHandle views[2] = { instanceBuffer, boundsBuffer };
+        list.setShaderResources(SHADER_STAGE_VERTEX, 2, 2, views);
+        list.drawIndexedInstanced(36, uint32_t(size), 0, 0, uint32_t(first));
+    };
+
+    CommandList serial, merged;
+    std::vector<CommandList> lists;
+    double serialMilliseconds = 1e9;
+    for (int run = 0; run < 5; run++) {
+        Stopwatch stopwatch;
+        serial.clear();
+        for (size_t part = 0; part < parts; part++)
+            record(part, serial);
+        serialMilliseconds = (std::min)(serialMilliseconds, stopwatch.getMilliseconds());
+    }
+    CaptureBackend expectedAll;
+    serial.replay(expectedAll);
+
+    // The same stream on 1, 2, 4 ... workers and on every hardware thread. At least 4, so the
+    // order is checked with several workers even on a small machine.
+    std::vector<size_t> threadCounts;
+    size_t hardwareThreads = (std::max)(size_t(std::thread::hardware_concurrency()), size_t(1));
+    size_t maxThreads = (std::max)(hardwareThreads, size_t(4));
+    for (size_t threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    std::vector<double> parallelMilliseconds(threadCounts.size(), 1e9);
+    for (size_t i = 0; i < threadCounts.size(); i++) {
+        JobSystem::GetInstance().setThreadsCount(threadCounts[i]);
+        CHECK(JobSystem::GetInstance().getThreadsCount() == threadCounts[i]);
+        for (int run = 0; run < 5; run++) {
+            Stopwatch stopwatch;
+            merged.clear();
+            recordParallel(merged, lists, parts, record);
+            parallelMilliseconds[i] = (std::min)(parallelMilliseconds[i], stopwatch.getMilliseconds());
+
+            CaptureBackend actual;
+            merged.replay(actual);
+            CHECK(actual.commands == expectedAll.commands && actual.stream == expectedAll.stream);
+        }
+    }
+
+    // Fewer parts than last frame: the leftover lists are kept but not stitched in
+    serial.clear();
+    for (size_t part = 0; part < parts / 2; part++)
+        record(part, serial);
+    merged.clear();
+    recordParallel(merged, lists, parts / 2, record);
+    CHECK(lists.size() == parts);
+    CaptureBackend expected, actual;
+    serial.replay(expected);
+    merged.replay(actual);
+    CHECK(actual.commands == expected.commands && actual.stream == expected.stream);
+
+    CountingBackend counter;
+    merged.replay(counter);
+    CHECK(counter.getStats().commands[COMMAND_EXECUTE_LIST] == 0 && counter.getStats().getDraws() == parts / 2);
+
+    std::printf("%zu cubes, %zu parts: serial %.2f ms\n", count, parts, serialMilliseconds);
+    for (size_t i = 0; i < threadCounts.size(); i++) {
+        std::printf("  recordParallel on %zu threads: %.2f ms (%.2fx)%s\n", threadCounts[i], parallelMilliseconds[i],
+            serialMilliseconds / parallelMilliseconds[i], threadCounts[i] > hardwareThreads ? ", more threads than cores" : "");
+    }
+    return 0;
+}
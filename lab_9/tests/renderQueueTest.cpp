@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <vector>
+
+#include "renderQueue.h"
+#include "testing.h"
+
+int main(int argc, char** argv) {
+    // Key order: passes first, opaque front to back, transparent back to front
+    CHECK(makeOpaqueKey(RENDER_PASS_OPAQUE, 1, 0, 1.0f) < makeOpaqueKey(RENDER_PASS_OPAQUE, 1, 0, 2.0f));
+    CHECK(makeOpaqueKey(RENDER_PASS_OPAQUE, 1, 7, 100.0f) < makeOpaqueKey(RENDER_PASS_OPAQUE, 2, 0, 1.0f));
+    CHECK(makeTransparentKey(RENDER_PASS_TRANSPARENT, 2.0f, 0, 0) < makeTransparentKey(RENDER_PASS_TRANSPARENT, 1.0f, 0, 0));
+    CHECK(makeOpaqueKey(RENDER_PASS_SKY, 0, 0, 0.0f) > makeOpaqueKey(RENDER_PASS_OPAQUE, 4095, 65535, 1e30f));
+    CHECK(makeTransparentKey(RENDER_PASS_TRANSPARENT, 1e30f, 4095, 65535) > makeOpaqueKey(RENDER_PASS_SKY, 4095, 65535, 1e30f));
+    CHECK(makeOpaqueKey(RENDER_PASS_OPAQUE, 0, 0, -5.0f) == makeOpaqueKey(RENDER_PASS_OPAQUE, 0, 0, 0.0f));
+
+    // Random frames against std::stable_sort: same keys and, for equal keys, submission order
+    const size_t count = isFullRun(argc, argv) ? 1000000 : 100000;
+    Random random(3);
+    RenderQueue queue;
+    std::vector<DrawPacket> expected;
+    double submitMilliseconds = 1e9, sortMilliseconds = 1e9, stdMilliseconds = 1e9;
+    for (int frame = 0; frame < 10; frame++) {
+        queue.clear();
+        expected.clear();
+        std::vector<uint64_t> keys(count);
+        for (uint64_t& key : keys) {
+            uint32_t r = random.nextInt();
+            float depth = random.range(0.01f, 500.0f);
+            if (r % 10 < 7)
+                key = makeOpaqueKey(RENDER_PASS_OPAQUE, r % 16, (r >> 8) % 64, depth);
+            else if (r % 10 < 8)
+                key = makeOpaqueKey(RENDER_PASS_SKY, 20, 0, depth);
+            else
+                key = makeTransparentKey(RENDER_PASS_TRANSPARENT, depth, r % 4, 0);
+        }
+        // Few distinct keys leave equal keys for the stability check
+        if (frame % 2)
+            for (uint64_t& key : keys)
+                key = makeOpaqueKey(RENDER_PASS_OPAQUE, uint32_t(key) % 3, 0, 1.0f);
+
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < count; i++)
+            queue.submit(keys[i], uint32_t(i & 3), uint32_t(i));
+        submitMilliseconds = (std::min)(submitMilliseconds, stopwatch.getMilliseconds());
+        stopwatch.restart();
+        queue.sort();
+        sortMilliseconds = (std::min)(sortMilliseconds, stopwatch.getMilliseconds());
+
+        for (size_t i = 0; i < count; i++)
+            expected.push_back({ keys[i], uint32_t(i & 3), uint32_t(i) });
+        stopwatch.restart();
+        std::stable_sort(expected.begin(), expected.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+        stdMilliseconds = (std::min)(stdMilliseconds, stopwatch.getMilliseconds());
+
+        const std::vector<DrawPacket>& packets = queue.getPackets();
+        CHECK(packets.size() == count);
+        for (size_t i = 0; i < count; i++)
+            CHECK(packets[i].key == expected[i].key && packets[i].item == expected[i].item && packets[i].object == expected[i].object);
+    }
+
+    std::printf("%zu packets: submit %.3f ms, radix sort %.3f ms, std::stable_sort %.3f ms\n",
+        count, submitMilliseconds, sortMilliseconds, stdMilliseconds);
+    return 0;
+}
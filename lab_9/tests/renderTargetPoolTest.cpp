@@ -0,0 +1,123 @@
+#include <set>
+
+#include "renderTargetPool.h"
+#include "testing.h"
+
+// Hands out numbered handles and checks every release is of a live one
+class MockDevice : public RenderTargetDevice {
+public:
+    bool create(const RenderTargetDesc&, RenderTarget& target) override {
+        if (failing)
+            return false;
+        target.texture = reinterpret_cast<GpuHandle>(uintptr_t(next++) * 16);
+        target.renderTargetView = target.texture;
+        target.shaderResourceView = target.texture;
+        alive.insert(target.texture);
+        created++;
+        return true;
+    }
+
+    void release(RenderTarget& target) override {
+        CHECK(alive.erase(target.texture) == 1);
+        released++;
+    }
+
+    std::set<GpuHandle> alive;
+    size_t created = 0;
+    size_t released = 0;
+    size_t next = 1;
+    bool failing = false;
+};
+
+// A chain of `passes` passes the way Postprocessing::render runs it: every pass but the last
+// draws to a new target and then gives its source back. Returns the textures drawn to.
+static std::set<GpuHandle> runChain(RenderTargetPool& pool, int passes, const RenderTargetDesc& desc, size_t held = 0) {
+    std::set<GpuHandle> used;
+    int source = -1;
+    for (int pass = 0; pass < passes; pass++) {
+        int target = pass + 1 < passes ? pool.acquire(desc) : -1;
+        if (target >= 0) {
+            used.insert(pool.getTarget(target).texture);
+            CHECK(target != source);
+        }
+        if (source >= 0)
+            pool.release(source);
+        source = target;
+    }
+    CHECK(pool.getStats().inUse == held);
+    return used;
+}
+
+int main(int argc, char** argv) {
+    MockDevice device;
+    RenderTargetPool pool;
+    pool.init(&device, 2);
+    const RenderTargetDesc small = { 800, 600, 10 }, large = { 1024, 768, 10 }, smallFloat = { 800, 600, 2 };
+
+    // Chains alternate between two targets at most
+    for (int passes = 1; passes <= 12; passes++) {
+        CHECK(runChain(pool, passes, small).size() == size_t(passes <= 1 ? 0 : passes == 2 ? 1 : 2));
+        pool.endFrame();
+    }
+    CHECK(device.created == 2 && pool.getStats().live == 2);
+
+    // Steady frames create nothing
+    for (int frame = 0; frame < 100; frame++) {
+        runChain(pool, 5, small);
+        pool.endFrame();
+    }
+    CHECK(device.created == 2);
+
+    // Formats are kept apart
+    int a = pool.acquire(small), b = pool.acquire(smallFloat);
+    CHECK(pool.getTarget(a).texture != pool.getTarget(b).texture && pool.getDesc(b) == smallFloat && device.created == 3);
+    pool.release(a);
+    pool.release(b);
+
+    // A resize: the new size is created, the old one goes after the idle frames, and a target
+    // of another format held through it stays
+    int held = pool.acquire(smallFloat);
+    for (int frame = 0; frame < 4; frame++) {
+        runChain(pool, 4, large, 1);
+        pool.endFrame();
+    }
+    CHECK(pool.getStats().live == 3 && device.alive.size() == 3 && device.created == 5);
+    pool.release(held);
+
+    // The old size is gone, so going back creates it again; the new one is still there
+    runChain(pool, 3, small);
+    pool.endFrame();
+    CHECK(device.created == 7);
+    runChain(pool, 3, large);
+    pool.endFrame();
+    CHECK(device.created == 7);
+
+    // A device that cannot create
+    device.failing = true;
+    CHECK(pool.acquire({ 1, 1, 1 }) == -1);
+    device.failing = false;
+
+    // Everything idle goes, and the freed slots are taken again
+    for (int frame = 0; frame < 5; frame++)
+        pool.endFrame();
+    CHECK(pool.getStats().live == 0 && device.alive.empty());
+    runChain(pool, 3, small);
+    runChain(pool, 3, small);
+    CHECK(device.created == 9);
+
+    const size_t frames = isFullRun(argc, argv) ? 1000000 : 100000;
+    Stopwatch stopwatch;
+    for (size_t frame = 0; frame < frames; frame++) {
+        runChain(pool, 6, frame % 1000 < 500 ? small : large);
+        pool.endFrame();
+    }
+    double milliseconds = stopwatch.getMilliseconds();
+
+    pool.clear();
+    CHECK(device.alive.empty() && device.created == device.released);
+    const RenderTargetPoolStats& stats = pool.getStats();
+    CHECK(stats.created == device.created && stats.released == device.released && stats.live == 0 && stats.inUse == 0);
+    std::printf("%zu frames of 5 passes, resizing every 500: %zu targets created, %zu acquires reused, %.1f ns per acquire\n",
+        frames, stats.created, stats.reused, milliseconds * 1e6 / (frames * 5));
+    return 0;
+}
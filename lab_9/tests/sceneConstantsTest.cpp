@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Consts.h"
+#include "commandList.h"
+#include "uploadRing.h"
+#include "testing.h"
+
+// Plain float mirrors of the constant buffers in structures.h; the layouts match byte for byte.
+struct Matrix {
+    float m[16];
+};
+
+struct Float4 {
+    float x, y, z, w;
+};
+
+struct WorldMatrixBuffer {
+    Matrix worldMatrix;
+    Float4 color;
+};
+
+struct SceneCB {
+    Matrix viewProjectionMatrix;
+    Float4 cameraPos;
+    int32_t lightCount[4];
+    Float4 lightPos[MAX_LIGHTS];
+    Float4 lightColor[MAX_LIGHTS];
+    Float4 ambientColor;
+};
+
+struct CullingParams {
+    int32_t numShapes[4];
+    Float4 planes[6];
+};
+
+struct SBWorldMatrixBuffer {
+    Matrix worldMatrix;
+    Float4 size;
+};
+
+struct PostprocessingCB {
+    int32_t params[4];
+};
+
+// The per-object scene buffers the shared block replaced
+struct SceneMatrixBuffer {
+    Matrix viewProjectionMatrix;
+};
+
+struct CubeSceneMatrixBuffer {
+    Matrix viewProjectionMatrix;
+    Float4 planes[6];
+};
+
+struct CullingParamsBefore {
+    int32_t numShapes[4];
+};
+
+struct LightableCB {
+    Float4 cameraPos;
+    int32_t lightCount[4];
+    Float4 lightPos[MAX_LIGHTS];
+    Float4 lightColor[MAX_LIGHTS];
+    Float4 ambientColor;
+};
+
+struct SBSceneMatrixBuffer {
+    Matrix viewProjectionMatrix;
+    Float4 cameraPos;
+};
+
+enum Block {
+    BLOCK_SCENE,
+    BLOCK_CULLING,
+    BLOCK_CUBE_SCENE,
+    BLOCK_CUBE_LIGHT,
+    BLOCK_PLANE_SCENE,
+    BLOCK_PLANE_LIGHT,
+    BLOCK_PLANE_WORLD, // one per plane
+    BLOCK_LIGHT_SCENE = BLOCK_PLANE_WORLD + 3,
+    BLOCK_LIGHT_WORLD,
+    BLOCK_SKYBOX_SCENE,
+    BLOCK_SKYBOX_WORLD,
+    BLOCK_POSTPROCESSING,
+};
+
+// What one frame knows: the camera, the lights and the objects' own transforms
+struct Frame {
+    Matrix view, projection;
+    Float4 cameraPos;
+    Float4 frustum[6];
+    int lightCount;
+    Float4 lightPos[MAX_LIGHTS];
+    Float4 lightColor[MAX_LIGHTS];
+    Matrix planeWorld[3];
+    Matrix lightWorld[MAX_LIGHTS];
+    Matrix skyboxWorld;
+};
+
+// XMMatrixMultiply, row vectors
+static Matrix multiply(const Matrix& a, const Matrix& b) {
+    Matrix result;
+    for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 4; column++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++)
+                sum += a.m[row * 4 + k] * b.m[k * 4 + column];
+            result.m[row * 4 + column] = sum;
+        }
+    }
+    return result;
+}
+
+template <typename T>
+static T& write(CommandList& commands, uint32_t block) {
+    return *reinterpret_cast<T*>(commands.writeConstants(block, sizeof(T)));
+}
+
+static void fillLights(const Frame& frame, Float4* positions, Float4* colors, int32_t* count) {
+    count[0] = frame.lightCount;
+    for (int i = 0; i < frame.lightCount; i++) {
+        positions[i] = { frame.lightPos[i].x, frame.lightPos[i].y, frame.lightPos[i].z, 1.0f };
+        colors[i] = { frame.lightColor[i].x, frame.lightColor[i].y, frame.lightColor[i].z, 1.0f };
+    }
+}
+
+// The uploads every object keeps: plane, light and skybox transforms and the postprocess params
+static void writeObjectConstants(CommandList& commands, const Frame& frame) {
+    for (int i = 0; i < 3; i++) {
+        WorldMatrixBuffer& plane = write<WorldMatrixBuffer>(commands, BLOCK_PLANE_WORLD + i);
+        plane.worldMatrix = frame.planeWorld[i];
+        plane.color = { 0.3f, 0.3f, 0.3f, 0.5f };
+    }
+    WorldMatrixBuffer* lights = reinterpret_cast<WorldMatrixBuffer*>(commands.writeConstants(BLOCK_LIGHT_WORLD, sizeof(WorldMatrixBuffer) * MAX_LIGHTS));
+    for (int i = 0; i < frame.lightCount; i++) {
+        lights[i].worldMatrix = frame.lightWorld[i];
+        lights[i].color = frame.lightColor[i];
+    }
+    SBWorldMatrixBuffer& skybox = write<SBWorldMatrixBuffer>(commands, BLOCK_SKYBOX_WORLD);
+    skybox.worldMatrix = frame.skyboxWorld;
+    skybox.size = { 100.0f, 0.0f, 0.0f, 0.0f };
+    PostprocessingCB& post = write<PostprocessingCB>(commands, BLOCK_POSTPROCESSING);
+    post.params[0] = 1;
+}
+
+// The fills before the shared block: every object built its own view-projection, and the cubes
+// and planes each their copy of the camera and the lights
+static void recordBefore(CommandList& commands, const Frame& frame, int cubes) {
+    write<CullingParamsBefore>(commands, BLOCK_CULLING).numShapes[0] = cubes;
+    CubeSceneMatrixBuffer& cubeScene = write<CubeSceneMatrixBuffer>(commands, BLOCK_CUBE_SCENE);
+    cubeScene.viewProjectionMatrix = multiply(frame.view, frame.projection);
+    for (int i = 0; i < 6; i++)
+        cubeScene.planes[i] = frame.frustum[i];
+    LightableCB& cubeLight = write<LightableCB>(commands, BLOCK_CUBE_LIGHT);
+    cubeLight.cameraPos = frame.cameraPos;
+    cubeLight.ambientColor = { 0.9f, 0.9f, 0.4f, 1.0f };
+    fillLights(frame, cubeLight.lightPos, cubeLight.lightColor, cubeLight.lightCount);
+    uint32_t cubeBlocks[] = { BLOCK_CUBE_SCENE, BLOCK_CUBE_LIGHT };
+    commands.setConstantBlocks(SHADER_STAGE_VERTEX, 1, 1, cubeBlocks);
+    commands.setConstantBlocks(SHADER_STAGE_PIXEL, 1, 2, cubeBlocks);
+
+    LightableCB& planeLight = write<LightableCB>(commands, BLOCK_PLANE_LIGHT);
+    planeLight.cameraPos = frame.cameraPos;
+    planeLight.ambientColor = { 0.9f, 0.9f, 0.3f, 1.0f };
+    fillLights(frame, planeLight.lightPos, planeLight.lightColor, planeLight.lightCount);
+    write<SceneMatrixBuffer>(commands, BLOCK_PLANE_SCENE).viewProjectionMatrix = multiply(frame.view, frame.projection);
+    uint32_t planeBlock = BLOCK_PLANE_SCENE;
+    commands.setConstantBlocks(SHADER_STAGE_VERTEX, 1, 1, &planeBlock);
+
+    write<SceneMatrixBuffer>(commands, BLOCK_LIGHT_SCENE).viewProjectionMatrix = multiply(frame.view, frame.projection);
+    SBSceneMatrixBuffer& skyboxScene = write<SBSceneMatrixBuffer>(commands, BLOCK_SKYBOX_SCENE);
+    skyboxScene.viewProjectionMatrix = multiply(frame.view, frame.projection);
+    skyboxScene.cameraPos = frame.cameraPos;
+
+    writeObjectConstants(commands, frame);
+}
+
+// Scene::writeSceneConstants and the culling params that took the frustum planes
+static void recordAfter(CommandList& commands, const Frame& frame, int cubes) {
+    SceneCB& scene = write<SceneCB>(commands, BLOCK_SCENE);
+    scene.viewProjectionMatrix = multiply(frame.view, frame.projection);
+    scene.cameraPos = frame.cameraPos;
+    scene.ambientColor = { 0.9f, 0.9f, 0.4f, 1.0f };
+    fillLights(frame, scene.lightPos, scene.lightColor, scene.lightCount);
+    uint32_t sceneBlock = BLOCK_SCENE;
+    commands.setConstantBlocks(SHADER_STAGE_VERTEX, 1, 1, &sceneBlock);
+    commands.setConstantBlocks(SHADER_STAGE_PIXEL, 1, 1, &sceneBlock);
+
+    CullingParams& culling = write<CullingParams>(commands, BLOCK_CULLING);
+    culling.numShapes[0] = cubes;
+    for (int i = 0; i < 6; i++)
+        culling.planes[i] = frame.frustum[i];
+
+    writeObjectConstants(commands, frame);
+}
+
+// Takes every constant write from the ring the way D3D11Backend does
+class RingBackend : public CommandBackend {
+public:
+    RingBackend() : ring(1 << 20) {};
+
+    void execute(const CommandList&, const Command& command) override {
+        if (command.type != COMMAND_WRITE_CONSTANTS)
+            return;
+        uint32_t offset;
+        CHECK(ring.allocate(command.count, offset));
+        writes++;
+        payloadBytes += command.count;
+    }
+
+    void beginFrame(uint64_t frame) {
+        ring.beginFrame(frame);
+        writes = 0;
+        payloadBytes = 0;
+    }
+
+    void endFrame(uint64_t frame) {
+        ringBytes = ring.getFrameBytes();
+        ring.endFrame();
+        ring.completeFrame(frame);
+    }
+
+    size_t writes = 0;
+    size_t payloadBytes = 0;
+    uint64_t ringBytes = 0;
+
+private:
+    UploadRing ring;
+};
+
+static Frame randomFrame(Random& random) {
+    Frame frame = {};
+    auto fill = [&](Matrix& matrix) {
+        for (float& value : matrix.m)
+            value = random.range(-1.0f, 1.0f);
+    };
+    fill(frame.view);
+    fill(frame.projection);
+    fill(frame.skyboxWorld);
+    for (Matrix& world : frame.planeWorld)
+        fill(world);
+    frame.cameraPos = { random.range(-10.0f, 10.0f), random.range(-10.0f, 10.0f), random.range(-10.0f, 10.0f), 1.0f };
+    for (Float4& plane : frame.frustum)
+        plane = { random.next(), random.next(), random.next(), random.next() };
+    frame.lightCount = MAX_LIGHTS;
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        fill(frame.lightWorld[i]);
+        frame.lightPos[i] = { random.range(-5.0f, 5.0f), random.range(-5.0f, 5.0f), random.range(-5.0f, 5.0f), 1.0f };
+        frame.lightColor[i] = { random.next(), random.next(), random.next(), 1.0f };
+    }
+    return frame;
+}
+
+struct Measured {
+    size_t writes;
+    size_t payloadBytes;
+    uint64_t ringBytes;
+    double nanoseconds; // record and replay of one frame
+};
+
+static Measured measure(void (*record)(CommandList&, const Frame&, int), const std::vector<Frame>& frames, int runs) {
+    Measured measured = {};
+    measured.nanoseconds = 1e30;
+    CommandList commands;
+    RingBackend backend;
+    uint64_t frameIndex = 0;
+    for (int run = 0; run < runs; run++) {
+        Stopwatch stopwatch;
+        for (const Frame& frame : frames) {
+            commands.clear();
+            record(commands, frame, 10000);
+            backend.beginFrame(++frameIndex);
+            commands.replay(backend);
+            backend.endFrame(frameIndex);
+        }
+        measured.nanoseconds = (std::min)(measured.nanoseconds, stopwatch.getMilliseconds() * 1e6 / frames.size());
+    }
+    measured.writes = backend.writes;
+    measured.payloadBytes = backend.payloadBytes;
+    measured.ringBytes = backend.ringBytes;
+    return measured;
+}
+
+int main(int argc, char** argv) {
+    const bool full = isFullRun(argc, argv);
+    Random random(18);
+    std::vector<Frame> frames(full ? 200000 : 20000);
+    for (Frame& frame : frames)
+        frame = randomFrame(random);
+
+    // The shared block carries everything the per-object copies did
+    {
+        CommandList before, after;
+        recordBefore(before, frames[0], 7);
+        recordAfter(after, frames[0], 7);
+        const SceneCB* scene = nullptr;
+        const CubeSceneMatrixBuffer* cubeScene = nullptr;
+        const LightableCB* cubeLight = nullptr;
+        const CullingParams* culling = nullptr;
+        for (const Command& command : after.getCommands()) {
+            if (command.type == COMMAND_WRITE_CONSTANTS && command.args[0] == BLOCK_SCENE)
+                scene = static_cast<const SceneCB*>(after.getPayload(command.first));
+            if (command.type == COMMAND_WRITE_CONSTANTS && command.args[0] == BLOCK_CULLING)
+                culling = static_cast<const CullingParams*>(after.getPayload(command.first));
+        }
+        for (const Command& command : before.getCommands()) {
+            if (command.type == COMMAND_WRITE_CONSTANTS && command.args[0] == BLOCK_CUBE_SCENE)
+                cubeScene = static_cast<const CubeSceneMatrixBuffer*>(before.getPayload(command.first));
+            if (command.type == COMMAND_WRITE_CONSTANTS && command.args[0] == BLOCK_CUBE_LIGHT)
+                cubeLight = static_cast<const LightableCB*>(before.getPayload(command.first));
+        }
+        CHECK(scene && culling && cubeScene && cubeLight);
+        CHECK(memcmp(&scene->viewProjectionMatrix, &cubeScene->viewProjectionMatrix, sizeof(Matrix)) == 0);
+        CHECK(memcmp(culling->planes, cubeScene->planes, sizeof(culling->planes)) == 0);
+        CHECK(memcmp(&scene->cameraPos, cubeLight, sizeof(LightableCB)) == 0);
+    }
+
+    const int runs = full ? 5 : 2;
+    Measured before = measure(recordBefore, frames, runs);
+    Measured after = measure(recordAfter, frames, runs);
+    CHECK(before.writes == 13 && after.writes == 8);
+    CHECK(after.payloadBytes < before.payloadBytes);
+    CHECK(after.ringBytes < before.ringBytes);
+
+    std::printf("before: %zu writes, %zu payload bytes, %llu ring bytes, %.0f ns per frame\n", before.writes,
+        before.payloadBytes, (unsigned long long)before.ringBytes, before.nanoseconds);
+    std::printf("after:  %zu writes, %zu payload bytes, %llu ring bytes, %.0f ns per frame\n", after.writes,
+        after.payloadBytes, (unsigned long long)after.ringBytes, after.nanoseconds);
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "shadowCasterCuller.h"
+#include "testing.h"
+
+// A camera at `eye` looking down +z with a 90 degree fov, near 0.1 and far 150
+static void makePlanes(const float eye[3], float planes[6][4]) {
+    const float normals[6][3] = { { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }, { 0.7071f, 0.0f, 0.7071f },
+        { -0.7071f, 0.0f, 0.7071f }, { 0.0f, -0.7071f, 0.7071f }, { 0.0f, 0.7071f, 0.7071f } };
+    for (int p = 0; p < 6; p++) {
+        for (int k = 0; k < 3; k++)
+            planes[p][k] = normals[p][k];
+        planes[p][3] = -(normals[p][0] * eye[0] + normals[p][1] * eye[1] + normals[p][2] * eye[2]);
+    }
+    planes[0][3] -= 0.1f;
+    planes[1][3] += 150.0f;
+}
+
+// Faces that see the box centered `d` from the light, each face tested on its own: inside the
+// sphere and on the inner side of the four planes n +- t through the light
+static uint32_t getFaceBits(const float d[3], const float e[3], float radius) {
+    float distance2 = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        float a = (std::max)(fabsf(d[k]) - e[k], 0.0f);
+        distance2 += a * a;
+    }
+    if (!(distance2 <= radius * radius))
+        return 0;
+    uint32_t bits = 0;
+    for (uint32_t face = 0; face < ShadowCasterCuller::FACES; face++) {
+        int axis = face / 2;
+        float sign = (face & 1) ? -1.0f : 1.0f;
+        bool inside = true;
+        for (int t = 0; t < 3; t++) {
+            if (t != axis) {
+                inside = inside && sign * d[axis] + d[t] + e[axis] + e[t] >= 0.0f;
+                inside = inside && sign * d[axis] - d[t] + e[axis] + e[t] >= 0.0f;
+            }
+        }
+        bits |= uint32_t(inside) << face;
+    }
+    return bits;
+}
+
+// Faces whose pyramid reaches the frustum: the apex or a corner of the far square is inside
+// every plane's half space
+static uint32_t getFaceMask(const float* sphere, const float planes[6][4]) {
+    uint32_t mask = 0x3F;
+    for (int p = 0; p < 6; p++) {
+        float apex = planes[p][0] * sphere[0] + planes[p][1] * sphere[1] + planes[p][2] * sphere[2] + planes[p][3];
+        for (uint32_t face = 0; face < ShadowCasterCuller::FACES; face++) {
+            int axis = face / 2;
+            float best = apex;
+            for (int u = -1; u <= 1; u += 2) {
+                for (int v = -1; v <= 1; v += 2) {
+                    const float tangent[2] = { float(u), float(v) };
+                    float point[3];
+                    for (int k = 0, t = 0; k < 3; k++)
+                        point[k] = sphere[k] + sphere[3] * (k == axis ? ((face & 1) ? -1.0f : 1.0f) : tangent[t++]);
+                    best = (std::max)(best, planes[p][0] * point[0] + planes[p][1] * point[1] + planes[p][2] * point[2] + planes[p][3]);
+                }
+            }
+            if (best < 0.0f)
+                mask &= ~(1u << face);
+        }
+    }
+    return mask;
+}
+
+int main(int argc, char** argv) {
+    // The face bits cover every point of the box: a point is seen by the face of its major axis
+    Random random(23);
+    for (int i = 0; i < 200000; i++) {
+        float d[3], e[3], p[3];
+        for (int k = 0; k < 3; k++) {
+            d[k] = random.range(-4.0f, 4.0f);
+            e[k] = random.next();
+        }
+        uint32_t bits = getFaceBits(d, e, 100.0f);
+        for (int k = 0; k < 3; k++)
+            p[k] = d[k] + random.range(-1.0f, 1.0f) * e[k];
+        int axis = 0;
+        for (int k = 1; k < 3; k++) {
+            if (fabsf(p[k]) > fabsf(p[axis]))
+                axis = k;
+        }
+        CHECK(bits & (1u << (axis * 2 + (p[axis] < 0.0f))));
+    }
+
+    // Cubes and lights in a 100^3 box, a camera at its edge
+    const bool full = isFullRun(argc, argv);
+    const size_t lightsCount = full ? 1000 : 200, count = full ? 100000 : 20000;
+    const float width = 100.0f;
+    InstanceBounds bounds;
+    bounds.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        float center[3], e = random.range(0.5f, 0.87f);
+        for (float& c : center)
+            c = random.range(-width / 2, width / 2);
+        float low[3] = { center[0] - e, center[1] - e, center[2] - e }, high[3] = { center[0] + e, center[1] + e, center[2] + e };
+        // Some long ones, which span several grid cells
+        if (i % 1001 == 0) {
+            low[0] -= 12.0f;
+            high[0] += 12.0f;
+        }
+        bounds.setBox(i, low, high);
+        if (i % 97 == 0)
+            bounds.hide(i);
+    }
+    std::vector<float> spheres(lightsCount * 4);
+    for (size_t l = 0; l < lightsCount; l++) {
+        for (int k = 0; k < 3; k++)
+            spheres[l * 4 + k] = random.range(-width / 2, width / 2);
+        spheres[l * 4 + 3] = random.range(3.0f, 10.0f);
+    }
+    const float eye[3] = { 0.0f, 0.0f, -width * 0.6f };
+    float planes[6][4];
+    makePlanes(eye, planes);
+
+    ShadowCasterCuller culler;
+    culler.cull(bounds, spheres.data(), 4 * sizeof(float), lightsCount, planes);
+    const std::vector<uint32_t> activeLights = culler.getActiveLights();
+    const std::vector<CasterRange> ranges = culler.getRanges();
+    const std::vector<uint32_t> casters = culler.getCasters();
+    CHECK(ranges.size() == activeLights.size() * ShadowCasterCuller::FACES);
+
+    // Skipped lights are outside a plane of the frustum
+    for (size_t l = 0, a = 0; l < lightsCount; l++) {
+        if (a < activeLights.size() && activeLights[a] == l) {
+            a++;
+            continue;
+        }
+        const float* s = &spheres[l * 4];
+        bool outside = false;
+        for (int p = 0; p < 6; p++)
+            outside = outside || planes[p][0] * s[0] + planes[p][1] * s[1] + planes[p][2] * s[2] + planes[p][3] < -s[3];
+        CHECK(outside);
+    }
+
+    // Every list against every box tested on its own for that face
+    Stopwatch stopwatch;
+    size_t expectedCasters = 0, faces = 0;
+    std::vector<uint32_t> expected, listed;
+    for (size_t a = 0; a < activeLights.size(); a++) {
+        const float* s = &spheres[activeLights[a] * 4];
+        uint32_t mask = getFaceMask(s, planes);
+        for (uint32_t face = 0; face < ShadowCasterCuller::FACES; face++) {
+            expected.clear();
+            if (mask & (1u << face)) {
+                faces++;
+                for (size_t i = 0; i < count; i++) {
+                    if (bounds.radius[i] < 0.0f)
+                        continue;
+                    float d[3] = { bounds.centerX[i] - s[0], bounds.centerY[i] - s[1], bounds.centerZ[i] - s[2] };
+                    float e[3] = { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] };
+                    if (getFaceBits(d, e, s[3]) & (1u << face))
+                        expected.push_back(uint32_t(i));
+                }
+            }
+            const CasterRange& range = ranges[a * ShadowCasterCuller::FACES + face];
+            listed.assign(casters.begin() + range.offset, casters.begin() + range.offset + range.count);
+            std::sort(listed.begin(), listed.end());
+            CHECK(listed == expected);
+            expectedCasters += expected.size();
+        }
+    }
+    double bruteMilliseconds = stopwatch.getMilliseconds();
+    const ShadowCasterStats& stats = culler.getStats();
+    CHECK(stats.casters == expectedCasters && stats.activeFaces == faces && stats.activeLights == activeLights.size());
+
+    // The same lists in the same order on every run
+    double milliseconds = 1e9;
+    for (int run = 0; run < 10; run++) {
+        stopwatch.restart();
+        culler.cull(bounds, spheres.data(), 4 * sizeof(float), lightsCount, planes);
+        milliseconds = (std::min)(milliseconds, stopwatch.getMilliseconds());
+        CHECK(culler.getCasters() == casters);
+    }
+
+    std::printf("%zu lights, %zu cubes: %zu active with %zu faces, %zu pairs, %zu casters; cull %.2f ms, every box "
+        "against every face %.0f ms\n", lightsCount, count, stats.activeLights, stats.activeFaces, stats.candidates,
+        stats.casters, milliseconds, bruteMilliseconds);
+    return 0;
+}
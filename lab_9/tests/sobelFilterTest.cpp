@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "sobelFilter.h"
+#include "testing.h"
+
+// PostprocessingPixelShader as it was: 18 fetches with clamped addressing
+static void reference(const std::vector<float>& source, int width, int height, std::vector<float>& target) {
+    const float kernelX[3][3] = { { -1, 0, 1 }, { -2, 0, 2 }, { -1, 0, 1 } };
+    const float kernelY[3][3] = { { 1, 2, 1 }, { 0, 0, 0 }, { -1, -2, -1 } };
+    target.assign(size_t(width) * height * 4, 0.0f);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float gx[3] = {}, gy[3] = {};
+            for (int i = -1; i <= 1; i++) {
+                for (int j = -1; j <= 1; j++) {
+                    int sx = (std::min)((std::max)(x + i, 0), width - 1), sy = (std::min)((std::max)(y + j, 0), height - 1);
+                    for (int c = 0; c < 3; c++) {
+                        gx[c] += source[(size_t(sy) * width + sx) * 4 + c] * kernelX[i + 1][j + 1];
+                        gy[c] += source[(size_t(sy) * width + sx) * 4 + c] * kernelY[i + 1][j + 1];
+                    }
+                }
+            }
+            float* out = &target[(size_t(y) * width + x) * 4];
+            for (int c = 0; c < 3; c++)
+                out[c] = sqrtf(gx[c] * gx[c] + gy[c] * gy[c]);
+            out[3] = 1.0f;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    Random random(24);
+    SobelFilter filter;
+    // Random sizes and tiles, every format pair, pitches with padding the filter must not touch
+    for (int run = 0; run < 60; run++) {
+        int width = run == 0 ? 1 : 1 + int(random.below(300)), height = run == 0 ? 1 : 1 + int(random.below(200));
+        filter.setTileSize(1 + random.below(128), 1 + random.below(64));
+        std::vector<uint8_t> bytes(size_t(width) * height * 4);
+        for (size_t i = 0; i < bytes.size(); i++)
+            bytes[i] = uint8_t(run % 3 == 0 ? ((i / 4 / 7) % 2 ? 255 : 0) : random.nextInt());
+        std::vector<float> floats(bytes.size());
+        for (size_t i = 0; i < bytes.size(); i++)
+            floats[i] = bytes[i] / 255.0f;
+        std::vector<float> expected;
+        reference(floats, width, height, expected);
+
+        for (int sourceFloat = 0; sourceFloat < 2; sourceFloat++) {
+            for (int targetFloat = 0; targetFloat < 2; targetFloat++) {
+                size_t sourcePitch = sourceFloat ? width * 16 + 32 : width * 4 + 12;
+                size_t targetPitch = targetFloat ? width * 16 + 16 : width * 4 + 4;
+                size_t rowBytes = targetFloat ? width * 16 : width * 4;
+                std::vector<uint8_t> source(sourcePitch * height), target(targetPitch * height, 0xCD);
+                for (int y = 0; y < height; y++) {
+                    if (sourceFloat)
+                        memcpy(&source[sourcePitch * y], &floats[size_t(y) * width * 4], width * 16);
+                    else
+                        memcpy(&source[sourcePitch * y], &bytes[size_t(y) * width * 4], width * 4);
+                }
+                ImageView sourceView = { source.data(), sourcePitch, uint32_t(width), uint32_t(height), sourceFloat ? IMAGE_RGBA32F : IMAGE_RGBA8 };
+                ImageView targetView = { target.data(), targetPitch, uint32_t(width), uint32_t(height), targetFloat ? IMAGE_RGBA32F : IMAGE_RGBA8 };
+                filter.apply(sourceView, targetView);
+                CHECK(filter.getStats().pixels == size_t(width) * height);
+
+                for (int y = 0; y < height; y++) {
+                    const uint8_t* row = &target[targetPitch * y];
+                    for (int i = 0; i < width * 4; i++) {
+                        float value = expected[size_t(y) * width * 4 + i];
+                        if (targetFloat) {
+                            float stored;
+                            memcpy(&stored, row + i * 4, 4);
+                            CHECK(fabsf(stored - value) <= 1e-5f);
+                        } else {
+                            // Within one step of the shader output stored to unorm
+                            int rounded = int(lrintf((std::min)(value, 1.0f) * 255.0f));
+                            CHECK(abs(int(row[i]) - rounded) <= 1);
+                        }
+                    }
+                    for (size_t p = rowBytes; p < targetPitch; p++)
+                        CHECK(row[p] == 0xCD);
+                }
+            }
+        }
+    }
+
+    const int width = isFullRun(argc, argv) ? 3840 : 1920, height = isFullRun(argc, argv) ? 2160 : 1080;
+    std::vector<uint8_t> bytes(size_t(width) * height * 4), target(bytes.size());
+    for (uint8_t& b : bytes)
+        b = uint8_t(random.nextInt());
+    std::vector<float> floats(bytes.size()), targetFloats(bytes.size());
+    for (size_t i = 0; i < bytes.size(); i++)
+        floats[i] = bytes[i] / 255.0f;
+    const ImageView bytesView = { bytes.data(), size_t(width) * 4, uint32_t(width), uint32_t(height), IMAGE_RGBA8 };
+    const ImageView floatsView = { floats.data(), size_t(width) * 16, uint32_t(width), uint32_t(height), IMAGE_RGBA32F };
+    const ImageView targetView = { target.data(), size_t(width) * 4, uint32_t(width), uint32_t(height), IMAGE_RGBA8 };
+    const ImageView targetFloatsView = { targetFloats.data(), size_t(width) * 16, uint32_t(width), uint32_t(height), IMAGE_RGBA32F };
+    filter.setTileSize(256, 64);
+    double rates[3] = {};
+    const ImageView* views[3][2] = { { &bytesView, &targetView }, { &floatsView, &targetView }, { &floatsView, &targetFloatsView } };
+    for (int format = 0; format < 3; format++) {
+        for (int run = 0; run < 10; run++) {
+            filter.apply(*views[format][0], *views[format][1]);
+            rates[format] = (std::max)(rates[format], filter.getStats().getMegapixelsPerSecond());
+        }
+    }
+    std::vector<float> expected;
+    Stopwatch stopwatch;
+    reference(floats, width, height, expected);
+    double referenceRate = double(width) * height / (stopwatch.getMilliseconds() * 1000.0);
+
+    std::printf("%dx%d: rgba8 -> rgba8 %.0f MP/s, f32 -> rgba8 %.0f MP/s, f32 -> f32 %.0f MP/s; 18-fetch reference %.0f MP/s\n",
+        width, height, rates[0], rates[1], rates[2], referenceRate);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "spatialGrid.h"
+#include "testing.h"
+
+static std::vector<int> sorted(std::vector<int> v) {
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+int main(int argc, char** argv) {
+    const int count = isFullRun(argc, argv) ? 1000000 : 100000;
+    // The density of the cubes of the scene, flattened like a level
+    const float size = 8.0f * sqrtf(count / 6.0f);
+    Random random(5);
+    SpatialGrid grid(4.0f);
+    std::vector<float> centers(3 * count), radii(count);
+    std::vector<int> handles(count);
+    for (int i = 0; i < count; i++) {
+        centers[3 * i] = random.range(-0.5f, 0.5f) * size;
+        centers[3 * i + 1] = random.range(-0.5f, 0.5f) * size * 0.05f;
+        centers[3 * i + 2] = random.range(-0.5f, 0.5f) * size;
+        radii[i] = random.range(0.5f, 1.5f);
+    }
+
+    Stopwatch stopwatch;
+    for (int i = 0; i < count; i++)
+        handles[i] = grid.insert(i, &centers[3 * i], radii[i]);
+    double insertMilliseconds = stopwatch.getMilliseconds();
+    CHECK(grid.size() == size_t(count));
+
+    for (int i = 0; i < count; i++) {
+        centers[3 * i] += sinf(float(i)) * 1.5f;
+        centers[3 * i + 2] += cosf(float(i)) * 1.5f;
+    }
+    stopwatch.restart();
+    for (int i = 0; i < count; i++)
+        grid.move(handles[i], &centers[3 * i], radii[i]);
+    double moveMilliseconds = stopwatch.getMilliseconds();
+
+    int removedHandle = handles[0];
+    for (int i = 0; i < count; i += 10) {
+        grid.remove(handles[i]);
+        handles[i] = -1;
+    }
+    CHECK(grid.size() == size_t(count - (count + 9) / 10));
+
+    // Stale handles leave the grid as it is
+    grid.move(-1, &centers[0], radii[0]);
+    grid.move(removedHandle, &centers[0], radii[0]);
+    grid.remove(removedHandle);
+    CHECK(grid.size() == size_t(count - (count + 9) / 10));
+
+    // Every query against a scan of all the spheres
+    const int queries = 50;
+    double sphereMilliseconds = 0.0, boxMilliseconds = 0.0, frustumMilliseconds = 0.0;
+    std::vector<int> ids, expected;
+    for (int q = 0; q < queries; q++) {
+        float p[3] = { random.range(-0.5f, 0.5f) * size, 0.0f, random.range(-0.5f, 0.5f) * size };
+        float radius = random.range(2.0f, 12.0f);
+        stopwatch.restart();
+        grid.querySphere(p, radius, ids);
+        sphereMilliseconds += stopwatch.getMilliseconds();
+        expected.clear();
+        for (int i = 0; i < count; i++) {
+            float dx = centers[3 * i] - p[0], dy = centers[3 * i + 1] - p[1], dz = centers[3 * i + 2] - p[2];
+            if (handles[i] >= 0 && dx * dx + dy * dy + dz * dz <= (radius + radii[i]) * (radius + radii[i]))
+                expected.push_back(i);
+        }
+        CHECK(sorted(ids) == expected);
+
+        float bbMin[3] = { p[0] - radius, -1.0f, p[2] - radius }, bbMax[3] = { p[0] + radius * 0.5f, 1.0f, p[2] + radius };
+        stopwatch.restart();
+        grid.queryBox(bbMin, bbMax, ids);
+        boxMilliseconds += stopwatch.getMilliseconds();
+        expected.clear();
+        for (int i = 0; i < count; i++) {
+            float distance = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                float outside = (std::max)((std::max)(bbMin[k] - centers[3 * i + k], centers[3 * i + k] - bbMax[k]), 0.0f);
+                distance += outside * outside;
+            }
+            if (handles[i] >= 0 && distance <= radii[i] * radii[i])
+                expected.push_back(i);
+        }
+        CHECK(sorted(ids) == expected);
+
+        // A view from p along a random yaw, 60 units deep
+        float planes[6][4];
+        float yaw = random.range(0.0f, 6.2832f), fx = sinf(yaw), fz = cosf(yaw), h = tanf(0.6f), rx = fz, rz = -fx;
+        auto set = [&](int i, float nx, float ny, float nz, float px, float py, float pz) {
+            float length = sqrtf(nx * nx + ny * ny + nz * nz);
+            planes[i][0] = nx / length;
+            planes[i][1] = ny / length;
+            planes[i][2] = nz / length;
+            planes[i][3] = -(planes[i][0] * px + planes[i][1] * py + planes[i][2] * pz);
+        };
+        set(0, fx, 0.0f, fz, p[0], 0.0f, p[2]);
+        set(1, -fx, 0.0f, -fz, p[0] + fx * 60.0f, 0.0f, p[2] + fz * 60.0f);
+        set(2, fx * h + rx, 0.0f, fz * h + rz, p[0], 0.0f, p[2]);
+        set(3, fx * h - rx, 0.0f, fz * h - rz, p[0], 0.0f, p[2]);
+        set(4, fx * h, 1.0f, fz * h, p[0], 0.0f, p[2]);
+        set(5, fx * h, -1.0f, fz * h, p[0], 0.0f, p[2]);
+        stopwatch.restart();
+        grid.queryFrustum(planes, ids);
+        frustumMilliseconds += stopwatch.getMilliseconds();
+
+        // Never more than the spheres in front of every plane, and never fewer than those
+        // completely inside.
+        std::vector<char> found(count);
+        for (int id : ids)
+            found[id] = 1;
+        for (int i = 0; i < count; i++) {
+            if (handles[i] < 0) {
+                CHECK(!found[i]);
+                continue;
+            }
+            bool touches = true, inside = true;
+            for (int k = 0; k < 6; k++) {
+                float distance = planes[k][0] * centers[3 * i] + planes[k][1] * centers[3 * i + 1] + planes[k][2] * centers[3 * i + 2] + planes[k][3];
+                touches = touches && distance >= -radii[i];
+                inside = inside && distance >= radii[i];
+            }
+            CHECK(!found[i] || touches);
+            CHECK(found[i] || !inside);
+        }
+    }
+
+    std::printf("%d spheres, %zu cells: insert %.1f M/s, move %.1f M/s; per query: sphere %.3f ms, box %.3f ms, frustum %.3f ms\n",
+        count, grid.getCellsCount(), count / insertMilliseconds * 1e-3, count / moveMilliseconds * 1e-3,
+        sphereMilliseconds / queries, boxMilliseconds / queries, frustumMilliseconds / queries);
+    return 0;
+}
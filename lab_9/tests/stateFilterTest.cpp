@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "stateFilter.h"
+#include "testing.h"
+
+// Bound state of a D3D11 context, applied the way the runtime applies each call. A draw
+// records a hash of everything bound, so two replays agree if every draw saw the same state.
+class DeviceModel : public CommandBackend {
+public:
+    void execute(const CommandList& list, const Command& command) override {
+        const GpuHandle* handles = list.getHandles(command);
+        Stage& stage = state.stages[command.stage];
+        switch (command.type) {
+        case COMMAND_SET_SHADER: stage.shader = value(command.object); break;
+        case COMMAND_SET_CONSTANT_BUFFERS: bind(stage.constantBuffers, command, handles); break;
+        case COMMAND_SET_CONSTANT_BLOCKS: {
+            const uint32_t* blocks = static_cast<const uint32_t*>(list.getPayload(command.first));
+            // The copy bound is the last one written
+            for (uint32_t i = 0; i < command.count; i++)
+                stage.constantBuffers[command.slot + i] = (uint64_t(1) << 63) | (uint64_t(versions[blocks[i]]) << 16) | blocks[i];
+            break;
+        }
+        case COMMAND_SET_SHADER_RESOURCES: bind(stage.shaderResources, command, handles); break;
+        case COMMAND_SET_SAMPLERS: bind(stage.samplers, command, handles); break;
+        case COMMAND_SET_UNORDERED_ACCESS_VIEWS: bind(state.unorderedAccessViews, command, handles); break;
+        case COMMAND_SET_INPUT_LAYOUT: state.inputLayout = value(command.object); break;
+        case COMMAND_SET_PRIMITIVE_TOPOLOGY: state.topology = command.args[0]; break;
+        case COMMAND_SET_VERTEX_BUFFERS: {
+            const uint32_t* strides = static_cast<const uint32_t*>(list.getPayload(command.args[0]));
+            const uint32_t* offsets = static_cast<const uint32_t*>(list.getPayload(command.args[1]));
+            for (uint32_t i = 0; i < command.count; i++) {
+                uint64_t* slot = state.vertexBuffers[command.slot + i];
+                slot[0] = value(handles[i]);
+                slot[1] = strides[i];
+                slot[2] = offsets[i];
+            }
+            break;
+        }
+        case COMMAND_SET_INDEX_BUFFER:
+            state.indexBuffer[0] = value(command.object);
+            state.indexBuffer[1] = command.args[0];
+            state.indexBuffer[2] = command.args[1];
+            break;
+        case COMMAND_SET_RASTERIZER_STATE: state.rasterizerState = value(command.object); break;
+        case COMMAND_SET_DEPTH_STENCIL_STATE:
+            state.depthStencilState[0] = value(command.object);
+            state.depthStencilState[1] = command.args[0];
+            break;
+        case COMMAND_SET_BLEND_STATE:
+            state.blendState[0] = value(command.object);
+            state.blendState[1] = command.args[0];
+            break;
+        case COMMAND_SET_RENDER_TARGETS:
+            // Slots past the count are unbound
+            for (uint32_t i = 0; i < 8; i++)
+                state.renderTargets[i] = i < command.count ? value(handles[i]) : 0;
+            state.renderTargets[8] = value(command.object);
+            break;
+        case COMMAND_SET_VIEWPORT: memcpy(state.viewport, list.getPayload(command.first), sizeof(state.viewport)); break;
+        case COMMAND_WRITE_CONSTANTS: versions[command.args[0]]++; break;
+        case COMMAND_DRAW:
+        case COMMAND_DRAW_INDEXED:
+        case COMMAND_DRAW_INDEXED_INSTANCED:
+        case COMMAND_DISPATCH:
+            draws.push_back(hash());
+            break;
+        default: break;
+        }
+    }
+
+    std::vector<uint64_t> draws;
+
+private:
+    struct Stage {
+        uint64_t shader;
+        uint64_t constantBuffers[14];
+        uint64_t shaderResources[48];
+        uint64_t samplers[16];
+    };
+
+    // Only 64-bit fields, so there is no padding to hash
+    struct State {
+        Stage stages[SHADER_STAGE_COUNT];
+        uint64_t unorderedAccessViews[8];
+        uint64_t inputLayout;
+        uint64_t topology;
+        uint64_t vertexBuffers[32][3];
+        uint64_t indexBuffer[3];
+        uint64_t rasterizerState;
+        uint64_t depthStencilState[2];
+        uint64_t blendState[2];
+        uint64_t renderTargets[9];
+        float viewport[6];
+    };
+
+    static uint64_t value(GpuHandle handle) { return uint64_t(reinterpret_cast<uintptr_t>(handle)); };
+
+    static void bind(uint64_t* slots, const Command& command, const GpuHandle* handles) {
+        for (uint32_t i = 0; i < command.count; i++)
+            slots[command.slot + i] = value(handles[i]);
+    }
+
+    // FNV-1a over 64-bit words
+    uint64_t hash() const {
+        uint64_t words[sizeof(State) / sizeof(uint64_t)];
+        memcpy(words, &state, sizeof(words));
+        uint64_t result = 14695981039346656037ull;
+        for (uint64_t word : words)
+            result = (result ^ word) * 1099511628211ull;
+        return result;
+    }
+
+    State state = {};
+    uint32_t versions[16] = {};
+};
+
+// Keeps every array command and the handles it carries after replay
+class Recorder : public CommandBackend {
+public:
+    void execute(const CommandList& list, const Command& command) override {
+        commands.push_back(command);
+        const GpuHandle* first = list.getHandles(command);
+        bool array = command.type == COMMAND_SET_CONSTANT_BUFFERS || command.type == COMMAND_SET_VERTEX_BUFFERS ||
+            command.type == COMMAND_SET_RENDER_TARGETS;
+        handles.push_back(std::vector<GpuHandle>(first, first + (array ? command.count : 0)));
+    }
+
+    std::vector<Command> commands;
+    std::vector<std::vector<GpuHandle>> handles;
+};
+
+static GpuHandle handle(uint32_t index) {
+    return index ? reinterpret_cast<GpuHandle>(uintptr_t(index) * 16) : nullptr;
+}
+
+// Random binds from few objects, so most of them repeat what is bound
+static void recordFrame(CommandList& list, Random& random, size_t draws) {
+    for (size_t draw = 0; draw < draws; draw++) {
+        uint32_t binds = random.below(12);
+        for (uint32_t b = 0; b < binds; b++) {
+            ShaderStage stage = ShaderStage(random.below(SHADER_STAGE_COUNT));
+            GpuHandle objects[8];
+            uint32_t strides[8], offsets[8];
+            for (uint32_t i = 0; i < 8; i++) {
+                objects[i] = handle(random.below(4));
+                strides[i] = 4 * (1 + random.below(2));
+                offsets[i] = 16 * random.below(2);
+            }
+            uint32_t count = 1 + random.below(4);
+            switch (random.below(15)) {
+            case 0: list.setShader(stage, objects[0]); break;
+            case 1: list.setConstantBuffers(stage, random.below(14 - count), count, objects); break;
+            case 2: {
+                uint32_t blocks[4];
+                for (uint32_t i = 0; i < count; i++)
+                    blocks[i] = random.below(3);
+                list.setConstantBlocks(stage, random.below(14 - count), count, blocks);
+                break;
+            }
+            // Slots up to 40 also take the binds past the tracked 32
+            case 3: list.setShaderResources(stage, random.below(40), count, objects); break;
+            case 4: list.setSamplers(stage, random.below(16 - count), count, objects); break;
+            case 5: list.setUnorderedAccessViews(random.below(8 - count), count, objects); break;
+            case 6: list.setInputLayout(objects[0]); break;
+            case 7: list.setPrimitiveTopology(4 + random.below(2)); break;
+            case 8: list.setVertexBuffers(random.below(20), count, objects, strides, offsets); break;
+            case 9: list.setIndexBuffer(objects[0], 57 - random.below(2) * 15, offsets[0]); break;
+            case 10: list.setDepthStencilState(objects[0], random.below(2)); break;
+            case 11: list.setBlendState(objects[0], random.below(2) ? ~0u : 0xffu); break;
+            case 12: list.setRenderTargets(random.below(3), objects, objects[3]); break;
+            case 13: list.setViewport(0.0f, 0.0f, 800.0f, random.below(2) ? 600.0f : 300.0f, 0.0f, 1.0f); break;
+            default: {
+                float* constants = static_cast<float*>(list.writeConstants(random.below(3), 64));
+                constants[0] = 1.0f;
+                break;
+            }
+            }
+        }
+        list.drawIndexed(36, 0, 0);
+    }
+}
+
+int main(int argc, char** argv) {
+    // Two objects sharing most of their state
+    {
+        GpuHandle a = handle(1), b = handle(2), c = handle(3), d = handle(4);
+        CommandList list;
+        Recorder recorder;
+        StateFilter filter;
+        filter.setBackend(&recorder);
+        GpuHandle constants[2][2] = { { a, b }, { a, c } };
+        GpuHandle vertexBuffers[2] = { c, d };
+        uint32_t strides[2][2] = { { 12, 4 }, { 12, 8 } }, offsets[2] = { 0, 0 };
+        for (int object = 0; object < 2; object++) {
+            list.setShader(SHADER_STAGE_VERTEX, a);
+            list.setShader(SHADER_STAGE_PIXEL, a);
+            list.setConstantBuffers(SHADER_STAGE_VERTEX, 0, 2, constants[object]);
+            list.setVertexBuffers(0, 2, vertexBuffers, strides[object], offsets);
+            list.setPrimitiveTopology(4);
+            list.setIndexBuffer(b, 57, 0);
+            list.setDepthStencilState(nullptr, 0);
+            list.setViewport(0.0f, 0.0f, 800.0f, 600.0f, 0.0f, 1.0f);
+            list.drawIndexed(36, 0, 0);
+        }
+        // Only the depth view changes in the last one
+        list.setRenderTargets(1, &a, b);
+        list.setRenderTargets(1, &a, b);
+        list.setRenderTargets(1, &a, nullptr);
+        filter.reset();
+        list.replay(filter);
+        CHECK(filter.getStats().issued == 8 + 2 + 2 && filter.getStats().skipped == 6 + 1);
+
+        // The second object rebinds only constant buffer slot 1 and vertex buffer slot 1
+        int constantBinds = 0, vertexBinds = 0;
+        for (size_t i = 0; i < recorder.commands.size(); i++) {
+            const Command& command = recorder.commands[i];
+            if (command.type == COMMAND_SET_CONSTANT_BUFFERS && ++constantBinds == 2)
+                CHECK(command.slot == 1 && command.count == 1 && recorder.handles[i][0] == c);
+            if (command.type == COMMAND_SET_VERTEX_BUFFERS && ++vertexBinds == 2) {
+                CHECK(command.slot == 1 && command.count == 1 && recorder.handles[i][0] == d);
+                CHECK(*static_cast<const uint32_t*>(list.getPayload(command.args[0])) == 8);
+                CHECK(*static_cast<const uint32_t*>(list.getPayload(command.args[1])) == 0);
+            }
+        }
+        CHECK(constantBinds == 2 && vertexBinds == 2);
+
+        // After a reset everything goes through again
+        filter.reset();
+        list.replay(filter);
+        CHECK(filter.getStats().issued == 12);
+    }
+
+    // Random frames: every draw sees the same state with and without the filter
+    const size_t draws = isFullRun(argc, argv) ? 1000000 : 100000;
+    Random random(16);
+    CommandList list;
+    recordFrame(list, random, draws);
+    DeviceModel direct, filtered;
+    StateFilter filter;
+    filter.setBackend(&filtered);
+    filter.reset();
+    list.replay(filter);
+    // A second frame continues from the state the first one left
+    list.replay(filter);
+    list.replay(direct);
+    list.replay(direct);
+    CHECK(direct.draws.size() == 2 * draws && filtered.draws == direct.draws);
+
+    CountingBackend counter;
+    filter.setBackend(&counter);
+    filter.reset();
+    Stopwatch stopwatch;
+    list.replay(filter);
+    double filterMilliseconds = stopwatch.getMilliseconds();
+    const StateFilterStats& stats = filter.getStats();
+    std::printf("%zu draws, %zu commands: %zu binds issued, %zu skipped (%.1f%%), filter %.2f ms per frame\n", draws,
+        list.getCommands().size(), stats.issued, stats.skipped, 100.0 * stats.skipped / (stats.issued + stats.skipped),
+        filterMilliseconds);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Stops the test at the first failed check; the exit code fails it under ctest.
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			std::exit(1); \
+		} \
+	} while (0)
+
+// --full runs the problem sizes quoted in the history instead of the quick ctest ones.
+inline bool isFullRun(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--full") == 0)
+			return true;
+	}
+	return false;
+}
+
+class Stopwatch {
+public:
+	Stopwatch() : start(std::chrono::steady_clock::now()) {};
+	void restart() { start = std::chrono::steady_clock::now(); };
+	double getMilliseconds() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+// Xorshift; unlike rand() the same sequence on every platform, so failures reproduce.
+class Random {
+public:
+	explicit Random(uint32_t seed = 1) : state(seed ? seed : 1) {};
+
+	uint32_t nextInt() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	};
+	// In [0, 1)
+	float next() { return float(nextInt() >> 8) * (1.0f / 16777216.0f); };
+	float range(float low, float high) { return low + (high - low) * next(); };
+	uint32_t below(uint32_t count) { return nextInt() % count; };
+
+private:
+	uint32_t state;
+};
@@ -0,0 +1,139 @@
+#include <cstring>
+#include <vector>
+
+#include "testing.h"
+#include "uploadRing.h"
+
+struct Allocation {
+    uint64_t frame;
+    uint32_t offset;
+    uint32_t size;
+    uint8_t tag;
+};
+
+// Drops the allocations of the frames the GPU has finished
+static void retire(std::vector<Allocation>& live, uint64_t completed) {
+    size_t kept = 0;
+    for (const Allocation& allocation : live) {
+        if (allocation.frame > completed)
+            live[kept++] = allocation;
+    }
+    live.resize(kept);
+}
+
+int main(int argc, char** argv) {
+    uint32_t offset;
+    // Alignment, a full ring, fences and empty frames
+    {
+        UploadRing ring(1000, 256);
+        CHECK(ring.getCapacity() == 768);
+        ring.beginFrame(1);
+        CHECK(ring.allocate(1, offset) && offset == 0);
+        CHECK(ring.allocate(256, offset) && offset == 256);
+        CHECK(ring.allocate(200, offset) && offset == 512);
+        CHECK(!ring.allocate(1, offset));
+        CHECK(!ring.allocate(0, offset));
+        CHECK(!ring.allocate(769, offset));
+        CHECK(ring.getFrameBytes() == 768);
+        ring.endFrame();
+
+        // Frame 1 is still in flight
+        ring.beginFrame(2);
+        CHECK(!ring.allocate(1, offset));
+        ring.completeFrame(1);
+        CHECK(ring.allocate(512, offset) && offset == 0);
+        // 256 bytes left before the end, and the start is taken by this frame
+        CHECK(!ring.allocate(512, offset));
+        CHECK(ring.allocate(256, offset) && offset == 512);
+        ring.endFrame();
+
+        ring.beginFrame(3);
+        CHECK(!ring.allocate(1, offset));
+        ring.completeFrame(2);
+        CHECK(ring.allocate(700, offset) && offset == 0);
+        ring.endFrame();
+
+        // A frame that allocated nothing is not fenced
+        ring.beginFrame(4);
+        ring.endFrame();
+        CHECK(ring.getOldestPendingFrame() == 3);
+        ring.completeFrame(4);
+        CHECK(!ring.hasPendingFrames() && ring.getUsed() == 0);
+    }
+
+    // A wrap skips the bytes left before the end, and they count as used
+    {
+        UploadRing ring(1024, 256);
+        ring.beginFrame(1);
+        CHECK(ring.allocate(768, offset) && offset == 0);
+        ring.endFrame();
+        ring.beginFrame(2);
+        ring.completeFrame(1);
+        CHECK(ring.allocate(256, offset) && offset == 768);
+        CHECK(ring.allocate(512, offset) && offset == 0);
+        CHECK(ring.getUsed() == 768);
+        CHECK(!ring.allocate(512, offset));
+        CHECK(ring.allocate(256, offset) && offset == 512);
+        ring.endFrame();
+    }
+
+    // A fake GPU finishes each frame `latency` frames after it was submitted and reads all of
+    // its allocations. The CPU fills every allocation with a tag, so overwriting anything still
+    // in flight is caught by the read.
+    const int runs = isFullRun(argc, argv) ? 2000 : 200;
+    Random random(17);
+    size_t allocations = 0, waits = 0, full = 0;
+    Stopwatch stopwatch;
+    for (int run = 0; run < runs; run++) {
+        uint32_t capacity = (4 + random.below(64)) * 256;
+        UploadRing ring(capacity, 256);
+        std::vector<uint8_t> memory(capacity, 0);
+        std::vector<Allocation> live;
+        uint64_t latency = random.below(4);
+        for (uint64_t frame = 1; frame < 300; frame++) {
+            if (frame > latency + 1) {
+                ring.completeFrame(frame - latency - 1);
+                retire(live, frame - latency - 1);
+            }
+            for (const Allocation& allocation : live) {
+                for (uint32_t i = 0; i < allocation.size; i++)
+                    CHECK(memory[allocation.offset + i] == allocation.tag);
+            }
+
+            ring.beginFrame(frame);
+            uint32_t count = random.below(6);
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t size = 1 + random.below(capacity / 3);
+                bool fits = ring.allocate(size, offset);
+                // Wait for the oldest frame in flight, as the backend does
+                while (!fits && ring.hasPendingFrames()) {
+                    uint64_t oldest = ring.getOldestPendingFrame();
+                    ring.completeFrame(oldest);
+                    retire(live, oldest);
+                    fits = ring.allocate(size, offset);
+                    waits++;
+                }
+                // With nothing else in flight only this frame's own data, and the bytes a wrap
+                // skips, can be in the way
+                if (!fits) {
+                    uint32_t aligned = (size + 255) & ~255u;
+                    CHECK(ring.getUsed() == ring.getFrameBytes() && ring.getFrameBytes() + 2 * aligned > capacity);
+                    full++;
+                    continue;
+                }
+                CHECK(offset % 256 == 0 && offset + size <= capacity);
+                for (const Allocation& allocation : live)
+                    CHECK(offset + size <= allocation.offset || allocation.offset + allocation.size <= offset);
+                uint8_t tag = uint8_t(random.nextInt());
+                memset(&memory[offset], tag, size);
+                live.push_back({ frame, offset, size, tag });
+                allocations++;
+            }
+            ring.endFrame();
+        }
+    }
+
+    std::printf("%d runs, %zu allocations: %zu waits for the GPU, %zu too big for what the frame left, %.2f ms\n", runs,
+        allocations, waits, full, stopwatch.getMilliseconds());
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "testing.h"
+#include "vertexPacking.h"
+
+// atan2 of the cross and dot products keeps its precision for small angles, acos does not
+static double angleDegrees(const float* a, const float* b) {
+    double cx = double(a[1]) * b[2] - double(a[2]) * b[1];
+    double cy = double(a[2]) * b[0] - double(a[0]) * b[2];
+    double cz = double(a[0]) * b[1] - double(a[1]) * b[0];
+    double d = double(a[0]) * b[0] + double(a[1]) * b[1] + double(a[2]) * b[2];
+    return atan2(sqrt(cx * cx + cy * cy + cz * cz), d) * 180.0 / 3.14159265358979;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = isFullRun(argc, argv) ? (1 << 20) : (1 << 16);
+    Random random(7);
+    // TexVertex: position, uv, normal, tangent
+    std::vector<float> vertices(count * 11);
+    std::vector<int8_t> handedness(count);
+    for (size_t i = 0; i < count; i++) {
+        float* v = &vertices[i * 11];
+        v[0] = random.range(-50.0f, 50.0f);
+        v[1] = random.range(-5.0f, 5.0f);
+        v[2] = random.range(50.0f, 150.0f);
+        v[3] = random.range(-4.0f, 4.0f);
+        v[4] = random.range(-4.0f, 4.0f);
+        for (int k = 5; k < 11; k += 3) {
+            float a, b, c, length;
+            do {
+                a = random.range(-1.0f, 1.0f);
+                b = random.range(-1.0f, 1.0f);
+                c = random.range(-1.0f, 1.0f);
+                length = a * a + b * b + c * c;
+            } while (length < 1e-4f || length > 1.0f);
+            float s = 1.0f / sqrtf(length);
+            // The axes, where the octahedron folds, and zero vectors
+            if (i % 97 == 0) {
+                a = float(i % 3 == 0);
+                b = float(i % 3 == 1);
+                c = -float(i % 3 == 2);
+                s = 1.0f;
+            }
+            if (i % 1001 == 0)
+                a = b = c = 0.0f;
+            v[k] = a * s;
+            v[k + 1] = b * s;
+            v[k + 2] = c * s;
+        }
+        handedness[i] = random.below(2) ? 1 : -1;
+    }
+
+    VertexQuantization quantization = computeQuantization(vertices.data(), 11 * sizeof(float), count);
+    std::vector<PackedVertex> packed(count), single(count);
+    Stopwatch stopwatch;
+    packVertices(vertices.data(), 11 * sizeof(float), count, handedness.data(), quantization, packed.data());
+    double packMilliseconds = stopwatch.getMilliseconds();
+    for (size_t i = 0; i < count; i++)
+        packVertices(&vertices[i * 11], 11 * sizeof(float), 1, &handedness[i], quantization, &single[i]);
+    CHECK(memcmp(packed.data(), single.data(), count * sizeof(PackedVertex)) == 0);
+
+    double positionError[3] = {}, uvError = 0.0, normalError = 0.0, tangentError = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        float out[11], sign;
+        unpackVertex(packed[i], quantization, out, sign);
+        const float* v = &vertices[i * 11];
+        CHECK(sign == handedness[i]);
+        for (int k = 0; k < 3; k++)
+            positionError[k] = (std::max)(positionError[k], double(fabsf(out[k] - v[k])));
+        for (int k = 3; k < 5; k++)
+            uvError = (std::max)(uvError, double(fabsf(out[k] - v[k])) / (std::max)(fabsf(v[k]), 1.0f));
+        if (i % 1001 != 0) {
+            normalError = (std::max)(normalError, angleDegrees(&out[5], &v[5]));
+            tangentError = (std::max)(tangentError, angleDegrees(&out[8], &v[8]));
+        }
+    }
+    // Half a unorm16 step of the mesh extent, with float slack
+    for (int k = 0; k < 3; k++)
+        CHECK(positionError[k] <= quantization.scale[k] / 131070.0 * 1.01 + 1e-5);
+    CHECK(uvError <= 1.0 / 1024.0);
+    CHECK(normalError < 0.01 && tangentError < 0.01);
+
+    float sum = 0.0f;
+    stopwatch.restart();
+    for (size_t i = 0; i < count; i++) {
+        float out[11], sign;
+        unpackVertex(packed[i], quantization, out, sign);
+        sum += out[0] + out[7];
+    }
+    double unpackMilliseconds = stopwatch.getMilliseconds();
+
+    std::printf("position error %.2e %.2e %.2e, uv relative error %.2e, normal %.4f deg, tangent %.4f deg\n",
+        positionError[0], positionError[1], positionError[2], uvError, normalError, tangentError);
+    std::printf("%zu vertices, %zu bytes each instead of 44: pack %.1f ns/vertex, unpack %.1f ns/vertex (%g)\n",
+        count, sizeof(PackedVertex), packMilliseconds * 1e6 / count, unpackMilliseconds * 1e6 / count, sum);
+    return 0;
+}
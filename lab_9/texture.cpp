@@ -1,85 +1,131 @@
-#include "texture.h"
-
-using namespace DirectX;
-
-HRESULT Texture::init(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename) {
-    realize();
-    return CreateDDSTextureFromFile(device, filename, nullptr, &g_pTextureView);
-}
-
-HRESULT Texture::initEx(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename) {
-    realize();
-    return CreateDDSTextureFromFileEx(device, deviceContext, filename, 0, D3D11_USAGE_DEFAULT,
-        D3D11_BIND_SHADER_RESOURCE, 0, D3D11_RESOURCE_MISC_TEXTURECUBE, false, nullptr, &g_pTextureView);
-}
-
-HRESULT Texture::initArray(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::vector<const wchar_t*>& filenames) {
-    realize();
-
-    HRESULT hr = S_OK;
-    auto textureCount = (UINT)filenames.size();
-
-    std::vector<ID3D11Texture2D*> textures(textureCount);
-
-    for (UINT i = 0; i < textureCount; ++i)
-        hr = DirectX::CreateDDSTextureFromFile(device, filenames[i], (ID3D11Resource**)(&textures[i]), nullptr);
-    if (FAILED(hr))
-        return hr;
-
-    D3D11_TEXTURE2D_DESC textureDesc;
-    textures[0]->GetDesc(&textureDesc);
-
-    D3D11_TEXTURE2D_DESC arrayDesc;
-    arrayDesc.Width = textureDesc.Width;
-    arrayDesc.Height = textureDesc.Height;
-    arrayDesc.MipLevels = textureDesc.MipLevels;
-    arrayDesc.ArraySize = textureCount;
-    arrayDesc.Format = textureDesc.Format;
-    arrayDesc.SampleDesc.Count = 1;
-    arrayDesc.SampleDesc.Quality = 0;
-    arrayDesc.Usage = D3D11_USAGE_DEFAULT;
-    arrayDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    arrayDesc.CPUAccessFlags = 0;
-    arrayDesc.MiscFlags = 0;
-
-    ID3D11Texture2D* textureArray = nullptr;
-    hr = device->CreateTexture2D(&arrayDesc, 0, &textureArray);
-    if (FAILED(hr))
-        return hr;
-
-    for (UINT texElement = 0; texElement < textureCount; ++texElement)
-        for (UINT mipLevel = 0; mipLevel < textureDesc.MipLevels; ++mipLevel) {
-            const int sourceSubresource = D3D11CalcSubresource(mipLevel, 0, textureDesc.MipLevels);
-            const int destSubresource = D3D11CalcSubresource(mipLevel, texElement, textureDesc.MipLevels);
-            deviceContext->CopySubresourceRegion(textureArray, destSubresource, 0, 0, 0, textures[texElement], sourceSubresource, nullptr);
-        }
-
-    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
-    viewDesc.Format = arrayDesc.Format;
-    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
-    viewDesc.Texture2DArray.MostDetailedMip = 0;
-    viewDesc.Texture2DArray.MipLevels = arrayDesc.MipLevels;
-    viewDesc.Texture2DArray.FirstArraySlice = 0;
-    viewDesc.Texture2DArray.ArraySize = textureCount;
-
-    hr = device->CreateShaderResourceView(textureArray, &viewDesc, &g_pTextureView);
-    if (FAILED(hr))
-        return hr;
-
-    textureArray->Release();
-    for (UINT i = 0; i < textureCount; ++i)
-        textures[i]->Release();
-
-    return hr;
-}
-
-ID3D11ShaderResourceView* Texture::getTexture() {
-    return g_pTextureView;
-};
-
-void Texture::realize() {
-    if (g_pTextureView) {
-        g_pTextureView->Release();
-        g_pTextureView = nullptr;
-    }
+#include <algorithm>
+#include <DirectXPackedVector.h>
+
+#include "texture.h"
+
+using namespace DirectX;
+
+HRESULT Texture::init(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename) {
+    realize();
+    return CreateDDSTextureFromFile(device, filename, nullptr, &g_pTextureView);
+}
+
+HRESULT Texture::initEx(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const wchar_t* filename) {
+    realize();
+    return CreateDDSTextureFromFileEx(device, deviceContext, filename, 0, D3D11_USAGE_DEFAULT,
+        D3D11_BIND_SHADER_RESOURCE, 0, D3D11_RESOURCE_MISC_TEXTURECUBE, false, nullptr, &g_pTextureView);
+}
+
+HRESULT Texture::initArray(ID3D11Device* device, ID3D11DeviceContext* deviceContext, const std::vector<const wchar_t*>& filenames) {
+    realize();
+
+    HRESULT hr = S_OK;
+    auto textureCount = (UINT)filenames.size();
+
+    std::vector<ID3D11Texture2D*> textures(textureCount);
+
+    for (UINT i = 0; i < textureCount; ++i)
+        hr = DirectX::CreateDDSTextureFromFile(device, filenames[i], (ID3D11Resource**)(&textures[i]), nullptr);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_TEXTURE2D_DESC textureDesc;
+    textures[0]->GetDesc(&textureDesc);
+
+    D3D11_TEXTURE2D_DESC arrayDesc;
+    arrayDesc.Width = textureDesc.Width;
+    arrayDesc.Height = textureDesc.Height;
+    arrayDesc.MipLevels = textureDesc.MipLevels;
+    arrayDesc.ArraySize = textureCount;
+    arrayDesc.Format = textureDesc.Format;
+    arrayDesc.SampleDesc.Count = 1;
+    arrayDesc.SampleDesc.Quality = 0;
+    arrayDesc.Usage = D3D11_USAGE_DEFAULT;
+    arrayDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    arrayDesc.CPUAccessFlags = 0;
+    arrayDesc.MiscFlags = 0;
+
+    ID3D11Texture2D* textureArray = nullptr;
+    hr = device->CreateTexture2D(&arrayDesc, 0, &textureArray);
+    if (FAILED(hr))
+        return hr;
+
+    for (UINT texElement = 0; texElement < textureCount; ++texElement)
+        for (UINT mipLevel = 0; mipLevel < textureDesc.MipLevels; ++mipLevel) {
+            const int sourceSubresource = D3D11CalcSubresource(mipLevel, 0, textureDesc.MipLevels);
+            const int destSubresource = D3D11CalcSubresource(mipLevel, texElement, textureDesc.MipLevels);
+            deviceContext->CopySubresourceRegion(textureArray, destSubresource, 0, 0, 0, textures[texElement], sourceSubresource, nullptr);
+        }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+    viewDesc.Format = arrayDesc.Format;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+    viewDesc.Texture2DArray.MostDetailedMip = 0;
+    viewDesc.Texture2DArray.MipLevels = arrayDesc.MipLevels;
+    viewDesc.Texture2DArray.FirstArraySlice = 0;
+    viewDesc.Texture2DArray.ArraySize = textureCount;
+
+    hr = device->CreateShaderResourceView(textureArray, &viewDesc, &g_pTextureView);
+    if (FAILED(hr))
+        return hr;
+
+    textureArray->Release();
+    for (UINT i = 0; i < textureCount; ++i)
+        textures[i]->Release();
+
+    return hr;
+}
+
+HRESULT Texture::initCube(ID3D11Device* device, UINT size, UINT mipLevels, const std::vector<const float*>& levels) {
+    realize();
+
+    std::vector<std::vector<PackedVector::HALF>> halfs(levels.size());
+    std::vector<D3D11_SUBRESOURCE_DATA> data(levels.size());
+    for (size_t i = 0; i < levels.size(); i++) {
+        UINT levelSize = (std::max)(size >> (i % mipLevels), 1u);
+        halfs[i].resize(levelSize * levelSize * 4);
+        PackedVector::XMConvertFloatToHalfStream(halfs[i].data(), sizeof(PackedVector::HALF), levels[i], sizeof(float), halfs[i].size());
+        data[i].pSysMem = halfs[i].data();
+        data[i].SysMemPitch = levelSize * 4 * sizeof(PackedVector::HALF);
+        data[i].SysMemSlicePitch = 0;
+    }
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = size;
+    desc.Height = size;
+    desc.MipLevels = mipLevels;
+    desc.ArraySize = 6;
+    desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+    ID3D11Texture2D* texture = nullptr;
+    HRESULT hr = device->CreateTexture2D(&desc, data.data(), &texture);
+    if (FAILED(hr))
+        return hr;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+    viewDesc.Format = desc.Format;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+    viewDesc.TextureCube.MostDetailedMip = 0;
+    viewDesc.TextureCube.MipLevels = mipLevels;
+
+    hr = device->CreateShaderResourceView(texture, &viewDesc, &g_pTextureView);
+    texture->Release();
+    return hr;
+}
+
+ID3D11ShaderResourceView* Texture::getTexture() {
+    return g_pTextureView;
+};
+
+void Texture::realize() {
+    if (g_pTextureView) {
+        g_pTextureView->Release();
+        g_pTextureView = nullptr;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "uploadRing.h"
+
+void UploadRing::reset(uint32_t capacity, uint32_t alignment) {
+    this->alignment = alignment;
+    this->capacity = capacity & ~(alignment - 1);
+    head = 0;
+    tail = 0;
+    frameStart = 0;
+    frame = 0;
+    frameOpen = false;
+    pending.clear();
+}
+
+void UploadRing::beginFrame(uint64_t frame) {
+    this->frame = frame;
+    frameStart = head;
+    frameOpen = true;
+}
+
+void UploadRing::endFrame() {
+    if (!frameOpen)
+        return;
+    frameOpen = false;
+    // A frame that allocated nothing holds nothing back.
+    if (head != frameStart)
+        pending.push_back({ frame, head });
+}
+
+void UploadRing::completeFrame(uint64_t frame) {
+    while (!pending.empty() && pending.front().frame <= frame) {
+        tail = pending.front().end;
+        pending.pop_front();
+    }
+    // Nothing in flight: start over from where the open frame began.
+    if (pending.empty())
+        tail = frameOpen ? frameStart : head;
+}
+
+bool UploadRing::allocate(uint32_t size, uint32_t& offset) {
+    uint64_t aligned = (uint64_t(size) + alignment - 1) & ~uint64_t(alignment - 1);
+    if (aligned == 0 || aligned > capacity)
+        return false;
+
+    // head stays aligned because every size is.
+    uint64_t position = head;
+    if (position % capacity + aligned > capacity)
+        position += capacity - position % capacity;
+    if (position + aligned - tail > capacity)
+        return false;
+
+    head = position + aligned;
+    offset = uint32_t(position % capacity);
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Suballocates a ring of `capacity` bytes among the frames in flight. Allocations of the open
+// frame are appended after the previous ones and wrap to the start of the ring when they do not
+// fit before its end; the space of a closed frame comes back only once completeFrame() reports
+// the GPU is done with it, so nothing the GPU may still read is written again.
+// Positions are kept as ever growing byte counts; the offset in the ring is position % capacity.
+class UploadRing {
+public:
+	explicit UploadRing(uint32_t capacity = 0, uint32_t alignment = 256) { reset(capacity, alignment); };
+
+	// Forgets all frames. `capacity` is rounded down to a multiple of `alignment` (a power of two).
+	void reset(uint32_t capacity, uint32_t alignment);
+
+	// Allocations made until the next endFrame() belong to `frame`; frames are numbered upward.
+	void beginFrame(uint64_t frame);
+	void endFrame();
+	// The GPU has finished every frame up to `frame`.
+	void completeFrame(uint64_t frame);
+
+	// Aligned offset of `size` bytes in the ring; false if they do not fit next to the data
+	// still in flight. Sizes are rounded up to the alignment.
+	bool allocate(uint32_t size, uint32_t& offset);
+
+	bool hasPendingFrames() const { return !pending.empty(); };
+	uint64_t getOldestPendingFrame() const { return pending.empty() ? 0 : pending.front().frame; };
+
+	uint32_t getCapacity() const { return capacity; };
+	uint32_t getAlignment() const { return alignment; };
+	// Bytes in flight, including the ones skipped at a wrap.
+	uint64_t getUsed() const { return head - tail; };
+	// Bytes allocated since beginFrame(), alignment padding included.
+	uint64_t getFrameBytes() const { return head - frameStart; };
+
+private:
+	struct PendingFrame {
+		uint64_t frame;
+		uint64_t end;
+	};
+
+	uint32_t capacity;
+	uint32_t alignment;
+	uint64_t head;
+	uint64_t tail;
+	uint64_t frameStart;
+	uint64_t frame;
+	bool frameOpen;
+	std::deque<PendingFrame> pending;
+};
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "vertexPacking.h"
+#include "instancePacking.h"
+#include "simd.h"
+
+static const float SNORM_RANGE = 32767.0f;
+static const float UNORM_RANGE = 65535.0f;
+
+VertexQuantization computeQuantization(const float* vertices, size_t stride, size_t count) {
+    float bbMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float bbMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    const char* bytes = reinterpret_cast<const char*>(vertices);
+    for (size_t i = 0; i < count; i++) {
+        const float* position = reinterpret_cast<const float*>(bytes + i * stride);
+        for (int k = 0; k < 3; k++) {
+            bbMin[k] = (std::min)(bbMin[k], position[k]);
+            bbMax[k] = (std::max)(bbMax[k], position[k]);
+        }
+    }
+
+    VertexQuantization quantization;
+    for (int k = 0; k < 3; k++) {
+        quantization.offset[k] = count > 0 ? bbMin[k] : 0.0f;
+        quantization.scale[k] = count > 0 ? bbMax[k] - bbMin[k] : 0.0f;
+    }
+    return quantization;
+}
+
+static inline float unpackSnorm16(int16_t value) {
+    return (std::max)(float(value) / SNORM_RANGE, -1.0f);
+}
+
+// Same steps as OctDecode in CubeCB.hlsli, on values already converted from snorm.
+static inline void octDecode(float u, float v, float direction[3]) {
+    float z = 1.0f - fabsf(u) - fabsf(v);
+    float t = (std::max)(-z, 0.0f);
+    u += u >= 0.0f ? -t : t;
+    v += v >= 0.0f ? -t : t;
+    float invLength = 1.0f / sqrtf(u * u + v * v + z * z);
+    direction[0] = u * invLength;
+    direction[1] = v * invLength;
+    direction[2] = z * invLength;
+}
+
+void octDecode(const int16_t encoded[2], float direction[3]) {
+    octDecode(unpackSnorm16(encoded[0]), unpackSnorm16(encoded[1]), direction);
+}
+
+// The direction is projected on the octahedron |x| + |y| + |z| = 1, the lower half is
+// folded over the diagonals and the four roundings around the result are decoded to keep
+// the one with the smallest angular error.
+void octEncode(const float direction[3], int16_t encoded[2]) {
+    float x = direction[0], y = direction[1], z = direction[2];
+    float l1 = fabsf(x) + fabsf(y) + fabsf(z);
+    if (!(l1 > 0.0f)) {
+        encoded[0] = 0;
+        encoded[1] = 0;
+        return;
+    }
+
+    float u = x / l1, v = y / l1;
+    if (z < 0.0f) {
+        float foldedU = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float foldedV = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = foldedU;
+        v = foldedV;
+    }
+
+    float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+    x *= invLength;
+    y *= invLength;
+    z *= invLength;
+
+    float baseU = floorf(u * SNORM_RANGE), baseV = floorf(v * SNORM_RANGE);
+    float bestError = -FLT_MAX;
+    for (int k = 0; k < 4; k++) {
+        float candidateU = (std::min)(baseU + float(k & 1), SNORM_RANGE);
+        float candidateV = (std::min)(baseV + float(k >> 1), SNORM_RANGE);
+        float decoded[3];
+        octDecode(candidateU / SNORM_RANGE, candidateV / SNORM_RANGE, decoded);
+        float cosine = decoded[0] * x + decoded[1] * y + decoded[2] * z;
+        if (cosine > bestError) {
+            bestError = cosine;
+            encoded[0] = int16_t(candidateU);
+            encoded[1] = int16_t(candidateV);
+        }
+    }
+}
+
+static inline uint16_t packUnorm16(float value, float offset, float invScale) {
+    float unorm = (std::min)((std::max)((value - offset) * invScale, 0.0f), 1.0f);
+    return uint16_t(lrintf(unorm * UNORM_RANGE));
+}
+
+static void packOne(const float* vertex, int8_t handedness, const VertexQuantization& quantization,
+        const float invScale[3], PackedVertex& packed) {
+    for (int k = 0; k < 3; k++)
+        packed.position[k] = packUnorm16(vertex[k], quantization.offset[k], invScale[k]);
+    packed.position[3] = handedness < 0 ? 0 : 0xFFFF;
+    packed.uv[0] = floatToHalf(vertex[3]);
+    packed.uv[1] = floatToHalf(vertex[4]);
+    octEncode(vertex + 5, packed.normal);
+    octEncode(vertex + 8, packed.tangent);
+}
+
+#if defined(SIMD_SSE)
+static inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 absolute(__m128 x) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+// floorf for |x| < 2^31, SSE2 has no rounding instruction.
+static inline __m128 floor4(__m128 x) {
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+static inline void octDecode4(__m128 u, __m128 v, __m128& x, __m128& y, __m128& z) {
+    const __m128 zero = _mm_setzero_ps();
+    z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), absolute(u)), absolute(v));
+    __m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+    u = _mm_add_ps(u, select(_mm_cmpge_ps(u, zero), _mm_sub_ps(zero, t), t));
+    v = _mm_add_ps(v, select(_mm_cmpge_ps(v, zero), _mm_sub_ps(zero, t), t));
+    __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f),
+        _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(v, v)), _mm_mul_ps(z, z))));
+    x = _mm_mul_ps(u, invLength);
+    y = _mm_mul_ps(v, invLength);
+    z = _mm_mul_ps(z, invLength);
+}
+
+// octEncode for four directions given as components; the steps match the scalar code so
+// both produce the same bits. Lanes with a zero direction encode to (0, 0) as well.
+static void octEncode4(__m128 x, __m128 y, __m128 z, int16_t* encoded, size_t encodedStride) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 range = _mm_set1_ps(SNORM_RANGE);
+
+    __m128 l1 = _mm_add_ps(_mm_add_ps(absolute(x), absolute(y)), absolute(z));
+    __m128 valid = _mm_cmpgt_ps(l1, zero);
+    l1 = select(valid, l1, one);
+    __m128 u = _mm_div_ps(x, l1), v = _mm_div_ps(y, l1);
+
+    __m128 signU = select(_mm_cmpge_ps(u, zero), one, _mm_set1_ps(-1.0f));
+    __m128 signV = select(_mm_cmpge_ps(v, zero), one, _mm_set1_ps(-1.0f));
+    __m128 lower = _mm_cmplt_ps(z, zero);
+    __m128 foldedU = _mm_mul_ps(_mm_sub_ps(one, absolute(v)), signU);
+    __m128 foldedV = _mm_mul_ps(_mm_sub_ps(one, absolute(u)), signV);
+    u = select(lower, foldedU, u);
+    v = select(lower, foldedV, v);
+
+    __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+    x = _mm_mul_ps(x, invLength);
+    y = _mm_mul_ps(y, invLength);
+    z = _mm_mul_ps(z, invLength);
+
+    __m128 baseU = floor4(_mm_mul_ps(u, range)), baseV = floor4(_mm_mul_ps(v, range));
+    __m128 bestError = _mm_set1_ps(-FLT_MAX);
+    __m128 bestU = zero, bestV = zero;
+    for (int k = 0; k < 4; k++) {
+        __m128 candidateU = _mm_min_ps(_mm_add_ps(baseU, _mm_set1_ps(float(k & 1))), range);
+        __m128 candidateV = _mm_min_ps(_mm_add_ps(baseV, _mm_set1_ps(float(k >> 1))), range);
+        __m128 dx, dy, dz;
+        octDecode4(_mm_div_ps(candidateU, range), _mm_div_ps(candidateV, range), dx, dy, dz);
+        __m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, x), _mm_mul_ps(dy, y)), _mm_mul_ps(dz, z));
+        __m128 better = _mm_cmpgt_ps(cosine, bestError);
+        bestError = select(better, cosine, bestError);
+        bestU = select(better, candidateU, bestU);
+        bestV = select(better, candidateV, bestV);
+    }
+
+    alignas(16) int32_t resultU[4], resultV[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(resultU), _mm_and_si128(_mm_castps_si128(valid), _mm_cvtps_epi32(bestU)));
+    _mm_store_si128(reinterpret_cast<__m128i*>(resultV), _mm_and_si128(_mm_castps_si128(valid), _mm_cvtps_epi32(bestV)));
+    for (int k = 0; k < 4; k++) {
+        int16_t* dst = reinterpret_cast<int16_t*>(reinterpret_cast<char*>(encoded) + k * encodedStride);
+        dst[0] = int16_t(resultU[k]);
+        dst[1] = int16_t(resultV[k]);
+    }
+}
+
+// Four vertices at a time, every lane is a vertex.
+static void packFour(const char* vertices, size_t stride, const int8_t* handedness,
+        const VertexQuantization& quantization, const float invScale[3], PackedVertex* packed) {
+    alignas(16) float components[11][4];
+    for (int k = 0; k < 4; k++) {
+        const float* vertex = reinterpret_cast<const float*>(vertices + k * stride);
+        for (int c = 0; c < 11; c++)
+            components[c][k] = vertex[c];
+    }
+    __m128 column[11];
+    for (int c = 0; c < 11; c++)
+        column[c] = _mm_load_ps(components[c]);
+
+    alignas(16) int32_t position[3][4];
+    for (int c = 0; c < 3; c++) {
+        __m128 unorm = _mm_mul_ps(_mm_sub_ps(column[c], _mm_set1_ps(quantization.offset[c])), _mm_set1_ps(invScale[c]));
+        unorm = _mm_min_ps(_mm_max_ps(unorm, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        _mm_store_si128(reinterpret_cast<__m128i*>(position[c]), _mm_cvtps_epi32(_mm_mul_ps(unorm, _mm_set1_ps(UNORM_RANGE))));
+    }
+
+    for (int k = 0; k < 4; k++) {
+        for (int c = 0; c < 3; c++)
+            packed[k].position[c] = uint16_t(position[c][k]);
+        packed[k].position[3] = handedness && handedness[k] < 0 ? 0 : 0xFFFF;
+        packed[k].uv[0] = floatToHalf(components[3][k]);
+        packed[k].uv[1] = floatToHalf(components[4][k]);
+    }
+
+    octEncode4(column[5], column[6], column[7], packed[0].normal, sizeof(PackedVertex));
+    octEncode4(column[8], column[9], column[10], packed[0].tangent, sizeof(PackedVertex));
+}
+#endif
+
+void packVertices(const float* vertices, size_t stride, size_t count, const int8_t* handedness,
+        const VertexQuantization& quantization, PackedVertex* packed) {
+    float invScale[3];
+    for (int k = 0; k < 3; k++)
+        invScale[k] = quantization.scale[k] > 0.0f ? 1.0f / quantization.scale[k] : 0.0f;
+
+    const char* bytes = reinterpret_cast<const char*>(vertices);
+    size_t i = 0;
+
+#if defined(SIMD_SSE)
+    for (; i + 4 <= count; i += 4)
+        packFour(bytes + i * stride, stride, handedness ? handedness + i : nullptr, quantization, invScale, packed + i);
+#endif
+
+    for (; i < count; i++)
+        packOne(reinterpret_cast<const float*>(bytes + i * stride), handedness ? handedness[i] : 1, quantization, invScale, packed[i]);
+}
+
+void unpackVertex(const PackedVertex& packed, const VertexQuantization& quantization, float vertex[11], float& handedness) {
+    for (int k = 0; k < 3; k++)
+        vertex[k] = float(packed.position[k]) / UNORM_RANGE * quantization.scale[k] + quantization.offset[k];
+    vertex[3] = halfToFloat(packed.uv[0]);
+    vertex[4] = halfToFloat(packed.uv[1]);
+    octDecode(packed.normal, vertex + 5);
+    octDecode(packed.tangent, vertex + 8);
+    handedness = packed.position[3] >= 0x8000 ? 1.0f : -1.0f;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Compact form of a TexVertex, 20 bytes instead of 44:
+//   position - R16G16B16A16_UNORM, xyz inside the mesh bounds (see VertexQuantization),
+//              w is the tangent handedness: 0 for -1, 65535 for +1
+//   uv       - R16G16_FLOAT
+//   normal   - R16G16_SNORM, octahedral
+//   tangent  - R16G16_SNORM, octahedral
+// Decoded by CubeCB.hlsli; unpackVertex below is the same code on the CPU.
+struct PackedVertex {
+	uint16_t position[4];
+	uint16_t uv[2];
+	int16_t normal[2];
+	int16_t tangent[2];
+};
+
+// Per-mesh dequantization: position = unorm * scale + offset.
+struct VertexQuantization {
+	float scale[3];
+	float offset[3];
+};
+
+// Vertices are laid out as TexVertex (position, uv, normal, tangent: 11 floats) and read
+// `stride` bytes apart.
+VertexQuantization computeQuantization(const float* vertices, size_t stride, size_t count);
+
+// `handedness` is the sign of the binormal against cross(normal, tangent), one per vertex;
+// null means +1 everywhere, which is what the shaders assumed for the float layout.
+void packVertices(const float* vertices, size_t stride, size_t count, const int8_t* handedness,
+	const VertexQuantization& quantization, PackedVertex* packed);
+
+// vertex receives the 11 TexVertex floats.
+void unpackVertex(const PackedVertex& packed, const VertexQuantization& quantization, float vertex[11], float& handedness);
+
+// Picks the rounding of the octahedral coordinates that decodes closest to `direction`,
+// which does not have to be normalized.
+void octEncode(const float direction[3], int16_t encoded[2]);
+void octDecode(const int16_t encoded[2], float direction[3]);